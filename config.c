@@ -6,6 +6,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <unistd.h>
 
 static const char *home_dir(void) {
@@ -68,12 +69,19 @@ void config_from_env(AppConfig *cfg) {
 
     env_str(cfg->mta_key, sizeof(cfg->mta_key), "MTA_KEY", NULL);
     env_str(cfg->stop_id, sizeof(cfg->stop_id), "STOP_ID", NULL);
+    const char *feed = getenv("MTA_FEED");
+    cfg->mta_gtfs_rt = feed && strcasecmp(feed, "gtfsrt") == 0;
+    env_str(cfg->gtfs_rt_url, sizeof(cfg->gtfs_rt_url), "GTFS_RT_URL",
+            "https://gtfsrt.prod.obanyc.com/tripUpdates");
     env_str(cfg->route_filter, sizeof(cfg->route_filter), "ROUTE_FILTER", NULL);
     env_str(cfg->stop_name_override, sizeof(cfg->stop_name_override), "STOP_NAME", NULL);
     env_str(cfg->aplay_device, sizeof(cfg->aplay_device), "APLAY_DEVICE", NULL);
 
     cfg->poll_seconds = env_int("POLL_SECONDS", 10, 5, 3600);
+    cfg->poll_min_seconds = env_int("POLL_MIN_SECONDS", 5, 2, cfg->poll_seconds);
+    cfg->poll_max_seconds = env_int("POLL_MAX_SECONDS", 600, cfg->poll_seconds, 3600);
     cfg->max_tiles = env_int("MAX_TILES", TILE_SLOTS_MAX, 1, TILE_SLOTS_MAX);
+    cfg->ambient_fps = env_int("AMBIENT_FPS", 15, 0, 60);
 
     env_str(cfg->gtfs_url, sizeof(cfg->gtfs_url), "GTFS_BUS_URL",
             "https://rrgtfsfeeds.s3.amazonaws.com/gtfs_busco.zip");
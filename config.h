@@ -10,12 +10,17 @@ typedef struct AppConfig {
     char symbol_font_path[512];
     char emoji_font_path[512];  /* required for moon/weather glyphs; no fallback */
     char mta_key[128];
-    char stop_id[64];
+    int mta_gtfs_rt;        /* MTA_FEED=gtfsrt: arrivals from GTFS-Realtime instead of SIRI */
+    char gtfs_rt_url[512];  /* GTFS_RT_URL: TripUpdates feed */
+    char stop_id[256];      /* STOP_ID: one stop, or up to STOP_IDS_MAX comma-separated */
     char route_filter[256];
-    int poll_seconds;
+    int poll_seconds;       /* POLL_SECONDS: interval with buses on the board */
+    int poll_min_seconds;   /* POLL_MIN_SECONDS: a bus is about to arrive */
+    int poll_max_seconds;   /* POLL_MAX_SECONDS: outside service hours */
     int max_tiles;
+    int ambient_fps;        /* AMBIENT_FPS: frame rate for steam/eyes; 0 = freeze them */
     char stop_name_override[256];
-    char gtfs_url[512];
+    char gtfs_url[2048];    /* GTFS_BUS_URL: one or more feed URLs */
     char gtfs_cache[512];
     char music_path[512];
     char music_loop2_path[512];
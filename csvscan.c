@@ -0,0 +1,136 @@
+/*
+ * CSV column locator: compare-and-movemask over 16/32-byte blocks, scalar tail.
+ * The vector path is picked at compile time from the target flags (-mavx2, NEON on
+ * ARMv7/AArch64); ARMv6 Pi builds and anything else scan 8 bytes per step in a
+ * plain 64-bit word. parse_csv_line() is the byte-at-a-time field split.
+ */
+#include "csvscan.h"
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/* Some block path below is compiled in (the byte loop alone needs no masks). */
+#if defined(__SSE2__) || defined(__ARM_NEON) || \
+    (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define CSV_BLOCKS 1
+#endif
+
+typedef struct {
+    int    col;         /* column wanted */
+    int    seen;        /* delimiters passed so far */
+    size_t start;       /* offset of the current column */
+} CsvScan;
+
+#ifdef CSV_BLOCKS
+/* Walk one block's masks: one set bit per matching byte, byte k owning bits
+ * [k << shift, (k + 1) << shift). Returns 1 with *res set once the column has ended (or a quote makes the count
+ * unreliable, *res = -1), else 0 to continue with the next block. */
+static int csv_block(CsvScan *s, uint64_t commas, uint64_t quotes, unsigned shift, size_t base,
+                     long *res, size_t *col_len) {
+    uint64_t first_quote = quotes & (~quotes + 1);
+    while (commas) {
+        uint64_t bit = commas & (~commas + 1);
+        if (quotes && first_quote < bit) { *res = -1; return 1; }
+        size_t pos = base + ((size_t)__builtin_ctzll(commas) >> shift);
+        if (s->seen == s->col) {
+            *col_len = pos - s->start;
+            *res = (long)s->start;
+            return 1;
+        }
+        s->seen++;
+        s->start = pos + 1;
+        commas &= commas - 1;
+    }
+    if (quotes) { *res = -1; return 1; }
+    return 0;
+}
+#endif
+
+long csv_column(const char *line, size_t len, int col, size_t *col_len) {
+    CsvScan s = { col, 0, 0 };
+    size_t i = 0;
+#ifdef CSV_BLOCKS
+    long res;
+#endif
+#if defined(__AVX2__)
+    const __m256i comma32 = _mm256_set1_epi8(','), quote32 = _mm256_set1_epi8('"');
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(line + i));
+        uint64_t c = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, comma32));
+        uint64_t q = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, quote32));
+        if ((c | q) && csv_block(&s, c, q, 0, i, &res, col_len)) return res;
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i comma16 = _mm_set1_epi8(','), quote16 = _mm_set1_epi8('"');
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(line + i));
+        uint64_t c = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, comma16));
+        uint64_t q = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote16));
+        if ((c | q) && csv_block(&s, c, q, 0, i, &res, col_len)) return res;
+    }
+#elif defined(__ARM_NEON)
+    /* No movemask on NEON: narrow each 0x00/0xFF byte to a nibble and keep one bit of it. */
+    const uint8x16_t comma16 = vdupq_n_u8(','), quote16 = vdupq_n_u8('"');
+    for (; i + 16 <= len; i += 16) {
+        uint8x16_t v = vld1q_u8((const uint8_t *)(line + i));
+        uint8x8_t cn = vshrn_n_u16(vreinterpretq_u16_u8(vceqq_u8(v, comma16)), 4);
+        uint8x8_t qn = vshrn_n_u16(vreinterpretq_u16_u8(vceqq_u8(v, quote16)), 4);
+        uint64_t c = vget_lane_u64(vreinterpret_u64_u8(cn), 0) & 0x1111111111111111ull;
+        uint64_t q = vget_lane_u64(vreinterpret_u64_u8(qn), 0) & 0x1111111111111111ull;
+        if ((c | q) && csv_block(&s, c, q, 2, i, &res, col_len)) return res;
+    }
+#elif defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    /* Word at a time: a byte equal to the target becomes 0, then sets its high bit. */
+    const uint64_t ones = 0x0101010101010101ull, low7 = 0x7F7F7F7F7F7F7F7Full;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t w, c, q;
+        memcpy(&w, line + i, sizeof(w));
+        c = w ^ (ones * ',');
+        q = w ^ (ones * '"');
+        c = ~(((c & low7) + low7) | c | low7);
+        q = ~(((q & low7) + low7) | q | low7);
+        if ((c | q) && csv_block(&s, c, q, 3, i, &res, col_len)) return res;
+    }
+#endif
+    for (; i < len; i++) {
+        if (line[i] == '"') return -1;
+        if (line[i] != ',') continue;
+        if (s.seen == col) {
+            *col_len = i - s.start;
+            return (long)s.start;
+        }
+        s.seen++;
+        s.start = i + 1;
+    }
+    if (s.seen != col) return -1;
+    *col_len = len - s.start;
+    return (long)s.start;
+}
+
+int parse_csv_line(char *line, char *fields[], int max_fields) {
+    int n = 0;
+    char *p = line;
+    while (n < max_fields && *p) {
+        fields[n++] = p;
+        if (*p == '"') {
+            p++;
+            fields[n - 1] = p;
+            while (*p && *p != '"') p++;
+            if (*p == '"') *p++ = '\0';
+            while (*p && *p != ',') p++;
+            if (*p) *p++ = '\0';
+        } else {
+            while (*p && *p != ',') p++;
+            if (*p) *p++ = '\0';
+        }
+    }
+    return n;
+}
@@ -0,0 +1,17 @@
+/*
+ * GTFS CSV lines: a column locator that finds delimiters 8-32 bytes at a time
+ * (SSE2/AVX2 on x86, NEON on ARM, 64-bit words elsewhere) so rows can be tested
+ * on one field in place before the full parse_csv_line() split.
+ */
+#pragma once
+
+#include <stddef.h>
+
+/* Locate column col (0-based) of line[0..len). Returns its offset and sets *col_len,
+ * or returns -1 if the line has fewer columns or a '"' occurs before the column ends
+ * (quoted fields: the caller falls back to the full parser). */
+long csv_column(const char *line, size_t len, int col, size_t *col_len);
+
+/* Split a NUL-terminated line in place at commas into fields[] (at most max_fields),
+ * unquoting "..." fields. Returns the field count. */
+int parse_csv_line(char *line, char *fields[], int max_fields);
@@ -0,0 +1,271 @@
+/*
+ * csv_column() on every code path this host can run (the build's own vector path, the
+ * 64-bit word path, the byte loop, and AVX2 where the compiler and CPU have it)
+ * against a byte-at-a-time reference, over fixed edge cases and random lines.
+ *
+ *   csvscan_test            check
+ *   csvscan_test -b [file]  MB/s of each path and of parse_csv_line() over the
+ *                           stop_id column of file (default: synthetic stop_times.txt)
+ */
+#include "csvscan.h"
+#include "test.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* csvscan.c rebuilt with the vector paths compiled out (see the Makefile). */
+long csv_column_swar(const char *line, size_t len, int col, size_t *col_len);
+long csv_column_scalar(const char *line, size_t len, int col, size_t *col_len);
+#ifdef CSVSCAN_TEST_AVX2
+long csv_column_avx2(const char *line, size_t len, int col, size_t *col_len);
+#endif
+
+typedef long (*ColumnFn)(const char *line, size_t len, int col, size_t *col_len);
+
+#if defined(__AVX2__)
+#define NATIVE_NAME "avx2"
+#elif defined(__SSE2__)
+#define NATIVE_NAME "sse2"
+#elif defined(__ARM_NEON)
+#define NATIVE_NAME "neon"
+#else
+#define NATIVE_NAME "swar"
+#endif
+
+static struct { const char *name; ColumnFn fn; } s_paths[4];
+static int s_n_paths;
+
+static void paths_init(void) {
+    s_paths[s_n_paths].name = NATIVE_NAME;
+    s_paths[s_n_paths++].fn = csv_column;
+#ifdef CSVSCAN_TEST_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        s_paths[s_n_paths].name = "avx2";
+        s_paths[s_n_paths++].fn = csv_column_avx2;
+    }
+#endif
+    s_paths[s_n_paths].name = "swar";
+    s_paths[s_n_paths++].fn = csv_column_swar;
+    s_paths[s_n_paths].name = "scalar";
+    s_paths[s_n_paths++].fn = csv_column_scalar;
+}
+
+/* The contract in csvscan.h, one byte at a time. */
+static long ref_column(const char *line, size_t len, int col, size_t *col_len) {
+    int seen = 0;
+    size_t start = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (line[i] == '"') return -1;
+        if (line[i] != ',') continue;
+        if (seen == col) {
+            *col_len = i - start;
+            return (long)start;
+        }
+        seen++;
+        start = i + 1;
+    }
+    if (seen != col) return -1;
+    *col_len = len - start;
+    return (long)start;
+}
+
+/* Every path agrees with the reference on line[0..len) for columns 0..max_col. */
+static int check_line(const char *line, size_t len, int max_col) {
+    int bad = 0;
+    for (int col = 0; col <= max_col; col++) {
+        size_t want_len = 0;
+        long want = ref_column(line, len, col, &want_len);
+        for (int p = 0; p < s_n_paths; p++) {
+            size_t got_len = (size_t)-1;
+            long got = s_paths[p].fn(line, len, col, &got_len);
+            if (got != want || (want >= 0 && got_len != want_len)) {
+                if (bad++ < 5)
+                    fprintf(stderr, "csv_column %s: col %d of \"%.*s\": got %ld/%zu, want %ld/%zu\n",
+                            s_paths[p].name, col, (int)len, line, got, got_len, want, want_len);
+            }
+        }
+    }
+    return bad;
+}
+
+/* One path's answer as "start:len" (or "-1"), to pin expected values. */
+static const char *col_of(ColumnFn fn, const char *line, int col) {
+    static char out[32];
+    size_t n = 0;
+    long at = fn(line, strlen(line), col, &n);
+    if (at < 0) snprintf(out, sizeof(out), "-1");
+    else snprintf(out, sizeof(out), "%ld:%zu", at, n);
+    return out;
+}
+
+static void check_fixed(void) {
+    static const struct { const char *line; int col; const char *want; } cases[] = {
+        /* final column, no newline */
+        { "trip,08:00:00,08:00:00,501627", 3, "23:6" },
+        { "a", 0, "0:1" },
+        { "", 0, "0:0" },
+        { "a,b,", 2, "4:0" },
+        /* fewer columns than asked for */
+        { "a,b", 2, "-1" },
+        { "", 1, "-1" },
+        { "trip,08:00:00", 7, "-1" },
+        /* quoted fields: fine before the column, fall back once a quote is reached */
+        { "\"a,b\",c,d", 0, "-1" },
+        { "x,\"a,b\",c", 0, "0:1" },
+        { "x,\"a,b\",c", 1, "-1" },
+        { "x,\"a,b\",c", 2, "-1" },
+        { "0123456789abcdef0123456789abcdef0,\"q\"", 0, "0:33" },
+        { "0123456789abcdef0123456789abcdef0,\"q\"", 1, "-1" },
+        /* delimiters on the 8/16/32-byte block edges */
+        { "0123456,89abcde,0123456789abcdef0123456789abcde,x", 2, "16:31" },
+        { "0123456789abcdef0123456789abcde,0123456789abcdef0123456789abcde,z", 2, "64:1" },
+        { ",,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,", 39, "39:0" },
+        { ",,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,", 40, "40:0" },
+        { ",,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,", 41, "-1" },
+        /* CR left on the last field by the caller */
+        { "a,b,c\r", 2, "4:2" },
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        for (int p = 0; p < s_n_paths; p++) {
+            const char *got = col_of(s_paths[p].fn, cases[i].line, cases[i].col);
+            if (strcmp(got, cases[i].want) != 0) {
+                fprintf(stderr, "csv_column %s: col %d of \"%s\" = %s, want %s\n", s_paths[p].name,
+                        cases[i].col, cases[i].line, got, cases[i].want);
+                test_failures++;
+            }
+        }
+        test_failures += check_line(cases[i].line, strlen(cases[i].line), 12) != 0;
+    }
+}
+
+/* Random lines at every alignment: mostly field text, some commas, rare quotes. */
+static void check_random(void) {
+    static char buf[512 + 64];
+    uint64_t x = 0x9E3779B97F4A7C15ull;
+    int bad = 0;
+    for (int iter = 0; iter < 200000; iter++) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        size_t len = (size_t)(x % 300);
+        size_t off = (size_t)((x >> 20) % 32);
+        int comma_rate = 2 + (int)((x >> 30) % 20);
+        int quotes = ((x >> 40) & 7) == 0;
+        for (size_t i = 0; i < len; i++) {
+            x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+            int r = (int)(x % 1000);
+            buf[off + i] = r < 1000 / comma_rate ? ',' : (quotes && r > 990) ? '"' : (char)('a' + r % 26);
+        }
+        bad += check_line(buf + off, len, 40) != 0;
+    }
+    CHECK(bad == 0);
+}
+
+/* ---- benchmark ---------------------------------------------------------------- */
+
+/* stop_times.txt in the MTA layout, about 50 MB. */
+static char *synth_stop_times(size_t *len) {
+    size_t cap = 48u << 20, n = 0;
+    char *b = malloc(cap + 256);
+    if (!b) return NULL;
+    n += (size_t)sprintf(b, "trip_id,arrival_time,departure_time,stop_id,stop_sequence,pickup_type,"
+                            "drop_off_type,timepoint\n");
+    for (unsigned i = 0; n < cap; i++) {
+        unsigned t = 5 * 3600 + (i * 37) % 80000;
+        n += (size_t)sprintf(b + n, "QV_B5-Weekday-SDon-%06u_Q%u_%u,%02u:%02u:00,%02u:%02u:00,%u,%u,0,0,%u\n",
+                             i / 40 * 100, 1 + i % 90, 100 + i % 500, t / 3600, t / 60 % 60,
+                             t / 3600, t / 60 % 60, 500000 + (i * 7919) % 9000, 1 + i % 40, i % 3 == 0);
+    }
+    *len = n;
+    return b;
+}
+
+typedef struct { size_t off, len; } LineRef;
+
+static void bench(const char *path) {
+    size_t len = 0;
+    char *data = path ? test_read_file(path, &len) : synth_stop_times(&len);
+    if (!data) {
+        fprintf(stderr, "csvscan_test: cannot read %s\n", path ? path : "(synthetic)");
+        test_failures++;
+        return;
+    }
+    /* Lines as the loader hands them over: CR/LF cut, NUL-terminated. */
+    size_t n_lines = 0, cap = 1 << 20;
+    LineRef *lines = malloc(cap * sizeof(LineRef));
+    for (size_t p = 0; lines && p < len;) {
+        char *nl = memchr(data + p, '\n', len - p);
+        size_t e = nl ? (size_t)(nl - data) : len;
+        size_t next = nl ? e + 1 : len;
+        if (e > p && data[e - 1] == '\r') e--;
+        data[e] = '\0';
+        if (n_lines == cap) {
+            LineRef *nb = realloc(lines, (cap *= 2) * sizeof(LineRef));
+            if (!nb) break;
+            lines = nb;
+        }
+        lines[n_lines++] = (LineRef){ p, e - p };
+        p = next;
+    }
+    char *copy = malloc(len + 1);
+    if (!lines || !copy) {
+        free(lines);
+        free(copy);
+        free(data);
+        return;
+    }
+    const double mb = (double)len / 1e6;
+    printf("csvscan bench: %s, %.1f MB, %zu lines, stop_id column\n", path ? path : "synthetic stop_times.txt",
+           mb, n_lines);
+
+    /* parse_csv_line() splits every row; it writes NULs, so each rep gets a fresh copy. */
+    double best = 1e30;
+    unsigned long sink = 0;
+    for (int rep = 0; rep < 5; rep++) {
+        memcpy(copy, data, len + 1);
+        double t0 = test_now_ms();
+        for (size_t i = 0; i < n_lines; i++) {
+            char *f[32];
+            if (parse_csv_line(copy + lines[i].off, f, 32) >= 4) sink += (unsigned char)f[3][0];
+        }
+        double ms = test_now_ms() - t0;
+        if (ms < best) best = ms;
+    }
+    const double split_ms = best;
+    printf("  %-22s %8.1f MB/s\n", "parse_csv_line", mb / (split_ms / 1000.0));
+
+    for (int p = -1; p < s_n_paths; p++) {
+        ColumnFn fn = p < 0 ? ref_column : s_paths[p].fn;
+        char name[32];
+        snprintf(name, sizeof(name), "csv_column %s", p < 0 ? "reference" : s_paths[p].name);
+        best = 1e30;
+        for (int rep = 0; rep < 5; rep++) {
+            double t0 = test_now_ms();
+            for (size_t i = 0; i < n_lines; i++) {
+                size_t n;
+                long at = fn(data + lines[i].off, lines[i].len, 3, &n);
+                if (at >= 0) sink += n;
+            }
+            double ms = test_now_ms() - t0;
+            if (ms < best) best = ms;
+        }
+        printf("  %-22s %8.1f MB/s  (%.1fx parse_csv_line)\n", name, mb / (best / 1000.0), split_ms / best);
+    }
+    if (sink == 0) printf("  (no rows)\n");
+    free(copy);
+    free(lines);
+    free(data);
+}
+
+int main(int argc, char **argv) {
+    paths_init();
+    if (argc >= 2 && strcmp(argv[1], "-b") == 0) {
+        bench(argc >= 3 ? argv[2] : NULL);
+        return test_failures ? 1 : 0;
+    }
+    printf("csvscan_test: paths");
+    for (int p = 0; p < s_n_paths; p++) printf(" %s", s_paths[p].name);
+    printf("\n");
+    check_fixed();
+    check_random();
+    return test_done("csvscan_test");
+}
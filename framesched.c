@@ -0,0 +1,88 @@
+/*
+ * Frame pacing for the render loop. Render thread only.
+ */
+#include "framesched.h"
+#include "util.h"
+#include <string.h>
+
+#define FRAME_FULL_MS       16      /* ~60 fps; vsync paces the present */
+#define FRAME_INPUT_POLL_MS 20      /* setup button debounce needs several reads */
+
+static const char *frame_mode_str(FrameMode m) {
+    switch (m) {
+        case FRAME_MODE_FULL: return "FULL";
+        case FRAME_MODE_AMBIENT: return "AMBIENT";
+        case FRAME_MODE_IDLE: return "IDLE";
+        default: return "UNKNOWN";
+    }
+}
+
+void frame_sched_init(FrameSched *fs, int ambient_fps) {
+    memset(fs, 0, sizeof(*fs));
+    fs->full_ms = FRAME_FULL_MS;
+    fs->ambient_ms = ambient_fps > 0 ? 1000 / ambient_fps : 0;
+    if (fs->ambient_ms && fs->ambient_ms < fs->full_ms) fs->ambient_ms = fs->full_ms;
+    fs->mode = FRAME_MODE_FULL;
+    fs->stats_ticks = SDL_GetTicks();
+    getrusage(RUSAGE_SELF, &fs->stats_usage);
+}
+
+static int frame_period(const FrameSched *fs) {
+    switch (fs->mode) {
+        case FRAME_MODE_FULL: return fs->full_ms;
+        case FRAME_MODE_AMBIENT: return fs->ambient_ms;
+        default: return -1;
+    }
+}
+
+int frame_sched_due(const FrameSched *fs, Uint32 now) {
+    int period = frame_period(fs);
+    return period >= 0 && (int)(now - fs->last_frame) >= period - 1;
+}
+
+void frame_sched_rendered(FrameSched *fs, Uint32 now, int flipping, int ambient) {
+    fs->rendered[fs->mode]++;
+    fs->last_frame = now;
+    if (flipping)
+        fs->mode = FRAME_MODE_FULL;
+    else if (ambient && fs->ambient_ms)
+        fs->mode = FRAME_MODE_AMBIENT;
+    else
+        fs->mode = FRAME_MODE_IDLE;
+}
+
+void frame_sched_idle_wakeup(FrameSched *fs) {
+    fs->wakeups++;
+}
+
+int frame_sched_wait_ms(const FrameSched *fs, Uint32 now) {
+    int period = frame_period(fs);
+    int wait = FRAME_INPUT_POLL_MS;
+    if (period >= 0) {
+        int left = period - (int)(now - fs->last_frame);
+        if (left < wait) wait = left;
+    }
+    return wait > 0 ? wait : 0;
+}
+
+static double tv_sec(struct timeval tv) {
+    return (double)tv.tv_sec + (double)tv.tv_usec / 1e6;
+}
+
+void frame_sched_log_stats(FrameSched *fs, Uint32 now) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    double wall = (double)(now - fs->stats_ticks) / 1000.0;
+    double cpu = tv_sec(ru.ru_utime) - tv_sec(fs->stats_usage.ru_utime) +
+                 tv_sec(ru.ru_stime) - tv_sec(fs->stats_usage.ru_stime);
+    long frames = fs->rendered[FRAME_MODE_FULL] + fs->rendered[FRAME_MODE_AMBIENT] +
+                  fs->rendered[FRAME_MODE_IDLE];
+    logf_("FRAME_STATS fps=%.1f frames full=%ld ambient=%ld idle=%ld wakeups=%ld mode=%s cpu=%.1f%%",
+          wall > 0 ? (double)frames / wall : 0.0, fs->rendered[FRAME_MODE_FULL],
+          fs->rendered[FRAME_MODE_AMBIENT], fs->rendered[FRAME_MODE_IDLE], fs->wakeups,
+          frame_mode_str(fs->mode), wall > 0 ? 100.0 * cpu / wall : 0.0);
+    memset(fs->rendered, 0, sizeof(fs->rendered));
+    fs->wakeups = 0;
+    fs->stats_ticks = now;
+    fs->stats_usage = ru;
+}
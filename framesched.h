@@ -0,0 +1,45 @@
+/*
+ * Render loop pacing: full rate while tiles flip, AMBIENT_FPS for the steam and eye
+ * effects, and otherwise no frames until something on the board changes. Between
+ * frames the loop still wakes every FRAME_INPUT_POLL_MS to poll input and the setup
+ * button, without drawing.
+ */
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <sys/resource.h>
+
+typedef enum {
+    FRAME_MODE_FULL = 0,        /* split-flap flips: every vsync */
+    FRAME_MODE_AMBIENT,         /* only ambient effects move: AMBIENT_FPS */
+    FRAME_MODE_IDLE,            /* nothing moves: draw only when the board changes */
+    FRAME_MODE_COUNT
+} FrameMode;
+
+typedef struct {
+    int       full_ms, ambient_ms;      /* frame periods; ambient_ms 0 = effects frozen */
+    FrameMode mode;
+    Uint32    last_frame;               /* ticks of the last rendered frame */
+    long      rendered[FRAME_MODE_COUNT];   /* since the last frame_sched_log_stats() */
+    long      wakeups;                  /* loop iterations that drew nothing */
+    Uint32    stats_ticks;
+    struct rusage stats_usage;
+} FrameSched;
+
+/* ambient_fps 0 freezes ambient effects, so a still board goes idle. */
+void frame_sched_init(FrameSched *fs, int ambient_fps);
+
+/* 1 if the current mode wants a frame at now (animation), whether or not data changed. */
+int frame_sched_due(const FrameSched *fs, Uint32 now);
+
+/* Count a frame rendered at now and pick the next mode from what it showed moving. */
+void frame_sched_rendered(FrameSched *fs, Uint32 now, int flipping, int ambient);
+
+/* Count a wakeup that drew nothing. */
+void frame_sched_idle_wakeup(FrameSched *fs);
+
+/* Milliseconds to wait (in SDL_WaitEventTimeout) before the next loop iteration. */
+int frame_sched_wait_ms(const FrameSched *fs, Uint32 now);
+
+/* Log frames per mode, effective fps and process CPU% since the last call. */
+void frame_sched_log_stats(FrameSched *fs, Uint32 now);
@@ -3,11 +3,21 @@
  * Timezone America/New_York. Uses cache file; updates daily.
  */
 #include "gtfs.h"
+#include "csvscan.h"
+#include "pool.h"
+#include "snapshot.h"
+#include "tz.h"
 #include "util.h"
+#include "zip.h"
 #include <ctype.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
 
@@ -17,115 +27,278 @@ enum {
     GTFS_STATUS_ALLOC_FAIL = 2,
     GTFS_STATUS_DOWNLOAD_FAIL = 3,
     GTFS_STATUS_PARSE_FAIL = 4,
+    GTFS_STATUS_NO_CACHE = 5,       /* GTFS_BUS_URL=none and no zip at the cache path */
 };
 
-#define MAX_ROUTES   512
-#define MAX_TRIPS    4000
-#define MAX_STOPTIMES_AT_STOP 8000
-#define MAX_STOPS    16000
-#define MAX_CALENDAR 128
-#define MAX_CAL_DATES 4096
-#define MAX_SERVICE_IDS 128
+/* GTFS_BUS_URL entry for a board that never downloads: the zip at the cache path (e.g. a
+ * gtfs_slice micro-feed put there by fleet tooling) is parsed as is, and reparsed when
+ * its content changes. */
+#define GTFS_URL_LOCAL "none"
+
+#define MAX_SERVICE_IDS 512
+#define MAX_STOP_FILTER_IDS 32
+#define SERVICE_WINDOW_DAYS 14                      /* service days searched ahead */
+#define WINDOW_TIME_DAYS    (SERVICE_WINDOW_DAYS + 3) /* + after-midnight times up to 72:00 */
+#define TIMELINE_DAYS       2                       /* timeline holds departures before day 2's midnight */
+#define GTFS_MAX_THREADS    4                       /* load threads, including the caller */
+#define GTFS_MAX_FEEDS      4                       /* GTFS_BUS_URL entries */
+#define GTFS_RECHECK_SECS   86400                   /* conditional refetch of a loaded feed */
+#define GTFS_RETRY_SECS     3600                    /* ... and of one whose download failed */
+
+/* String fields are Str handles: offsets into the feed's interned string pool. */
+typedef uint32_t Str;
 
 typedef struct {
-    char route_id[64];
-    char short_name[32];
+    Str route_id;
+    Str short_name;
 } GtfsRoute;
 
 typedef struct {
-    char trip_id[64];
-    char route_id[64];
-    char service_id[64];
-    char headsign[128];
+    Str trip_id;
+    Str route_id;
+    Str service_id;
+    Str headsign;
 } GtfsTrip;
 
 typedef struct {
-    char trip_id[64];
+    Str trip_id;
     int arrival_mins;
+    int stop;                   /* STOP_ID list entry whose stop this is */
 } GtfsStopTime;
 
 typedef struct {
-    char stop_id[32];
-    char stop_code[32];
+    Str stop_id;
+    Str stop_code;
 } GtfsStop;
 
 typedef struct {
-    char service_id[64];
-    int start_ymd;
-    int end_ymd;
-    int dow[7];
+    Str     service_id;
+    int     start_ymd;
+    int     end_ymd;
+    uint8_t dow;                /* bit 0 = Sunday */
 } GtfsCalendar;
 
 typedef struct {
-    char service_id[64];
+    Str service_id;
     int date_ymd;
     int exception_type;
 } GtfsCalendarDate;
 
+/* One service_id with its active days in the current window (bit d = window day d). */
+typedef struct {
+    Str      service_id;
+    uint32_t active;
+} GtfsService;
+
+/* One departure in the stop timeline. */
+typedef struct {
+    time_t when;
+    int    lane;                /* route * n_list_stops + STOP_ID list entry */
+    int    trip;                /* trips[] index (headsign) */
+    int    seq;                 /* build order: ties keep the first, like the old scan */
+} TimelineEntry;
+
+/* The resolved stops' departures from the start of the window until TIMELINE_DAYS
+ * midnights later, grouped into lanes (one per route and listed stop) and time-sorted
+ * within each lane. Lanes whose next departure lies beyond that keep it in
+ * far_when/far_trip. */
 typedef struct {
-    GtfsRoute        *routes;
-    int               n_routes;
+    TimelineEntry *e;
+    int            n, cap;
+    int           *begin;       /* n_lanes + 1: lane l owns e[begin[l] .. begin[l+1]) */
+    int           *cur;         /* first entry of lane l not yet departed */
+    time_t        *far_when;    /* (time_t)-1 if none */
+    int           *far_trip;
+    int           *st_count;    /* stop_times per lane (for the log line) */
+    int            n_lanes;     /* size of the per-lane arrays */
+    int            n_stops;     /* lanes per route: STOP_ID list entries */
+    int            orphan_express;          /* express stop_times whose route is not in routes.txt */
+    int            valid;
+} StopTimeline;
+
+/* One local calendar day in the window. Local time on this day is
+ * midnight + mins * 60, plus shift_secs from minute shift_at on (DST change days). */
+typedef struct {
+    int    ymd;
+    time_t midnight;
+    int    shift_at;            /* 24 * 60 when the day has no UTC offset change */
+    int    shift_secs;
+} GtfsDay;
+
+/* ---- Id indexes --------------------------------------------------------------
+ * Open-addressing string -> row maps over the feed arrays, rebuilt whenever the
+ * arrays they cover are reloaded. Slots hold row index + 1 (0 = empty); the key is
+ * the row's Str handle, resolved through the string pool, so nothing is copied.
+ * -------------------------------------------------------------------------- */
+
+typedef struct {
+    int        *slot;       /* NULL if allocation failed: lookups fall back to a scan */
+    uint32_t    mask;
+    const char *rows;       /* base of the indexed array */
+    int         n_rows;
+    size_t      stride;     /* sizeof one row */
+    size_t      key_off;    /* offsetof the Str key in the row */
+    const StrTab *strs;     /* pool the key handles point into */
+} IdIndex;
+
+static uint32_t id_hash(const char *s) {
+    uint32_t h = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)s; *p; p++) {
+        h ^= *p;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static const char *id_key(const IdIndex *ix, int row) {
+    Str h;
+    memcpy(&h, ix->rows + (size_t)row * ix->stride + ix->key_off, sizeof(h));
+    return ix->strs->buf + h;
+}
+
+/* Index rows[0..n) by key; duplicate keys keep the first row, like the old linear scans. */
+static int id_index_build(IdIndex *ix, const StrTab *strs, const void *rows, int n,
+                          size_t stride, size_t key_off) {
+    ix->strs = strs;
+    ix->rows = (const char *)rows;
+    ix->n_rows = n;
+    ix->stride = stride;
+    ix->key_off = key_off;
+    uint32_t n_slots = 64;
+    while (n_slots < (uint32_t)n * 2) n_slots *= 2;
+    if (!ix->slot || ix->mask + 1 < n_slots) {
+        int *s = realloc(ix->slot, n_slots * sizeof(int));
+        if (!s) {
+            free(ix->slot);
+            ix->slot = NULL;
+            return -1;
+        }
+        ix->slot = s;
+        ix->mask = n_slots - 1;
+    }
+    memset(ix->slot, 0, (ix->mask + 1) * sizeof(int));
+    for (int i = 0; i < n; i++) {
+        const char *k = id_key(ix, i);
+        uint32_t j = id_hash(k) & ix->mask;
+        while (ix->slot[j] && strcmp(id_key(ix, ix->slot[j] - 1), k) != 0)
+            j = (j + 1) & ix->mask;
+        if (!ix->slot[j]) ix->slot[j] = i + 1;
+    }
+    return 0;
+}
+
+/* Row index of key, or -1. */
+static int id_index_find(const IdIndex *ix, const char *key) {
+    if (!key) return -1;
+    if (!ix->slot) {
+        for (int i = 0; i < ix->n_rows; i++)
+            if (strcmp(id_key(ix, i), key) == 0) return i;
+        return -1;
+    }
+    uint32_t j = id_hash(key) & ix->mask;
+    while (ix->slot[j]) {
+        int row = ix->slot[j] - 1;
+        if (strcmp(id_key(ix, row), key) == 0) return row;
+        j = (j + 1) & ix->mask;
+    }
+    return -1;
+}
+
+typedef struct {
+    StrTab            strs;             /* every id, name and headsign, stored once */
+    GtfsRoute        *routes;           /* tables grow as parsed; freed with the feed */
+    int               n_routes, cap_routes;
     GtfsTrip         *trips;
-    int               n_trips;
+    int               n_trips, cap_trips;
     GtfsStopTime     *stop_times;
-    int               n_stop_times;
+    int               n_stop_times, cap_stop_times;
     GtfsStop         *stops;
-    int               n_stops;
+    int               n_stops, cap_stops;
     GtfsCalendar     *calendars;
-    int               n_calendars;
+    int               n_calendars, cap_calendars;
     GtfsCalendarDate *cal_dates;
-    int               n_cal_dates;
+    int               n_cal_dates, cap_cal_dates;
     char              cache_path[512];
     int               loaded;
     int               stop_times_cached;
-    char              cached_stop_id[64];
+    char              cached_stop_id[256];                        /* STOP_ID list of the slice */
+    char              stop_filter_ids[MAX_STOP_FILTER_IDS][32];   /* stop_ids sharing the stops' codes */
+    unsigned char     stop_filter_stop[MAX_STOP_FILTER_IDS];      /* list entry of each filter id */
+    int               n_stop_filter_ids;
+    char              list_stops[STOP_IDS_MAX][32];               /* STOP_ID list entries */
+    int               n_list_stops;
+    char              stop_id_resolved[32];
+    Snapshot          snap;             /* compiled tables for the current zip, if any */
+    int               have_snap;
+    int               read_only;        /* never write <zip>.snap / <zip>.stop (gtfs_slice) */
+    uint64_t          zip_hash;         /* zip_content_hash() of the parsed zip */
+    IdIndex           route_ix;         /* route_id -> routes[] */
+    IdIndex           trip_ix;          /* trip_id -> trips[] (stop slice) */
+    IdIndex           st_ix;            /* trip_id -> stop_times[], while trips.txt is filtered */
+    IdIndex           cal_ix;           /* service_id -> first calendars[] row */
+    IdIndex           cd_ix;            /* service_id -> first cal_dates[] row */
+    int              *cal_next;         /* next row with the same service_id, or -1 */
+    int              *cd_next;
+    GtfsService       services[MAX_SERVICE_IDS];
+    int               n_services;
+    int               services_full;    /* more service_ids than MAX_SERVICE_IDS */
+    IdIndex           service_ix;       /* service_id -> services[] */
+    GtfsDay           days[WINDOW_TIME_DAYS];
+    int               window_ymd;       /* NY date the window starts on; 0 = rebuild */
+    StopTimeline      tl;
+    unsigned char    *route_excl;       /* route_excluded() per route for excl_for */
+    char              excl_for[1024];
+    int               excl_valid;
+    int               oom;              /* a table, index or string failed to allocate */
+    int               corrupt;          /* a member failed to inflate or its CRC-32: not published */
+    pthread_mutex_t  *intern_lock;      /* set while members are parsed concurrently */
+    atomic_int        refs;             /* one for its slot, one per reader in flight */
+    pthread_mutex_t   query_lock;       /* stop slice, window and timeline are built lazily */
 } GtfsFeed;
 
-static GtfsFeed feed;
+/*
+ * One live feed per GTFS_BUS_URL entry. Each has its own cache file, string pool and
+ * indexes, so its ids never collide with another feed's; queries run on every feed and
+ * merge the results. A feed is immutable once published except for the lazily built
+ * query state, which query_lock guards. A reload builds a complete new feed off to the
+ * side and swaps the slot's pointer; the old one is freed when its last reader releases it.
+ */
+typedef struct {
+    GtfsFeed *feed;             /* live feed, or NULL */
+    char      url[1024];        /* loader-only from here down */
+    char      cache_path[512];
+    time_t    next_check;       /* 0 = due on the next gtfs_load() */
+    int       status;           /* GTFS_STATUS_* of the last load */
+} FeedSlot;
 
-#define MAX_STOP_FILTER_IDS 32
-static char stop_filter_ids[MAX_STOP_FILTER_IDS][32];
-static int n_stop_filter_ids;
-static char gtfs_stop_id_resolved[32];
-static int g_gtfs_last_status = GTFS_STATUS_OK;
+static FeedSlot g_slots[GTFS_MAX_FEEDS];
+static int g_n_slots;
+static pthread_mutex_t g_feed_swap = PTHREAD_MUTEX_INITIALIZER;  /* feed pointers, g_n_slots, ref pickup */
+static atomic_int g_gtfs_last_status = GTFS_STATUS_OK;
+static atomic_int g_gtfs_loading;
 
-static int parse_csv_line(char *line, char *fields[], int max_fields) {
-    int n = 0;
-    char *p = line;
-    while (n < max_fields && *p) {
-        fields[n++] = p;
-        if (*p == '"') {
-            p++;
-            fields[n - 1] = p;
-            while (*p && *p != '"') p++;
-            if (*p == '"') *p++ = '\0';
-            while (*p && *p != ',') p++;
-            if (*p) *p++ = '\0';
-        } else {
-            while (*p && *p != ',') p++;
-            if (*p) *p++ = '\0';
-        }
+/* read_zip_file() / scan_member(): the zip lists the member but it did not inflate, or
+ * its size or CRC-32 is wrong. fn has seen part of it; what it built must be dropped. */
+#define MEMBER_CORRUPT (-2)
+
+/* Stream one CSV member (header skipped) through fn. Returns rows read, -1 if missing,
+ * or MEMBER_CORRUPT. */
+static int read_zip_file(ZipArchive *za, const char *file_name,
+                         int (*fn)(char *line, void *ctx), void *ctx) {
+    int count = zip_for_each_line(za, file_name, fn, ctx);
+    if (count >= 0) return count;
+    if (zip_has_member(za, file_name)) {
+        logf_("GTFS: %s corrupt in zip", file_name);
+        return MEMBER_CORRUPT;
     }
-    return n;
+    logf_("GTFS: %s missing in zip", file_name);
+    return -1;
 }
 
-static int read_zip_file(const char *zip_path, const char *file_name,
-                         int (*fn)(char *line, void *ctx), void *ctx) {
-    char cmd[1024];
-    snprintf(cmd, sizeof(cmd), "unzip -p '%s' '%s' 2>/dev/null", zip_path, file_name);
-    FILE *fp = popen(cmd, "r");
-    if (!fp) return -1;
-    char buf[2048];
-    if (!fgets(buf, sizeof(buf), fp)) { pclose(fp); return 0; }
-    int count = 0;
-    while (fgets(buf, sizeof(buf), fp)) {
-        size_t len = strlen(buf);
-        if (len > 0 && buf[len - 1] == '\n') buf[--len] = '\0';
-        if (fn(buf, ctx) != 0) break;
-        count++;
-    }
-    pclose(fp);
-    return count;
+static long elapsed_ms(const struct timespec *t0) {
+    struct timespec t1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return (long)(t1.tv_sec - t0->tv_sec) * 1000L + (long)(t1.tv_nsec - t0->tv_nsec) / 1000000L;
 }
 
 static int parse_time_mins(const char *s) {
@@ -135,165 +308,404 @@ static int parse_time_mins(const char *s) {
     return h * 60 + m;
 }
 
+static const char *fstr(const GtfsFeed *f, Str h) {
+    return f->strs.buf + h;
+}
+
+static Str intern(GtfsFeed *f, const char *s) {
+    if (f->intern_lock) pthread_mutex_lock(f->intern_lock);
+    Str h = strtab_add(&f->strs, s, NULL);
+    if (!h && *s) f->oom = 1;
+    if (f->intern_lock) pthread_mutex_unlock(f->intern_lock);
+    return h;
+}
+
+/* Append a zeroed row to a growable table; NULL if out of memory. */
+static void *table_push(void *base_ptr, int *n, int *cap, size_t row) {
+    void **base = (void **)base_ptr;
+    if (*n == *cap) {
+        int ncap = *cap ? *cap * 2 : 64;
+        void *nb = realloc(*base, (size_t)ncap * row);
+        if (!nb) return NULL;
+        *base = nb;
+        *cap = ncap;
+    }
+    char *r = (char *)*base + (size_t)(*n)++ * row;
+    memset(r, 0, row);
+    return r;
+}
+
+/* Growable u32 column (compile columns, scan rows). */
+typedef struct {
+    uint32_t *v;
+    size_t    n, cap;
+} U32Vec;
+
+static int u32vec_push(U32Vec *a, uint32_t x) {
+    if (a->n == a->cap) {
+        size_t cap = a->cap ? a->cap * 2 : 4096;
+        uint32_t *nv = realloc(a->v, cap * sizeof(uint32_t));
+        if (!nv) return -1;
+        a->v = nv;
+        a->cap = cap;
+    }
+    a->v[a->n++] = x;
+    return 0;
+}
+
+/* Load threads: GTFS_THREADS if set, else online cores; at most GTFS_MAX_THREADS.
+ * 1 (e.g. a Pi Zero) runs everything on the calling thread. */
+static int gtfs_threads(void) {
+    const char *e = getenv("GTFS_THREADS");
+    long n = (e && *e) ? atol(e) : sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 1) n = 1;
+    if (n > GTFS_MAX_THREADS) n = GTFS_MAX_THREADS;
+    return (int)n;
+}
+
+/* ---- Parallel member scans ---------------------------------------------------
+ * A large member is cut into window-sized blocks of whole lines. Workers turn each
+ * block into rows of u32s; the caller merges blocks in file order, so the tables come
+ * out exactly as a single-threaded pass would build them. Inflate stays on the caller
+ * and overlaps with the workers' parsing.
+ * -------------------------------------------------------------------------- */
+
+typedef struct MemberScan MemberScan;
+
+typedef struct {
+    char       *buf;            /* copy of the block (or the zip window when inline) */
+    size_t      len, cap;
+    U32Vec      rows;           /* scan output, consumed by merge */
+    int         failed;
+    MemberScan *ms;
+} ScanJob;
+
+struct MemberScan {
+    Pool    *pool;              /* NULL: scan and merge each block in place */
+    void   (*scan)(ScanJob *j); /* worker thread: block -> rows */
+    int    (*merge)(ScanJob *j);/* caller thread, file order; nonzero = fail */
+    void    *ctx;
+    ScanJob *jobs;
+    int      n_jobs, n_pending;
+    int      failed;
+};
+
+/* Cut the next line off a block: CR/LF stripped, NUL-terminated, length in *len.
+ * NULL at the end. */
+static char *block_line(char **p, char *end, size_t *len) {
+    if (*p >= end) return NULL;
+    char *line = *p;
+    char *nl = memchr(line, '\n', (size_t)(end - line));
+    char *e = nl ? nl : end;
+    *p = nl ? nl + 1 : end;
+    if (e > line && e[-1] == '\r') e--;
+    *e = '\0';
+    *len = (size_t)(e - line);
+    return line;
+}
+
+static void scan_job_run(void *arg) {
+    ScanJob *j = (ScanJob *)arg;
+    j->ms->scan(j);
+}
+
+static void scan_flush(MemberScan *ms) {
+    pool_wait(ms->pool);
+    for (int i = 0; i < ms->n_pending; i++) {
+        ScanJob *j = &ms->jobs[i];
+        if (!ms->failed && (j->failed || ms->merge(j) != 0)) ms->failed = 1;
+    }
+    ms->n_pending = 0;
+}
+
+static int scan_block_fn(char *buf, size_t len, void *ctx) {
+    MemberScan *ms = (MemberScan *)ctx;
+    if (!ms->pool) {
+        ScanJob *j = &ms->jobs[0];
+        char *own = j->buf;
+        j->buf = buf;
+        j->len = len;
+        j->rows.n = 0;
+        ms->scan(j);
+        if (j->failed || ms->merge(j) != 0) ms->failed = 1;
+        j->buf = own;
+        return ms->failed ? -1 : 0;
+    }
+    if (ms->n_pending == ms->n_jobs) scan_flush(ms);
+    if (ms->failed) return -1;
+    ScanJob *j = &ms->jobs[ms->n_pending];
+    if (j->cap < len + 1) {
+        char *nb = realloc(j->buf, len + 1);
+        if (!nb) { ms->failed = 1; return -1; }
+        j->buf = nb;
+        j->cap = len + 1;
+    }
+    memcpy(j->buf, buf, len + 1);
+    j->len = len;
+    j->rows.n = 0;
+    ms->n_pending++;
+    pool_submit(ms->pool, scan_job_run, j);
+    return 0;
+}
+
+/* Stream member name through scan (on the pool) and merge (here, in file order).
+ * pool may be NULL. Returns blocks read, -1 if missing or a merge failed, or
+ * MEMBER_CORRUPT. */
+static int scan_member(ZipArchive *za, const char *name, Pool *pool, int n_jobs,
+                       void (*scan)(ScanJob *j), int (*merge)(ScanJob *j), void *ctx) {
+    MemberScan ms = { pool, scan, merge, ctx, NULL, pool ? n_jobs : 1, 0, 0 };
+    ms.jobs = calloc((size_t)ms.n_jobs, sizeof(ScanJob));
+    if (!ms.jobs) return -1;
+    for (int i = 0; i < ms.n_jobs; i++) ms.jobs[i].ms = &ms;
+    int blocks = zip_for_each_block(za, name, scan_block_fn, &ms);
+    if (pool) scan_flush(&ms);
+    for (int i = 0; i < ms.n_jobs; i++) {
+        free(ms.jobs[i].buf);
+        free(ms.jobs[i].rows.v);
+    }
+    free(ms.jobs);
+    if (ms.failed) return -1;
+    if (blocks < 0 && zip_has_member(za, name)) {
+        logf_("GTFS: %s corrupt in zip", name);
+        return MEMBER_CORRUPT;
+    }
+    if (blocks < 0) logf_("GTFS: %s missing in zip", name);
+    return blocks;
+}
+
 static int routes_fn(char *line, void *ctx) {
-    (void)ctx;
+    GtfsFeed *fd = (GtfsFeed *)ctx;
     char *f[32];
     int n = parse_csv_line(line, f, 32);
-    if (n < 2 || feed.n_routes >= MAX_ROUTES) return (n < 2) ? 0 : -1;
-    GtfsRoute *r = &feed.routes[feed.n_routes++];
-    snprintf(r->route_id, sizeof(r->route_id), "%s", f[0]);
-    snprintf(r->short_name, sizeof(r->short_name), "%s", n >= 3 ? f[2] : f[0]);
+    if (n < 2) return 0;
+    GtfsRoute *r = table_push(&fd->routes, &fd->n_routes, &fd->cap_routes, sizeof(GtfsRoute));
+    if (!r) return -1;
+    r->route_id = intern(fd, f[0]);
+    r->short_name = intern(fd, n >= 3 ? f[2] : f[0]);
     return 0;
 }
 
-static int stop_times_fn(char *line, void *ctx) {
-    (void)ctx;
-    char *f[32];
-    int n = parse_csv_line(line, f, 32);
-    if (n < 4) return 0;
-    int match = 0;
-    for (int i = 0; i < n_stop_filter_ids; i++)
-        if (strcmp(f[3], stop_filter_ids[i]) == 0) { match = 1; break; }
-    if (!match) return 0;
-    if (feed.n_stop_times >= MAX_STOPTIMES_AT_STOP) return -1;
-    GtfsStopTime *st = &feed.stop_times[feed.n_stop_times];
-    snprintf(st->trip_id, sizeof(st->trip_id), "%s", f[0]);
-    st->arrival_mins = parse_time_mins(f[1]);
-    if (st->arrival_mins < 0) return 0;
-    feed.n_stop_times++;
+/* Worker: keep rows at the stops as (trip_id offset in the block, arrival minutes, list
+ * entry). The stop_id (column 4) is tested in place; only rows at a stop are split. */
+static void stop_times_scan(ScanJob *j) {
+    const GtfsFeed *fd = (const GtfsFeed *)j->ms->ctx;
+    char *p = j->buf, *end = j->buf + j->len, *line;
+    size_t len;
+    while ((line = block_line(&p, end, &len)) != NULL) {
+        size_t id_len;
+        long at = csv_column(line, len, 3, &id_len);
+        if (at >= 0) {
+            int match = 0;
+            for (int i = 0; i < fd->n_stop_filter_ids && !match; i++)
+                match = strncmp(line + at, fd->stop_filter_ids[i], id_len) == 0 &&
+                        fd->stop_filter_ids[i][id_len] == '\0';
+            if (!match) continue;
+        }
+        char *f[32];
+        int n = parse_csv_line(line, f, 32);
+        if (n < 4) continue;
+        int match = -1;
+        for (int i = 0; i < fd->n_stop_filter_ids; i++)
+            if (strcmp(f[3], fd->stop_filter_ids[i]) == 0) { match = i; break; }
+        int mins = match >= 0 ? parse_time_mins(f[1]) : -1;
+        if (mins < 0) continue;
+        if (u32vec_push(&j->rows, (uint32_t)(f[0] - j->buf)) != 0 ||
+            u32vec_push(&j->rows, (uint32_t)mins) != 0 ||
+            u32vec_push(&j->rows, fd->stop_filter_stop[match]) != 0) {
+            j->failed = 1;
+            return;
+        }
+    }
+}
+
+static int stop_times_merge(ScanJob *j) {
+    GtfsFeed *fd = (GtfsFeed *)j->ms->ctx;
+    for (size_t i = 0; i + 2 < j->rows.n; i += 3) {
+        GtfsStopTime *st = table_push(&fd->stop_times, &fd->n_stop_times, &fd->cap_stop_times,
+                                      sizeof(GtfsStopTime));
+        if (!st) return -1;
+        st->trip_id = intern(fd, j->buf + j->rows.v[i]);
+        st->arrival_mins = (int)j->rows.v[i + 1];
+        st->stop = (int)j->rows.v[i + 2];
+    }
     return 0;
 }
 
 static int stops_fn(char *line, void *ctx) {
-    (void)ctx;
+    GtfsFeed *fd = (GtfsFeed *)ctx;
     char *f[32];
     int n = parse_csv_line(line, f, 32);
-    if (n < 1 || feed.n_stops >= MAX_STOPS) return (n < 1) ? 0 : -1;
-    GtfsStop *s = &feed.stops[feed.n_stops++];
-    snprintf(s->stop_id, sizeof(s->stop_id), "%s", f[0]);
-    snprintf(s->stop_code, sizeof(s->stop_code), "%s", n >= 2 ? f[1] : "");
+    if (n < 1) return 0;
+    GtfsStop *s = table_push(&fd->stops, &fd->n_stops, &fd->cap_stops, sizeof(GtfsStop));
+    if (!s) return -1;
+    s->stop_id = intern(fd, f[0]);
+    s->stop_code = intern(fd, n >= 2 ? f[1] : "");
     return 0;
 }
 
 static int calendar_fn(char *line, void *ctx) {
-    (void)ctx;
+    GtfsFeed *fd = (GtfsFeed *)ctx;
     char *f[32];
     int n = parse_csv_line(line, f, 32);
-    if (n < 10 || feed.n_calendars >= MAX_CALENDAR) return (n < 10) ? 0 : -1;
-    GtfsCalendar *c = &feed.calendars[feed.n_calendars];
-    snprintf(c->service_id, sizeof(c->service_id), "%s", f[0]);
+    if (n < 10) return 0;
+    GtfsCalendar *c = table_push(&fd->calendars, &fd->n_calendars, &fd->cap_calendars,
+                                 sizeof(GtfsCalendar));
+    if (!c) return -1;
+    c->service_id = intern(fd, f[0]);
     if (strlen(f[8]) >= 8) c->start_ymd = atoi(f[8]);
     if (strlen(f[9]) >= 8) c->end_ymd = atoi(f[9]);
-    if (n >= 8) {
-        c->dow[0] = (f[7][0] == '1') ? 1 : 0;
-        for (int i = 1; i < 7; i++)
-            c->dow[i] = (f[i][0] == '1') ? 1 : 0;
-    }
-    feed.n_calendars++;
+    if (f[7][0] == '1') c->dow |= 1u;
+    for (int i = 1; i < 7; i++)
+        if (f[i][0] == '1') c->dow |= (uint8_t)(1u << i);
     return 0;
 }
 
 static int calendar_dates_fn(char *line, void *ctx) {
-    (void)ctx;
+    GtfsFeed *fd = (GtfsFeed *)ctx;
     char *f[32];
     int n = parse_csv_line(line, f, 32);
-    if (n < 3 || feed.n_cal_dates >= MAX_CAL_DATES) return (n < 3) ? 0 : -1;
-    GtfsCalendarDate *cd = &feed.cal_dates[feed.n_cal_dates++];
-    snprintf(cd->service_id, sizeof(cd->service_id), "%s", f[0]);
+    if (n < 3) return 0;
+    GtfsCalendarDate *cd = table_push(&fd->cal_dates, &fd->n_cal_dates, &fd->cap_cal_dates,
+                                      sizeof(GtfsCalendarDate));
+    if (!cd) return -1;
+    cd->service_id = intern(fd, f[0]);
     if (strlen(f[1]) >= 8) cd->date_ymd = atoi(f[1]);
     cd->exception_type = atoi(f[2]);
     return 0;
 }
 
-static int service_active_on(int service_ymd, const char *service_id) {
-    int y = service_ymd / 10000, m = (service_ymd / 100) % 100, d = service_ymd % 100;
-    struct tm tm = { 0 };
-    tm.tm_year = y - 1900;
-    tm.tm_mon = m - 1;
-    tm.tm_mday = d;
-    tm.tm_isdst = -1;
-    time_t t = timegm(&tm);
-    if (t == (time_t)-1) return 0;
-    struct tm *lt = gmtime(&t);
-    int dow = lt ? lt->tm_wday : -1;
-
-    for (int i = 0; i < feed.n_cal_dates; i++) {
-        if (strcmp(feed.cal_dates[i].service_id, service_id) != 0) continue;
-        if (feed.cal_dates[i].date_ymd != service_ymd) continue;
-        if (feed.cal_dates[i].exception_type == 1) return 1;
-        if (feed.cal_dates[i].exception_type == 2) return 0;
-    }
-    for (int i = 0; i < feed.n_calendars; i++) {
-        if (strcmp(feed.calendars[i].service_id, service_id) != 0) continue;
-        if (service_ymd < feed.calendars[i].start_ymd || service_ymd > feed.calendars[i].end_ymd) continue;
-        if (dow >= 0 && dow < 7 && feed.calendars[i].dow[dow]) return 1;
+/* Link each row to the next one sharing its key, in file order, so a service's rows
+ * can be walked from the index hit without rescanning the table. */
+static int id_chain_build(const IdIndex *ix, int **next, int n) {
+    int *nx = realloc(*next, (size_t)(n ? n : 1) * sizeof(int));
+    if (!nx) return -1;
+    *next = nx;
+    int *tail = malloc((size_t)(n ? n : 1) * sizeof(int));
+    if (!tail) return -1;
+    for (int i = 0; i < n; i++) {
+        nx[i] = -1;
+        int first = id_index_find(ix, id_key(ix, i));
+        if (first < 0 || first == i) { tail[i] = i; continue; }
+        nx[tail[first]] = i;
+        tail[first] = i;
+    }
+    free(tail);
+    return 0;
+}
+
+/* Rebuild route and service indexes after routes/calendars are (re)loaded. */
+static void gtfs_build_indexes(GtfsFeed *f) {
+    id_index_build(&f->route_ix, &f->strs, f->routes, f->n_routes, sizeof(GtfsRoute),
+                   offsetof(GtfsRoute, route_id));
+    id_index_build(&f->cal_ix, &f->strs, f->calendars, f->n_calendars, sizeof(GtfsCalendar),
+                   offsetof(GtfsCalendar, service_id));
+    if (id_chain_build(&f->cal_ix, &f->cal_next, f->n_calendars) != 0) f->oom = 1;
+    id_index_build(&f->cd_ix, &f->strs, f->cal_dates, f->n_cal_dates, sizeof(GtfsCalendarDate),
+                   offsetof(GtfsCalendarDate, service_id));
+    if (id_chain_build(&f->cd_ix, &f->cd_next, f->n_cal_dates) != 0) f->oom = 1;
+    id_index_build(&f->trip_ix, &f->strs, f->trips, 0, sizeof(GtfsTrip), offsetof(GtfsTrip, trip_id));
+    unsigned char *ex = realloc(f->route_excl, (size_t)(f->n_routes ? f->n_routes : 1));
+    if (ex) f->route_excl = ex; else f->oom = 1;
+    f->excl_valid = 0;
+    f->window_ymd = 0;
+}
+
+static int service_active_on(GtfsFeed *f, int service_ymd, const char *service_id) {
+    int dow = tz_ymd_wday(service_ymd);
+
+    for (int i = id_index_find(&f->cd_ix, service_id); i >= 0; i = f->cd_next[i]) {
+        if (f->cal_dates[i].date_ymd != service_ymd) continue;
+        if (f->cal_dates[i].exception_type == 1) return 1;
+        if (f->cal_dates[i].exception_type == 2) return 0;
+    }
+    for (int i = id_index_find(&f->cal_ix, service_id); i >= 0; i = f->cal_next[i]) {
+        if (service_ymd < f->calendars[i].start_ymd || service_ymd > f->calendars[i].end_ymd) continue;
+        if (dow >= 0 && dow < 7 && ((f->calendars[i].dow >> dow) & 1)) return 1;
     }
     return 0;
 }
 
-static int resolve_stop(const char *stop_id) {
+/* Add the stop_ids that count as stop_id (the stop plus those sharing its stop_code) to
+ * the filter as list entry `entry`; ids already taken by an earlier entry stay there.
+ * Returns 0 if stop_id is neither a stop_id nor a stop_code of this feed. */
+static int resolve_one_stop(GtfsFeed *f, const char *stop_id, int entry) {
     const char *code_to_match = NULL;
     int found_idx = -1;
-    for (int i = 0; i < feed.n_stops; i++) {
-        if (strcmp(feed.stops[i].stop_id, stop_id) == 0) {
-            snprintf(gtfs_stop_id_resolved, sizeof(gtfs_stop_id_resolved), "%s", feed.stops[i].stop_id);
-            code_to_match = feed.stops[i].stop_code[0] ? feed.stops[i].stop_code : feed.stops[i].stop_id;
+    for (int i = 0; i < f->n_stops; i++) {
+        if (strcmp(fstr(f, f->stops[i].stop_id), stop_id) == 0) {
+            code_to_match = *fstr(f, f->stops[i].stop_code) ? fstr(f, f->stops[i].stop_code) : fstr(f, f->stops[i].stop_id);
             found_idx = i;
             break;
         }
     }
     if (found_idx < 0) {
-        for (int i = 0; i < feed.n_stops; i++) {
-            if (feed.stops[i].stop_code[0] && strcmp(feed.stops[i].stop_code, stop_id) == 0) {
-                snprintf(gtfs_stop_id_resolved, sizeof(gtfs_stop_id_resolved), "%s", feed.stops[i].stop_id);
-                code_to_match = feed.stops[i].stop_code;
+        for (int i = 0; i < f->n_stops; i++) {
+            if (*fstr(f, f->stops[i].stop_code) && strcmp(fstr(f, f->stops[i].stop_code), stop_id) == 0) {
+                code_to_match = fstr(f, f->stops[i].stop_code);
                 found_idx = i;
                 break;
             }
         }
     }
-    if (found_idx < 0) {
-        logf_("GTFS: stop_id '%s' not found in feed (check GTFS_BUS_URL and that stop is in this feed)", stop_id);
-        return 0;
-    }
-    n_stop_filter_ids = 0;
-    for (int i = 0; i < feed.n_stops && n_stop_filter_ids < MAX_STOP_FILTER_IDS; i++) {
+    if (found_idx < 0) return 0;
+    const char *resolved = fstr(f, f->stops[found_idx].stop_id);
+    if (!f->stop_id_resolved[0])
+        snprintf(f->stop_id_resolved, sizeof(f->stop_id_resolved), "%s", resolved);
+    int added = 0;
+    for (int i = 0; i < f->n_stops && f->n_stop_filter_ids < MAX_STOP_FILTER_IDS; i++) {
         int include = 0;
-        if (code_to_match && feed.stops[i].stop_code[0] && strcmp(feed.stops[i].stop_code, code_to_match) == 0)
+        if (code_to_match && *fstr(f, f->stops[i].stop_code) && strcmp(fstr(f, f->stops[i].stop_code), code_to_match) == 0)
             include = 1;
-        else if (code_to_match && !feed.stops[i].stop_code[0] && strcmp(feed.stops[i].stop_id, code_to_match) == 0)
+        else if (code_to_match && !*fstr(f, f->stops[i].stop_code) && strcmp(fstr(f, f->stops[i].stop_id), code_to_match) == 0)
             include = 1;
-        if (!include && feed.stops[i].stop_code[0] && strcmp(feed.stops[i].stop_code, stop_id) == 0)
+        if (!include && *fstr(f, f->stops[i].stop_code) && strcmp(fstr(f, f->stops[i].stop_code), stop_id) == 0)
             include = 1;
         if (include) {
             int already = 0;
-            for (int j = 0; j < n_stop_filter_ids; j++)
-                if (strcmp(stop_filter_ids[j], feed.stops[i].stop_id) == 0) { already = 1; break; }
+            for (int j = 0; j < f->n_stop_filter_ids; j++)
+                if (strcmp(f->stop_filter_ids[j], fstr(f, f->stops[i].stop_id)) == 0) { already = 1; break; }
             if (!already) {
-                snprintf(stop_filter_ids[n_stop_filter_ids], sizeof(stop_filter_ids[0]), "%s", feed.stops[i].stop_id);
-                n_stop_filter_ids++;
+                snprintf(f->stop_filter_ids[f->n_stop_filter_ids], sizeof(f->stop_filter_ids[0]), "%s", fstr(f, f->stops[i].stop_id));
+                f->stop_filter_stop[f->n_stop_filter_ids] = (unsigned char)entry;
+                f->n_stop_filter_ids++;
+                added++;
             }
         }
     }
-    if (n_stop_filter_ids == 0) {
-        snprintf(stop_filter_ids[0], sizeof(stop_filter_ids[0]), "%s", gtfs_stop_id_resolved);
-        n_stop_filter_ids = 1;
+    if (!added && f->n_stop_filter_ids < MAX_STOP_FILTER_IDS) {
+        int already = 0;
+        for (int j = 0; j < f->n_stop_filter_ids; j++)
+            if (strcmp(f->stop_filter_ids[j], resolved) == 0) { already = 1; break; }
+        if (!already) {
+            snprintf(f->stop_filter_ids[f->n_stop_filter_ids], sizeof(f->stop_filter_ids[0]), "%s", resolved);
+            f->stop_filter_stop[f->n_stop_filter_ids] = (unsigned char)entry;
+            f->n_stop_filter_ids++;
+        }
     }
     return 1;
 }
 
-static const char *route_short_name(const char *route_id) {
-    for (int i = 0; i < feed.n_routes; i++)
-        if (strcmp(feed.routes[i].route_id, route_id) == 0)
-            return feed.routes[i].short_name;
-    return route_id;
+/* Resolve a STOP_ID list ("501627" or "501627,501628"): entry k's ids are tagged k, so
+ * one stop_times pass serves every listed stop. Returns 0 if no entry is in this feed. */
+static int resolve_stop(GtfsFeed *f, const char *stop_ids) {
+    char list[256], *save = NULL;
+    snprintf(list, sizeof(list), "%s", stop_ids);
+    f->n_stop_filter_ids = 0;
+    f->n_list_stops = 0;
+    f->stop_id_resolved[0] = '\0';
+    int found = 0;
+    for (char *id = strtok_r(list, ", \t\n", &save); id && f->n_list_stops < STOP_IDS_MAX;
+         id = strtok_r(NULL, ", \t\n", &save)) {
+        int entry = f->n_list_stops++;
+        snprintf(f->list_stops[entry], sizeof(f->list_stops[0]), "%s", id);
+        found += resolve_one_stop(f, id, entry);
+    }
+    return found > 0;
 }
 
-static GtfsTrip *trip_by_id(const char *trip_id) {
-    for (int i = 0; i < feed.n_trips; i++)
-        if (strcmp(feed.trips[i].trip_id, trip_id) == 0)
-            return &feed.trips[i];
-    return NULL;
+static GtfsTrip *trip_by_id(GtfsFeed *f, const char *trip_id) {
+    int i = id_index_find(&f->trip_ix, trip_id);
+    return i >= 0 ? &f->trips[i] : NULL;
 }
 
 static int route_excluded(const char *short_name, const char *realtime_routes) {
@@ -312,83 +724,889 @@ static int route_excluded(const char *short_name, const char *realtime_routes) {
     return 0;
 }
 
-static void now_ny(int *out_ymd, int *out_mins) {
-    time_t t = time(NULL);
+/* route_excluded() for route index ri, recomputed only when the realtime list changes. */
+static int route_idx_excluded(GtfsFeed *f, int ri, const char *realtime_routes) {
+    const char *list = realtime_routes ? realtime_routes : "";
+    if (!f->excl_valid || strcmp(f->excl_for, list) != 0) {
+        for (int i = 0; i < f->n_routes; i++)
+            f->route_excl[i] = (unsigned char)route_excluded(fstr(f, f->routes[i].short_name), list);
+        snprintf(f->excl_for, sizeof(f->excl_for), "%s", list);
+        f->excl_valid = 1;
+    }
+    return f->route_excl[ri];
+}
+
+static void now_ny(time_t now, int *out_ymd, int *out_mins) {
     struct tm tm;
-    tz_set_ny();
-    localtime_r(&t, &tm);
+    tz_ny_local(now, &tm);
     *out_ymd = (tm.tm_year + 1900) * 10000 + (tm.tm_mon + 1) * 100 + tm.tm_mday;
     *out_mins = tm.tm_hour * 60 + tm.tm_min;
 }
 
-static time_t ymd_mins_to_time(int date_ymd, int mins) {
-    int day_offset = 0;
-    while (mins >= 24 * 60) { mins -= 24 * 60; day_offset++; }
-    while (mins < 0) { mins += 24 * 60; day_offset--; }
-    int y = date_ymd / 10000, m = (date_ymd / 100) % 100, d = date_ymd % 100;
-    struct tm tm = { 0 };
-    tm.tm_year = y - 1900;
-    tm.tm_mon = m - 1;
-    tm.tm_mday = d + day_offset;
-    tm.tm_hour = mins / 60;
-    tm.tm_min = mins % 60;
-    tm.tm_isdst = -1;
-    tz_set_ny();
-    return mktime(&tm);
-}
-
-/* Only keep trips whose trip_id appears in the already-parsed stop_times. */
-static int trips_filtered_fn(char *line, void *ctx) {
-    (void)ctx;
+/* Locate a UTC offset change during the day. Wall-clock minutes in the skipped spring
+ * hour map forward; repeated fall-back minutes take the first (daylight) occurrence,
+ * i.e. GTFS "noon minus 12h" time -- the same answer tz_ny_time() gives. */
+static void day_find_shift(GtfsDay *day) {
+    day->shift_at = 24 * 60;
+    day->shift_secs = 0;
+    long off0 = tz_ny_offset(day->midnight);
+    long off1 = tz_ny_offset(day->midnight + 24 * 3600);
+    if (off1 == off0) return;
+    long shift = off0 - off1;           /* wall clock -> epoch correction after the change */
+    int lo = 0, hi = 24 * 60;           /* first elapsed minute on the new offset */
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (tz_ny_offset(day->midnight + mid * 60L) != off0) hi = mid; else lo = mid + 1;
+    }
+    day->shift_at = lo + (shift < 0 ? (int)(-shift / 60) : 0);
+    day->shift_secs = (int)shift;
+}
+
+/* Rebuild the day table and per-service active bits for the window starting on today_ymd.
+ * Runs at load and on the first query after each NY midnight. */
+static void gtfs_build_window(GtfsFeed *f, int today_ymd) {
+    for (int e = 0; e < WINDOW_TIME_DAYS; e++) {
+        GtfsDay *day = &f->days[e];
+        day->ymd = tz_ymd_add(today_ymd, e);
+        day->midnight = tz_ny_time(day->ymd, 0);
+        day_find_shift(day);
+    }
+
+    /* One entry per distinct service_id: calendar rows first, then calendar_dates-only. */
+    f->n_services = 0;
+    f->services_full = 0;
+    for (int i = 0; i < f->n_calendars + f->n_cal_dates; i++) {
+        Str sh = i < f->n_calendars ? f->calendars[i].service_id
+                                    : f->cal_dates[i - f->n_calendars].service_id;
+        const char *sid = fstr(f, sh);
+        int first = i < f->n_calendars ? id_index_find(&f->cal_ix, sid)
+                                         : id_index_find(&f->cd_ix, sid) + f->n_calendars;
+        if (first != i || (i >= f->n_calendars && id_index_find(&f->cal_ix, sid) >= 0)) continue;
+        if (f->n_services >= MAX_SERVICE_IDS) { f->services_full = 1; break; }
+        GtfsService *sv = &f->services[f->n_services++];
+        sv->service_id = sh;
+        sv->active = 0;
+        for (int day = 0; day < SERVICE_WINDOW_DAYS; day++)
+            if (service_active_on(f, f->days[day].ymd, sid)) sv->active |= 1u << day;
+    }
+    id_index_build(&f->service_ix, &f->strs, f->services, f->n_services, sizeof(GtfsService),
+                   offsetof(GtfsService, service_id));
+    f->window_ymd = today_ymd;
+    f->tl.valid = 0;
+    if (f->services_full)
+        logf_("GTFS: more than %d service_ids; extra ones use the slow calendar path", MAX_SERVICE_IDS);
+}
+
+/* Active-day bits for service_id in the current window. */
+static uint32_t service_days(GtfsFeed *f, const char *service_id) {
+    int i = id_index_find(&f->service_ix, service_id);
+    if (i >= 0) return f->services[i].active;
+    uint32_t active = 0;
+    if (f->services_full)
+        for (int day = 0; day < SERVICE_WINDOW_DAYS; day++)
+            if (service_active_on(f, f->days[day].ymd, service_id)) active |= 1u << day;
+    return active;
+}
+
+/* Epoch for GTFS time mins (may exceed 24:00) on window day 'day', from the day table. */
+static time_t window_time(GtfsFeed *f, int day, int mins) {
+    int e = day + mins / (24 * 60);
+    if (e >= WINDOW_TIME_DAYS) return tz_ny_time(f->days[day].ymd, mins);
+    mins %= 24 * 60;
+    const GtfsDay *dd = &f->days[e];
+    return dd->midnight + (time_t)mins * 60 + (mins >= dd->shift_at ? dd->shift_secs : 0);
+}
+
+/* Every trip, into a scratch feed read alongside stop_times.txt; see slice_trips_from(). */
+static int trips_fn(char *line, void *ctx) {
+    GtfsFeed *fd = (GtfsFeed *)ctx;
     char *f[32];
     int n = parse_csv_line(line, f, 32);
     if (n < 3) return 0;
-    int found = 0;
-    for (int i = 0; i < feed.n_stop_times; i++)
-        if (strcmp(feed.stop_times[i].trip_id, f[2]) == 0) { found = 1; break; }
-    if (!found) return 0;
-    if (feed.n_trips >= MAX_TRIPS) return -1;
-    GtfsTrip *t = &feed.trips[feed.n_trips++];
-    snprintf(t->trip_id, sizeof(t->trip_id), "%s", f[2]);
-    snprintf(t->route_id, sizeof(t->route_id), "%s", f[0]);
-    snprintf(t->service_id, sizeof(t->service_id), "%s", f[1]);
-    snprintf(t->headsign, sizeof(t->headsign), "%s", n >= 4 ? f[3] : "");
+    GtfsTrip *t = table_push(&fd->trips, &fd->n_trips, &fd->cap_trips, sizeof(GtfsTrip));
+    if (!t) return -1;
+    t->trip_id = intern(fd, f[2]);
+    t->route_id = intern(fd, f[0]);
+    t->service_id = intern(fd, f[1]);
+    t->headsign = intern(fd, n >= 4 ? f[3] : "");
+    return 0;
+}
+
+/* Copy the trips of all whose trip_id appears in f's stop_times, in trips.txt order. */
+static int slice_trips_from(GtfsFeed *f, const GtfsFeed *all) {
+    if (id_index_build(&f->st_ix, &f->strs, f->stop_times, f->n_stop_times,
+                       sizeof(GtfsStopTime), offsetof(GtfsStopTime, trip_id)) != 0)
+        return -1;
+    for (int i = 0; i < all->n_trips; i++) {
+        const GtfsTrip *a = &all->trips[i];
+        if (id_index_find(&f->st_ix, fstr(all, a->trip_id)) < 0) continue;
+        GtfsTrip *t = table_push(&f->trips, &f->n_trips, &f->cap_trips, sizeof(GtfsTrip));
+        if (!t) return -1;
+        t->trip_id = intern(f, fstr(all, a->trip_id));
+        t->route_id = intern(f, fstr(all, a->route_id));
+        t->service_id = intern(f, fstr(all, a->service_id));
+        t->headsign = intern(f, fstr(all, a->headsign));
+    }
+    return 0;
+}
+
+/* ---- Compiled snapshot ------------------------------------------------------
+ * Built once per zip content hash from the parsed tables plus full passes over
+ * trips.txt and stop_times.txt, then mmap'd on every later load/stop change.
+ * -------------------------------------------------------------------------- */
+
+typedef struct {
+    StrTab    strs;
+    uint32_t *route_of;     /* string id -> route index + 1 (0 = none) */
+    uint32_t  route_of_n;
+    uint32_t *stop_of;      /* string id -> stop index + 1 */
+    uint32_t  stop_of_n;
+    uint32_t *trip_of;      /* string id -> trip index + 1 */
+    uint32_t  trip_of_n;
+    U32Vec    trip_id, trip_route, trip_service, trip_headsign;
+    uint32_t *st_begin;     /* n_stops + 1 */
+    uint32_t *st_fill;      /* write cursor per stop during the second pass */
+    uint32_t *st_trip;
+    uint16_t *st_mins;
+    int       fill_pass;
+    int       failed;
+} SnapBuild;
+
+static uint32_t snap_lookup(const StrTab *t, const uint32_t *map, uint32_t map_n, const char *s) {
+    uint32_t id = strtab_find(t, s);
+    if (id == UINT32_MAX || id >= map_n || !map[id]) return UINT32_MAX;
+    return map[id] - 1;
+}
+
+/* Map every interned id below n_strings to its table index (first occurrence wins). */
+static uint32_t *snap_index_map(SnapBuild *b, const uint32_t *ids, uint32_t n, uint32_t *out_n) {
+    *out_n = b->strs.n_strings;
+    uint32_t *map = calloc(*out_n ? *out_n : 1, sizeof(uint32_t));
+    if (!map) return NULL;
+    for (uint32_t i = 0; i < n; i++)
+        if (ids[i] && !map[ids[i]]) map[ids[i]] = i + 1;
+    return map;
+}
+
+static int snap_trips_fn(char *line, void *ctx) {
+    SnapBuild *b = (SnapBuild *)ctx;
+    char *f[32];
+    int n = parse_csv_line(line, f, 32);
+    if (n < 3) return 0;
+    uint32_t route = snap_lookup(&b->strs, b->route_of, b->route_of_n, f[0]);
+    if (u32vec_push(&b->trip_id, strtab_add(&b->strs, f[2], NULL)) != 0 ||
+        u32vec_push(&b->trip_route, route) != 0 ||
+        u32vec_push(&b->trip_service, strtab_add(&b->strs, f[1], NULL)) != 0 ||
+        u32vec_push(&b->trip_headsign, strtab_add(&b->strs, n >= 4 ? f[3] : "", NULL)) != 0) {
+        b->failed = 1;
+        return -1;
+    }
+    return 0;
+}
+
+/* Worker: (stop, trip, minutes) per row. The string table is only read here. */
+static void snap_stop_times_scan(ScanJob *j) {
+    const SnapBuild *b = (const SnapBuild *)j->ms->ctx;
+    char *p = j->buf, *end = j->buf + j->len, *line;
+    size_t len;
+    while ((line = block_line(&p, end, &len)) != NULL) {
+        char *f[32];
+        int n = parse_csv_line(line, f, 32);
+        if (n < 4) continue;
+        uint32_t stop = snap_lookup(&b->strs, b->stop_of, b->stop_of_n, f[3]);
+        if (stop == UINT32_MAX) continue;
+        uint32_t trip = snap_lookup(&b->strs, b->trip_of, b->trip_of_n, f[0]);
+        if (trip == UINT32_MAX) continue;
+        int mins = parse_time_mins(f[1]);
+        if (mins < 0 || mins > 0xFFFF) continue;
+        if (u32vec_push(&j->rows, stop) != 0 || u32vec_push(&j->rows, trip) != 0 ||
+            u32vec_push(&j->rows, (uint32_t)mins) != 0) {
+            j->failed = 1;
+            return;
+        }
+    }
+}
+
+/* Two passes: count rows per stop, then place (trip, minutes) into each stop's range. */
+static int snap_stop_times_merge(ScanJob *j) {
+    SnapBuild *b = (SnapBuild *)j->ms->ctx;
+    for (size_t i = 0; i + 2 < j->rows.n; i += 3) {
+        uint32_t stop = j->rows.v[i];
+        if (!b->fill_pass) {
+            b->st_begin[stop + 1]++;
+        } else {
+            uint32_t at = b->st_fill[stop]++;
+            b->st_trip[at] = j->rows.v[i + 1];
+            b->st_mins[at] = (uint16_t)j->rows.v[i + 2];
+        }
+    }
     return 0;
 }
 
-static void gtfs_parse_zip(const char *zip_path) {
-    feed.n_routes = feed.n_trips = feed.n_stop_times = 0;
-    feed.n_stops = feed.n_calendars = feed.n_cal_dates = 0;
-    feed.stop_times_cached = 0;
-    feed.cached_stop_id[0] = '\0';
-    read_zip_file(zip_path, "routes.txt", routes_fn, NULL);
-    /* trips.txt is loaded lazily in gtfs_next_departures, filtered by stop */
-    read_zip_file(zip_path, "stops.txt", stops_fn, NULL);
-    read_zip_file(zip_path, "calendar.txt", calendar_fn, NULL);
-    read_zip_file(zip_path, "calendar_dates.txt", calendar_dates_fn, NULL);
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void snap_build_free(SnapBuild *b) {
+    strtab_free(&b->strs);
+    free(b->route_of); free(b->stop_of); free(b->trip_of);
+    free(b->trip_id.v); free(b->trip_route.v); free(b->trip_service.v); free(b->trip_headsign.v);
+    free(b->st_begin); free(b->st_fill); free(b->st_trip); free(b->st_mins);
+}
+
+static int gtfs_compile_snapshot(GtfsFeed *f, ZipArchive *za, Pool *pool, int n_threads,
+                                 const char *snap_path, uint64_t zip_hash) {
+    SnapBuild b;
+    memset(&b, 0, sizeof(b));
+    if (strtab_init(&b.strs) != 0) return -1;
+
+    uint32_t nr = (uint32_t)f->n_routes, ns = (uint32_t)f->n_stops;
+    uint32_t nc = (uint32_t)f->n_calendars, nd = (uint32_t)f->n_cal_dates;
+    uint32_t *r_id = calloc(nr + 1, 4), *r_short = calloc(nr + 1, 4), *r_sid = calloc(nr + 1, 4);
+    uint32_t *s_id = calloc(ns + 1, 4), *s_code = calloc(ns + 1, 4), *s_sid = calloc(ns + 1, 4);
+    uint32_t *c_svc = calloc(nc + 1, 4);
+    int32_t  *c_start = calloc(nc + 1, 4), *c_end = calloc(nc + 1, 4);
+    uint8_t  *c_dow = calloc(nc + 1, 1);
+    uint32_t *d_svc = calloc(nd + 1, 4);
+    int32_t  *d_date = calloc(nd + 1, 4);
+    uint8_t  *d_type = calloc(nd + 1, 1);
+    uint16_t *st_delta = NULL;
+    uint64_t *sort_buf = NULL;
+    int rc = -1;
+    if (!r_id || !r_short || !r_sid || !s_id || !s_code || !s_sid || !c_svc || !c_start ||
+        !c_end || !c_dow || !d_svc || !d_date || !d_type)
+        goto out;
+
+    for (uint32_t i = 0; i < nr; i++) {
+        r_id[i] = strtab_add(&b.strs, fstr(f, f->routes[i].route_id), &r_sid[i]);
+        r_short[i] = strtab_add(&b.strs, fstr(f, f->routes[i].short_name), NULL);
+    }
+    for (uint32_t i = 0; i < ns; i++) {
+        s_id[i] = strtab_add(&b.strs, fstr(f, f->stops[i].stop_id), &s_sid[i]);
+        s_code[i] = strtab_add(&b.strs, fstr(f, f->stops[i].stop_code), NULL);
+    }
+    for (uint32_t i = 0; i < nc; i++) {
+        c_svc[i] = strtab_add(&b.strs, fstr(f, f->calendars[i].service_id), NULL);
+        c_start[i] = f->calendars[i].start_ymd;
+        c_end[i] = f->calendars[i].end_ymd;
+        c_dow[i] = f->calendars[i].dow;
+    }
+    for (uint32_t i = 0; i < nd; i++) {
+        d_svc[i] = strtab_add(&b.strs, fstr(f, f->cal_dates[i].service_id), NULL);
+        d_date[i] = f->cal_dates[i].date_ymd;
+        d_type[i] = (uint8_t)f->cal_dates[i].exception_type;
+    }
+    b.route_of = snap_index_map(&b, r_sid, nr, &b.route_of_n);
+    b.stop_of = snap_index_map(&b, s_sid, ns, &b.stop_of_n);
+    if (!b.route_of || !b.stop_of) goto out;
+
+    int rows = read_zip_file(za, "trips.txt", snap_trips_fn, &b);
+    if (rows == MEMBER_CORRUPT) f->corrupt = 1;
+    if (rows < 0 || b.failed) goto out;
+    uint32_t nt = (uint32_t)b.trip_id.n;
+    {
+        uint32_t *t_sid = calloc(nt + 1, 4);
+        if (!t_sid) goto out;
+        for (uint32_t i = 0; i < nt; i++)
+            t_sid[i] = strtab_find(&b.strs, b.strs.buf + b.trip_id.v[i]);
+        b.trip_of = snap_index_map(&b, t_sid, nt, &b.trip_of_n);
+        free(t_sid);
+        if (!b.trip_of) goto out;
+    }
+
+    b.st_begin = calloc(ns + 1, sizeof(uint32_t));
+    b.st_fill = calloc(ns + 1, sizeof(uint32_t));
+    if (!b.st_begin || !b.st_fill) goto out;
+    rows = scan_member(za, "stop_times.txt", pool, 2 * n_threads, snap_stop_times_scan,
+                       snap_stop_times_merge, &b);
+    if (rows == MEMBER_CORRUPT) f->corrupt = 1;
+    if (rows < 0) goto out;
+    for (uint32_t i = 0; i < ns; i++) b.st_begin[i + 1] += b.st_begin[i];
+    uint32_t nst = b.st_begin[ns];
+    b.st_trip = malloc((nst + 1) * sizeof(uint32_t));
+    b.st_mins = malloc((nst + 1) * sizeof(uint16_t));
+    st_delta = malloc((nst + 1) * sizeof(uint16_t));
+    if (!b.st_trip || !b.st_mins || !st_delta) goto out;
+    memcpy(b.st_fill, b.st_begin, ns * sizeof(uint32_t));
+    b.fill_pass = 1;
+    rows = scan_member(za, "stop_times.txt", pool, 2 * n_threads, snap_stop_times_scan,
+                       snap_stop_times_merge, &b);
+    if (rows == MEMBER_CORRUPT) f->corrupt = 1;
+    if (rows < 0) goto out;
+
+    /* Sort each stop's rows by arrival, then delta-encode the minutes. */
+    uint32_t max_run = 0;
+    for (uint32_t i = 0; i < ns; i++)
+        if (b.st_begin[i + 1] - b.st_begin[i] > max_run) max_run = b.st_begin[i + 1] - b.st_begin[i];
+    sort_buf = malloc((max_run + 1) * sizeof(uint64_t));
+    if (!sort_buf) goto out;
+    for (uint32_t i = 0; i < ns; i++) {
+        uint32_t lo = b.st_begin[i], run = b.st_begin[i + 1] - lo;
+        for (uint32_t k = 0; k < run; k++)
+            sort_buf[k] = ((uint64_t)b.st_mins[lo + k] << 32) | b.st_trip[lo + k];
+        qsort(sort_buf, run, sizeof(uint64_t), cmp_u64);
+        uint16_t prev = 0;
+        for (uint32_t k = 0; k < run; k++) {
+            uint16_t m = (uint16_t)(sort_buf[k] >> 32);
+            b.st_trip[lo + k] = (uint32_t)sort_buf[k];
+            st_delta[lo + k] = (uint16_t)(m - prev);
+            prev = m;
+        }
+    }
+
+    SnapHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.zip_hash = zip_hash;
+    hdr.n_routes = nr;
+    hdr.n_stops = ns;
+    hdr.n_trips = nt;
+    hdr.n_calendars = nc;
+    hdr.n_cal_dates = nd;
+    hdr.n_stop_times = nst;
+    hdr.strings_size = b.strs.len;
+    const void *cols[SNAP_COL_COUNT] = {
+        [SNAP_ROUTE_ID] = r_id, [SNAP_ROUTE_SHORT] = r_short,
+        [SNAP_STOP_ID] = s_id, [SNAP_STOP_CODE] = s_code, [SNAP_STOP_ST_BEGIN] = b.st_begin,
+        [SNAP_TRIP_ID] = b.trip_id.v, [SNAP_TRIP_ROUTE] = b.trip_route.v,
+        [SNAP_TRIP_SERVICE] = b.trip_service.v, [SNAP_TRIP_HEADSIGN] = b.trip_headsign.v,
+        [SNAP_CAL_SERVICE] = c_svc, [SNAP_CAL_START] = c_start, [SNAP_CAL_END] = c_end,
+        [SNAP_CAL_DOW] = c_dow,
+        [SNAP_CD_SERVICE] = d_svc, [SNAP_CD_DATE] = d_date, [SNAP_CD_TYPE] = d_type,
+        [SNAP_ST_TRIP] = b.st_trip, [SNAP_ST_MINS_DELTA] = st_delta,
+        [SNAP_STRINGS] = b.strs.buf,
+    };
+    const size_t sizes[SNAP_COL_COUNT] = {
+        [SNAP_ROUTE_ID] = nr * 4u, [SNAP_ROUTE_SHORT] = nr * 4u,
+        [SNAP_STOP_ID] = ns * 4u, [SNAP_STOP_CODE] = ns * 4u, [SNAP_STOP_ST_BEGIN] = (ns + 1) * 4u,
+        [SNAP_TRIP_ID] = nt * 4u, [SNAP_TRIP_ROUTE] = nt * 4u,
+        [SNAP_TRIP_SERVICE] = nt * 4u, [SNAP_TRIP_HEADSIGN] = nt * 4u,
+        [SNAP_CAL_SERVICE] = nc * 4u, [SNAP_CAL_START] = nc * 4u, [SNAP_CAL_END] = nc * 4u,
+        [SNAP_CAL_DOW] = nc,
+        [SNAP_CD_SERVICE] = nd * 4u, [SNAP_CD_DATE] = nd * 4u, [SNAP_CD_TYPE] = nd,
+        [SNAP_ST_TRIP] = (size_t)nst * 4u, [SNAP_ST_MINS_DELTA] = (size_t)nst * 2u,
+        [SNAP_STRINGS] = b.strs.len,
+    };
+    rc = snapshot_write(snap_path, &hdr, cols, sizes);
+    if (rc == 0)
+        logf_("GTFS: compiled snapshot %s: trips=%u stop_times=%u strings=%u bytes",
+              snap_path, nt, nst, b.strs.len);
+
+out:
+    free(r_id); free(r_short); free(r_sid); free(s_id); free(s_code); free(s_sid);
+    free(c_svc); free(c_start); free(c_end); free(c_dow);
+    free(d_svc); free(d_date); free(d_type); free(st_delta); free(sort_buf);
+    snap_build_free(&b);
+    return rc;
+}
+
+/* Fill the small in-memory tables straight from the mapped snapshot (no CSV). */
+static void feed_from_snapshot(GtfsFeed *f, const Snapshot *s) {
+    const SnapHeader *h = s->hdr;
+    const uint32_t *r_id = snapshot_col(s, SNAP_ROUTE_ID), *r_short = snapshot_col(s, SNAP_ROUTE_SHORT);
+    const uint32_t *s_id = snapshot_col(s, SNAP_STOP_ID), *s_code = snapshot_col(s, SNAP_STOP_CODE);
+    const uint32_t *c_svc = snapshot_col(s, SNAP_CAL_SERVICE);
+    const int32_t *c_start = snapshot_col(s, SNAP_CAL_START), *c_end = snapshot_col(s, SNAP_CAL_END);
+    const uint8_t *c_dow = snapshot_col(s, SNAP_CAL_DOW);
+    const uint32_t *d_svc = snapshot_col(s, SNAP_CD_SERVICE);
+    const int32_t *d_date = snapshot_col(s, SNAP_CD_DATE);
+    const uint8_t *d_type = snapshot_col(s, SNAP_CD_TYPE);
+
+    for (uint32_t i = 0; i < h->n_routes; i++) {
+        GtfsRoute *r = table_push(&f->routes, &f->n_routes, &f->cap_routes, sizeof(GtfsRoute));
+        if (!r) { f->oom = 1; return; }
+        r->route_id = intern(f, snapshot_str(s, r_id[i]));
+        r->short_name = intern(f, snapshot_str(s, r_short[i]));
+    }
+    for (uint32_t i = 0; i < h->n_stops; i++) {
+        GtfsStop *st = table_push(&f->stops, &f->n_stops, &f->cap_stops, sizeof(GtfsStop));
+        if (!st) { f->oom = 1; return; }
+        st->stop_id = intern(f, snapshot_str(s, s_id[i]));
+        st->stop_code = intern(f, snapshot_str(s, s_code[i]));
+    }
+    for (uint32_t i = 0; i < h->n_calendars; i++) {
+        GtfsCalendar *c = table_push(&f->calendars, &f->n_calendars, &f->cap_calendars,
+                                     sizeof(GtfsCalendar));
+        if (!c) { f->oom = 1; return; }
+        c->service_id = intern(f, snapshot_str(s, c_svc[i]));
+        c->start_ymd = c_start[i];
+        c->end_ymd = c_end[i];
+        c->dow = c_dow[i];
+    }
+    for (uint32_t i = 0; i < h->n_cal_dates; i++) {
+        GtfsCalendarDate *cd = table_push(&f->cal_dates, &f->n_cal_dates, &f->cap_cal_dates,
+                                          sizeof(GtfsCalendarDate));
+        if (!cd) { f->oom = 1; return; }
+        cd->service_id = intern(f, snapshot_str(s, d_svc[i]));
+        cd->date_ymd = d_date[i];
+        cd->exception_type = d_type[i];
+    }
+}
+
+/* Materialize the stop_times and trips for the resolved stop filter from the inverted index. */
+static void stop_slice_from_snapshot(GtfsFeed *f, const Snapshot *s) {
+    const SnapHeader *h = s->hdr;
+    const uint32_t *begin = snapshot_col(s, SNAP_STOP_ST_BEGIN);
+    const uint32_t *st_trip = snapshot_col(s, SNAP_ST_TRIP);
+    const uint16_t *st_delta = snapshot_col(s, SNAP_ST_MINS_DELTA);
+    const uint32_t *t_id = snapshot_col(s, SNAP_TRIP_ID), *t_route = snapshot_col(s, SNAP_TRIP_ROUTE);
+    const uint32_t *t_svc = snapshot_col(s, SNAP_TRIP_SERVICE), *t_head = snapshot_col(s, SNAP_TRIP_HEADSIGN);
+    const uint32_t *r_id = snapshot_col(s, SNAP_ROUTE_ID);
+    uint8_t *trip_taken = calloc(h->n_trips ? h->n_trips : 1, 1);
+    if (!trip_taken) return;
+
+    f->n_stop_times = 0;
+    f->n_trips = 0;
+    for (int k = 0; k < f->n_stop_filter_ids; k++) {
+        uint32_t stop = UINT32_MAX;
+        for (int i = 0; i < f->n_stops && (uint32_t)i < h->n_stops; i++)
+            if (strcmp(fstr(f, f->stops[i].stop_id), f->stop_filter_ids[k]) == 0) { stop = (uint32_t)i; break; }
+        if (stop == UINT32_MAX) continue;
+        int mins = 0;
+        for (uint32_t j = begin[stop]; j < begin[stop + 1]; j++) {
+            mins += st_delta[j];
+            uint32_t t = st_trip[j];
+            if (t >= h->n_trips) continue;
+            GtfsStopTime *st = table_push(&f->stop_times, &f->n_stop_times, &f->cap_stop_times,
+                                          sizeof(GtfsStopTime));
+            if (!st) { f->oom = 1; break; }
+            st->trip_id = intern(f, snapshot_str(s, t_id[t]));
+            st->arrival_mins = mins;
+            st->stop = f->stop_filter_stop[k];
+            trip_taken[t] = 1;
+        }
+    }
+    /* trips.txt order, like the CSV path, so duplicate trip_ids resolve the same way */
+    for (uint32_t t = 0; t < h->n_trips; t++) {
+        if (!trip_taken[t]) continue;
+        GtfsTrip *tr = table_push(&f->trips, &f->n_trips, &f->cap_trips, sizeof(GtfsTrip));
+        if (!tr) { f->oom = 1; break; }
+        tr->trip_id = intern(f, snapshot_str(s, t_id[t]));
+        tr->route_id = intern(f, t_route[t] < h->n_routes ? snapshot_str(s, r_id[t_route[t]]) : "");
+        tr->service_id = intern(f, snapshot_str(s, t_svc[t]));
+        tr->headsign = intern(f, snapshot_str(s, t_head[t]));
+    }
+    free(trip_taken);
+}
+
+/* One small member parsed on the pool, through its own view of the zip. */
+typedef struct {
+    GtfsFeed   *f;
+    ZipArchive  za;
+    const char *name;
+    int       (*fn)(char *line, void *ctx);
+    int         rows;           /* read_zip_file() result */
+} MemberJob;
+
+static void member_job(void *arg) {
+    MemberJob *j = (MemberJob *)arg;
+    j->rows = read_zip_file(&j->za, j->name, j->fn, j->f);
+}
+
+static void gtfs_parse_zip(GtfsFeed *f, const char *zip_path) {
+    f->n_routes = f->n_trips = f->n_stop_times = 0;
+    f->n_stops = f->n_calendars = f->n_cal_dates = 0;
+    f->stop_times_cached = 0;
+    f->cached_stop_id[0] = '\0';
+    snapshot_close(&f->snap);
+    f->have_snap = 0;
+    ZipArchive za;
+    if (zip_open(&za, zip_path) != 0) {
+        logf_("GTFS: cannot open zip %s", zip_path);
+        return;
+    }
+    uint64_t hash = zip_content_hash(&za);
+    f->zip_hash = hash;
+    char snap_path[600];
+    snprintf(snap_path, sizeof(snap_path), "%s.snap", zip_path);
+    if (snapshot_open(&f->snap, snap_path, hash) == 0) {
+        f->have_snap = 1;
+        feed_from_snapshot(f, &f->snap);
+        gtfs_build_indexes(f);
+        zip_close(&za);
+        logf_("GTFS: using snapshot %s", snap_path);
+        return;
+    }
+
+    /* The four members fill separate tables and only share the string pool, so they
+     * are parsed concurrently. trips.txt and stop_times.txt are only read whole by the
+     * snapshot compile; without a snapshot they are loaded lazily per stop. */
+    int n_threads = gtfs_threads();
+    Pool *pool = n_threads > 1 ? pool_create(n_threads - 1) : NULL;
+    pthread_mutex_t intern_lock = PTHREAD_MUTEX_INITIALIZER;
+    MemberJob jobs[] = {
+        { f, { 0 }, "routes.txt", routes_fn, 0 },
+        { f, { 0 }, "stops.txt", stops_fn, 0 },
+        { f, { 0 }, "calendar.txt", calendar_fn, 0 },
+        { f, { 0 }, "calendar_dates.txt", calendar_dates_fn, 0 },
+    };
+    int n_jobs = (int)(sizeof(jobs) / sizeof(jobs[0]));
+    if (pool) f->intern_lock = &intern_lock;
+    for (int i = 0; i < n_jobs; i++) {
+        zip_view(&jobs[i].za, &za);
+        if (pool) pool_submit(pool, member_job, &jobs[i]);
+        else member_job(&jobs[i]);
+    }
+    if (pool) pool_wait(pool);
+    f->intern_lock = NULL;
+    for (int i = 0; i < n_jobs; i++) {
+        zip_view_close(&jobs[i].za);
+        if (jobs[i].rows == MEMBER_CORRUPT) f->corrupt = 1;
+    }
+
+    if (f->n_routes > 0 && f->n_stops > 0 && !f->corrupt && !f->read_only &&
+        gtfs_compile_snapshot(f, &za, pool, n_threads, snap_path, hash) == 0 &&
+        snapshot_open(&f->snap, snap_path, hash) == 0)
+        f->have_snap = 1;
+    pool_destroy(pool);
+    zip_close(&za);
+    gtfs_build_indexes(f);
+}
+
+static void feed_free(GtfsFeed *f) {
+    if (!f) return;
+    free(f->routes);
+    free(f->trips);
+    free(f->stop_times);
+    free(f->stops);
+    free(f->calendars);
+    free(f->cal_dates);
+    free(f->cal_next);
+    free(f->cd_next);
+    free(f->route_excl);
+    strtab_free(&f->strs);
+    snapshot_close(&f->snap);
+    free(f->route_ix.slot);
+    free(f->trip_ix.slot);
+    free(f->st_ix.slot);
+    free(f->cal_ix.slot);
+    free(f->cd_ix.slot);
+    free(f->service_ix.slot);
+    free(f->tl.e);
+    free(f->tl.begin);
+    free(f->tl.cur);
+    free(f->tl.far_when);
+    free(f->tl.far_trip);
+    free(f->tl.st_count);
+    pthread_mutex_destroy(&f->query_lock);
+    free(f);
+}
+
+static GtfsFeed *feed_new(void) {
+    GtfsFeed *f = calloc(1, sizeof(GtfsFeed));
+    if (!f) return NULL;
+    pthread_mutex_init(&f->query_lock, NULL);
+    atomic_init(&f->refs, 1);
+    if (strtab_init(&f->strs) != 0) {
+        feed_free(f);
+        return NULL;
+    }
+    return f;
 }
 
-static int feed_alloc(void) {
-    if (!feed.routes)    feed.routes    = calloc(MAX_ROUTES, sizeof(GtfsRoute));
-    if (!feed.trips)     feed.trips     = calloc(MAX_TRIPS, sizeof(GtfsTrip));
-    if (!feed.stop_times)feed.stop_times= calloc(MAX_STOPTIMES_AT_STOP, sizeof(GtfsStopTime));
-    if (!feed.stops)     feed.stops     = calloc(MAX_STOPS, sizeof(GtfsStop));
-    if (!feed.calendars) feed.calendars = calloc(MAX_CALENDAR, sizeof(GtfsCalendar));
-    if (!feed.cal_dates) feed.cal_dates = calloc(MAX_CAL_DATES, sizeof(GtfsCalendarDate));
-    return (feed.routes && feed.trips && feed.stop_times &&
-            feed.stops && feed.calendars && feed.cal_dates);
+/* Take a reference to every live feed, in GTFS_BUS_URL order. Returns the count;
+ * pair with feeds_release(). */
+static int feeds_acquire(GtfsFeed *out[GTFS_MAX_FEEDS]) {
+    int n = 0;
+    pthread_mutex_lock(&g_feed_swap);
+    for (int i = 0; i < g_n_slots; i++) {
+        GtfsFeed *f = g_slots[i].feed;
+        if (!f) continue;
+        atomic_fetch_add(&f->refs, 1);
+        out[n++] = f;
+    }
+    pthread_mutex_unlock(&g_feed_swap);
+    return n;
+}
+
+static void feed_release(GtfsFeed *f) {
+    if (f && atomic_fetch_sub(&f->refs, 1) == 1)
+        feed_free(f);
+}
+
+static void feeds_release(GtfsFeed *fs[], int n) {
+    for (int i = 0; i < n; i++) feed_release(fs[i]);
 }
 
-void gtfs_load(const char *gtfs_url, const char *cache_path) {
-    if (!gtfs_url || !*gtfs_url || !cache_path || !*cache_path) {
+/* Reference to the live feed of one slot (NULL if none). */
+static GtfsFeed *slot_acquire(int slot) {
+    pthread_mutex_lock(&g_feed_swap);
+    GtfsFeed *f = g_slots[slot].feed;
+    if (f) atomic_fetch_add(&f->refs, 1);
+    pthread_mutex_unlock(&g_feed_swap);
+    return f;
+}
+
+/* Publish f in slot (taking over the caller's reference; NULL empties the slot). The
+ * previous feed goes once unused. */
+static void feed_publish(int slot, GtfsFeed *f) {
+    pthread_mutex_lock(&g_feed_swap);
+    GtfsFeed *old = g_slots[slot].feed;
+    g_slots[slot].feed = f;
+    pthread_mutex_unlock(&g_feed_swap);
+    feed_release(old);
+}
+
+enum { GTFS_DL_FAIL = 0, GTFS_DL_NEW, GTFS_DL_NOT_MODIFIED };
+
+/*
+ * Fetch gtfs_url into cache_path without ever exposing a partial zip:
+ * - conditional: If-None-Match from <cache>.etag and If-Modified-Since from the cache
+ *   file's mtime (set from Last-Modified by -R), so an unchanged feed is a 304;
+ * - resumable: the body goes to <cache>.part and an interrupted transfer continues
+ *   with a Range request on the next attempt;
+ * - atomic: the .part file is renamed over the cache only once it opens as a zip.
+ */
+static int gtfs_download(const char *gtfs_url, const char *cache_path) {
+    char part[600], part_etag[600], etag[600], etag_new[600];
+    snprintf(part, sizeof(part), "%s.part", cache_path);
+    snprintf(part_etag, sizeof(part_etag), "%s.part.etag", cache_path);
+    snprintf(etag, sizeof(etag), "%s.etag", cache_path);
+    snprintf(etag_new, sizeof(etag_new), "%s.etag.new", cache_path);
+
+    char cond[1400] = "";
+    if (access(cache_path, R_OK) == 0) {
+        if (access(etag, R_OK) == 0)
+            snprintf(cond, sizeof(cond), "--etag-compare '%s' -z '%s'", etag, cache_path);
+        else
+            snprintf(cond, sizeof(cond), "-z '%s'", cache_path);
+    }
+    /* Resume only when we know which version the .part belongs to (If-Range). */
+    char resume[300] = "";
+    if (access(part, F_OK) == 0) {
+        char tag[200] = "";
+        FILE *f = fopen(part_etag, "r");
+        if (f) {
+            if (!fgets(tag, sizeof(tag), f)) tag[0] = '\0';
+            fclose(f);
+        }
+        tag[strcspn(tag, "\r\n")] = '\0';
+        if (tag[0] && !strchr(tag, '\'')) {
+            snprintf(resume, sizeof(resume), "-C - -H 'If-Range: %s'", tag);
+        } else {
+            unlink(part);
+            unlink(part_etag);
+        }
+    }
+    /* No --compressed: the zip's members are already deflated, and byte-range resume
+     * needs offsets into the file itself, not into an encoded stream. */
+    char cmd[4096];
+    snprintf(cmd, sizeof(cmd),
+             "curl -fsSL -R --connect-timeout 15 --max-time 120 %s %s --etag-save '%s' "
+             "-w '%%{http_code} %%{size_download}' -o '%s' '%s' 2>/dev/null",
+             resume, cond, etag_new, part, gtfs_url);
+    FILE *p = popen(cmd, "r");
+    if (!p) return GTFS_DL_FAIL;
+    int code = 0;
+    long wire = 0;
+    if (fscanf(p, "%d %ld", &code, &wire) < 1) code = 0;
+    int rc = pclose(p);
+
+    if (code == 304) {
+        unlink(etag_new);
+        return GTFS_DL_NOT_MODIFIED;
+    }
+    if (rc != 0 || (code != 200 && code != 206)) {
+        if ((resume[0] && code == 200) || code == 416 || access(etag_new, R_OK) != 0) {
+            /* full body refused as a resume, range rejected, or version unknown: restart */
+            unlink(part);
+            unlink(part_etag);
+            unlink(etag_new);
+        } else {
+            rename(etag_new, part_etag);
+        }
+        logf_("GTFS: download failed (HTTP %d)%s", code,
+              access(part, F_OK) == 0 ? "; will resume" : "");
+        return GTFS_DL_FAIL;
+    }
+    unlink(part_etag);
+    ZipArchive za;
+    if (zip_open(&za, part) != 0) {
+        logf_("GTFS: downloaded file is not a valid zip; discarding");
+        unlink(part);
+        unlink(etag_new);
+        return GTFS_DL_FAIL;
+    }
+    zip_close(&za);
+    if (rename(part, cache_path) != 0) {
+        logf_("GTFS: cannot rename %s", part);
+        return GTFS_DL_FAIL;
+    }
+    if (rename(etag_new, etag) != 0) unlink(etag);
+    logf_("GTFS: downloaded new feed (HTTP %d, %ld bytes on the wire)", code, wire);
+    return GTFS_DL_NEW;
+}
+
+/* New unpublished feed parsed from zip_path (check ->loaded), or NULL if out of memory.
+ * A read_only feed uses an existing snapshot but leaves no files next to the zip. */
+static GtfsFeed *feed_parse(const char *zip_path, int read_only) {
+    GtfsFeed *f = feed_new();
+    if (!f) return NULL;
+    f->read_only = read_only;
+    gtfs_parse_zip(f, zip_path);
+    snprintf(f->cache_path, sizeof(f->cache_path), "%s", zip_path);
+    f->loaded = (f->n_routes > 0 && f->n_stops > 0 && !f->oom && !f->corrupt);
+    return f;
+}
+
+/* Parse zip_path into a new feed and publish it in slot if usable; otherwise keep the
+ * live one. Returns a GTFS_STATUS_*. */
+static int gtfs_build_and_publish(int slot, const char *zip_path, const char *what) {
+    struct timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    GtfsFeed *f = feed_parse(zip_path, 0);
+    if (!f) return GTFS_STATUS_ALLOC_FAIL;
+    logf_("GTFS: %sroutes=%d stops=%d calendar=%d cal_dates=%d loaded=%d parse_ms=%ld",
+          what, f->n_routes, f->n_stops, f->n_calendars, f->n_cal_dates, f->loaded, elapsed_ms(&t0));
+    logf_("GTFS: bytes routes=%zu stops=%zu calendar=%zu cal_dates=%zu strings=%u (%u ids)",
+          (size_t)f->cap_routes * sizeof(GtfsRoute), (size_t)f->cap_stops * sizeof(GtfsStop),
+          (size_t)f->cap_calendars * sizeof(GtfsCalendar), (size_t)f->cap_cal_dates * sizeof(GtfsCalendarDate),
+          f->strs.cap, f->strs.n_strings);
+    if (!f->loaded) {
+        int status = f->oom ? GTFS_STATUS_ALLOC_FAIL : GTFS_STATUS_PARSE_FAIL;
+        feed_release(f);
+        return status;
+    }
+    feed_publish(slot, f);
+    return GTFS_STATUS_OK;
+}
+
+/* Conditionally fetch one slot's feed (GTFS_URL_LOCAL: take the cache file as it is) and
+ * reparse it only if its content changed. Returns a GTFS_STATUS_*; *dl_failed is set if the download failed (even when the
+ * live feed or the cache file still serves). */
+static int gtfs_load_feed(int slot, int *dl_failed) {
+    const char *gtfs_url = g_slots[slot].url, *cache_path = g_slots[slot].cache_path;
+    int dl;
+    if (strcasecmp(gtfs_url, GTFS_URL_LOCAL) == 0) {
+        /* The file stands in for a new download: an unchanged zip keeps the live feed
+         * through the content-hash check below. */
+        if (access(cache_path, R_OK) != 0) {
+            logf_("GTFS: GTFS_BUS_URL=none but no zip at %s", cache_path);
+            *dl_failed = 1;
+            return GTFS_STATUS_NO_CACHE;
+        }
+        dl = GTFS_DL_NEW;
+    } else {
+        dl = gtfs_download(gtfs_url, cache_path);
+        if (dl == GTFS_DL_FAIL) {
+            logf_("GTFS: download failed, retrying in 2s");
+            sleep(2);
+            dl = gtfs_download(gtfs_url, cache_path);
+        }
+    }
+    GtfsFeed *live = slot_acquire(slot);
+    int same_cache = live && strcmp(live->cache_path, cache_path) == 0;
+    uint64_t live_hash = live ? live->zip_hash : 0;
+    feed_release(live);
+
+    *dl_failed = (dl == GTFS_DL_FAIL);
+    if (dl == GTFS_DL_FAIL) {
+        logf_("GTFS: download failed at %s", cache_path);
+        if (same_cache) {
+            logf_("GTFS: keeping the live feed parsed from %s", cache_path);
+            return GTFS_STATUS_OK;
+        }
+        if (access(cache_path, R_OK) == 0)
+            return gtfs_build_and_publish(slot, cache_path, "loaded from existing cache after download fail: ");
+        logf_("GTFS: no cache file; keeping previous in-memory feed if any");
+        return GTFS_STATUS_DOWNLOAD_FAIL;
+    }
+    if (same_cache) {
+        /* 304, or a new download with the same members: keep the live feed */
+        ZipArchive za;
+        uint64_t hash = 0;
+        if (dl == GTFS_DL_NEW && zip_open(&za, cache_path) == 0) {
+            hash = zip_content_hash(&za);
+            zip_close(&za);
+        }
+        if (dl == GTFS_DL_NOT_MODIFIED || hash == live_hash) {
+            logf_("GTFS: feed unchanged (%s), keeping parsed data",
+                  dl == GTFS_DL_NOT_MODIFIED ? "304" : "same content hash");
+            return GTFS_STATUS_OK;
+        }
+    }
+    return gtfs_build_and_publish(slot, cache_path, "");
+}
+
+static void load_feed_job(void *arg) {
+    int slot = (int)(intptr_t)arg;
+    FeedSlot *s = &g_slots[slot];
+    int dl_failed = 0;
+    s->status = gtfs_load_feed(slot, &dl_failed);
+    /* A local zip costs only a central-directory hash to recheck, so it is looked at hourly. */
+    int local = strcasecmp(s->url, GTFS_URL_LOCAL) == 0;
+    s->next_check = time(NULL) + (dl_failed || local ? GTFS_RETRY_SECS : GTFS_RECHECK_SECS);
+}
+
+/* Cache file for one of n feeds: cache_path itself when there is one feed, else
+ * cache_path with the URL's zip name inserted (gtfs_bus_cache_gtfs_q.zip), so a file
+ * stays with its feed if the list is reordered. */
+static void feed_cache_path(char *out, size_t out_sz, const char *cache_path, const char *url, int n) {
+    if (n == 1) {
+        snprintf(out, out_sz, "%s", cache_path);
+        return;
+    }
+    const char *name = strrchr(url, '/');
+    name = name ? name + 1 : url;
+    char tag[128];
+    size_t k = 0;
+    for (; name[k] && name[k] != '?' && name[k] != '#' && k + 1 < sizeof(tag); k++)
+        tag[k] = (isalnum((unsigned char)name[k]) || name[k] == '-' || name[k] == '.') ? name[k] : '_';
+    tag[k] = '\0';
+    if (k > 4 && strcmp(tag + k - 4, ".zip") == 0) tag[k - 4] = '\0';
+    size_t stem = strlen(cache_path);
+    if (stem > 4 && strcmp(cache_path + stem - 4, ".zip") == 0) stem -= 4;
+    snprintf(out, out_sz, "%.*s_%s.zip", (int)stem, cache_path, tag[0] ? tag : "feed");
+}
+
+void gtfs_load(const char *gtfs_urls, const char *cache_path) {
+    if (!gtfs_urls || !*gtfs_urls || !cache_path || !*cache_path) {
         g_gtfs_last_status = GTFS_STATUS_BAD_INPUT;
         return;
     }
 
-    if (!feed_alloc()) {
-        g_gtfs_last_status = GTFS_STATUS_ALLOC_FAIL;
+    /* Split the list (commas or whitespace) into slots; a slot whose URL or cache
+     * file changed is due at once. */
+    char list[2048], *save = NULL;
+    snprintf(list, sizeof(list), "%s", gtfs_urls);
+    const char *urls[GTFS_MAX_FEEDS];
+    int n = 0;
+    for (char *tok = strtok_r(list, ", \t\n", &save); tok; tok = strtok_r(NULL, ", \t\n", &save)) {
+        if (n == GTFS_MAX_FEEDS) {
+            logf_("GTFS: more than %d feeds in GTFS_BUS_URL; ignoring %s", GTFS_MAX_FEEDS, tok);
+            continue;
+        }
+        urls[n++] = tok;
+    }
+    if (n == 0) {
+        g_gtfs_last_status = GTFS_STATUS_BAD_INPUT;
         return;
     }
+    char paths[GTFS_MAX_FEEDS][512];
+    for (int i = 0; i < n; i++) {
+        FeedSlot *s = &g_slots[i];
+        char *path = paths[i];
+        feed_cache_path(path, sizeof(paths[i]), cache_path, urls[i], n);
+        for (int j = 0; j < i; j++)
+            if (strcmp(paths[j], path) == 0) {     /* same zip name on two hosts */
+                size_t len = strlen(path);
+                snprintf(path + len - 4, sizeof(paths[i]) - (len - 4), "_%d.zip", i + 1);
+                break;
+            }
+        if (strcmp(s->url, urls[i]) != 0 || strcmp(s->cache_path, path) != 0) {
+            snprintf(s->url, sizeof(s->url), "%s", urls[i]);
+            snprintf(s->cache_path, sizeof(s->cache_path), "%s", path);
+            s->next_check = 0;
+        }
+    }
+    pthread_mutex_lock(&g_feed_swap);
+    int old_n = g_n_slots;
+    g_n_slots = n;
+    pthread_mutex_unlock(&g_feed_swap);
+    for (int i = n; i < old_n; i++) {
+        feed_publish(i, NULL);
+        memset(&g_slots[i], 0, sizeof(g_slots[i]));
+    }
 
     char dir[512];
     snprintf(dir, sizeof(dir), "%s", cache_path);
@@ -399,53 +1617,101 @@ void gtfs_load(const char *gtfs_url, const char *cache_path) {
         snprintf(mkdir_cmd, sizeof(mkdir_cmd), "mkdir -p '%s' 2>/dev/null", dir);
         (void)system(mkdir_cmd);
     }
-    char cmd[2048];
-    snprintf(cmd, sizeof(cmd),
-             "curl -fsSL --connect-timeout 15 --max-time 120 -o '%s' '%s' 2>/dev/null",
-             cache_path, gtfs_url);
-    int dl_ok = (system(cmd) == 0);
-    if (!dl_ok) {
-        logf_("GTFS: download failed, retrying in 2s");
-        sleep(2);
-        dl_ok = (system(cmd) == 0);
-    }
-    if (!dl_ok) {
-        logf_("GTFS: download failed at %s", cache_path);
-        g_gtfs_last_status = GTFS_STATUS_DOWNLOAD_FAIL;
-        if (access(cache_path, R_OK) == 0) {
-            gtfs_parse_zip(cache_path);
-            snprintf(feed.cache_path, sizeof(feed.cache_path), "%s", cache_path);
-            feed.loaded = (feed.n_routes > 0 && feed.n_stops > 0);
-            g_gtfs_last_status = feed.loaded ? GTFS_STATUS_OK : GTFS_STATUS_PARSE_FAIL;
-            logf_("GTFS: loaded from existing cache after download fail: routes=%d trips=%d stops=%d loaded=%d",
-                  feed.n_routes, feed.n_trips, feed.n_stops, feed.loaded);
-        } else {
-            logf_("GTFS: no cache file; keeping previous in-memory feed if any");
-        }
-        return;
+
+    /* Due feeds download and parse side by side; the others are not touched. */
+    time_t now = time(NULL);
+    int due[GTFS_MAX_FEEDS], n_due = 0;
+    for (int i = 0; i < n; i++)
+        if (!g_slots[i].feed || now >= g_slots[i].next_check) due[n_due++] = i;
+    if (n > 1)
+        logf_("GTFS: %d feeds, %d due for a refresh", n, n_due);
+    int n_workers = (n_due < gtfs_threads() ? n_due : gtfs_threads()) - 1;
+    Pool *pool = n_workers > 0 ? pool_create(n_workers) : NULL;
+    for (int k = 0; k < n_due; k++) {
+        if (pool) pool_submit(pool, load_feed_job, (void *)(intptr_t)due[k]);
+        else load_feed_job((void *)(intptr_t)due[k]);
+    }
+    if (pool) pool_wait(pool);
+    pool_destroy(pool);
+
+    int status = GTFS_STATUS_OK;
+    for (int i = 0; i < n && status == GTFS_STATUS_OK; i++) status = g_slots[i].status;
+    g_gtfs_last_status = status;
+}
+
+typedef struct {
+    char url[2048];
+    char cache_path[512];
+} GtfsLoadJob;
+
+static void *gtfs_load_worker(void *arg) {
+    GtfsLoadJob *job = (GtfsLoadJob *)arg;
+    gtfs_load(job->url, job->cache_path);
+    free(job);
+    atomic_store(&g_gtfs_loading, 0);
+    return NULL;
+}
+
+int gtfs_load_async(const char *gtfs_urls, const char *cache_path) {
+    int idle = 0;
+    if (!atomic_compare_exchange_strong(&g_gtfs_loading, &idle, 1)) return -1;
+    GtfsLoadJob *job = calloc(1, sizeof(GtfsLoadJob));
+    pthread_t tid;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (job) {
+        snprintf(job->url, sizeof(job->url), "%s", gtfs_urls ? gtfs_urls : "");
+        snprintf(job->cache_path, sizeof(job->cache_path), "%s", cache_path ? cache_path : "");
+    }
+    if (!job || pthread_create(&tid, &attr, gtfs_load_worker, job) != 0) {
+        pthread_attr_destroy(&attr);
+        free(job);
+        atomic_store(&g_gtfs_loading, 0);
+        logf_("GTFS: cannot start reload worker");
+        return -1;
     }
+    pthread_attr_destroy(&attr);
+    return 0;
+}
 
-    gtfs_parse_zip(cache_path);
-    snprintf(feed.cache_path, sizeof(feed.cache_path), "%s", cache_path);
-    feed.loaded = (feed.n_routes > 0 && feed.n_stops > 0);
-    g_gtfs_last_status = feed.loaded ? GTFS_STATUS_OK : GTFS_STATUS_PARSE_FAIL;
-    logf_("GTFS: routes=%d trips=%d stops=%d calendar=%d cal_dates=%d loaded=%d",
-          feed.n_routes, feed.n_trips, feed.n_stops, feed.n_calendars, feed.n_cal_dates, feed.loaded);
+int gtfs_load_busy(void) {
+    return atomic_load(&g_gtfs_loading);
 }
 
 int gtfs_last_status(void) {
     return g_gtfs_last_status;
 }
 
-int gtfs_stop_known(const char *stop_id) {
-    if (!feed.loaded || !stop_id || !*stop_id) return -1;
-    for (int i = 0; i < feed.n_stops; i++) {
-        if (strcmp(feed.stops[i].stop_id, stop_id) == 0)
-            return 1;
-        if (feed.stops[i].stop_code[0] && strcmp(feed.stops[i].stop_code, stop_id) == 0)
-            return 1;
+/* 1 if stop_id is a stop_id or stop_code of a loaded feed, 0 if not, -1 if none is loaded. */
+static int stop_known_one(GtfsFeed *fs[], int n, const char *stop_id) {
+    int known = -1;
+    for (int k = 0; k < n && known != 1; k++) {
+        GtfsFeed *f = fs[k];
+        if (!f->loaded) continue;
+        known = 0;
+        pthread_mutex_lock(&f->query_lock);    /* a stop slice load may move the string pool */
+        for (int i = 0; i < f->n_stops && !known; i++) {
+            if (strcmp(fstr(f, f->stops[i].stop_id), stop_id) == 0)
+                known = 1;
+            else if (f->stops[i].stop_code && strcmp(fstr(f, f->stops[i].stop_code), stop_id) == 0)
+                known = 1;
+        }
+        pthread_mutex_unlock(&f->query_lock);
     }
-    return 0;
+    return known;
+}
+
+int gtfs_stop_known(const char *stop_id) {
+    GtfsFeed *fs[GTFS_MAX_FEEDS];
+    int n = feeds_acquire(fs);
+    int known = -1;
+    char list[256], *save = NULL;
+    snprintf(list, sizeof(list), "%s", stop_id ? stop_id : "");
+    for (char *id = strtok_r(list, ", \t\n", &save); id && known != 0; id = strtok_r(NULL, ", \t\n", &save))
+        known = stop_known_one(fs, n, id);
+    feeds_release(fs, n);
+    return known;
 }
 
 const char *gtfs_last_status_str(void) {
@@ -455,120 +1721,775 @@ const char *gtfs_last_status_str(void) {
         case GTFS_STATUS_ALLOC_FAIL:    return "ALLOC_FAIL";
         case GTFS_STATUS_DOWNLOAD_FAIL: return "DOWNLOAD_FAIL";
         case GTFS_STATUS_PARSE_FAIL:    return "PARSE_FAIL";
+        case GTFS_STATUS_NO_CACHE:      return "NO_CACHE";
         default:                        return "UNKNOWN";
     }
 }
 
-int gtfs_next_departures(const char *stop_id, const char *realtime_routes,
-                         ScheduledDeparture *out, int max_out) {
-    if (!feed.loaded || !out || max_out <= 0 || !stop_id || !*stop_id) return 0;
+typedef struct {
+    GtfsFeed   *all;            /* scratch feed: every trip in trips.txt */
+    ZipArchive  za;
+    int         rows;           /* read_zip_file() result */
+} TripsJob;
+
+static void trips_job(void *arg) {
+    TripsJob *j = (TripsJob *)arg;
+    j->rows = read_zip_file(&j->za, "trips.txt", trips_fn, j->all);
+}
 
-    if (!feed.stop_times_cached || strcmp(stop_id, feed.cached_stop_id) != 0) {
-        if (!resolve_stop(stop_id)) return 0;
-        const char *zip = feed.cache_path[0] ? feed.cache_path : "/tmp/gtfs_bus_cache.zip";
+/* No snapshot: filter stop_times.txt in parallel blocks while trips.txt is read on the
+ * pool, then keep the trips the stop uses. Returns 0 if the zip cannot be read or either
+ * member is missing or corrupt (nothing is kept). */
+static int stop_slice_from_zip(GtfsFeed *f) {
+    const char *zip = f->cache_path[0] ? f->cache_path : "/tmp/gtfs_bus_cache.zip";
+    ZipArchive za;
+    if (zip_open(&za, zip) != 0) {
+        logf_("GTFS: cannot open zip %s", zip);
+        return 0;
+    }
+    struct timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    int n_threads = gtfs_threads();
+    Pool *pool = n_threads > 1 ? pool_create(n_threads - 1) : NULL;
+    TripsJob tj = { feed_new(), { 0 }, 0 };
+    if (!tj.all) {
+        pool_destroy(pool);
+        zip_close(&za);
+        f->oom = 1;
+        return 0;
+    }
+    zip_view(&tj.za, &za);
+    if (pool) pool_submit(pool, trips_job, &tj);
+    else trips_job(&tj);
+
+    f->n_stop_times = 0;
+    f->n_trips = 0;
+    int blocks = scan_member(&za, "stop_times.txt", pool, 2 * n_threads, stop_times_scan, stop_times_merge, f);
+    if (pool) pool_wait(pool);
+    if (blocks < 0 || tj.rows < 0) {
+        f->n_stop_times = 0;
+        pool_destroy(pool);
+        zip_view_close(&tj.za);
+        feed_release(tj.all);
+        zip_close(&za);
+        return 0;
+    }
+    if (slice_trips_from(f, tj.all) != 0) f->oom = 1;
+    long ms = elapsed_ms(&t0);
+    logf_("GTFS: stop_times at stop (%d ids): %d, trips: %d (%ld ms, %.0f MB/s, %d threads) bytes stop_times=%zu trips=%zu strings=%u",
+          f->n_stop_filter_ids, f->n_stop_times, f->n_trips, ms,
+          zip_member_size(&za, "stop_times.txt") / 1e3 / (ms ? ms : 1), n_threads,
+          (size_t)f->cap_stop_times * sizeof(GtfsStopTime), (size_t)f->cap_trips * sizeof(GtfsTrip),
+          f->strs.cap);
+    pool_destroy(pool);
+    zip_view_close(&tj.za);
+    feed_release(tj.all);
+    zip_close(&za);
+    return 1;
+}
+
+/* ---- Per-stop cache -----------------------------------------------------------
+ * Without a snapshot the stop's slice costs a full pass over stop_times.txt, so the
+ * resolved filter ids and the matched stop_times and trips are kept in <zip>.stop,
+ * tagged with the zip's content hash and the configured STOP_ID list. A restart reads
+ * that back instead of the zip. Layout: header, filter ids, their list entries (u8 each,
+ * padded to 4 bytes), stop_times, trips, strings. */
+
+#define STOP_CACHE_MAGIC   "GTFSSTOP"
+#define STOP_CACHE_VERSION 2
+
+typedef struct {
+    char     magic[8];
+    uint32_t version;
+    uint32_t n_filter_ids;
+    uint64_t zip_hash;
+    char     stop_id[256];
+    char     stop_id_resolved[32];
+    uint32_t n_stop_times;      /* u32 trip_id offset, i32 arrival_mins, u32 list entry each */
+    uint32_t n_trips;           /* u32 trip_id, route_id, service_id, headsign offsets each */
+    uint32_t strings_size;      /* NUL-terminated strings; offset 0 is "" */
+    uint32_t reserved;
+} StopCacheHeader;
 
-        feed.n_stop_times = 0;
-        read_zip_file(zip, "stop_times.txt", stop_times_fn, NULL);
-        logf_("GTFS: stop_times at stop (%d ids): %d", n_stop_filter_ids, feed.n_stop_times);
+static void stop_cache_path(const GtfsFeed *f, char *out, size_t out_sz) {
+    snprintf(out, out_sz, "%s.stop", f->cache_path[0] ? f->cache_path : "/tmp/gtfs_bus_cache.zip");
+}
 
-        feed.n_trips = 0;
-        read_zip_file(zip, "trips.txt", trips_filtered_fn, NULL);
-        logf_("GTFS: trips matching stop: %d", feed.n_trips);
+/* Save the current slice; best effort, a failed write only costs the next restart a scan. */
+static void stop_cache_write(const GtfsFeed *f, const char *stop_id) {
+    char path[600], tmp[610];
+    stop_cache_path(f, path, sizeof(path));
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    StrTab t;
+    if (strtab_init(&t) != 0) return;
+    size_t st_sz = (size_t)f->n_stop_times * 3, tr_sz = (size_t)f->n_trips * 4;
+    uint32_t *st = malloc((st_sz ? st_sz : 1) * sizeof(uint32_t));
+    uint32_t *tr = malloc((tr_sz ? tr_sz : 1) * sizeof(uint32_t));
+    unsigned char entries[(MAX_STOP_FILTER_IDS + 3) & ~3] = { 0 };
+    size_t entries_sz = ((size_t)f->n_stop_filter_ids + 3) & ~(size_t)3;
+    memcpy(entries, f->stop_filter_stop, (size_t)f->n_stop_filter_ids);
+    int ok = st && tr;
+    for (int i = 0; ok && i < f->n_stop_times; i++) {
+        const char *s = fstr(f, f->stop_times[i].trip_id);
+        st[3 * i] = strtab_add(&t, s, NULL);
+        st[3 * i + 1] = (uint32_t)f->stop_times[i].arrival_mins;
+        st[3 * i + 2] = (uint32_t)f->stop_times[i].stop;
+        if (!st[3 * i] && *s) ok = 0;
+    }
+    for (int i = 0; ok && i < f->n_trips; i++) {
+        const Str h[4] = { f->trips[i].trip_id, f->trips[i].route_id, f->trips[i].service_id,
+                           f->trips[i].headsign };
+        for (int k = 0; k < 4; k++) {
+            tr[4 * i + k] = strtab_add(&t, fstr(f, h[k]), NULL);
+            if (!tr[4 * i + k] && *fstr(f, h[k])) ok = 0;
+        }
+    }
+    StopCacheHeader hdr = { 0 };
+    memcpy(hdr.magic, STOP_CACHE_MAGIC, sizeof(hdr.magic));
+    hdr.version = STOP_CACHE_VERSION;
+    hdr.n_filter_ids = (uint32_t)f->n_stop_filter_ids;
+    hdr.zip_hash = f->zip_hash;
+    snprintf(hdr.stop_id, sizeof(hdr.stop_id), "%s", stop_id);
+    snprintf(hdr.stop_id_resolved, sizeof(hdr.stop_id_resolved), "%s", f->stop_id_resolved);
+    hdr.n_stop_times = (uint32_t)f->n_stop_times;
+    hdr.n_trips = (uint32_t)f->n_trips;
+    hdr.strings_size = t.len;
 
-        feed.stop_times_cached = 1;
-        snprintf(feed.cached_stop_id, sizeof(feed.cached_stop_id), "%s", stop_id);
+    FILE *fp = ok ? fopen(tmp, "wb") : NULL;
+    if (fp) {
+        ok = fwrite(&hdr, sizeof(hdr), 1, fp) == 1 &&
+             (hdr.n_filter_ids == 0 ||
+              fwrite(f->stop_filter_ids, sizeof(f->stop_filter_ids[0]), hdr.n_filter_ids, fp) == hdr.n_filter_ids) &&
+             fwrite(entries, 1, entries_sz, fp) == entries_sz &&
+             (st_sz == 0 || fwrite(st, sizeof(uint32_t), st_sz, fp) == st_sz) &&
+             (tr_sz == 0 || fwrite(tr, sizeof(uint32_t), tr_sz, fp) == tr_sz) &&
+             fwrite(t.buf, 1, t.len, fp) == t.len;
+        if (fflush(fp) != 0 || fsync(fileno(fp)) != 0) ok = 0;
+        if (fclose(fp) != 0) ok = 0;
+        if (!ok || rename(tmp, path) != 0) {
+            unlink(tmp);
+            ok = 0;
+        }
+    } else {
+        ok = 0;
     }
+    if (!ok) logf_("GTFS: cannot write stop cache %s", path);
+    free(st);
+    free(tr);
+    strtab_free(&t);
+}
 
-    int now_ymd, now_mins;
-    now_ny(&now_ymd, &now_mins);
+/* Rehydrate the slice for the STOP_ID list stop_id from <zip>.stop. Returns 1 on success, 0 if the file
+ * is missing, for another zip or stop, or corrupt (the caller scans the zip). */
+static int stop_cache_read(GtfsFeed *f, const char *stop_id) {
+    char path[600];
+    stop_cache_path(f, path, sizeof(path));
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return 0;
+    StopCacheHeader hdr;
+    unsigned char *body = NULL;
+    int ok = fread(&hdr, sizeof(hdr), 1, fp) == 1 &&
+             memcmp(hdr.magic, STOP_CACHE_MAGIC, sizeof(hdr.magic)) == 0 &&
+             hdr.version == STOP_CACHE_VERSION &&
+             hdr.zip_hash == f->zip_hash &&
+             hdr.stop_id[sizeof(hdr.stop_id) - 1] == '\0' && strcmp(hdr.stop_id, stop_id) == 0 &&
+             hdr.stop_id_resolved[sizeof(hdr.stop_id_resolved) - 1] == '\0' &&
+             hdr.n_filter_ids >= 1 && hdr.n_filter_ids <= MAX_STOP_FILTER_IDS &&
+             hdr.n_stop_times <= INT32_MAX / 3 && hdr.n_trips <= INT32_MAX / 4 &&
+             hdr.strings_size >= 1;
+    size_t entries_sz = ok ? ((size_t)hdr.n_filter_ids + 3) & ~(size_t)3 : 0;
+    size_t ids_sz = ok ? (size_t)hdr.n_filter_ids * sizeof(f->stop_filter_ids[0]) + entries_sz : 0;
+    size_t st_sz = ok ? (size_t)hdr.n_stop_times * 3 * sizeof(uint32_t) : 0;
+    size_t tr_sz = ok ? (size_t)hdr.n_trips * 4 * sizeof(uint32_t) : 0;
+    size_t body_sz = ids_sz + st_sz + tr_sz + hdr.strings_size;
+    if (ok) body = malloc(body_sz);
+    ok = ok && body && fread(body, 1, body_sz, fp) == body_sz && fgetc(fp) == EOF;
+    fclose(fp);
+    const char (*ids)[32] = (const char (*)[32])body;
+    const unsigned char *entries = ok ? body + ids_sz - entries_sz : NULL;
+    const char *strs = ok ? (const char *)body + ids_sz + st_sz + tr_sz : NULL;
+    ok = ok && strs[0] == '\0' && strs[hdr.strings_size - 1] == '\0';
+    for (uint32_t i = 0; ok && i < hdr.n_filter_ids; i++)
+        if (!memchr(ids[i], '\0', sizeof(ids[i])) || entries[i] >= f->n_list_stops) ok = 0;
+    uint32_t st[3], tr[4];
+    for (uint32_t i = 0; ok && i < hdr.n_stop_times; i++) {
+        memcpy(st, body + ids_sz + (size_t)i * sizeof(st), sizeof(st));
+        if (st[0] >= hdr.strings_size || st[2] >= (uint32_t)f->n_list_stops) ok = 0;
+    }
+    for (uint32_t i = 0; ok && i < hdr.n_trips; i++) {
+        memcpy(tr, body + ids_sz + st_sz + (size_t)i * sizeof(tr), sizeof(tr));
+        for (int k = 0; k < 4; k++)
+            if (tr[k] >= hdr.strings_size) ok = 0;
+    }
+    if (!ok) {
+        free(body);
+        return 0;
+    }
+
+    f->n_stop_filter_ids = (int)hdr.n_filter_ids;
+    memcpy(f->stop_filter_ids, ids, ids_sz - entries_sz);
+    memcpy(f->stop_filter_stop, entries, hdr.n_filter_ids);
+    snprintf(f->stop_id_resolved, sizeof(f->stop_id_resolved), "%s", hdr.stop_id_resolved);
+    f->n_stop_times = 0;
+    f->n_trips = 0;
+    for (uint32_t i = 0; i < hdr.n_stop_times; i++) {
+        memcpy(st, body + ids_sz + (size_t)i * sizeof(st), sizeof(st));
+        GtfsStopTime *row = table_push(&f->stop_times, &f->n_stop_times, &f->cap_stop_times,
+                                       sizeof(GtfsStopTime));
+        if (!row) { f->oom = 1; break; }
+        row->trip_id = intern(f, strs + st[0]);
+        row->arrival_mins = (int)st[1];
+        row->stop = (int)st[2];
+    }
+    for (uint32_t i = 0; i < hdr.n_trips; i++) {
+        memcpy(tr, body + ids_sz + st_sz + (size_t)i * sizeof(tr), sizeof(tr));
+        GtfsTrip *row = table_push(&f->trips, &f->n_trips, &f->cap_trips, sizeof(GtfsTrip));
+        if (!row) { f->oom = 1; break; }
+        row->trip_id = intern(f, strs + tr[0]);
+        row->route_id = intern(f, strs + tr[1]);
+        row->service_id = intern(f, strs + tr[2]);
+        row->headsign = intern(f, strs + tr[3]);
+    }
+    free(body);
+    return 1;
+}
 
-    typedef struct { char route_id[64]; time_t when; char headsign[128]; } Cand;
-    static Cand best[MAX_ROUTES];
-    static int route_seen[MAX_ROUTES];
-    for (int i = 0; i < MAX_ROUTES; i++) {
-        route_seen[i] = 0;
-        best[i].when = (time_t)-1;
-        best[i].route_id[0] = '\0';
+/* Load the stop_times and trips serving stop_id, unless already cached. Returns 1 if
+ * loaded, 0 if the zip cannot be read, or -1 if the stop is not in this feed. */
+static int load_stop_slice(GtfsFeed *f, const char *stop_id) {
+    if (!f->stop_times_cached || strcmp(stop_id, f->cached_stop_id) != 0) {
+        if (!resolve_stop(f, stop_id)) return -1;
+        struct timespec t0;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        if (f->have_snap) {
+            stop_slice_from_snapshot(f, &f->snap);
+            logf_("GTFS: stop_times at stop (%d ids): %d, trips: %d (snapshot, %ld ms) bytes stop_times=%zu trips=%zu strings=%u",
+                  f->n_stop_filter_ids, f->n_stop_times, f->n_trips, elapsed_ms(&t0),
+                  (size_t)f->cap_stop_times * sizeof(GtfsStopTime), (size_t)f->cap_trips * sizeof(GtfsTrip),
+                  f->strs.cap);
+        } else if (stop_cache_read(f, stop_id)) {
+            logf_("GTFS: stop_times at stop (%d ids): %d, trips: %d (stop cache, %ld ms) bytes stop_times=%zu trips=%zu strings=%u",
+                  f->n_stop_filter_ids, f->n_stop_times, f->n_trips, elapsed_ms(&t0),
+                  (size_t)f->cap_stop_times * sizeof(GtfsStopTime), (size_t)f->cap_trips * sizeof(GtfsTrip),
+                  f->strs.cap);
+        } else if (!stop_slice_from_zip(f)) {
+            return 0;
+        } else if (!f->oom && !f->read_only) {
+            stop_cache_write(f, stop_id);
+        }
+        id_index_build(&f->trip_ix, &f->strs, f->trips, f->n_trips, sizeof(GtfsTrip),
+                       offsetof(GtfsTrip, trip_id));
+
+        f->stop_times_cached = 1;
+        snprintf(f->cached_stop_id, sizeof(f->cached_stop_id), "%s", stop_id);
+        f->tl.valid = 0;
     }
+    return 1;
+}
 
-    time_t now_sec = time(NULL);
-    int express_routes_found = 0;
-    for (int i = 0; i < feed.n_stop_times; i++) {
-        GtfsTrip *tr = trip_by_id(feed.stop_times[i].trip_id);
+static int cmp_timeline(const void *a, const void *b) {
+    const TimelineEntry *x = (const TimelineEntry *)a, *y = (const TimelineEntry *)b;
+    if (x->lane != y->lane) return x->lane < y->lane ? -1 : 1;
+    if (x->when != y->when) return x->when < y->when ? -1 : 1;
+    return (x->seq > y->seq) - (x->seq < y->seq);
+}
+
+/* Expand the stops' stop_times over the service window into the timeline.
+ * Runs after a feed reload, a stop change, or a service-day rollover. */
+static void gtfs_build_timeline(GtfsFeed *f) {
+    StopTimeline *tl = &f->tl;
+    time_t horizon = f->days[TIMELINE_DAYS].midnight;
+    tl->n = 0;
+    tl->orphan_express = 0;
+    int n_stops = f->n_list_stops > 0 ? f->n_list_stops : 1;
+    if (tl->n_lanes != f->n_routes * n_stops || !tl->begin) {
+        int nl = f->n_routes * n_stops;
+        free(tl->begin); free(tl->cur); free(tl->far_when); free(tl->far_trip); free(tl->st_count);
+        tl->begin = malloc((size_t)(nl + 1) * sizeof(int));
+        tl->cur = malloc((size_t)(nl + 1) * sizeof(int));
+        tl->far_when = malloc((size_t)(nl + 1) * sizeof(time_t));
+        tl->far_trip = malloc((size_t)(nl + 1) * sizeof(int));
+        tl->st_count = malloc((size_t)(nl + 1) * sizeof(int));
+        tl->n_lanes = nl;
+        if (!tl->begin || !tl->cur || !tl->far_when || !tl->far_trip || !tl->st_count) {
+            free(tl->begin); free(tl->cur); free(tl->far_when); free(tl->far_trip); free(tl->st_count);
+            tl->begin = tl->cur = tl->far_trip = tl->st_count = NULL;
+            tl->far_when = NULL;
+            tl->n_lanes = 0;
+            tl->n_stops = 0;
+            f->oom = 1;
+            return;
+        }
+    }
+    tl->n_stops = n_stops;
+    for (int l = 0; l < tl->n_lanes; l++) {
+        tl->far_when[l] = (time_t)-1;
+        tl->st_count[l] = 0;
+    }
+    int seq = 0;
+    for (int i = 0; i < f->n_stop_times; i++) {
+        GtfsTrip *tr = trip_by_id(f, fstr(f, f->stop_times[i].trip_id));
         if (!tr) continue;
-        const char *short_name = route_short_name(tr->route_id);
-        if (route_excluded(short_name, realtime_routes)) continue;
-        if (is_express_route(tr->route_id)) express_routes_found++;
-
-        int route_idx = -1;
-        for (int ri = 0; ri < feed.n_routes; ri++)
-            if (strcmp(feed.routes[ri].route_id, tr->route_id) == 0) { route_idx = ri; break; }
-        if (route_idx < 0) continue;
-
-        int arr_mins = feed.stop_times[i].arrival_mins;
-        for (int day = 0; day < 14; day++) {
-            int y = now_ymd / 10000, m = (now_ymd / 100) % 100, d = now_ymd % 100;
-            struct tm tm = { 0 };
-            tm.tm_year = y - 1900;
-            tm.tm_mon = m - 1;
-            tm.tm_mday = d + day;
-            tm.tm_isdst = -1;
-            tz_set_ny();
-            time_t t = mktime(&tm);
-            if (t == (time_t)-1) continue;
-            struct tm *lt = localtime(&t);
-            if (!lt) continue;
-            int date_ymd = (lt->tm_year + 1900) * 10000 + (lt->tm_mon + 1) * 100 + lt->tm_mday;
-            if (!service_active_on(date_ymd, tr->service_id)) continue;
-
-            int day_off = 0, mins = arr_mins;
-            while (mins >= 24 * 60) { mins -= 24 * 60; day_off++; }
-            int actual_ymd = date_ymd;
-            for (int k = 0; k < day_off; k++) {
-                int yy = actual_ymd / 10000, mm = (actual_ymd / 100) % 100, dd = actual_ymd % 100;
-                struct tm tm2 = { 0 };
-                tm2.tm_year = yy - 1900;
-                tm2.tm_mon = mm - 1;
-                tm2.tm_mday = dd + 1;
-                tm2.tm_isdst = -1;
-                time_t t2 = mktime(&tm2);
-                if (t2 == (time_t)-1) break;
-                struct tm *lt2 = localtime(&t2);
-                if (!lt2) break;
-                actual_ymd = (lt2->tm_year + 1900) * 10000 + (lt2->tm_mon + 1) * 100 + lt2->tm_mday;
+        const char *route_id = fstr(f, tr->route_id);
+        int r = id_index_find(&f->route_ix, route_id);
+        if (r < 0) {
+            if (is_express_route(route_id)) tl->orphan_express++;
+            continue;
+        }
+        int stop = f->stop_times[i].stop;
+        int l = r * n_stops + (stop >= 0 && stop < n_stops ? stop : 0);
+        tl->st_count[l]++;
+        int trip = (int)(tr - f->trips);
+        int arr_mins = f->stop_times[i].arrival_mins;
+        uint32_t active = service_days(f, fstr(f, tr->service_id));
+        for (int day = 0; day < SERVICE_WINDOW_DAYS; day++) {
+            if (!(active & (1u << day))) continue;
+            time_t when = window_time(f, day, arr_mins);
+            if (when >= horizon) {
+                if (tl->far_when[l] == (time_t)-1 || when < tl->far_when[l]) {
+                    tl->far_when[l] = when;
+                    tl->far_trip[l] = trip;
+                }
+                continue;
             }
-            time_t when = ymd_mins_to_time(actual_ymd, mins);
-            if (when >= now_sec && (best[route_idx].when == (time_t)-1 || when < best[route_idx].when)) {
-                best[route_idx].when = when;
-                snprintf(best[route_idx].route_id, sizeof(best[route_idx].route_id), "%s", tr->route_id);
-                snprintf(best[route_idx].headsign, sizeof(best[route_idx].headsign), "%s",
-                         tr->headsign[0] ? tr->headsign : "--");
-                route_seen[route_idx] = 1;
+            if (tl->n == tl->cap) {
+                int cap = tl->cap ? tl->cap * 2 : 4096;
+                TimelineEntry *ne = realloc(tl->e, (size_t)cap * sizeof(TimelineEntry));
+                if (!ne) break;     /* keep what fits; far_when still covers later days */
+                tl->e = ne;
+                tl->cap = cap;
             }
+            tl->e[tl->n++] = (TimelineEntry){ when, l, trip, seq++ };
         }
     }
+    qsort(tl->e, (size_t)tl->n, sizeof(TimelineEntry), cmp_timeline);
+    int k = 0;
+    for (int l = 0; l <= tl->n_lanes; l++) {
+        while (k < tl->n && tl->e[k].lane < l) k++;
+        tl->begin[l] = k;
+        tl->cur[l] = k;
+    }
+    tl->valid = 1;
+}
+
+/* Rebuild whatever the NY date at now invalidated. Returns 0 if the timeline could
+ * not be allocated. */
+static int timeline_refresh(GtfsFeed *f, time_t now) {
+    int now_ymd, now_mins;
+    now_ny(now, &now_ymd, &now_mins);
+    if (f->window_ymd != now_ymd) gtfs_build_window(f, now_ymd);
+    if (!f->tl.valid) gtfs_build_timeline(f);
+    return f->tl.valid;
+}
+
+/* First timeline entry of lane l at or after now. The per-lane cursor only moves
+ * forward in normal use; a clock step backwards falls back to a binary search. */
+static int timeline_seek(GtfsFeed *f, int l, time_t now) {
+    StopTimeline *tl = &f->tl;
+    int lo = tl->begin[l], end = tl->begin[l + 1], c = tl->cur[l];
+    if (c > lo && tl->e[c - 1].when >= now) {
+        int hi = c;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (tl->e[mid].when < now) lo = mid + 1; else hi = mid;
+        }
+        c = lo;
+    }
+    while (c < end && tl->e[c].when < now) c++;
+    tl->cur[l] = c;
+    return c;
+}
+
+/* Next up to k departures of lane l from now: timeline entries, then far_when.
+ * trip may be NULL. */
+static int timeline_next(GtfsFeed *f, int l, time_t now, time_t *when, int *trip, int k) {
+    const StopTimeline *tl = &f->tl;
+    int n = 0;
+    for (int c = timeline_seek(f, l, now); c < tl->begin[l + 1] && n < k; c++, n++) {
+        when[n] = tl->e[c].when;
+        if (trip) trip[n] = tl->e[c].trip;
+    }
+    if (n < k && tl->far_when[l] != (time_t)-1 && tl->far_when[l] >= now) {
+        when[n] = tl->far_when[l];
+        if (trip) trip[n] = tl->far_trip[l];
+        n++;
+    }
+    return n;
+}
+
+/* Counters for the scheduled-departures log line, summed over the feeds. */
+typedef struct {
+    int express_routes_found;
+    int q27_filtered;
+    int non_express_filtered;
+    int stop_found;
+} DepStats;
 
+/* One feed's next departure per route and listed stop after now_sec, in route order. */
+static int feed_next_departures(GtfsFeed *f, time_t now_sec, const char *stop_id,
+                                const char *realtime_routes, ScheduledDeparture *out, int max_out,
+                                DepStats *st) {
+    int sl = load_stop_slice(f, stop_id);
+    if (sl != -1) st->stop_found = 1;
+    if (sl <= 0 || !timeline_refresh(f, now_sec)) return 0;
+
+    st->express_routes_found += f->tl.orphan_express;
+    int n_stops = f->tl.n_stops;
     int n_out = 0;
-    int q27_filtered = 0, non_express_filtered = 0;
-    for (int ri = 0; ri < feed.n_routes && n_out < max_out; ri++) {
-        if (!route_seen[ri]) continue;
-        const char *short_name = route_short_name(best[ri].route_id);
-        if (route_excluded(short_name, realtime_routes)) continue;
-        if (strcmp(short_name, "Q27") == 0) { q27_filtered++; continue; }
-        if (!is_express_route(best[ri].route_id)) { non_express_filtered++; continue; }
-        out[n_out].when = best[ri].when;
-        snprintf(out[n_out].route, sizeof(out[n_out].route), "%.31s", short_name);
-        snprintf(out[n_out].dest, sizeof(out[n_out].dest), "%s", best[ri].headsign);
-        n_out++;
-    }
-    for (int i = 0; i < n_out; i++)
-        for (int j = i + 1; j < n_out; j++)
-            if (out[j].when < out[i].when) {
-                ScheduledDeparture tmp = out[i];
-                out[i] = out[j];
-                out[j] = tmp;
-            }
-    logf_("GTFS: scheduled departures: %d (Express routes at stop: %d, Q27 filtered: %d, non-Express filtered: %d)",
-          n_out, express_routes_found, q27_filtered, non_express_filtered);
+    for (int l = 0; l < f->tl.n_lanes; l++) {
+        int ri = l / n_stops, stop = l % n_stops;
+        if (!f->tl.st_count[l] || route_idx_excluded(f, ri, realtime_routes)) continue;
+        const char *route_id = fstr(f, f->routes[ri].route_id);
+        if (is_express_route(route_id)) st->express_routes_found += f->tl.st_count[l];
+        time_t when;
+        int trip;
+        if (!timeline_next(f, l, now_sec, &when, &trip, 1)) continue;
+        const char *short_name = fstr(f, f->routes[ri].short_name);
+        if (strcmp(short_name, "Q27") == 0) { st->q27_filtered++; continue; }
+        if (!is_express_route(route_id)) { st->non_express_filtered++; continue; }
+        /* Keep the soonest max_out lanes (not the first in route order): with several
+         * stops there are more lanes than slots. */
+        if (n_out == max_out && when >= out[n_out - 1].when) continue;
+        int j = n_out < max_out ? n_out++ : max_out - 1;
+        for (; j > 0 && out[j - 1].when > when; j--) out[j] = out[j - 1];
+        out[j].when = when;
+        snprintf(out[j].route, sizeof(out[j].route), "%.31s", short_name);
+        snprintf(out[j].dest, sizeof(out[j].dest), "%s",
+                 f->trips[trip].headsign ? fstr(f, f->trips[trip].headsign) : "--");
+        snprintf(out[j].stop, sizeof(out[j].stop), "%s",
+                 n_stops > 1 ? f->list_stops[stop] : "");
+    }
+    return n_out;
+}
+
+/* Next departures at the STOP_ID list stop_id over feeds fs[0..n_feeds) at now: one per
+ * route and listed stop, soonest first, at most max_out. */
+static int feeds_next_departures(GtfsFeed *fs[], int n_feeds, time_t now, const char *stop_id,
+                                 const char *realtime_routes, ScheduledDeparture *out, int max_out,
+                                 DepStats *st) {
+    ScheduledDeparture all[GTFS_MAX_FEEDS * SCHEDULED_MAX];
+    int n_all = 0;
+    int per_feed = max_out < SCHEDULED_MAX ? max_out : SCHEDULED_MAX;
+    for (int k = 0; k < n_feeds; k++) {
+        pthread_mutex_lock(&fs[k]->query_lock);
+        n_all += feed_next_departures(fs[k], now, stop_id, realtime_routes, all + n_all, per_feed, st);
+        pthread_mutex_unlock(&fs[k]->query_lock);
+    }
+
+    /* Soonest first (stable, so one feed keeps its route order on ties); a route
+     * served at one stop by several feeds keeps its earliest departure. */
+    for (int i = 1; i < n_all; i++) {
+        ScheduledDeparture d = all[i];
+        int j = i;
+        for (; j > 0 && all[j - 1].when > d.when; j--) all[j] = all[j - 1];
+        all[j] = d;
+    }
+    int n_out = 0;
+    for (int i = 0; i < n_all && n_out < max_out; i++) {
+        int dup = 0;
+        for (int j = 0; j < n_out && !dup; j++)
+            dup = strcmp(out[j].route, all[i].route) == 0 && strcmp(out[j].stop, all[i].stop) == 0;
+        if (!dup) out[n_out++] = all[i];
+    }
     return n_out;
 }
+
+int gtfs_next_departures(const char *stop_id, const char *realtime_routes,
+                         ScheduledDeparture *out, int max_out) {
+    if (!out || max_out <= 0 || !stop_id || !*stop_id) return 0;
+    GtfsFeed *fs[GTFS_MAX_FEEDS];
+    int n_feeds = feeds_acquire(fs);
+    if (!n_feeds) return 0;
+    struct timespec tq;
+    clock_gettime(CLOCK_MONOTONIC, &tq);
+    DepStats st = { 0 };
+    int n_out = feeds_next_departures(fs, n_feeds, time(NULL), stop_id, realtime_routes, out, max_out, &st);
+    feeds_release(fs, n_feeds);
+    if (!st.stop_found) {
+        logf_("GTFS: stop_id '%s' not found in any feed (check GTFS_BUS_URL and that stop is in these feeds)", stop_id);
+        return 0;
+    }
+    logf_("GTFS: scheduled departures: %d (Express routes at stop: %d, Q27 filtered: %d, non-Express filtered: %d) %ld ms",
+          n_out, st.express_routes_found, st.q27_filtered, st.non_express_filtered, elapsed_ms(&tq));
+    return n_out;
+}
+
+int gtfs_next_service(const char *stop_id, time_t now, time_t *when) {
+    if (!stop_id || !*stop_id || !when) return -1;
+    GtfsFeed *fs[GTFS_MAX_FEEDS];
+    int n_feeds = feeds_acquire(fs);
+    int rc = -1;
+    *when = 0;
+    for (int fi = 0; fi < n_feeds; fi++) {
+        GtfsFeed *f = fs[fi];
+        pthread_mutex_lock(&f->query_lock);
+        if (load_stop_slice(f, stop_id) > 0 && timeline_refresh(f, now)) {
+            if (rc < 0) rc = 0;
+            for (int l = 0; l < f->tl.n_lanes; l++) {
+                time_t t;
+                if (!timeline_next(f, l, now, &t, NULL, 1)) continue;
+                if (!rc || t < *when) *when = t;
+                rc = 1;
+            }
+        }
+        pthread_mutex_unlock(&f->query_lock);
+    }
+    feeds_release(fs, n_feeds);
+    return rc;
+}
+
+int gtfs_stop_ids(const char *stop_id, char ids[][32], int *entries, int max_ids) {
+    if (!stop_id || !*stop_id || !ids || max_ids <= 0) return 0;
+    GtfsFeed *fs[GTFS_MAX_FEEDS];
+    int n_feeds = feeds_acquire(fs);
+    int n = 0;
+    for (int fi = 0; fi < n_feeds; fi++) {
+        GtfsFeed *f = fs[fi];
+        pthread_mutex_lock(&f->query_lock);
+        if (load_stop_slice(f, stop_id) > 0) {
+            for (int k = 0; k < f->n_stop_filter_ids && n < max_ids; k++) {
+                int dup = 0;
+                for (int j = 0; j < n && !dup; j++)
+                    dup = strcmp(ids[j], f->stop_filter_ids[k]) == 0;
+                if (dup) continue;
+                if (entries) entries[n] = f->stop_filter_stop[k];
+                snprintf(ids[n++], sizeof(ids[0]), "%s", f->stop_filter_ids[k]);
+            }
+        }
+        pthread_mutex_unlock(&f->query_lock);
+    }
+    feeds_release(fs, n_feeds);
+    return n;
+}
+
+int gtfs_trip_info(const char *stop_id, const char *trip_id,
+                   char *route, size_t route_sz, char *dest, size_t dest_sz) {
+    if (!stop_id || !*stop_id || !trip_id || !*trip_id) return 0;
+    GtfsFeed *fs[GTFS_MAX_FEEDS];
+    int n_feeds = feeds_acquire(fs);
+    int found = 0;
+    for (int fi = 0; fi < n_feeds && !found; fi++) {
+        GtfsFeed *f = fs[fi];
+        pthread_mutex_lock(&f->query_lock);
+        const GtfsTrip *tr = load_stop_slice(f, stop_id) > 0 ? trip_by_id(f, trip_id) : NULL;
+        int r = tr ? id_index_find(&f->route_ix, fstr(f, tr->route_id)) : -1;
+        if (tr) {
+            if (route && route_sz)
+                snprintf(route, route_sz, "%s", r >= 0 ? fstr(f, f->routes[r].short_name) : fstr(f, tr->route_id));
+            if (dest && dest_sz)
+                snprintf(dest, dest_sz, "%s", *fstr(f, tr->headsign) ? fstr(f, tr->headsign) : "--");
+            found = 1;
+        }
+        pthread_mutex_unlock(&f->query_lock);
+    }
+    feeds_release(fs, n_feeds);
+    return found;
+}
+
+/* ---- Per-stop slices (gtfs_slice) ---------------------------------------------
+ * A slice is an ordinary GTFS zip holding only what a set of stops needs: the stops,
+ * their stop_times, and the trips, routes and calendars those use. Rows are copied
+ * verbatim and in file order, so the loader resolves duplicate ids and ties exactly
+ * as it does on the full feed.
+ * -------------------------------------------------------------------------- */
+
+typedef struct {
+    char  *p;
+    size_t n, cap;
+} SliceBuf;
+
+static int slice_buf_put(SliceBuf *b, const char *s, size_t len) {
+    if (b->n + len + 1 > b->cap) {
+        size_t cap = b->cap ? b->cap : 65536;
+        while (cap < b->n + len + 1) cap *= 2;
+        char *np = realloc(b->p, cap);
+        if (!np) return -1;
+        b->p = np;
+        b->cap = cap;
+    }
+    memcpy(b->p + b->n, s, len);
+    b->n += len;
+    b->p[b->n++] = '\n';
+    return 0;
+}
+
+/* Copy column col of line into out. Returns 0, or -1 if the line is too short. */
+static int slice_field(const char *line, int col, char *out, size_t out_sz) {
+    size_t len = strlen(line), flen;
+    long at = csv_column(line, len, col, &flen);
+    if (at >= 0) {
+        snprintf(out, out_sz, "%.*s", (int)flen, line + at);
+        return 0;
+    }
+    char *copy = strdup(line);          /* quoted fields: full split on a copy */
+    char *f[32];
+    int n = copy ? parse_csv_line(copy, f, 32) : 0;
+    if (n > col) snprintf(out, out_sz, "%s", f[col]);
+    free(copy);
+    return n > col ? 0 : -1;
+}
+
+/* One member being cut: a row is kept if its key column is in keep; each kept row adds
+ * its add_col values to the add sets. */
+typedef struct {
+    const char *name;
+    int         key_col;
+    StrTab     *keep;
+    int         add_col[2];
+    StrTab     *add[2];
+    SliceBuf    out;
+    int         rows;
+    int         failed;
+} SliceMember;
+
+static int slice_line_fn(char *line, void *ctx) {
+    SliceMember *m = (SliceMember *)ctx;
+    char v[256];
+    if (slice_field(line, m->key_col, v, sizeof(v)) != 0 || !v[0] || strtab_find(m->keep, v) == UINT32_MAX)
+        return 0;
+    for (int k = 0; k < 2 && m->add[k]; k++)
+        if (slice_field(line, m->add_col[k], v, sizeof(v)) == 0 && strtab_add(m->add[k], v, NULL) == 0 && v[0])
+            m->failed = 1;
+    if (slice_buf_put(&m->out, line, strlen(line)) != 0) m->failed = 1;
+    m->rows++;
+    return m->failed;
+}
+
+static int slice_block_fn(char *buf, size_t len, void *ctx) {
+    SliceMember *m = (SliceMember *)ctx;
+    if (len && buf[len - 1] == '\n') len--;
+    if (slice_buf_put(&m->out, buf, len) != 0) m->failed = 1;
+    return m->failed;
+}
+
+int gtfs_slice_write(const char *zip_path, const char *stop_ids, const char *out_path) {
+    GtfsFeed *f = feed_parse(zip_path, 1);
+    if (!f || !f->loaded) {
+        logf_("GTFS: slice: cannot load %s", zip_path);
+        feed_release(f);
+        return -1;
+    }
+    int rc = -1;
+    StrTab stops = { 0 }, trips = { 0 }, routes = { 0 }, services = { 0 };
+    int tabs_ok = (strtab_init(&stops) == 0) + (strtab_init(&trips) == 0) +
+                  (strtab_init(&routes) == 0) + (strtab_init(&services) == 0) == 4;
+    SliceMember members[] = {
+        { "stops.txt",          0, &stops,    { 0, 0 }, { NULL, NULL },       { 0 }, 0, 0 },
+        { "stop_times.txt",     3, &stops,    { 0, 0 }, { &trips, NULL },     { 0 }, 0, 0 },
+        { "trips.txt",          2, &trips,    { 0, 1 }, { &routes, &services }, { 0 }, 0, 0 },
+        { "routes.txt",         0, &routes,   { 0, 0 }, { NULL, NULL },       { 0 }, 0, 0 },
+        { "calendar.txt",       0, &services, { 0, 0 }, { NULL, NULL },       { 0 }, 0, 0 },
+        { "calendar_dates.txt", 0, &services, { 0, 0 }, { NULL, NULL },       { 0 }, 0, 0 },
+        { "agency.txt",        -1, NULL,      { 0, 0 }, { NULL, NULL },       { 0 }, 0, 0 },
+        { "feed_info.txt",     -1, NULL,      { 0, 0 }, { NULL, NULL },       { 0 }, 0, 0 },
+    };
+    int n_members = (int)(sizeof(members) / sizeof(members[0]));
+    ZipArchive za;
+    int za_open = 0;
+    ZipWriter zw = { 0 };
+    if (!tabs_ok) goto out;
+
+    /* Every stop_id the loader would filter on for each requested stop. */
+    char list[1024], *save = NULL;
+    snprintf(list, sizeof(list), "%s", stop_ids ? stop_ids : "");
+    int n_req = 0;
+    for (char *id = strtok_r(list, ", \t\n", &save); id; id = strtok_r(NULL, ", \t\n", &save)) {
+        if (!resolve_stop(f, id)) {
+            logf_("GTFS: slice: stop_id '%s' not found in %s", id, zip_path);
+            goto out;
+        }
+        for (int i = 0; i < f->n_stop_filter_ids; i++)
+            if (strtab_add(&stops, f->stop_filter_ids[i], NULL) == 0) goto out;
+        n_req++;
+    }
+    if (!n_req) {
+        logf_("GTFS: slice: no stop_ids given");
+        goto out;
+    }
+
+    if (zip_open(&za, zip_path) != 0) goto out;
+    za_open = 1;
+    if (zip_writer_open(&zw, out_path) != 0) {
+        logf_("GTFS: slice: cannot write %s", out_path);
+        goto out;
+    }
+    for (int i = 0; i < n_members; i++) {
+        SliceMember *m = &members[i];
+        char header[1024];
+        if (zip_member_header(&za, m->name, header, sizeof(header)) != 0) {
+            if (i < 4) {
+                logf_("GTFS: slice: %s missing in %s", m->name, zip_path);
+                goto out;
+            }
+            continue;                   /* optional member */
+        }
+        if (slice_buf_put(&m->out, header, strlen(header)) != 0) goto out;
+        int n = m->keep ? zip_for_each_line(&za, m->name, slice_line_fn, m)
+                        : zip_for_each_block(&za, m->name, slice_block_fn, m);
+        if (n < 0 || m->failed || zip_writer_add(&zw, m->name, m->out.p, m->out.n) != 0) goto out;
+    }
+    if (zip_writer_close(&zw) != 0) {
+        logf_("GTFS: slice: cannot write %s", out_path);
+        goto out;
+    }
+    struct stat st;
+    logf_("GTFS: slice %s: %d stop(s) -> stops=%d stop_times=%d trips=%d routes=%d calendar=%d cal_dates=%d, %lld bytes",
+          out_path, n_req, members[0].rows, members[1].rows, members[2].rows, members[3].rows,
+          members[4].rows, members[5].rows, stat(out_path, &st) == 0 ? (long long)st.st_size : -1LL);
+    rc = 0;
+out:
+    if (zw.fp) {                        /* failed part way: drop the .tmp, keep any old slice */
+        zw.failed = 1;
+        zip_writer_close(&zw);
+    }
+    for (int i = 0; i < n_members; i++) free(members[i].out.p);
+    if (za_open) zip_close(&za);
+    strtab_free(&stops);
+    strtab_free(&trips);
+    strtab_free(&routes);
+    strtab_free(&services);
+    feed_release(f);
+    return rc;
+}
+
+/* Departures from the full feed and the slice at one instant; logs the first mismatches. */
+static int slice_compare(GtfsFeed *full, GtfsFeed *slice, const char *stop_id, time_t t, int *logged) {
+    ScheduledDeparture a[SCHEDULED_MAX], b[SCHEDULED_MAX];
+    DepStats sa = { 0 }, sb = { 0 };
+    int na = feeds_next_departures(&full, 1, t, stop_id, NULL, a, SCHEDULED_MAX, &sa);
+    int nb = feeds_next_departures(&slice, 1, t, stop_id, NULL, b, SCHEDULED_MAX, &sb);
+    int same = na == nb;
+    for (int i = 0; i < na && same; i++)
+        same = a[i].when == b[i].when && strcmp(a[i].route, b[i].route) == 0 &&
+               strcmp(a[i].dest, b[i].dest) == 0;
+    if (!same && (*logged)++ < 5)
+        logf_("GTFS: slice verify: stop %s at %ld: full %d departures (first %s %ld), slice %d (first %s %ld)",
+              stop_id, (long)t, na, na ? a[0].route : "-", na ? (long)a[0].when : 0L,
+              nb, nb ? b[0].route : "-", nb ? (long)b[0].when : 0L);
+    return same;
+}
+
+int gtfs_slice_verify(const char *full_zip, const char *slice_zip, const char *stop_ids,
+                      time_t start, int days, int step_mins) {
+    GtfsFeed *full = feed_parse(full_zip, 1), *slice = feed_parse(slice_zip, 1);
+    int bad = -1;
+    if (!full || !full->loaded || !slice || !slice->loaded || days <= 0 || step_mins <= 0) {
+        logf_("GTFS: slice verify: cannot load %s and %s", full_zip, slice_zip);
+        goto out;
+    }
+    char list[1024], *save = NULL;
+    snprintf(list, sizeof(list), "%s", stop_ids ? stop_ids : "");
+    long queries = 0;
+    int logged = 0;
+    bad = 0;
+    for (char *id = strtok_r(list, ", \t\n", &save); id; id = strtok_r(NULL, ", \t\n", &save))
+        for (time_t t = start; t < start + (time_t)days * 86400; t += step_mins * 60) {
+            bad += !slice_compare(full, slice, id, t, &logged);
+            queries++;
+        }
+    logf_("GTFS: slice verify: %ld queries over %d days, %d mismatches", queries, days, bad);
+out:
+    feed_release(full);
+    feed_release(slice);
+    return bad;
+}
@@ -6,20 +6,64 @@
 
 #include "types.h"
 
-/* Load or refresh GTFS from URL. Uses cache if download fails. Call periodically (e.g. daily). */
-void gtfs_load(const char *gtfs_url, const char *cache_path);
+/* Load or refresh GTFS from gtfs_urls: one feed URL, or several separated by commas or
+ * spaces (e.g. a borough feed plus MTABC), each cached next to cache_path and queried as
+ * one schedule. Uses the cache if a download fails. Call periodically (e.g. hourly): each
+ * feed is refetched only when its own recheck time is due, and reparsed only if changed.
+ * gtfs_urls "none" downloads nothing and loads the zip already at cache_path.
+ * A new feed is built off to the side and swapped in; queries keep using the old one meanwhile. */
+void gtfs_load(const char *gtfs_urls, const char *cache_path);
+
+/* Run gtfs_load() on a background thread. Returns 0 if started, -1 if a load is already
+ * running (or the thread could not be created). */
+int gtfs_load_async(const char *gtfs_urls, const char *cache_path);
+
+/* 1 while an async load is running, else 0. */
+int gtfs_load_busy(void);
 
 /* Get next scheduled departures at stop_id for routes NOT in realtime_routes.
- * stop_id: same as STOP_ID (try as GTFS stop_id, then stop_code).
+ * stop_id: same as STOP_ID (try as GTFS stop_id, then stop_code); a comma-separated list
+ * of up to STOP_IDS_MAX stops is resolved in one pass and each departure tagged with
+ * its stop.
  * realtime_routes: comma-separated or NULL = all routes.
- * out: filled with up to SCHEDULED_MAX entries, 1 per route. Returns count. */
+ * out: filled with up to SCHEDULED_MAX entries, 1 per route and stop. Returns count. */
 int gtfs_next_departures(const char *stop_id, const char *realtime_routes,
                          ScheduledDeparture *out, int max_out);
 
-/* Returns 1 if the loaded GTFS feed contains stop_id as a stop_id or stop_code.
- * Returns 0 if the feed is loaded and the stop is unknown, or -1 if unavailable. */
+/* Soonest scheduled departure of any route at stop_id (any entry of a list) at or after
+ * now, for telling service hours apart from a quiet spell. Returns 1 and sets *when, 0 if
+ * no departure is scheduled at all, or -1 if no loaded feed knows the stop. */
+int gtfs_next_service(const char *stop_id, time_t now, time_t *when);
+
+/* Returns 1 if loaded GTFS feeds contain stop_id (every entry of a list) as a stop_id or
+ * stop_code. Returns 0 if feeds are loaded and one is unknown, or -1 if unavailable. */
 int gtfs_stop_known(const char *stop_id);
 
+/* GTFS stop_ids that count as stop_id (each stop plus those sharing its stop_code), for
+ * matching realtime stop_time_updates. Fills up to max_ids, with the index of the list
+ * entry each belongs to in entries[] (may be NULL), and returns the count (0 if no
+ * loaded feed knows the stops). */
+int gtfs_stop_ids(const char *stop_id, char ids[][32], int *entries, int max_ids);
+
+/* Route short name and headsign of trip_id, looked up among the trips serving stop_id.
+ * Returns 1 if found, else 0 (route and dest untouched). */
+int gtfs_trip_info(const char *stop_id, const char *trip_id,
+                   char *route, size_t route_sz, char *dest, size_t dest_sz);
+
 /* Last GTFS load status for debug instrumentation. */
 int gtfs_last_status(void);
 const char *gtfs_last_status_str(void);
+
+/* Cut a per-stop micro-feed from the GTFS zip at zip_path into out_path: the stops in
+ * stop_ids (comma-separated, resolved like STOP_ID), their stop_times, and only the
+ * trips, routes and calendars those use. The result is an ordinary GTFS zip: serve it as
+ * GTFS_BUS_URL, or copy it to GTFS_CACHE_PATH with GTFS_BUS_URL=none. Returns 0, or -1
+ * on error (logged). */
+int gtfs_slice_write(const char *zip_path, const char *stop_ids, const char *out_path);
+
+/* Compare next-departure answers of full_zip and slice_zip for each of stop_ids every
+ * step_mins from start over days days. Returns the number of differing queries (0 =
+ * identical), or -1 if either zip cannot be loaded. Neither function writes snapshot or
+ * stop cache files next to the zips it reads. */
+int gtfs_slice_verify(const char *full_zip, const char *slice_zip, const char *stop_ids,
+                      time_t start, int days, int step_mins);
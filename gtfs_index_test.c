@@ -0,0 +1,366 @@
+/*
+ * gtfs.c's IdIndex lookups on a generated MTABC-sized feed (90 routes, 120 service_ids,
+ * 4000 trips in the stop slice): trip_by_id(), the route_id index, route_idx_excluded()
+ * and service_active_on()/service_days() must give what the linear scans they replaced
+ * give, for every id, for ids that are not in the feed, and for ids listed twice (the
+ * first row wins). The scans are IdIndex's own fallback (no slots) and the old
+ * strcmp loops over calendar.txt and calendar_dates.txt. gtfs.c is included so its
+ * static functions can be called directly.
+ *
+ *   gtfs_index_test            check
+ *   gtfs_index_test -b [trips] ns per lookup of each index against its linear scan, and
+ *                              per stop_time of a timeline build (default: 4000 trips)
+ */
+#include "gtfs.c"
+#include "test.h"
+
+#define TODAY      20261016     /* window start; a calendar row boundary falls inside it */
+#define N_TRIPS    4000
+#define BENCH_REPS 5
+
+static const char *const s_depots[] = { "JA", "JK", "FP", "LG", "SC", "BP", "CS", "EC", "YU", "FR" };
+static const char *const s_kinds[] = { "Weekday", "Saturday", "Sunday" };
+static const uint8_t s_kind_dow[] = { 0x3e, 0x40, 0x01 };
+static const char *const s_lines[] = { "B", "BM", "BxM", "Q", "QM" };
+
+#define N_SERVICES ((int)(sizeof(s_depots) / sizeof(s_depots[0])) * 3 * 4)
+#define N_ROUTES   90
+#define REALTIME   "Q10, B6,BM2,QM21"
+
+static uint32_t s_rng = 12345;
+
+static uint32_t rnd(void) {
+    s_rng = s_rng * 1103515245u + 12345u;
+    return s_rng >> 8;
+}
+
+static void service_name(char *out, size_t sz, int s) {
+    snprintf(out, sz, "%s_%c6-%s", s_depots[s / 12], 'A' + s % 4, s_kinds[s / 4 % 3]);
+}
+
+static void route_name(char *out, size_t sz, int r) {
+    snprintf(out, sz, "%s%d", s_lines[r % 5], 1 + r / 5 * 3);
+}
+
+/* Routes, calendars, calendar_dates and trips shaped like MTA Bus Company's feed, with a
+ * duplicate route_id and trip_id at the end; indexed and windowed as a load would. */
+static GtfsFeed *make_feed(int n_trips) {
+    GtfsFeed *f = feed_new();
+    if (!f) return NULL;
+    char a[64], b[96];
+    for (int r = 0; r <= N_ROUTES; r++) {
+        GtfsRoute *rt = table_push(&f->routes, &f->n_routes, &f->cap_routes, sizeof(GtfsRoute));
+        if (!rt) break;
+        route_name(a, sizeof(a), r < N_ROUTES ? r : 0);
+        snprintf(b, sizeof(b), "MTABC_%s", a);
+        rt->route_id = intern(f, b);
+        rt->short_name = intern(f, r < N_ROUTES ? a : "DUP");
+    }
+    for (int s = 0; s < N_SERVICES; s++) {
+        service_name(a, sizeof(a), s);
+        /* Every fourth service_id changes calendar rows in the middle of the window. */
+        for (int part = 0; part < (s % 4 == 0 ? 2 : 1); part++) {
+            GtfsCalendar *c = table_push(&f->calendars, &f->n_calendars, &f->cap_calendars,
+                                         sizeof(GtfsCalendar));
+            if (!c) break;
+            c->service_id = intern(f, a);
+            c->start_ymd = part ? 20261021 : 20260830;
+            c->end_ymd = s % 4 == 0 && !part ? 20261020 : 20270102;
+            c->dow = part ? 0x7f : s_kind_dow[s / 4 % 3];
+        }
+        for (int k = 0; k < 10; k++) {
+            GtfsCalendarDate *cd = table_push(&f->cal_dates, &f->n_cal_dates, &f->cap_cal_dates,
+                                              sizeof(GtfsCalendarDate));
+            if (!cd) break;
+            cd->service_id = intern(f, a);
+            cd->date_ymd = tz_ymd_add(TODAY, (s * 7 + k * 5) % 40 - 10);
+            cd->exception_type = 1 + (s + k) % 2;
+        }
+    }
+    for (int t = 0; t <= n_trips; t++) {
+        GtfsTrip *tr = table_push(&f->trips, &f->n_trips, &f->cap_trips, sizeof(GtfsTrip));
+        if (!tr) break;
+        if (t == n_trips) {
+            *tr = f->trips[0];
+            tr->headsign = intern(f, "DUP");
+            break;
+        }
+        int s = (int)(rnd() % N_SERVICES), r = (int)(rnd() % N_ROUTES);
+        service_name(a, sizeof(a), s);
+        snprintf(b, sizeof(b), "%s-SDon-%06d_%s%d_%d", a, 30000 + t * 7, s_lines[r % 5],
+                 1 + r / 5 * 3, t % 700);
+        tr->trip_id = intern(f, b);
+        tr->service_id = intern(f, a);
+        snprintf(b, sizeof(b), "MTABC_%s%d", s_lines[r % 5], 1 + r / 5 * 3);
+        tr->route_id = intern(f, b);
+        tr->headsign = intern(f, "VIA MAIN ST");
+    }
+    gtfs_build_indexes(f);
+    id_index_build(&f->trip_ix, &f->strs, f->trips, f->n_trips, sizeof(GtfsTrip),
+                   offsetof(GtfsTrip, trip_id));
+    gtfs_build_window(f, TODAY);
+    if (f->oom || f->n_trips != n_trips + 1) {
+        feed_free(f);
+        return NULL;
+    }
+    return f;
+}
+
+/* IdIndex's no-slot fallback: the first row whose key matches, by strcmp. */
+static int scan_find(const IdIndex *ix, const char *key) {
+    IdIndex scan = *ix;
+    scan.slot = NULL;
+    return id_index_find(&scan, key);
+}
+
+/* service_active_on() as it was before the indexes: every row of both tables by strcmp. */
+static int scan_service_active_on(GtfsFeed *f, int ymd, const char *service_id) {
+    int dow = tz_ymd_wday(ymd);
+    for (int i = 0; i < f->n_cal_dates; i++) {
+        if (strcmp(fstr(f, f->cal_dates[i].service_id), service_id) != 0) continue;
+        if (f->cal_dates[i].date_ymd != ymd) continue;
+        if (f->cal_dates[i].exception_type == 1) return 1;
+        if (f->cal_dates[i].exception_type == 2) return 0;
+    }
+    for (int i = 0; i < f->n_calendars; i++) {
+        if (strcmp(fstr(f, f->calendars[i].service_id), service_id) != 0) continue;
+        if (ymd < f->calendars[i].start_ymd || ymd > f->calendars[i].end_ymd) continue;
+        if (dow >= 0 && dow < 7 && ((f->calendars[i].dow >> dow) & 1)) return 1;
+    }
+    return 0;
+}
+
+static uint32_t scan_service_days(GtfsFeed *f, const char *service_id) {
+    uint32_t active = 0;
+    for (int day = 0; day < SERVICE_WINDOW_DAYS; day++)
+        if (scan_service_active_on(f, f->days[day].ymd, service_id)) active |= 1u << day;
+    return active;
+}
+
+/* The old route_short_name() + route_excluded() pair. */
+static int scan_route_excluded(GtfsFeed *f, const char *route_id, const char *realtime) {
+    int r = scan_find(&f->route_ix, route_id);
+    return route_excluded(r >= 0 ? fstr(f, f->routes[r].short_name) : route_id, realtime);
+}
+
+static void check_indexes(void) {
+    GtfsFeed *f = make_feed(N_TRIPS);
+    CHECK(f != NULL);
+    if (!f) return;
+    CHECK(f->n_trips == N_TRIPS + 1 && f->n_routes == N_ROUTES + 1);
+    CHECK(f->trip_ix.slot && f->route_ix.slot && f->cal_ix.slot && f->cd_ix.slot && f->service_ix.slot);
+    CHECK(!f->services_full && f->n_services == N_SERVICES);
+
+    int trips_ok = 1, routes_ok = 1, excl_ok = 1, n_excl = 0;
+    for (int t = 0; t < f->n_trips; t++) {
+        const char *id = fstr(f, f->trips[t].trip_id);
+        GtfsTrip *tr = trip_by_id(f, id);
+        if (!tr || tr - f->trips != scan_find(&f->trip_ix, id)) trips_ok = 0;
+        const char *route_id = fstr(f, f->trips[t].route_id);
+        int r = id_index_find(&f->route_ix, route_id);
+        if (r < 0 || r != scan_find(&f->route_ix, route_id)) { routes_ok = 0; continue; }
+        int ex = route_idx_excluded(f, r, REALTIME);
+        if (ex != scan_route_excluded(f, route_id, REALTIME)) excl_ok = 0;
+        n_excl += ex;
+    }
+    CHECK(trips_ok && routes_ok && excl_ok);
+    CHECK(n_excl > 0 && n_excl < f->n_trips);
+    /* The duplicates resolve to the first row, as the scans did. */
+    GtfsTrip *dup = trip_by_id(f, fstr(f, f->trips[N_TRIPS].trip_id));
+    CHECK(dup && dup != &f->trips[N_TRIPS] && strcmp(fstr(f, dup->headsign), "VIA MAIN ST") == 0);
+    CHECK(id_index_find(&f->route_ix, fstr(f, f->routes[N_ROUTES].route_id)) == 0);
+    CHECK(route_idx_excluded(f, 0, "DUP") == 0 && route_idx_excluded(f, 0, "B1") == 1);
+
+    const char *missing[] = { "", "nope", "JA_A6-Weekda", "JA_A6-Weekday-", "JA_A6-Weekday-SDon-030000_B1_", "MTABC_" };
+    for (size_t i = 0; i < sizeof(missing) / sizeof(missing[0]); i++) {
+        CHECK(trip_by_id(f, missing[i]) == NULL && scan_find(&f->trip_ix, missing[i]) < 0);
+        CHECK(id_index_find(&f->route_ix, missing[i]) < 0);
+        CHECK(service_days(f, missing[i]) == 0);
+    }
+    CHECK(trip_by_id(f, NULL) == NULL);
+
+    int days_ok = 1, on = 0;
+    char sid[64];
+    for (int s = 0; s < N_SERVICES; s++) {
+        service_name(sid, sizeof(sid), s);
+        for (int d = -3; d < SERVICE_WINDOW_DAYS + 3; d++) {
+            int ymd = tz_ymd_add(TODAY, d), want = scan_service_active_on(f, ymd, sid);
+            if (service_active_on(f, ymd, sid) != want) days_ok = 0;
+            on += want;
+        }
+        if (service_days(f, sid) != scan_service_days(f, sid)) days_ok = 0;
+    }
+    CHECK(days_ok);
+    CHECK(on > 0 && on < N_SERVICES * (SERVICE_WINDOW_DAYS + 6));
+
+    /* Without slots (an index that failed to allocate) every lookup still answers. */
+    int *slots = f->trip_ix.slot;
+    f->trip_ix.slot = NULL;
+    CHECK(trip_by_id(f, fstr(f, f->trips[N_TRIPS / 2].trip_id)) == &f->trips[N_TRIPS / 2]);
+    CHECK(trip_by_id(f, "nope") == NULL);
+    f->trip_ix.slot = slots;
+    feed_free(f);
+}
+
+/* ---- bench ------------------------------------------------------------------- */
+
+typedef struct {
+    GtfsFeed   *f;
+    const char **keys;          /* trip_id of each stop_time, in stop_times.txt order */
+    int         n;
+} BenchIn;
+
+static volatile long s_sink;
+
+static long run_trip_hash(const BenchIn *in) {
+    long hits = 0;
+    for (int i = 0; i < in->n; i++) hits += trip_by_id(in->f, in->keys[i]) != NULL;
+    return hits;
+}
+
+static long run_trip_scan(const BenchIn *in) {
+    long hits = 0;
+    for (int i = 0; i < in->n; i++) hits += scan_find(&in->f->trip_ix, in->keys[i]) >= 0;
+    return hits;
+}
+
+static long run_route_hash(const BenchIn *in) {
+    long hits = 0;
+    for (int i = 0; i < in->n; i++)
+        hits += id_index_find(&in->f->route_ix, fstr(in->f, in->f->trips[i % in->f->n_trips].route_id)) >= 0;
+    return hits;
+}
+
+static long run_route_scan(const BenchIn *in) {
+    long hits = 0;
+    for (int i = 0; i < in->n; i++)
+        hits += scan_find(&in->f->route_ix, fstr(in->f, in->f->trips[i % in->f->n_trips].route_id)) >= 0;
+    return hits;
+}
+
+static long run_excl_cached(const BenchIn *in) {
+    long hits = 0;
+    for (int i = 0; i < in->n; i++) {
+        int r = id_index_find(&in->f->route_ix, fstr(in->f, in->f->trips[i % in->f->n_trips].route_id));
+        hits += r >= 0 && route_idx_excluded(in->f, r, REALTIME);
+    }
+    return hits;
+}
+
+static long run_excl_scan(const BenchIn *in) {
+    long hits = 0;
+    for (int i = 0; i < in->n; i++)
+        hits += scan_route_excluded(in->f, fstr(in->f, in->f->trips[i % in->f->n_trips].route_id), REALTIME);
+    return hits;
+}
+
+static long run_active_chain(const BenchIn *in) {
+    long hits = 0;
+    for (int i = 0; i < in->n; i++)
+        hits += service_active_on(in->f, in->f->days[i % SERVICE_WINDOW_DAYS].ymd,
+                                  fstr(in->f, in->f->trips[i % in->f->n_trips].service_id));
+    return hits;
+}
+
+static long run_active_scan(const BenchIn *in) {
+    long hits = 0;
+    for (int i = 0; i < in->n; i++)
+        hits += scan_service_active_on(in->f, in->f->days[i % SERVICE_WINDOW_DAYS].ymd,
+                                       fstr(in->f, in->f->trips[i % in->f->n_trips].service_id));
+    return hits;
+}
+
+/* Everything the timeline build looks up for one stop_time, then and now. */
+static long run_stop_time_hash(const BenchIn *in) {
+    long hits = 0;
+    for (int i = 0; i < in->n; i++) {
+        GtfsTrip *tr = trip_by_id(in->f, in->keys[i]);
+        if (!tr) continue;
+        int r = id_index_find(&in->f->route_ix, fstr(in->f, tr->route_id));
+        if (r < 0 || route_idx_excluded(in->f, r, REALTIME)) continue;
+        hits += __builtin_popcount(service_days(in->f, fstr(in->f, tr->service_id)));
+    }
+    return hits;
+}
+
+static long run_stop_time_scan(const BenchIn *in) {
+    long hits = 0;
+    for (int i = 0; i < in->n; i++) {
+        int t = scan_find(&in->f->trip_ix, in->keys[i]);
+        if (t < 0) continue;
+        GtfsTrip *tr = &in->f->trips[t];
+        if (scan_route_excluded(in->f, fstr(in->f, tr->route_id), REALTIME)) continue;
+        hits += __builtin_popcount(scan_service_days(in->f, fstr(in->f, tr->service_id)));
+    }
+    return hits;
+}
+
+/* Best ns per lookup over BENCH_REPS passes; *out gets the pass's result. */
+static double best_ns(long (*fn)(const BenchIn *), const BenchIn *in, long *out) {
+    double best = 1e30;
+    for (int rep = 0; rep < BENCH_REPS; rep++) {
+        double t0 = test_now_ms();
+        *out = fn(in);
+        double ns = (test_now_ms() - t0) * 1e6 / in->n;
+        if (ns < best) best = ns;
+    }
+    s_sink += *out;
+    return best;
+}
+
+static void bench(int n_trips) {
+    GtfsFeed *f = make_feed(n_trips);
+    const char **keys = malloc((size_t)n_trips * sizeof(*keys));
+    if (!f || !keys) {
+        fprintf(stderr, "gtfs_index_test: out of memory for %d trips\n", n_trips);
+        test_failures++;
+        free(keys);
+        feed_free(f);
+        return;
+    }
+    /* One stop_time per trip, in a shuffled order like stop_times.txt's. */
+    for (int i = 0; i < n_trips; i++) keys[i] = fstr(f, f->trips[i].trip_id);
+    for (int i = n_trips - 1; i > 0; i--) {
+        int j = (int)(rnd() % (uint32_t)(i + 1));
+        const char *k = keys[i];
+        keys[i] = keys[j];
+        keys[j] = k;
+    }
+    BenchIn in = { f, keys, n_trips };
+    int n_cal = f->n_calendars + f->n_cal_dates;
+    const struct {
+        const char *name, *what;
+        int rows;
+        long (*hash)(const BenchIn *), (*scan)(const BenchIn *);
+    } runs[] = {
+        { "trip_by_id", "trips", f->n_trips, run_trip_hash, run_trip_scan },
+        { "route_id", "routes", f->n_routes, run_route_hash, run_route_scan },
+        { "route excluded", "routes", f->n_routes, run_excl_cached, run_excl_scan },
+        { "service_active_on", "calendar rows", n_cal, run_active_chain, run_active_scan },
+        { "per stop_time", "rows, 14 days", f->n_trips + f->n_routes + 14 * n_cal,
+          run_stop_time_hash, run_stop_time_scan },
+    };
+    printf("gtfs index bench: %d trips, %d routes, %d service_ids (%d calendar + %d calendar_dates "
+           "rows); ns per lookup, best of %d\n", f->n_trips, f->n_routes, f->n_services,
+           f->n_calendars, f->n_cal_dates, BENCH_REPS);
+    for (size_t i = 0; i < sizeof(runs) / sizeof(runs[0]); i++) {
+        long got_hash = 0, got_scan = 0;
+        double ns_hash = best_ns(runs[i].hash, &in, &got_hash);
+        double ns_scan = best_ns(runs[i].scan, &in, &got_scan);
+        printf("  %-18s %9.1f ns   scan over %6d %-13s %10.1f ns  %7.1fx\n", runs[i].name,
+               ns_hash, runs[i].rows, runs[i].what, ns_scan, ns_scan / ns_hash);
+        CHECK(got_hash == got_scan);
+    }
+    free(keys);
+    feed_free(f);
+}
+
+int main(int argc, char **argv) {
+    if (argc >= 2 && strcmp(argv[1], "-b") == 0) {
+        int n = argc >= 3 ? atoi(argv[2]) : N_TRIPS;
+        bench(n > 0 ? n : N_TRIPS);
+        return test_failures ? 1 : 0;
+    }
+    check_indexes();
+    return test_done("gtfs_index_test");
+}
@@ -0,0 +1,43 @@
+/*
+ * gtfs_slice: cut a per-stop micro-feed from a full GTFS zip on a build host, so each
+ * board downloads kilobytes instead of the whole borough feed. Uses gtfs.c's loader
+ * for both the cut and the check.
+ *
+ *   gtfs_slice FULL.zip STOP_IDS OUT.zip     write OUT.zip, then verify it (exit 1 on a mismatch)
+ *   gtfs_slice -n FULL.zip STOP_IDS OUT.zip  write only
+ *   gtfs_slice -v FULL.zip STOP_IDS OUT.zip  verify an existing slice only
+ *
+ * STOP_IDS is one STOP_ID or a comma-separated list. Verification compares the next
+ * departures of both feeds every minute for GTFS_SLICE_DAYS (default 7) days from now.
+ */
+#include "gtfs.h"
+#include "util.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static int usage(void) {
+    fprintf(stderr, "usage: gtfs_slice [-n | -v] FULL.zip STOP_IDS OUT.zip\n");
+    return 2;
+}
+
+int main(int argc, char **argv) {
+    int write = 1, verify = 1;
+    int a = 1;
+    if (a < argc && strcmp(argv[a], "-n") == 0) { verify = 0; a++; }
+    else if (a < argc && strcmp(argv[a], "-v") == 0) { write = 0; a++; }
+    if (argc - a != 3) return usage();
+    const char *full = argv[a], *stops = argv[a + 1], *out = argv[a + 2];
+
+    if (write && gtfs_slice_write(full, stops, out) != 0) return 1;
+    if (!verify) return 0;
+    const char *d = getenv("GTFS_SLICE_DAYS");
+    int days = d && atoi(d) > 0 ? atoi(d) : 7;
+    int bad = gtfs_slice_verify(full, out, stops, time(NULL), days, 1);
+    if (bad != 0) {
+        logf_("gtfs_slice: %s does not match %s", out, full);
+        return 1;
+    }
+    return 0;
+}
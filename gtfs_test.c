@@ -0,0 +1,316 @@
+/*
+ * gtfs_load() download path against tools/http_standin.py: 200, 304, an interrupted
+ * transfer resumed with a 206, a restart when the ETag changes under a .part, a body
+ * that is not a zip, a server without ETags and a 416 on a finished .part; then
+ * GTFS_BUS_URL=none, which must load the local zip without a request but not one with a
+ * corrupt member (and must leave no snapshot of it), and gtfs_slice,
+ * which must not leave cache files next to its zips. A watcher thread reads the cache
+ * zip throughout and must only ever see a whole published version.
+ */
+#include "gtfs.h"
+#include "test.h"
+#include <dirent.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define MAX_VERSIONS 8
+
+static Standin s_srv;
+static char s_dir[512], s_cache[600];
+static char *s_ver[MAX_VERSIONS];
+static size_t s_ver_len[MAX_VERSIONS];
+static int s_n_ver;
+static int s_load;
+static atomic_int s_watch_stop, s_watch_reads, s_watch_torn;
+
+/* Build the GTFS zip for headsign and serve it as feed.zip from now on (Last-Modified
+ * one minute per version apart). Returns its version index. */
+static int publish(const char *headsign, int garbage) {
+    char path[700], cmd[1400];
+    snprintf(path, sizeof(path), "%s/srv/feed.zip", s_dir);
+    int v = s_n_ver;
+    if (garbage) {
+        char junk[4096];
+        for (size_t i = 0; i < sizeof(junk); i++) junk[i] = (char)('a' + i % 26);
+        test_write_file(path, junk, sizeof(junk));
+    } else {
+        snprintf(cmd, sizeof(cmd), "python3 tools/http_standin.py gtfs-zip '%s' '%s'", path, headsign);
+        CHECK(system(cmd) == 0);
+    }
+    struct timespec ts[2] = { { 1700000000 + 60 * v, 0 }, { 1700000000 + 60 * v, 0 } };
+    utimensat(AT_FDCWD, path, ts, 0);
+    if (!garbage) s_ver[v] = test_read_file(path, &s_ver_len[v]);
+    s_n_ver = v + 1;
+    return v;
+}
+
+static void load(void) {
+    char url[256];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/feed.zip?load=%d", s_srv.port, ++s_load);
+    gtfs_load(url, s_cache);   /* a new URL makes the feed due at once */
+}
+
+static int file_is(const char *path, int v) {
+    size_t n;
+    char *b = test_read_file(path, &n);
+    int same = b && n == s_ver_len[v] && memcmp(b, s_ver[v], n) == 0;
+    free(b);
+    return same;
+}
+
+static int exists(const char *suffix) {
+    char path[700];
+    snprintf(path, sizeof(path), "%s%s", s_cache, suffix);
+    return access(path, F_OK) == 0;
+}
+
+static int no_temp_files(void) {
+    return !exists(".part") && !exists(".part.etag") && !exists(".etag.new");
+}
+
+/* Files in dir, not counting . and .. */
+static int dir_entries(const char *dir) {
+    DIR *d = opendir(dir);
+    int n = 0;
+    for (struct dirent *e; d && (e = readdir(d));)
+        n += strcmp(e->d_name, ".") != 0 && strcmp(e->d_name, "..") != 0;
+    if (d) closedir(d);
+    return n;
+}
+
+/* Copy of version v with one byte in the middle of member's data flipped (*len bytes). */
+static char *corrupt_member(int v, const char *member, size_t *len) {
+    const unsigned char *z = (const unsigned char *)s_ver[v];
+    size_t n = s_ver_len[v], name_len = strlen(member);
+    for (size_t i = 0; i + 30 + name_len <= n; i++) {
+        if (memcmp(z + i, "PK\3\4", 4) != 0 || (size_t)(z[i + 26] | z[i + 27] << 8) != name_len ||
+            memcmp(z + i + 30, member, name_len) != 0)
+            continue;
+        size_t comp = (size_t)z[i + 18] | (size_t)z[i + 19] << 8 | (size_t)z[i + 20] << 16 | (size_t)z[i + 21] << 24;
+        size_t data = i + 30 + name_len + (size_t)(z[i + 28] | z[i + 29] << 8);
+        char *out = malloc(n);
+        if (!out || comp == 0 || data + comp > n) break;
+        memcpy(out, z, n);
+        out[data + comp / 2] ^= 0x55;
+        *len = n;
+        return out;
+    }
+    return NULL;
+}
+
+/* Departure headsign of the loaded schedule at the test stop ("" if none). */
+static const char *headsign(void) {
+    static ScheduledDeparture d[SCHEDULED_MAX];
+    return gtfs_next_departures("900001", NULL, d, SCHEDULED_MAX) > 0 ? d[0].dest : "";
+}
+
+/* Every read of the cache zip must be absent or byte-identical to a served version. */
+static void *watcher(void *arg) {
+    (void)arg;
+    while (!atomic_load(&s_watch_stop)) {
+        size_t n;
+        char *b = test_read_file(s_cache, &n);
+        if (b) {
+            int known = 0;
+            for (int v = 0; v < s_n_ver && !known; v++)
+                known = s_ver[v] && n == s_ver_len[v] && memcmp(b, s_ver[v], n) == 0;
+            if (!known) atomic_fetch_add(&s_watch_torn, 1);
+            atomic_fetch_add(&s_watch_reads, 1);
+            free(b);
+        }
+        usleep(500);
+    }
+    return NULL;
+}
+
+int main(void) {
+    char srv_root[600], codes[512], part[700], etag[700];
+    if (test_mkdtemp(s_dir, sizeof(s_dir), "gtfs") != 0) return 1;
+    snprintf(srv_root, sizeof(srv_root), "%s/srv", s_dir);
+    snprintf(s_cache, sizeof(s_cache), "%s/cache/gtfs.zip", s_dir);
+    snprintf(part, sizeof(part), "%s.part", s_cache);
+    snprintf(etag, sizeof(etag), "%s.etag", s_cache);
+    mkdir(srv_root, 0755);
+    if (standin_start(&s_srv, srv_root) != 0) {
+        test_rmtree(s_dir);
+        return 1;
+    }
+    pthread_t th;
+    pthread_create(&th, NULL, watcher, NULL);
+
+    /* 200: first download */
+    int a = publish("VERSION A", 0);
+    load();
+    standin_codes(&s_srv, codes, sizeof(codes));
+    CHECK(strcmp(codes, "200 -") == 0);
+    CHECK(file_is(s_cache, a));
+    CHECK(exists(".etag") && no_temp_files());
+    CHECK(strcmp(headsign(), "VERSION A") == 0);
+
+    /* 304: nothing fetched, nothing reparsed */
+    char snap[700];
+    struct stat st0, st1;
+    snprintf(snap, sizeof(snap), "%s.snap", s_cache);
+    CHECK(stat(snap, &st0) == 0);
+    load();
+    standin_codes(&s_srv, codes, sizeof(codes));
+    CHECK(strcmp(codes, "304 -") == 0);
+    CHECK(file_is(s_cache, a) && no_temp_files());
+    CHECK(stat(snap, &st1) == 0 && st1.st_ino == st0.st_ino &&
+          st1.st_mtim.tv_sec == st0.st_mtim.tv_sec && st1.st_mtim.tv_nsec == st0.st_mtim.tv_nsec);
+
+    /* Interrupted: both attempts cut off; the .part grows and the cache stays A */
+    int b = publish("VERSION B", 0);
+    standin_mode(&s_srv, "truncate");
+    load();
+    standin_codes(&s_srv, codes, sizeof(codes));
+    CHECK(strncmp(codes, "200 - 206 bytes=", 16) == 0);
+    CHECK(file_is(s_cache, a));
+    size_t part_len = 0;
+    char *p = test_read_file(part, &part_len);
+    CHECK(p && part_len > 0 && part_len < s_ver_len[b] && memcmp(p, s_ver[b], part_len) == 0);
+    free(p);
+    CHECK(exists(".part.etag") && !exists(".etag.new"));
+    CHECK(strcmp(headsign(), "VERSION A") == 0);
+
+    /* 206: the rest is appended and the whole zip renamed over the cache */
+    int old_fd = open(s_cache, O_RDONLY);
+    struct stat before;
+    fstat(old_fd, &before);
+    standin_mode(&s_srv, "");
+    load();
+    standin_codes(&s_srv, codes, sizeof(codes));
+    char want[64];
+    snprintf(want, sizeof(want), "206 bytes=%zu-", part_len);
+    CHECK(strcmp(codes, want) == 0);
+    CHECK(file_is(s_cache, b) && no_temp_files());
+    struct stat after;
+    CHECK(stat(s_cache, &after) == 0 && after.st_ino != before.st_ino);
+    char *old = malloc(s_ver_len[a] + 1);
+    CHECK(old && pread(old_fd, old, s_ver_len[a] + 1, 0) == (ssize_t)s_ver_len[a] &&
+          memcmp(old, s_ver[a], s_ver_len[a]) == 0);      /* replaced, not rewritten */
+    free(old);
+    close(old_fd);
+    CHECK(strcmp(headsign(), "VERSION B") == 0);
+
+    /* Changed ETag: the .part of C is dropped when the server now has D */
+    publish("VERSION C", 0);
+    standin_mode(&s_srv, "truncate");
+    load();
+    standin_codes(&s_srv, codes, sizeof(codes));
+    CHECK(exists(".part") && file_is(s_cache, b));
+    int d = publish("VERSION D", 0);
+    standin_mode(&s_srv, "");
+    load();
+    standin_codes(&s_srv, codes, sizeof(codes));
+    CHECK(strncmp(codes, "200 bytes=", 10) == 0 && strstr(codes, " 200 -") != NULL);
+    CHECK(file_is(s_cache, d) && no_temp_files());
+    CHECK(strcmp(headsign(), "VERSION D") == 0);
+
+    /* Not a zip: discarded, the cache and its ETag stay D */
+    char *tag_d = test_read_file(etag, NULL);
+    publish(NULL, 1);
+    load();
+    standin_codes(&s_srv, codes, sizeof(codes));
+    CHECK(strcmp(codes, "200 - 200 -") == 0);
+    CHECK(file_is(s_cache, d) && no_temp_files());
+    char *tag = test_read_file(etag, NULL);
+    CHECK(tag && tag_d && strcmp(tag, tag_d) == 0);
+    free(tag);
+    free(tag_d);
+    CHECK(strcmp(headsign(), "VERSION D") == 0);
+
+    /* No ETag: a cut transfer of unknown version is never resumed */
+    int f = publish("VERSION F", 0);
+    standin_mode(&s_srv, "truncate noetag");
+    load();
+    standin_codes(&s_srv, codes, sizeof(codes));
+    CHECK(strcmp(codes, "200 - 200 -") == 0);
+    CHECK(file_is(s_cache, d));
+    standin_mode(&s_srv, "noetag");
+    load();
+    standin_codes(&s_srv, codes, sizeof(codes));
+    CHECK(strcmp(codes, "200 -") == 0);
+    CHECK(file_is(s_cache, f) && no_temp_files());
+    tag = test_read_file(etag, NULL);
+    CHECK(!tag || !strstr(tag, "\""));     /* D's tag must not stick to F */
+    free(tag);
+    CHECK(strcmp(headsign(), "VERSION F") == 0);
+
+    /* 416: a .part that already holds the whole file is restarted from scratch */
+    int g = publish("VERSION G", 0);
+    standin_mode(&s_srv, "truncate");
+    load();
+    standin_codes(&s_srv, codes, sizeof(codes));
+    CHECK(exists(".part.etag"));
+    test_write_file(part, s_ver[g], s_ver_len[g]);
+    standin_mode(&s_srv, "");
+    load();
+    standin_codes(&s_srv, codes, sizeof(codes));
+    CHECK(strncmp(codes, "416 bytes=", 10) == 0 && strstr(codes, " 200 -") != NULL);
+    CHECK(file_is(s_cache, g) && no_temp_files());
+    CHECK(strcmp(headsign(), "VERSION G") == 0);
+
+    /* GTFS_BUS_URL=none: no request; the zip at the cache path loads as is */
+    char local_dir[700], local[800];
+    snprintf(local_dir, sizeof(local_dir), "%s/local", s_dir);
+    mkdir(local_dir, 0755);
+    snprintf(local, sizeof(local), "%s/missing.zip", local_dir);
+    gtfs_load("none", local);
+    CHECK(strcmp(gtfs_last_status_str(), "NO_CACHE") == 0);
+    snprintf(local, sizeof(local), "%s/slice.zip", local_dir);
+    test_write_file(local, s_ver[b], s_ver_len[b]);
+    gtfs_load("none", local);
+    CHECK(strcmp(gtfs_last_status_str(), "OK") == 0);
+    CHECK(strcmp(headsign(), "VERSION B") == 0);
+    standin_codes(&s_srv, codes, sizeof(codes));
+    CHECK(codes[0] == '\0');
+
+    /* A corrupt member (a byte of stop_times.txt or trips.txt flipped: inflate or CRC-32
+     * fails) is not a load: B stays, and no .snap or .stop is written for the bad zip */
+    static const char *bad_members[] = { "stop_times.txt", "trips.txt" };
+    for (int i = 0; i < 2; i++) {
+        size_t bad_len = 0;
+        char *bad = corrupt_member(b, bad_members[i], &bad_len);
+        CHECK(bad != NULL);
+        if (!bad) continue;
+        snprintf(local_dir, sizeof(local_dir), "%s/bad%d", s_dir, i);
+        mkdir(local_dir, 0755);
+        snprintf(local, sizeof(local), "%s/bad.zip", local_dir);
+        test_write_file(local, bad, bad_len);
+        free(bad);
+        gtfs_load("none", local);
+        CHECK(strcmp(gtfs_last_status_str(), "PARSE_FAIL") == 0);
+        CHECK(strcmp(headsign(), "VERSION B") == 0);
+        CHECK(dir_entries(local_dir) == 1);
+    }
+
+    /* gtfs_slice: the cut and its check leave nothing next to the zips but the slice */
+    char full[800], cut[800];
+    snprintf(full, sizeof(full), "%s/slice/full.zip", s_dir);
+    snprintf(cut, sizeof(cut), "%s/slice/cut.zip", s_dir);
+    snprintf(local_dir, sizeof(local_dir), "%s/slice", s_dir);
+    mkdir(local_dir, 0755);
+    test_write_file(full, s_ver[g], s_ver_len[g]);
+    CHECK(gtfs_slice_write(full, "900001", cut) == 0);
+    CHECK(gtfs_slice_verify(full, cut, "900001", 1700000000, 1, 60) == 0);
+    CHECK(dir_entries(local_dir) == 2);
+
+    atomic_store(&s_watch_stop, 1);
+    pthread_join(th, NULL);
+    CHECK(atomic_load(&s_watch_reads) > 0);
+    CHECK(atomic_load(&s_watch_torn) == 0);
+    printf("gtfs_test: %d cache reads during downloads, %d torn\n",
+           atomic_load(&s_watch_reads), atomic_load(&s_watch_torn));
+
+    standin_stop(&s_srv);
+    test_rmtree(s_dir);
+    for (int v = 0; v < s_n_ver; v++) free(s_ver[v]);
+    return test_done("gtfs_test");
+}
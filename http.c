@@ -0,0 +1,338 @@
+/*
+ * In-process HTTP client: a libcurl multi handle whose connection pool, together with a
+ * share handle for DNS answers and TLS sessions, carries over from request to request.
+ * A fixed set of easy handles runs up to HTTP_MAX_PARALLEL transfers at once.
+ */
+#include "http.h"
+#include "util.h"
+#include <curl/curl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define HTTP_BUF_INITIAL (64 * 1024)
+#define HTTP_MAX_SOURCES 8      /* hosts with their own byte counters */
+
+/* Bytes received from one host: as sent (wire, compressed when the server chose to) and
+ * as delivered to the caller (body). */
+typedef struct {
+    char      host[64];
+    long      responses;
+    long long wire, body;
+} HttpSourceBytes;
+
+typedef struct {
+    long   requests, failed, reused;
+    double dns_ms, connect_ms, tls_ms, ttfb_ms, total_ms;
+    HttpSourceBytes src[HTTP_MAX_SOURCES];
+    int    n_src;
+} HttpStats;
+
+/* Everything below is used only with g_http_lock held, so the share handle needs no
+ * lock callbacks. */
+static pthread_mutex_t g_http_lock = PTHREAD_MUTEX_INITIALIZER;
+static CURLM    *g_multi;
+static CURLSH   *g_share;
+static CURL     *g_easy[HTTP_MAX_PARALLEL];
+static int       g_curl_global;
+static int       g_trace;
+static HttpStats g_stats;
+
+typedef struct {
+    HttpBuf *b;
+    size_t   max_len;
+    int      too_big;
+} HttpSink;
+
+static size_t http_write(char *p, size_t size, size_t nmemb, void *ud) {
+    HttpSink *s = (HttpSink *)ud;
+    HttpBuf *b = s->b;
+    size_t n = size * nmemb;
+    if (n > s->max_len - b->len) {
+        s->too_big = 1;
+        return 0;
+    }
+    if (b->len + n + 1 > b->cap) {
+        size_t cap = b->cap;
+        while (cap < b->len + n + 1) cap *= 2;
+        if (cap > s->max_len + 1) cap = s->max_len + 1;
+        char *nb = (char *)realloc(b->data, cap);
+        if (!nb) return 0;
+        b->data = nb;
+        b->cap = cap;
+    }
+    memcpy(b->data + b->len, p, n);
+    b->len += n;
+    return n;
+}
+
+static CURL *http_easy_new(void) {
+    CURL *c = curl_easy_init();
+    if (!c) return NULL;
+    curl_easy_setopt(c, CURLOPT_SHARE, g_share);
+    curl_easy_setopt(c, CURLOPT_NOSIGNAL, 1L);            /* timeouts without SIGALRM (threads) */
+    curl_easy_setopt(c, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(c, CURLOPT_MAXREDIRS, 5L);
+    curl_easy_setopt(c, CURLOPT_CONNECTTIMEOUT, 10L);
+    curl_easy_setopt(c, CURLOPT_TIMEOUT, 20L);
+    curl_easy_setopt(c, CURLOPT_DNS_CACHE_TIMEOUT, 300L);
+    curl_easy_setopt(c, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(c, CURLOPT_PIPEWAIT, 1L);            /* prefer multiplexing over a new connection */
+    curl_easy_setopt(c, CURLOPT_USERAGENT, "arrival_board");
+    /* Offer every encoding libcurl was built with (gzip, deflate, ...). It inflates as data
+     * arrives, so http_write() appends decoded bytes straight into the caller's buffer and
+     * max_len bounds the decoded size. */
+    curl_easy_setopt(c, CURLOPT_ACCEPT_ENCODING, "");
+    curl_easy_setopt(c, CURLOPT_WRITEFUNCTION, http_write);
+    return c;
+}
+
+/* Create the shared handles on first use. Caller holds g_http_lock. Returns 0 if
+ * libcurl cannot be set up. */
+static int http_handles(void) {
+    if (g_multi) return 1;
+    if (!g_curl_global) {
+        if (curl_global_init(CURL_GLOBAL_DEFAULT) != 0) return 0;
+        g_curl_global = 1;
+        const char *tr = getenv("HTTP_TRACE");
+        g_trace = tr && atoi(tr) > 0;
+    }
+    g_share = curl_share_init();
+    g_multi = curl_multi_init();
+    if (!g_share || !g_multi) goto fail;
+    curl_share_setopt(g_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(g_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    /* parallel polls to one host, plus the other APIs */
+    curl_multi_setopt(g_multi, CURLMOPT_MAXCONNECTS, (long)(HTTP_MAX_PARALLEL + 4));
+    for (int i = 0; i < HTTP_MAX_PARALLEL; i++)
+        if (!(g_easy[i] = http_easy_new())) goto fail;
+    return 1;
+fail:
+    for (int i = 0; i < HTTP_MAX_PARALLEL; i++) {
+        if (g_easy[i]) curl_easy_cleanup(g_easy[i]);
+        g_easy[i] = NULL;
+    }
+    if (g_multi) curl_multi_cleanup(g_multi);
+    if (g_share) curl_share_cleanup(g_share);
+    g_multi = NULL;
+    g_share = NULL;
+    return 0;
+}
+
+void http_init(void) {
+    pthread_mutex_lock(&g_http_lock);
+    if (!http_handles()) logf_("HTTP: cannot initialize libcurl");
+    pthread_mutex_unlock(&g_http_lock);
+}
+
+void http_cleanup(void) {
+    pthread_mutex_lock(&g_http_lock);
+    for (int i = 0; i < HTTP_MAX_PARALLEL; i++) {
+        if (g_easy[i]) curl_easy_cleanup(g_easy[i]);
+        g_easy[i] = NULL;
+    }
+    if (g_multi) curl_multi_cleanup(g_multi);
+    if (g_share) curl_share_cleanup(g_share);
+    g_multi = NULL;
+    g_share = NULL;
+    if (g_curl_global) curl_global_cleanup();
+    g_curl_global = 0;
+    pthread_mutex_unlock(&g_http_lock);
+}
+
+/* Add one response to the byte counters of the host in url. Caller holds g_http_lock. */
+static void http_count_bytes(const char *url, long long wire, long long body) {
+    const char *h = strstr(url, "://");
+    h = h ? h + 3 : url;
+    size_t n = strcspn(h, "/:?");
+    if (n >= sizeof(g_stats.src[0].host)) n = sizeof(g_stats.src[0].host) - 1;
+    HttpSourceBytes *s = NULL;
+    for (int i = 0; i < g_stats.n_src && !s; i++)
+        if (strlen(g_stats.src[i].host) == n && memcmp(g_stats.src[i].host, h, n) == 0)
+            s = &g_stats.src[i];
+    if (!s) {
+        if (g_stats.n_src == HTTP_MAX_SOURCES) return;
+        s = &g_stats.src[g_stats.n_src++];
+        memcpy(s->host, h, n);
+        s->host[n] = '\0';
+    }
+    s->responses++;
+    s->wire += wire;
+    s->body += body;
+}
+
+static double info_ms(CURL *c, CURLINFO what) {
+    curl_off_t us = 0;
+    if (curl_easy_getinfo(c, what, &us) != CURLE_OK) return 0.0;
+    return (double)us / 1000.0;
+}
+
+static void http_timing(CURL *c, HttpTiming *t) {
+    long conns = 0;
+    t->code = 0;
+    curl_easy_getinfo(c, CURLINFO_NUM_CONNECTS, &conns);
+    curl_easy_getinfo(c, CURLINFO_RESPONSE_CODE, &t->code);
+    double dns = info_ms(c, CURLINFO_NAMELOOKUP_TIME_T);
+    double conn = info_ms(c, CURLINFO_CONNECT_TIME_T);
+    double tls = info_ms(c, CURLINFO_APPCONNECT_TIME_T);
+    t->reused = (conns == 0);
+    t->dns_ms = t->reused ? 0.0 : dns;
+    t->connect_ms = t->reused || conn < dns ? 0.0 : conn - dns;
+    t->tls_ms = t->reused || tls < conn ? 0.0 : tls - conn;
+    t->ttfb_ms = info_ms(c, CURLINFO_STARTTRANSFER_TIME_T);
+    t->total_ms = info_ms(c, CURLINFO_TOTAL_TIME_T);
+    curl_off_t wire = 0;
+    curl_easy_getinfo(c, CURLINFO_SIZE_DOWNLOAD_T, &wire);
+    t->wire_bytes = (long)wire;
+}
+
+/* One attempt at every request in reqs[0..n) that is not yet ok, run concurrently.
+ * Logs URLs without their query string (it carries the API key). */
+static void http_batch(HttpReq *reqs, int n) {
+    HttpSink sink[HTTP_MAX_PARALLEL];
+    CURLcode rc[HTTP_MAX_PARALLEL];
+    char err[HTTP_MAX_PARALLEL][CURL_ERROR_SIZE];
+    int active[HTTP_MAX_PARALLEL] = { 0 }, done[HTTP_MAX_PARALLEL] = { 0 };
+    int n_active = 0;
+
+    pthread_mutex_lock(&g_http_lock);
+    if (!http_handles()) {
+        pthread_mutex_unlock(&g_http_lock);
+        logf_("HTTP_GET_FAIL cannot initialize libcurl");
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        HttpReq *q = &reqs[i];
+        HttpBuf *b = q->buf;
+        if (q->ok || !q->url || !b) continue;
+        b->len = 0;
+        if (!b->data) {
+            b->data = (char *)malloc(HTTP_BUF_INITIAL);
+            if (!b->data) continue;
+            b->cap = HTTP_BUF_INITIAL;
+        }
+        sink[i] = (HttpSink){ b, q->max_len, 0 };
+        rc[i] = CURLE_OK;
+        err[i][0] = '\0';
+        CURL *c = g_easy[i];
+        curl_easy_setopt(c, CURLOPT_URL, q->url);
+        curl_easy_setopt(c, CURLOPT_WRITEDATA, &sink[i]);
+        curl_easy_setopt(c, CURLOPT_ERRORBUFFER, err[i]);
+        if (curl_multi_add_handle(g_multi, c) != CURLM_OK) continue;
+        active[i] = 1;
+        n_active++;
+    }
+
+    int running = n_active;
+    while (running > 0) {
+        if (curl_multi_perform(g_multi, &running) != CURLM_OK) break;
+        if (running > 0 && curl_multi_poll(g_multi, NULL, 0, 1000, NULL) != CURLM_OK) break;
+    }
+    CURLMsg *msg;
+    int left;
+    while ((msg = curl_multi_info_read(g_multi, &left)) != NULL) {
+        if (msg->msg != CURLMSG_DONE) continue;
+        for (int i = 0; i < n; i++)
+            if (active[i] && g_easy[i] == msg->easy_handle) {
+                rc[i] = msg->data.result;
+                done[i] = 1;
+            }
+    }
+
+    int trace = g_trace;
+    for (int i = 0; i < n; i++) {
+        if (!active[i]) continue;
+        CURL *c = g_easy[i];
+        HttpReq *q = &reqs[i];
+        if (!done[i]) rc[i] = CURLE_OPERATION_TIMEDOUT;    /* the multi loop failed */
+        curl_multi_remove_handle(g_multi, c);
+        curl_easy_setopt(c, CURLOPT_ERRORBUFFER, NULL);
+        http_timing(c, &q->timing);
+        q->ok = (rc[i] == CURLE_OK && q->timing.code < 400);
+        g_stats.requests++;
+        g_stats.failed += !q->ok;
+        g_stats.reused += q->timing.reused;
+        g_stats.dns_ms += q->timing.dns_ms;
+        g_stats.connect_ms += q->timing.connect_ms;
+        g_stats.tls_ms += q->timing.tls_ms;
+        g_stats.ttfb_ms += q->timing.ttfb_ms;
+        g_stats.total_ms += q->timing.total_ms;
+        if (q->ok) http_count_bytes(q->url, q->timing.wire_bytes, (long long)q->buf->len);
+    }
+    pthread_mutex_unlock(&g_http_lock);
+
+    for (int i = 0; i < n; i++) {
+        if (!active[i]) continue;
+        const HttpReq *q = &reqs[i];
+        const HttpTiming *tm = &q->timing;
+        int path_len = (int)strcspn(q->url, "?");
+        q->buf->data[q->buf->len] = '\0';
+        if (trace)
+            logf_("HTTP %ld %.*s bytes=%zu wire=%ld dns=%.1f connect=%.1f tls=%.1f ttfb=%.1f total=%.1f ms%s",
+                  tm->code, path_len, q->url, q->buf->len, tm->wire_bytes, tm->dns_ms, tm->connect_ms, tm->tls_ms,
+                  tm->ttfb_ms, tm->total_ms, tm->reused ? " (reused)" : "");
+        if (q->ok) continue;
+        if (sink[i].too_big)
+            logf_("HTTP_GET_FAIL response exceeds %zu bytes, aborting", q->max_len);
+        else if (rc[i] != CURLE_OK)
+            logf_("HTTP_GET_FAIL url=%.*s curl=%d %s", path_len, q->url, (int)rc[i],
+                  err[i][0] ? err[i] : curl_easy_strerror(rc[i]));
+        else
+            logf_("HTTP_GET_FAIL url=%.*s status=%ld", path_len, q->url, tm->code);
+    }
+}
+
+int http_fetch_many(HttpReq *reqs, int n) {
+    if (!reqs || n <= 0) return 0;
+    if (n > HTTP_MAX_PARALLEL) n = HTTP_MAX_PARALLEL;
+    for (int i = 0; i < n; i++) {
+        reqs[i].ok = 0;
+        memset(&reqs[i].timing, 0, sizeof(reqs[i].timing));
+    }
+    http_batch(reqs, n);
+    int ok = 0;
+    for (int i = 0; i < n; i++) ok += reqs[i].ok;
+    if (ok < n) {
+        sleep(2);
+        http_batch(reqs, n);
+        ok = 0;
+        for (int i = 0; i < n; i++) ok += reqs[i].ok;
+    }
+    return ok;
+}
+
+int http_fetch(HttpBuf *b, const char *url, size_t max_len, HttpTiming *t) {
+    if (!b || !url) return -1;
+    HttpReq q;
+    memset(&q, 0, sizeof(q));
+    q.url = url;
+    q.buf = b;
+    q.max_len = max_len;
+    http_fetch_many(&q, 1);
+    if (t) *t = q.timing;
+    return q.ok ? 0 : -1;
+}
+
+void http_buf_free(HttpBuf *b) {
+    if (!b) return;
+    free(b->data);
+    memset(b, 0, sizeof(*b));
+}
+
+void http_log_stats(void) {
+    pthread_mutex_lock(&g_http_lock);
+    HttpStats s = g_stats;
+    memset(&g_stats, 0, sizeof(g_stats));
+    pthread_mutex_unlock(&g_http_lock);
+    if (s.requests == 0) return;
+    double n = (double)s.requests;
+    logf_("HTTP_STATS requests=%ld failed=%ld reused=%ld mean_ms dns=%.1f connect=%.1f tls=%.1f ttfb=%.1f total=%.1f",
+          s.requests, s.failed, s.reused, s.dns_ms / n, s.connect_ms / n, s.tls_ms / n,
+          s.ttfb_ms / n, s.total_ms / n);
+    for (int i = 0; i < s.n_src; i++) {
+        const HttpSourceBytes *b = &s.src[i];
+        logf_("HTTP_BYTES host=%s responses=%ld wire=%lld body=%lld saved=%.0f%%", b->host,
+              b->responses, b->wire, b->body, b->body > 0 ? 100.0 * (double)(b->body - b->wire) / (double)b->body : 0.0);
+    }
+}
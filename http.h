@@ -0,0 +1,65 @@
+/*
+ * In-process HTTP client (libcurl). Handles are kept for the life of the process, so
+ * polls reuse open connections (per host), TLS sessions and DNS answers instead of
+ * starting a curl process, resolver lookup and handshake every time.
+ */
+#pragma once
+
+#include <stddef.h>
+
+#define HTTP_TEXT_MAX   (4u * 1024 * 1024)    /* JSON APIs */
+#define HTTP_BINARY_MAX (32u * 1024 * 1024)   /* protobuf feeds */
+
+/* Response body buffer. Keep one per call site and reuse it: it grows to the largest
+ * response seen, so steady-state polls do not allocate. */
+typedef struct HttpBuf {
+    char  *data;    /* body, NUL-terminated past len (may hold NULs) */
+    size_t len;
+    size_t cap;
+} HttpBuf;
+
+/* One request's phases in ms. dns/connect/tls are 0 when a pooled connection was reused;
+ * ttfb and total count from the start of the request. */
+typedef struct HttpTiming {
+    double dns_ms, connect_ms, tls_ms, ttfb_ms, total_ms;
+    long   code;        /* HTTP status, 0 if none */
+    int    reused;      /* 1 if no new connection was opened */
+    long   wire_bytes;  /* body bytes as received, before Content-Encoding is undone */
+} HttpTiming;
+
+/* One request of a concurrent batch (http_fetch_many). */
+typedef struct HttpReq {
+    const char *url;
+    HttpBuf    *buf;
+    size_t      max_len;
+    HttpTiming  timing;     /* out */
+    int         ok;         /* out: 1 if buf holds the body */
+} HttpReq;
+
+#define HTTP_MAX_PARALLEL 8     /* requests per http_fetch_many() batch */
+
+/* Global libcurl setup; call once from main before starting threads. */
+void http_init(void);
+
+/* Close pooled connections and release libcurl. */
+void http_cleanup(void);
+
+/* GET url into b (replacing its contents), retrying once after 2 s on failure. Bodies
+ * over max_len bytes and HTTP errors (>= 400) fail. Fills *t (if non-null) for the last
+ * attempt. Returns 0 on success, -1 on failure (logged). Thread-safe; requests and
+ * batches are serialized. Set HTTP_TRACE=1 to log every request's timing. */
+int http_fetch(HttpBuf *b, const char *url, size_t max_len, HttpTiming *t);
+
+/* Run up to HTTP_MAX_PARALLEL requests at once, on parallel (or, over HTTP/2, shared)
+ * connections; failed ones are retried together once after 2 s. The batch takes about
+ * as long as its slowest request. Sets each req's ok and timing; returns how many
+ * succeeded. */
+int http_fetch_many(HttpReq *reqs, int n);
+
+/* Free b's storage. */
+void http_buf_free(HttpBuf *b);
+
+/* Log request count, connection reuse and mean phase times since the last call, and per
+ * host the bytes received on the wire against the decoded body bytes (responses are
+ * requested compressed). */
+void http_log_stats(void);
@@ -0,0 +1,284 @@
+/*
+ * http.c against tools/http_standin.py on loopback: a second request rides the first
+ * one's connection (HttpTiming.reused) into the same buffer, a body over max_len fails
+ * while one of exactly max_len fits, HTTP >= 400 fails, and a batch retries only its
+ * failed requests, once. A gzip or deflate answer arrives in fewer wire bytes and decodes
+ * to the same body. Then the cost of a poll: wall time and CPU per request
+ * in-process against the curl process per request it replaced.
+ */
+#include "http.h"
+#include "test.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define POLLS 50
+
+static Standin s_srv;
+static char s_dir[512];
+
+static void url(char *out, size_t sz, const char *path) {
+    snprintf(out, sz, "http://127.0.0.1:%d/%s", s_srv.port, path);
+}
+
+/* Responses with status code in the log lines codes ("200 - 404 - ..."). */
+static int count_code(const char *codes, const char *code) {
+    int n = 0;
+    size_t len = strlen(code);
+    for (const char *p = codes; (p = strstr(p, code)) != NULL; p += len)
+        n += (p == codes || p[-1] == ' ') && p[len] == ' ';
+    return n;
+}
+
+/* Milliseconds of CPU used by this process and its waited-for children. */
+static double cpu_ms(void) {
+    struct rusage self, kids;
+    getrusage(RUSAGE_SELF, &self);
+    getrusage(RUSAGE_CHILDREN, &kids);
+    return (self.ru_utime.tv_sec + self.ru_stime.tv_sec + kids.ru_utime.tv_sec + kids.ru_stime.tv_sec) * 1000.0 +
+           (self.ru_utime.tv_usec + self.ru_stime.tv_usec + kids.ru_utime.tv_usec + kids.ru_stime.tv_usec) / 1000.0;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* The request path http.c replaced: a curl process per request, read byte by byte. */
+static char *curl_get(const char *u, size_t *len) {
+    char cmd[512];
+    snprintf(cmd, sizeof(cmd), "curl -s --max-time 20 '%s'", u);
+    FILE *p = popen(cmd, "r");
+    if (!p) return NULL;
+    size_t cap = 4096, n = 0;
+    char *b = malloc(cap);
+    int c;
+    while (b && (c = fgetc(p)) != EOF) {
+        if (n + 1 >= cap) {
+            char *nb = realloc(b, cap *= 2);
+            if (!nb) { free(b); b = NULL; break; }
+            b = nb;
+        }
+        b[n++] = (char)c;
+    }
+    if (pclose(p) != 0 && b) { free(b); b = NULL; }
+    if (b) b[n] = '\0';
+    *len = n;
+    return b;
+}
+
+static void check_reuse(const char *body, size_t body_len) {
+    char u[256], codes[256];
+    HttpBuf b = { 0 };
+    HttpTiming t1, t2;
+    url(u, sizeof(u), "stop.json");
+    CHECK(http_fetch(&b, u, HTTP_TEXT_MAX, &t1) == 0);
+    CHECK(b.len == body_len && memcmp(b.data, body, body_len) == 0 && b.data[b.len] == '\0');
+    CHECK(t1.code == 200 && !t1.reused && t1.total_ms > 0 && t1.ttfb_ms <= t1.total_ms);
+    const char *data = b.data;
+    size_t cap = b.cap;
+    CHECK(http_fetch(&b, u, HTTP_TEXT_MAX, &t2) == 0);
+    CHECK(t2.code == 200 && t2.reused && t2.dns_ms == 0 && t2.connect_ms == 0 && t2.tls_ms == 0);
+    CHECK(b.data == data && b.cap == cap && b.len == body_len);     /* same buffer, no regrowth */
+    standin_codes(&s_srv, codes, sizeof(codes));
+    CHECK(strcmp(codes, "200 - 200 -") == 0);
+
+    /* A smaller body into the grown buffer, same connection */
+    url(u, sizeof(u), "small.txt");
+    CHECK(http_fetch(&b, u, HTTP_TEXT_MAX, &t2) == 0 && b.len == 6 && strcmp(b.data, "hello\n") == 0);
+    CHECK(b.data == data && t2.reused);
+    http_buf_free(&b);
+    CHECK(b.data == NULL && b.len == 0 && b.cap == 0);
+    standin_codes(&s_srv, codes, sizeof(codes));
+}
+
+static void check_limits(size_t big_len) {
+    char u[256], codes[512];
+    HttpBuf b = { 0 };
+    HttpTiming t;
+
+    /* exactly max_len fits */
+    url(u, sizeof(u), "big.bin");
+    CHECK(http_fetch(&b, u, big_len, &t) == 0 && b.len == big_len && t.code == 200);
+    standin_codes(&s_srv, codes, sizeof(codes));
+    CHECK(strcmp(codes, "200 -") == 0);
+
+    /* One batch: fine, one byte over max_len, and statuses >= 400. The failures are
+     * retried once, together, and the fine one is not fetched again. */
+    HttpBuf bufs[6] = { { 0 } };
+    char urls[6][256];
+    HttpReq reqs[6];
+    memset(reqs, 0, sizeof(reqs));
+    static const char *paths[6] = { "small.txt", "big.bin", "status/400", "status/404", "missing", "status/503" };
+    for (int i = 0; i < 6; i++) {
+        url(urls[i], sizeof(urls[i]), paths[i]);
+        reqs[i].url = urls[i];
+        reqs[i].buf = &bufs[i];
+        reqs[i].max_len = i == 1 ? big_len - 1 : HTTP_TEXT_MAX;
+    }
+    double t0 = test_now_ms();
+    CHECK(http_fetch_many(reqs, 6) == 1);
+    double ms = test_now_ms() - t0;
+    CHECK(reqs[0].ok && bufs[0].len == 6 && strcmp(bufs[0].data, "hello\n") == 0);
+    for (int i = 1; i < 6; i++) CHECK(!reqs[i].ok);
+    CHECK(reqs[1].timing.code == 200 && bufs[1].len <= big_len - 1);
+    CHECK(reqs[2].timing.code == 400 && reqs[3].timing.code == 404 && reqs[4].timing.code == 404 &&
+          reqs[5].timing.code == 503);
+    CHECK(ms >= 2000 && ms < 6000);                 /* one 2 s pause, not one per request */
+    standin_codes(&s_srv, codes, sizeof(codes));
+    CHECK(count_code(codes, "200") == 1 + 2 && count_code(codes, "400") == 2 &&
+          count_code(codes, "404") == 4 && count_code(codes, "503") == 2);
+    for (int i = 0; i < 6; i++) http_buf_free(&bufs[i]);
+
+    /* http_fetch() makes the same promise */
+    url(u, sizeof(u), "status/500");
+    CHECK(http_fetch(&b, u, HTTP_TEXT_MAX, &t) == -1 && t.code == 500);
+    standin_codes(&s_srv, codes, sizeof(codes));
+    CHECK(strcmp(codes, "500 - 500 -") == 0);
+    http_buf_free(&b);
+}
+
+/* What http_log_stats() logs (to stderr), in out. */
+static void log_stats(char *out, size_t sz) {
+    char path[600];
+    snprintf(path, sizeof(path), "%s/stats.log", s_dir);
+    fflush(stderr);
+    int saved = dup(2), fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (saved >= 0 && fd >= 0) dup2(fd, 2);
+    if (fd >= 0) close(fd);
+    http_log_stats();
+    fflush(stderr);
+    if (saved >= 0) {
+        dup2(saved, 2);
+        close(saved);
+    }
+    size_t len = 0;
+    char *got = test_read_file(path, &len);
+    snprintf(out, sz, "%s", got ? got : "");
+    free(got);
+}
+
+/* A compressed answer: fewer bytes on the wire, the same bytes in the buffer. */
+static void check_encoding(const char *body, size_t body_len) {
+    static const char *encodings[] = { "gzip", "deflate" };
+    char u[256], codes[256];
+    HttpBuf b = { 0 };
+    HttpTiming t;
+    char stats[1024], want[256];
+    long long wire = (long long)body_len;
+    url(u, sizeof(u), "stop.json");
+    log_stats(stats, sizeof(stats));                /* start the counters from zero */
+    CHECK(http_fetch(&b, u, HTTP_TEXT_MAX, &t) == 0 && t.wire_bytes == (long)body_len);
+    for (int e = 0; e < 2; e++) {
+        standin_mode(&s_srv, encodings[e]);
+        for (int rep = 0; rep < 2; rep++) {
+            memset(b.data, 0, b.cap);
+            CHECK(http_fetch(&b, u, HTTP_TEXT_MAX, &t) == 0 && t.code == 200);
+            CHECK(b.len == body_len && memcmp(b.data, body, body_len) == 0 && b.data[b.len] == '\0');
+            CHECK(t.wire_bytes > 0 && t.wire_bytes < (long)body_len / 2);
+            wire += t.wire_bytes;
+        }
+        printf("http_test: %s: %zu-byte body in %ld bytes\n", encodings[e], body_len, t.wire_bytes);
+    }
+    standin_mode(&s_srv, "");
+    http_buf_free(&b);
+    standin_codes(&s_srv, codes, sizeof(codes));
+    CHECK(strcmp(codes, "200 - 200 - 200 - 200 - 200 -") == 0);
+
+    /* The host's byte counters add up the same */
+    log_stats(stats, sizeof(stats));
+    snprintf(want, sizeof(want), "HTTP_BYTES host=127.0.0.1 responses=5 wire=%lld body=%lld ", wire,
+             5 * (long long)body_len);
+    CHECK(strstr(stats, want) != NULL);
+}
+
+/* POLLS requests each way: in-process on a kept-alive connection, then a curl process
+ * per request. */
+static void measure(const char *body, size_t body_len) {
+    char u[256], codes[4096];
+    double lat[2][POLLS], cpu[2];
+    int ok[2] = { 0, 0 };
+    url(u, sizeof(u), "stop.json");
+
+    HttpBuf b = { 0 };
+    http_fetch(&b, u, HTTP_TEXT_MAX, NULL);         /* connect once, as a running board has */
+    int reused = 0;
+    double c0 = cpu_ms();
+    for (int i = 0; i < POLLS; i++) {
+        HttpTiming t;
+        double t0 = test_now_ms();
+        ok[0] += http_fetch(&b, u, HTTP_TEXT_MAX, &t) == 0 && b.len == body_len;
+        lat[0][i] = test_now_ms() - t0;
+        reused += t.reused;
+    }
+    cpu[0] = cpu_ms() - c0;
+    http_buf_free(&b);
+    CHECK(ok[0] == POLLS && reused == POLLS);
+
+    int have_curl = system("curl --version >/dev/null 2>&1") == 0;
+    if (have_curl) {
+        c0 = cpu_ms();
+        for (int i = 0; i < POLLS; i++) {
+            size_t n = 0;
+            double t0 = test_now_ms();
+            char *got = curl_get(u, &n);
+            lat[1][i] = test_now_ms() - t0;
+            ok[1] += got && n == body_len && memcmp(got, body, n) == 0;
+            free(got);
+        }
+        cpu[1] = cpu_ms() - c0;
+        CHECK(ok[1] == POLLS);
+    }
+    standin_codes(&s_srv, codes, sizeof(codes));
+
+    printf("http_test: %d polls of a %zu-byte body over loopback\n", POLLS, body_len);
+    for (int k = 0; k < 1 + have_curl; k++) {
+        qsort(lat[k], POLLS, sizeof(double), cmp_double);
+        printf("  %-24s p50 %6.2f ms  p90 %6.2f ms  cpu %6.3f ms/poll\n",
+               k ? "curl process per poll" : "in-process, kept alive", lat[k][POLLS / 2],
+               lat[k][POLLS * 9 / 10], cpu[k] / POLLS);
+    }
+    if (have_curl) CHECK(cpu[0] < cpu[1] && lat[0][POLLS / 2] < lat[1][POLLS / 2]);
+}
+
+int main(void) {
+    char root[600], path[700];
+    if (test_mkdtemp(s_dir, sizeof(s_dir), "http") != 0) return 1;
+    snprintf(root, sizeof(root), "%s/srv", s_dir);
+    mkdir(root, 0755);
+
+    size_t body_len = 0;
+    char *body = test_read_file("testdata/siri_stop.json", &body_len);
+    size_t big_len = 300 * 1024 + 7;
+    char *big = malloc(big_len);
+    CHECK(body != NULL && big != NULL);
+    if (!body || !big) return test_done("http_test");
+    for (size_t i = 0; i < big_len; i++) big[i] = (char)(i * 7919 >> 3);
+    snprintf(path, sizeof(path), "%s/stop.json", root);
+    test_write_file(path, body, body_len);
+    snprintf(path, sizeof(path), "%s/big.bin", root);
+    test_write_file(path, big, big_len);
+    snprintf(path, sizeof(path), "%s/small.txt", root);
+    test_write_file(path, "hello\n", 6);
+
+    if (standin_start(&s_srv, root) != 0) {
+        test_rmtree(s_dir);
+        return 1;
+    }
+    http_init();
+    check_reuse(body, body_len);
+    check_limits(big_len);
+    check_encoding(body, body_len);
+    measure(body, body_len);
+    http_cleanup();
+
+    standin_stop(&s_srv);
+    test_rmtree(s_dir);
+    free(body);
+    free(big);
+    return test_done("http_test");
+}
@@ -3,13 +3,17 @@
  * Build: make (requires libsdl2-image-dev). Config via environment (see arrival_board.env.example).
  *
  * All blocking I/O (MTA API, weather API, GTFS parsing) runs on a background
- * thread so the SDL render loop stays smooth at ~60 fps even on a Pi Zero W.
+ * thread so the SDL render loop stays smooth at ~60 fps even on a Pi Zero W. The loop
+ * only runs that fast during tile flips (see framesched.h).
  */
 #include "audio.h"
 #include "config.h"
 #include "config_mode.h"
+#include "framesched.h"
 #include "gtfs.h"
+#include "http.h"
 #include "mta.h"
+#include "pollsched.h"
 #include "tile.h"
 #include "texture.h"
 #include "types.h"
@@ -82,6 +86,14 @@ typedef enum {
 
 static void *fetch_loop(void *arg);
 
+/* Wake the render loop from SDL_WaitEventTimeout() when the fetch thread publishes. */
+static void wake_render_loop(void) {
+    SDL_Event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.type = SDL_USEREVENT;
+    SDL_PushEvent(&ev);
+}
+
 static void stop_fetch_thread(FetchCtx *fctx, int *fetch_started) {
     if (!fctx || !fetch_started || !*fetch_started) return;
     fctx->running = 0;
@@ -101,6 +113,7 @@ static void start_fetch_thread(FetchCtx *fctx, int *fetch_started) {
 }
 
 static void resources_destroy(Resources *res) {
+    text_cache_clear();
     if (res->bg_tex)          SDL_DestroyTexture(res->bg_tex);
     if (res->steam_tex)       SDL_DestroyTexture(res->steam_tex);
     if (res->logo_tex)        SDL_DestroyTexture(res->logo_tex);
@@ -157,13 +170,22 @@ static int config_value_missing(const char *value) {
     return (!value || !*value || strcmp(value, "Insert MTA key here") == 0);
 }
 
+/* A stop number, or a comma-separated list of them; whitespace only around commas. */
 static int stop_id_format_ok(const char *stop_id) {
     if (!stop_id || !*stop_id) return 0;
+    int in_id = 0, gap = 0, n = 0;
     for (const char *p = stop_id; *p; p++) {
-        if (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
-            return 0;
+        if (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+            gap = in_id;
+        } else if (*p == ',') {
+            in_id = gap = 0;
+        } else {
+            if (gap) return 0;
+            if (!in_id) n++;
+            in_id = 1;
+        }
     }
-    return 1;
+    return n > 0;
 }
 
 static int wifi_connected(void) {
@@ -230,6 +252,30 @@ static void on_flip_ended(void *userdata) {
  * Runs MTA, weather, and GTFS queries in a loop.  Results are published to
  * FetchCtx under the mutex; the render thread copies them each frame.
  * -------------------------------------------------------------------------- */
+/* 1 if ctx already holds what a poll produced, so publishing it would change nothing on
+ * screen. Caller holds ctx->lock. */
+static int fetch_results_same(const FetchCtx *ctx, const Arrival *arr, int n,
+                              const ScheduledDeparture *sched, int ns, const Weather *wx,
+                              const char *stop_name, const char *health) {
+    if (n >= 0) {
+        if (n != ctx->n) return 0;
+        for (int i = 0; i < n; i++)
+            if (!arrival_same(&arr[i], &ctx->arrivals[i])) return 0;
+    }
+    if (ns != ctx->n_scheduled) return 0;
+    for (int i = 0; i < ns; i++) {
+        const ScheduledDeparture *a = &sched[i], *b = &ctx->scheduled[i];
+        if (a->when != b->when || strcmp(a->route, b->route) != 0 ||
+            strcmp(a->dest, b->dest) != 0 || strcmp(a->stop, b->stop) != 0) return 0;
+    }
+    const Weather *w = &ctx->weather;
+    if (wx->have != w->have || strcmp(wx->icon, w->icon) != 0 || wx->is_day != w->is_day ||
+        wx->temp_f != w->temp_f || wx->precip_prob != w->precip_prob ||
+        wx->precip_in != w->precip_in || wx->moon_phase != w->moon_phase) return 0;
+    if (!ctx->stop_name[0] && stop_name[0]) return 0;
+    return strcmp(ctx->health_message, health) == 0;
+}
+
 static void *fetch_loop(void *arg) {
     FetchCtx *ctx = (FetchCtx *)arg;
     AppConfig *cfg = &ctx->cfg;
@@ -239,6 +285,9 @@ static void *fetch_loop(void *arg) {
     SourceHealth gtfs_h   = { "GTFS_LOAD", 0, 0, 0, 0, 0 };
     time_t last_gtfs_load = 0;
     time_t last_health_log = 0;
+    long published = 0, unchanged = 0;
+    PollSched sched;
+    poll_sched_init(&sched, cfg->poll_min_seconds, cfg->poll_seconds, cfg->poll_max_seconds);
 
     Weather persist_wx;
     memset(&persist_wx, 0, sizeof(persist_wx));
@@ -246,8 +295,12 @@ static void *fetch_loop(void *arg) {
     persist_wx.precip_in   = -1.0;
     persist_wx.moon_phase  = -1.f;
 
-    gtfs_load(cfg->gtfs_url, cfg->gtfs_cache);
-    source_health_update(&gtfs_h, gtfs_last_status() == 0, gtfs_last_status_str(), time(NULL));
+    /* GTFS loads on its own thread so MTA polling starts (and keeps its cadence) at once. */
+    int gtfs_pending = (gtfs_load_async(cfg->gtfs_url, cfg->gtfs_cache) == 0);
+    if (!gtfs_pending) {
+        gtfs_load(cfg->gtfs_url, cfg->gtfs_cache);
+        source_health_update(&gtfs_h, gtfs_last_status() == 0, gtfs_last_status_str(), time(NULL));
+    }
     last_gtfs_load = time(NULL);
 
     while (ctx->running) {
@@ -257,9 +310,13 @@ static void *fetch_loop(void *arg) {
         Arrival local_arr[TILE_SLOTS_MAX];
         memset(local_arr, 0, sizeof(local_arr));
         char sn[256] = {0};
-        int n_new = fetch_mta_arrivals(local_arr, cfg->max_tiles, sn, sizeof(sn),
-                                       cfg->mta_key, cfg->stop_id,
-                                       cfg->route_filter[0] ? cfg->route_filter : NULL);
+        int n_new = cfg->mta_gtfs_rt
+            ? fetch_mta_arrivals_rt(local_arr, cfg->max_tiles, sn, sizeof(sn),
+                                    cfg->mta_key, cfg->gtfs_rt_url, cfg->stop_id,
+                                    cfg->route_filter[0] ? cfg->route_filter : NULL)
+            : fetch_mta_arrivals(local_arr, cfg->max_tiles, sn, sizeof(sn),
+                                 cfg->mta_key, cfg->stop_id,
+                                 cfg->route_filter[0] ? cfg->route_filter : NULL);
         now = time(NULL);
         source_health_update(&mta_h, mta_last_status() == 0, mta_last_status_str(), now);
         mta_log_realtime_express_routes(local_arr, n_new >= 0 ? n_new : 0);
@@ -277,7 +334,8 @@ static void *fetch_loop(void *arg) {
                              (weather_last_status() == 0 || weather_last_status() == 1),
                              weather_last_status_str(), time(NULL));
 
-        /* --- GTFS scheduled departures, excluding routes already in real-time --- */
+        /* --- GTFS scheduled departures (all stops in one pass), excluding routes already
+         * in real-time at the same stop --- */
         ScheduledDeparture local_sched[SCHEDULED_MAX];
         int n_sched = 0;
         if (cfg->stop_id[0]) {
@@ -287,7 +345,8 @@ static void *fetch_loop(void *arg) {
             for (int i = 0; i < nt; i++) {
                 int dup = 0;
                 for (int j = 0; j < n_rt; j++)
-                    if (strcmp(local_sched[i].route, local_arr[j].route) == 0) { dup = 1; break; }
+                    if (strcmp(local_sched[i].route, local_arr[j].route) == 0 &&
+                        strcmp(local_sched[i].stop, local_arr[j].stop) == 0) { dup = 1; break; }
                 if (!dup) local_sched[out++] = local_sched[i];
             }
             n_sched = out;
@@ -300,26 +359,40 @@ static void *fetch_loop(void *arg) {
         build_health_message(cfg, wifi_connected(), stop_known,
                              &mta_h, health_message, sizeof(health_message));
 
-        /* --- Publish results --- */
+        /* --- Publish results: only when something visible changed, so the render loop
+         *     does not re-copy and re-diff an identical board --- */
         pthread_mutex_lock(&ctx->lock);
-        if (n_new >= 0) {
-            memcpy(ctx->arrivals, local_arr, sizeof(Arrival) * (size_t)n_new);
-            ctx->n = n_new;
+        int publish = !fetch_results_same(ctx, local_arr, n_new, local_sched, n_sched,
+                                          &persist_wx, sn, health_message);
+        if (!publish) {
+            unchanged++;
+        } else {
+            if (n_new >= 0) {
+                memcpy(ctx->arrivals, local_arr, sizeof(Arrival) * (size_t)n_new);
+                ctx->n = n_new;
+            }
+            if (!ctx->stop_name[0] && sn[0])
+                snprintf(ctx->stop_name, sizeof(ctx->stop_name), "%s", sn);
+            ctx->weather = persist_wx;
+            memcpy(ctx->scheduled, local_sched, sizeof(ScheduledDeparture) * (size_t)n_sched);
+            ctx->n_scheduled = n_sched;
+            snprintf(ctx->health_message, sizeof(ctx->health_message), "%s", health_message);
+            ctx->generation++;
+            published++;
         }
-        if (!ctx->stop_name[0] && sn[0])
-            snprintf(ctx->stop_name, sizeof(ctx->stop_name), "%s", sn);
-        ctx->weather = persist_wx;
-        memcpy(ctx->scheduled, local_sched, sizeof(ScheduledDeparture) * (size_t)n_sched);
-        ctx->n_scheduled = n_sched;
-        snprintf(ctx->health_message, sizeof(ctx->health_message), "%s", health_message);
-        ctx->generation++;
         pthread_mutex_unlock(&ctx->lock);
+        if (publish) wake_render_loop();
 
-        /* --- Daily GTFS zip refresh --- */
+        /* --- Hourly GTFS check (background): each feed refetches on its own schedule and
+         *     the live feeds are swapped when ready --- */
         now = time(NULL);
-        if (difftime(now, last_gtfs_load) >= 86400) {
-            gtfs_load(cfg->gtfs_url, cfg->gtfs_cache);
+        if (gtfs_pending && !gtfs_load_busy()) {
             source_health_update(&gtfs_h, gtfs_last_status() == 0, gtfs_last_status_str(), now);
+            gtfs_pending = 0;
+        }
+        if (!gtfs_pending && difftime(now, last_gtfs_load) >= 3600 &&
+            gtfs_load_async(cfg->gtfs_url, cfg->gtfs_cache) == 0) {
+            gtfs_pending = 1;
             last_gtfs_load = now;
         }
 
@@ -330,11 +403,25 @@ static void *fetch_loop(void *arg) {
             pthread_mutex_unlock(&ctx->lock);
             logf_("SRC_HEARTBEAT mta_n=%d weather_have=%d scheduled_n=%d mta_fail=%d weather_fail=%d gtfs_fail=%d",
                   hn, hwx, hns, mta_h.consecutive_failures, wx_h.consecutive_failures, gtfs_h.consecutive_failures);
+            http_log_stats();
+            poll_sched_log_stats(&sched);
+            long mta_hits, mta_polls, wx_hits, wx_polls;
+            mta_parse_cache_stats(&mta_hits, &mta_polls);
+            weather_parse_cache_stats(&wx_hits, &wx_polls);
+            logf_("SKIP_STATS mta_parse_reused=%ld/%ld weather_parse_reused=%ld/%ld publish_skipped=%ld/%ld",
+                  mta_hits, mta_polls, wx_hits, wx_polls, unchanged, unchanged + published);
             last_health_log = now;
         }
 
+        /* --- Next poll: sooner when a bus is close, later on an empty board or outside
+         *     the stop's service hours --- */
+        time_t next_service = 0;
+        int service = (n_new == 0 && cfg->stop_id[0])
+            ? gtfs_next_service(cfg->stop_id, now, &next_service) : -1;
+        int wait_s = poll_sched_next(&sched, local_arr, n_new, service, next_service, now);
+
         /* Sleep in 1-second chunks so the thread exits promptly on shutdown. */
-        for (int s = 0; s < cfg->poll_seconds && ctx->running; s++)
+        for (int s = 0; s < wait_s && ctx->running; s++)
             sleep(1);
     }
     return NULL;
@@ -463,6 +550,7 @@ int main(int argc, char **argv) {
     }
 
     /* ---- Start background fetch thread ----------------------------------- */
+    http_init();    /* libcurl global setup must precede the threads that use it */
     static FetchCtx fctx;
     memset(&fctx, 0, sizeof(fctx));
     pthread_mutex_init(&fctx.lock, NULL);
@@ -504,9 +592,22 @@ int main(int argc, char **argv) {
     int config_ap_client_connected = 0;
 
     /* ---- Main render loop ------------------------------------------------ */
-    enum { FRAME_BUDGET_MS = 16 };
+    enum { STATS_INTERVAL_MS = 600000 };
+    Uint32 last_stats = SDL_GetTicks();
+    FrameSched fsched;
+    frame_sched_init(&fsched, cfg.ambient_fps);
+    time_t drawn_minute = -1;
+    int drawn_W = 0, drawn_H = 0;
+    char drawn_status[sizeof(config_status)] = "";
+    int config_drawn = 0;
     for (;;) {
         Uint32 frame_start = SDL_GetTicks();
+        if (frame_start - last_stats >= STATS_INTERVAL_MS) {
+            text_cache_log_stats();
+            ui_log_stats();
+            frame_sched_log_stats(&fsched, frame_start);
+            last_stats = frame_start;
+        }
         SDL_Event e;
         while (SDL_PollEvent(&e)) {
             if (e.type == SDL_QUIT) goto done;
@@ -528,6 +629,7 @@ int main(int argc, char **argv) {
             config_unconnected_since = time(NULL);
             config_ap_checked_at = 0;
             config_ap_client_connected = 0;
+            config_drawn = 0;
         }
 
         if (app_mode != APP_RUNNING) {
@@ -573,19 +675,28 @@ int main(int argc, char **argv) {
             SDL_GetRendererOutputSize(r, &W, &H);
             if (strstr(config_status, "Applying") || strstr(config_status, "Reboot"))
                 app_mode = APP_CONFIG_APPLYING;
-            ui_render_config(r, &res.fonts, W, H, config_status);
-            {
-                Uint32 elapsed = SDL_GetTicks() - frame_start;
-                if (elapsed < FRAME_BUDGET_MS)
-                    SDL_Delay(FRAME_BUDGET_MS - elapsed);
+            /* Static instructions: redraw only when the helper's status changes. */
+            if (!config_drawn || strcmp(config_status, drawn_status) != 0) {
+                ui_render_config(r, &res.fonts, W, H, config_status);
+                frame_sched_rendered(&fsched, SDL_GetTicks(), 0, 0);
+                snprintf(drawn_status, sizeof(drawn_status), "%s", config_status);
+                config_drawn = 1;
+            } else {
+                frame_sched_idle_wakeup(&fsched);
             }
+            int wait_ms = frame_sched_wait_ms(&fsched, SDL_GetTicks());
+            if (wait_ms > 0) SDL_WaitEventTimeout(NULL, wait_ms);
+            drawn_minute = -1;
             continue;
         }
 
-        /* Pick up new data from the fetch thread (fast: just a memcpy under lock). */
+        /* Pick up new data from the fetch thread (fast: just a memcpy under lock). Only
+         * redraw when something is moving or what is shown changed. */
         int play_ferry = 0;
+        int dirty = frame_sched_due(&fsched, frame_start);
         pthread_mutex_lock(&fctx.lock);
         if (fctx.generation != local_gen) {
+            dirty = 1;
             /* Detect bus departures (bus with mins<=1 that disappeared). */
             if (ferry_path && ferry_path[0] && local_n > 0) {
                 for (int pi = 0; pi < local_n; pi++) {
@@ -605,7 +716,10 @@ int main(int argc, char **argv) {
                 snprintf(local_sn, sizeof(local_sn), "%s", fctx.stop_name);
             local_gen = fctx.generation;
         }
-        snprintf(local_health, sizeof(local_health), "%s", fctx.health_message);
+        if (strcmp(local_health, fctx.health_message) != 0) {
+            snprintf(local_health, sizeof(local_health), "%s", fctx.health_message);
+            dirty = 1;
+        }
         pthread_mutex_unlock(&fctx.lock);
 
         if (play_ferry) {
@@ -614,6 +728,25 @@ int main(int argc, char **argv) {
         }
 
         SDL_GetRendererOutputSize(r, &W, &H);
+        time_t now = time(NULL);
+        int eta_before[TILE_SLOTS_MAX];
+        int n_before = local_n;
+        for (int i = 0; i < local_n; i++) eta_before[i] = local_arr[i].mins;
+        local_n = arrivals_refresh_eta(local_arr, local_n, now);
+        for (int i = 0; i < local_n && !dirty; i++)
+            if (local_arr[i].mins != eta_before[i]) dirty = 1;
+        if (local_n != n_before || now / 60 != drawn_minute || W != drawn_W || H != drawn_H)
+            dirty = 1;
+        if (!dirty) {
+            frame_sched_idle_wakeup(&fsched);
+            int wait_ms = frame_sched_wait_ms(&fsched, SDL_GetTicks());
+            if (wait_ms > 0) SDL_WaitEventTimeout(NULL, wait_ms);
+            continue;
+        }
+        drawn_minute = now / 60;
+        drawn_W = W;
+        drawn_H = H;
+
         static FlipSoundCtx flip_ctx;
         if (cfg.flip_path[0]) {
             flip_ctx.flip_path       = cfg.flip_path;
@@ -621,7 +754,6 @@ int main(int argc, char **argv) {
             flip_ctx.music_path      = cfg.music_path;
             flip_ctx.music_loop2_path = cfg.music_loop2_path;
         }
-        local_n = arrivals_refresh_eta(local_arr, local_n, time(NULL));
         ui_render(r, &res.fonts, W, H,
                   cfg.stop_id[0] ? cfg.stop_id : "--", local_sn, &local_wx,
                   local_arr, local_n,
@@ -632,16 +764,16 @@ int main(int argc, char **argv) {
                   cfg.flip_path[0] ? on_flip_ended : NULL,
                   cfg.flip_path[0] ? (void *)&flip_ctx : NULL,
                   local_health);
+        int anim = ui_animation();
+        frame_sched_rendered(&fsched, frame_start, anim & UI_ANIM_FLIP, anim & UI_ANIM_AMBIENT);
 
-        {
-            Uint32 elapsed = SDL_GetTicks() - frame_start;
-            if (elapsed < FRAME_BUDGET_MS)
-                SDL_Delay(FRAME_BUDGET_MS - elapsed);
-        }
+        int wait_ms = frame_sched_wait_ms(&fsched, SDL_GetTicks());
+        if (wait_ms > 0) SDL_WaitEventTimeout(NULL, wait_ms);
     }
 
 done:
     stop_fetch_thread(&fctx, &fetch_started);
+    http_cleanup();
     pthread_mutex_destroy(&fctx.lock);
     config_mode_destroy(&config_mode);
     audio_stop_music();
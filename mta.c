@@ -1,11 +1,14 @@
 /*
- * MTA Bus Time API implementation: SIRI stop-monitoring parsing and arrival list.
+ * MTA Bus Time API implementation: SIRI stop-monitoring parsing and arrival list, or
+ * GTFS-Realtime TripUpdates joined against the static GTFS schedule.
  */
 #include "mta.h"
+#include "gtfs.h"
+#include "http.h"
 #include "util.h"
-#include <cjson/cJSON.h>
 #include <ctype.h>
 #include <math.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -17,10 +20,97 @@ enum {
     MTA_STATUS_HTTP_FAIL = 2,
     MTA_STATUS_JSON_FAIL = 3,
     MTA_STATUS_SCHEMA_FAIL = 4,
+    MTA_STATUS_PB_FAIL = 5,
 };
 
 static int g_mta_last_status = MTA_STATUS_OK;
 
+/* Response bodies, reused poll to poll (fetch thread only). */
+static HttpBuf s_siri_body[STOP_IDS_MAX];
+static HttpBuf s_rt_body;
+
+/* The last parse of each response, reused while the request and the body bytes stay the
+ * same (fetch thread only). */
+typedef struct {
+    uint64_t key;               /* hash of request + body; 0 = empty */
+    int      n;
+    Arrival  arr[TILE_SLOTS_MAX];
+    char     stop_name[256];
+} ParseCache;
+
+static ParseCache s_siri_cache[STOP_IDS_MAX];
+static ParseCache s_rt_cache;
+static long s_cache_hits, s_cache_polls;
+
+/* SIRI stop-monitoring endpoint (mta_test points it at tools/http_standin.py). */
+static const char *s_siri_url = "https://bustime.mta.info/api/siri/stop-monitoring.json";
+
+/* Split a STOP_ID list ("501627" or "501627, 501628") into out; returns the count. */
+static int split_stops(const char *list, char out[][32]) {
+    char copy[256], *save = NULL;
+    snprintf(copy, sizeof(copy), "%s", list);
+    int n = 0;
+    for (char *tok = strtok_r(copy, ", \t\n", &save); tok && n < STOP_IDS_MAX;
+         tok = strtok_r(NULL, ", \t\n", &save))
+        snprintf(out[n++], sizeof(out[0]), "%s", tok);
+    return n;
+}
+
+/* Merge arrivals gathered from several stops into arr[0..n): soonest first (unknown
+ * times last), one entry per vehicle (its soonest), at most max_arr. Returns the count. */
+static int arrivals_merge(Arrival *arr, int n, int max_arr) {
+    for (int i = 1; i < n; i++) {
+        Arrival a = arr[i];
+        time_t ka = a.expected > 0 ? a.expected : (time_t)INT64_MAX;
+        int j = i;
+        for (; j > 0 && (arr[j - 1].expected > 0 ? arr[j - 1].expected : (time_t)INT64_MAX) > ka; j--)
+            arr[j] = arr[j - 1];
+        arr[j] = a;
+    }
+    int out = 0;
+    for (int i = 0; i < n && out < max_arr; i++) {
+        int dup = 0;
+        if (strcmp(arr[i].bus, "--") != 0)
+            for (int j = 0; j < out && !dup; j++) dup = strcmp(arr[j].bus, arr[i].bus) == 0;
+        if (!dup) arr[out++] = arr[i];
+    }
+    return out;
+}
+
+/* Cache key of a response: the request that produced it and its bytes. */
+static uint64_t parse_key(const char *url, const char *stop_id, const char *route_filter,
+                          int max_arr, const HttpBuf *body) {
+    uint64_t h = hash_bytes(url, strlen(url), (uint64_t)max_arr);
+    if (stop_id) h = hash_bytes(stop_id, strlen(stop_id), h);
+    if (route_filter) h = hash_bytes(route_filter, strlen(route_filter), h);
+    h = hash_bytes(body->data, body->len, h);
+    return h ? h : 1;
+}
+
+/* Look key up in c; on a hit copy out its arrivals (and stop name) and return the count,
+ * else -1. Counts toward the hit rate. */
+static int parse_cache_get(const ParseCache *c, uint64_t key, Arrival *arr,
+                           char *stop_name, size_t stop_name_sz) {
+    s_cache_polls++;
+    if (c->key != key) return -1;
+    s_cache_hits++;
+    memcpy(arr, c->arr, sizeof(Arrival) * (size_t)c->n);
+    if (stop_name && stop_name_sz) snprintf(stop_name, stop_name_sz, "%s", c->stop_name);
+    return c->n;
+}
+
+static void parse_cache_put(ParseCache *c, uint64_t key, const Arrival *arr, int n,
+                            const char *stop_name) {
+    if (n < 0 || n > TILE_SLOTS_MAX) {
+        c->key = 0;
+        return;
+    }
+    c->key = key;
+    c->n = n;
+    memcpy(c->arr, arr, sizeof(Arrival) * (size_t)n);
+    snprintf(c->stop_name, sizeof(c->stop_name), "%s", stop_name ? stop_name : "");
+}
+
 /* Normalize route string: use last segment after '_', ':', or '/'. */
 static void normalize_route(char *dst, size_t dstsz, const char *src) {
     if (!src) { snprintf(dst, dstsz, "?"); return; }
@@ -127,6 +217,16 @@ static int estimate_people(int mins, int stops_away) {
     return clampi(ip, 0, cap);
 }
 
+/* Bring cached arrivals to now: the fields a fresh parse derives from the clock. */
+static void arrivals_retime(Arrival *arr, int n, time_t now) {
+    for (int i = 0; i < n; i++) {
+        if (arr[i].expected <= 0) continue;
+        int mins = (int)lrint(difftime(arr[i].expected, now) / 60.0);
+        arr[i].mins = mins < 0 ? 0 : mins;
+        arr[i].ppl_est = estimate_people(arr[i].mins, arr[i].stops_away);
+    }
+}
+
 /* Return 1 if route is in the comma-separated filter list, or if filter is empty. */
 static int route_allowed(const char *route, const char *filter_csv) {
     if (!filter_csv || !*filter_csv) return 1;
@@ -146,64 +246,202 @@ static int route_allowed(const char *route, const char *filter_csv) {
     return 0;
 }
 
-/* Parse stops-away from SIRI journey / MonitoredCall / Extensions / Distances. */
-static int parse_stops_away(const cJSON *journey) {
-    const cJSON *mc = jgeto(journey, "MonitoredCall");
-    const cJSON *ext = mc ? jgeto(mc, "Extensions") : NULL;
-    const cJSON *dist = ext ? jgeto(ext, "Distances") : NULL;
-
-    int v = jint(jgeto(dist, "StopsFromCall"), -1);
-    if (v >= 0) return v;
-    v = jint(jgeto(dist, "StopsAway"), -1);
-    if (v >= 0) return v;
-
-    const cJSON *ext2 = jgeto(journey, "Extensions");
-    const cJSON *dist2 = ext2 ? jgeto(ext2, "Distances") : NULL;
-    v = jint(jgeto(dist2, "StopsFromCall"), -1);
-    if (v >= 0) return v;
-
+/* One MonitoredStopVisit's fields, collected as the visit streams past. Numbers are -1
+ * when absent, as are unknown distances. */
+typedef struct {
+    int    open;                /* inside a visit object */
+    int    index;               /* position in MonitoredStopVisit */
+    int    have_mvj;            /* MonitoredVehicleJourney was an object */
+    int    have_line, have_vehicle, have_expected, have_aimed;
+    char   line[64];
+    char   vehicle[32];
+    char   dest[128];
+    char   expected[64], aimed[64];
+    int    call_stops_from_call, call_stops_away, journey_stops_from_call;
+    double call_dist_from_call, call_dist_from_stop, journey_dist_from_call, journey_dist_from_stop;
+} SiriVisit;
+
+typedef struct {
+    Arrival    *arr;
+    int         max_arr, count;
+    char       *stop_name;
+    size_t      stop_name_sz;
+    const char *route_filter;
+    time_t      now;
+    SiriVisit   v;
+} SiriScan;
+
+/* Stops-away: MonitoredCall distances first, then the journey's. */
+static int siri_stops_away(const SiriVisit *v) {
+    if (v->call_stops_from_call >= 0) return v->call_stops_from_call;
+    if (v->call_stops_away >= 0) return v->call_stops_away;
+    if (v->journey_stops_from_call >= 0) return v->journey_stops_from_call;
     return -1;
 }
 
-/* Parse distance to stop (meters) from SIRI and convert to miles. Returns <0 if unknown. */
-static double parse_miles_away(const cJSON *journey) {
-    const cJSON *mc = jgeto(journey, "MonitoredCall");
-    const cJSON *ext = mc ? jgeto(mc, "Extensions") : NULL;
-    const cJSON *dist = ext ? jgeto(ext, "Distances") : NULL;
-
-    double meters = jdouble(jgeto(dist, "DistanceFromCall"), -1.0);
-    if (meters < 0.0) meters = jdouble(jgeto(dist, "DistanceFromStop"), -1.0);
-
-    if (meters < 0.0) {
-        const cJSON *ext2 = jgeto(journey, "Extensions");
-        const cJSON *dist2 = ext2 ? jgeto(ext2, "Distances") : NULL;
-        meters = jdouble(jgeto(dist2, "DistanceFromCall"), -1.0);
-        if (meters < 0.0) meters = jdouble(jgeto(dist2, "DistanceFromStop"), -1.0);
-    }
-
+/* Distance to stop (meters) converted to miles, or <0 if unknown. */
+static double siri_miles_away(const SiriVisit *v) {
+    double meters = v->call_dist_from_call;
+    if (meters < 0.0) meters = v->call_dist_from_stop;
+    if (meters < 0.0) meters = v->journey_dist_from_call;
+    if (meters < 0.0) meters = v->journey_dist_from_stop;
     if (meters < 0.0) return -1.0;
     return meters / 1609.344;
 }
 
-/* Extract stop display name from the first delivery. */
-static void parse_stop_name(char *out, size_t outsz, const cJSON *delivery) {
-    if (!out || outsz == 0) return;
-    out[0] = '\0';
+static void siri_visit_done(SiriScan *sc) {
+    const SiriVisit *v = &sc->v;
+    if (!v->have_mvj || sc->count >= sc->max_arr) return;
+
+    char route[32] = {0};
+    normalize_route(route, sizeof(route), v->have_line ? v->line : NULL);
+    if (!route_allowed(route, sc->route_filter)) return;
+
+    const char *tiso = v->have_expected ? v->expected : v->have_aimed ? v->aimed : NULL;
+    time_t exp = parse_iso8601(tiso);
+    int mins = -1;
+    if (exp > 0) {
+        double d = difftime(exp, sc->now);
+        mins = (int)lrint(d / 60.0);
+        if (mins < 0) mins = 0;
+    }
+    int stops = siri_stops_away(v);
+
+    Arrival a;
+    memset(&a, 0, sizeof(a));
+    snprintf(a.route, sizeof(a.route), "%s", route);
+    snprintf(a.bus, sizeof(a.bus), "%s", v->have_vehicle ? v->vehicle : "--");
+    snprintf(a.dest, sizeof(a.dest), "%s", v->dest[0] ? v->dest : "--");
+    a.stops_away = stops;
+    a.mins = mins;
+    a.expected = exp;
+    a.miles_away = siri_miles_away(v);
+    a.ppl_est = estimate_people(mins, stops);
+
+    sc->arr[sc->count++] = a;
+}
 
-    const cJSON *visits = jgeto(delivery, "MonitoredStopVisit");
-    const cJSON *v0 = jgeti(visits, 0);
-    if (!v0) return;
+/* Fields under MonitoredVehicleJourney (path from depth j on). Dispatches on how deep
+ * the scalar sits so each token is compared against a handful of keys, not all of them. */
+static void siri_journey_field(SiriScan *sc, const JsonTok *t, int j) {
+    SiriVisit *v = &sc->v;
+    const int d = t->depth;
+    const int first0 = t->path[d - 1].index == 0;   /* element 0 of a name array */
+    switch (d - j) {
+    case 1:
+        if (json_match(t, j, "LineRef") == d)
+            v->have_line = json_str(t, v->line, sizeof(v->line)) != NULL;
+        else if (json_match(t, j, "VehicleRef") == d)
+            v->have_vehicle = json_str(t, v->vehicle, sizeof(v->vehicle)) != NULL;
+        else if (json_match(t, j, "DestinationName") == d)
+            json_str(t, v->dest, sizeof(v->dest));
+        break;
+    case 2:
+        if (json_match(t, j, "DestinationName.#") == d) {
+            if (first0) json_str(t, v->dest, sizeof(v->dest));
+        } else if (json_match(t, j, "MonitoredCall") == j + 1) {
+            if (json_match(t, j + 1, "ExpectedArrivalTime") == d)
+                v->have_expected = json_str(t, v->expected, sizeof(v->expected)) != NULL;
+            else if (json_match(t, j + 1, "AimedArrivalTime") == d)
+                v->have_aimed = json_str(t, v->aimed, sizeof(v->aimed)) != NULL;
+            else if (v->index == 0 && sc->stop_name && json_match(t, j + 1, "StopPointName") == d)
+                json_str(t, sc->stop_name, sc->stop_name_sz);
+        }
+        break;
+    case 3:
+        if (json_match(t, j, "Extensions.Distances") == d - 1) {
+            if (json_match(t, d - 1, "StopsFromCall") == d)
+                v->journey_stops_from_call = json_int(t, -1);
+            else if (json_match(t, d - 1, "DistanceFromCall") == d)
+                v->journey_dist_from_call = json_double(t, -1.0);
+            else if (json_match(t, d - 1, "DistanceFromStop") == d)
+                v->journey_dist_from_stop = json_double(t, -1.0);
+        } else if (v->index == 0 && sc->stop_name && first0 &&
+                   json_match(t, j, "MonitoredCall.StopPointName.#") == d) {
+            json_str(t, sc->stop_name, sc->stop_name_sz);
+        }
+        break;
+    case 4:
+        if (json_match(t, j, "MonitoredCall.Extensions.Distances") == d - 1) {
+            if (json_match(t, d - 1, "StopsFromCall") == d)
+                v->call_stops_from_call = json_int(t, -1);
+            else if (json_match(t, d - 1, "StopsAway") == d)
+                v->call_stops_away = json_int(t, -1);
+            else if (json_match(t, d - 1, "DistanceFromCall") == d)
+                v->call_dist_from_call = json_double(t, -1.0);
+            else if (json_match(t, d - 1, "DistanceFromStop") == d)
+                v->call_dist_from_stop = json_double(t, -1.0);
+        }
+        break;
+    }
+}
 
-    const cJSON *mvj = jgeto(v0, "MonitoredVehicleJourney");
-    const cJSON *mc = mvj ? jgeto(mvj, "MonitoredCall") : NULL;
+/* Siri.ServiceDelivery.StopMonitoringDelivery (one object, or an array of which only the
+ * first counts) .MonitoredStopVisit[i].MonitoredVehicleJourney.* */
+static int siri_fn(const JsonTok *t, void *ctx) {
+    SiriScan *sc = (SiriScan *)ctx;
+    int d = json_match(t, 0, "Siri.ServiceDelivery.StopMonitoringDelivery");
+    if (d < 0) return 0;
+    if (d < t->depth && t->path[d].index >= 0) {
+        if (t->path[d].index != 0) return 0;
+        d++;
+    }
+    d = json_match(t, d, "MonitoredStopVisit.#");
+    if (d < 0) return 0;
+    SiriVisit *v = &sc->v;
+    if (t->depth == d) {
+        if (t->type == JSON_OBJECT) {
+            memset(v, 0, sizeof(*v));
+            v->open = 1;
+            v->index = t->path[d - 1].index;
+            v->call_stops_from_call = v->call_stops_away = v->journey_stops_from_call = -1;
+            v->call_dist_from_call = v->call_dist_from_stop = -1.0;
+            v->journey_dist_from_call = v->journey_dist_from_stop = -1.0;
+        } else if (t->type == JSON_END && v->open) {
+            siri_visit_done(sc);
+            v->open = 0;
+            if (sc->count >= sc->max_arr) return 1;     /* the rest cannot be shown */
+        }
+        return 0;
+    }
+    int j = json_match(t, d, "MonitoredVehicleJourney");
+    if (!v->open || j < 0) return 0;
+    if (j == t->depth) {
+        if (t->type == JSON_OBJECT) v->have_mvj = 1;
+        return 0;
+    }
+    if (t->type < JSON_OBJECT) siri_journey_field(sc, t, j);
+    return 0;
+}
 
-    const cJSON *spn = mc ? jgeto(mc, "StopPointName") : NULL;
-    if (jgets(spn)) {
-        snprintf(out, outsz, "%s", jgets(spn));
-        return;
+/* Parse one stop-monitoring response into arr (at most max_arr), each tagged with stop;
+ * an unchanged response reuses its last parse from c. Returns the count, or -1 if the
+ * body is not JSON. */
+static int siri_parse(ParseCache *c, const char *url, const HttpBuf *body, Arrival *arr, int max_arr,
+                      char *stop_name, size_t stop_name_sz,
+                      const char *route_filter, time_t now, const char *stop) {
+    uint64_t key = parse_key(url, stop, route_filter, max_arr, body);
+    int hit = parse_cache_get(c, key, arr, stop_name, stop_name_sz);
+    if (hit >= 0) {
+        arrivals_retime(arr, hit, now);
+        return hit;
+    }
+    SiriScan sc;
+    memset(&sc, 0, sizeof(sc));
+    sc.arr = arr;
+    sc.max_arr = max_arr;
+    sc.stop_name = stop_name && stop_name_sz ? stop_name : NULL;
+    sc.stop_name_sz = stop_name_sz;
+    sc.route_filter = route_filter;
+    sc.now = now;
+    if (json_walk(body->data, body->len, siri_fn, &sc) < 0) {
+        if (sc.stop_name) sc.stop_name[0] = '\0';
+        return -1;
     }
-    const cJSON *spn0 = jgeti(spn, 0);
-    if (jgets(spn0)) snprintf(out, outsz, "%s", jgets(spn0));
+    for (int i = 0; i < sc.count; i++)
+        snprintf(arr[i].stop, sizeof(arr[i].stop), "%s", stop);
+    parse_cache_put(c, key, arr, sc.count, sc.stop_name);
+    return sc.count;
 }
 
 int fetch_mta_arrivals(Arrival *arr, int max_arr,
@@ -216,110 +454,394 @@ int fetch_mta_arrivals(Arrival *arr, int max_arr,
     }
     if (stop_name && stop_name_sz) stop_name[0] = '\0';
 
-    if (!mta_key || !*mta_key || !stop_id || !*stop_id) {
+    char stops[STOP_IDS_MAX][32];
+    int n_stops = stop_id ? split_stops(stop_id, stops) : 0;
+    if (!mta_key || !*mta_key || n_stops == 0) {
         g_mta_last_status = MTA_STATUS_BAD_INPUT;
         return 0;
     }
 
-    char url[1024];
-    snprintf(url, sizeof(url),
-             "https://bustime.mta.info/api/siri/stop-monitoring.json?key=%s&MonitoringRef=%s&OperatorRef=MTA&MaximumStopVisits=%d",
-             mta_key, stop_id, max_arr);
-
-    char *json = http_get(url);
-    if (!json) {
+    /* One request per stop, all in flight at once. */
+    char urls[STOP_IDS_MAX][512];
+    HttpReq reqs[STOP_IDS_MAX];
+    memset(reqs, 0, sizeof(reqs));
+    for (int k = 0; k < n_stops; k++) {
+        snprintf(urls[k], sizeof(urls[k]),
+                 "%s?key=%s&MonitoringRef=%s&OperatorRef=MTA&MaximumStopVisits=%d",
+                 s_siri_url, mta_key, stops[k], max_arr);
+        reqs[k].url = urls[k];
+        reqs[k].buf = &s_siri_body[k];
+        reqs[k].max_len = HTTP_TEXT_MAX;
+    }
+    if (http_fetch_many(reqs, n_stops) == 0) {
         g_mta_last_status = MTA_STATUS_HTTP_FAIL;
         return -1;
     }
 
-    cJSON *root = cJSON_Parse(json);
-    free(json);
-    if (!root) {
-        g_mta_last_status = MTA_STATUS_JSON_FAIL;
-        return -1;
+    if (n_stops == 1) {
+        int n = siri_parse(&s_siri_cache[0], urls[0], &s_siri_body[0], arr, max_arr,
+                           stop_name, stop_name_sz, route_filter, time(NULL), "");
+        /* No deliveries is an empty feed (0 arrivals), not SCHEMA_FAIL. */
+        g_mta_last_status = n < 0 ? MTA_STATUS_JSON_FAIL : MTA_STATUS_OK;
+        return n;
     }
 
-    int count = 0;
+    /* Several stops: gather each one's arrivals, then merge. A stop that failed costs
+     * only its own arrivals this poll (status reports the failure). */
+    Arrival all[STOP_IDS_MAX * TILE_SLOTS_MAX];
+    int per_stop = max_arr < TILE_SLOTS_MAX ? max_arr : TILE_SLOTS_MAX;
+    int n_all = 0, n_parsed = 0, status = MTA_STATUS_OK;
+    time_t now = time(NULL);
+    for (int k = 0; k < n_stops; k++) {
+        if (!reqs[k].ok) {
+            status = MTA_STATUS_HTTP_FAIL;
+            continue;
+        }
+        int n = siri_parse(&s_siri_cache[k], urls[k], &s_siri_body[k], all + n_all, per_stop,
+                           k == 0 ? stop_name : NULL, stop_name_sz, route_filter, now, stops[k]);
+        if (n < 0) {
+            if (status == MTA_STATUS_OK) status = MTA_STATUS_JSON_FAIL;
+            continue;
+        }
+        n_all += n;
+        n_parsed++;
+    }
+    g_mta_last_status = status;
+    if (n_parsed == 0) return -1;
+    int n = arrivals_merge(all, n_all, max_arr);
+    memcpy(arr, all, sizeof(Arrival) * (size_t)n);
+    return n;
+}
+
+/* ---- GTFS-Realtime TripUpdates ------------------------------------------------
+ * A minimal protobuf wire reader walks FeedMessage.entity -> FeedEntity.trip_update and
+ * keeps the stop_time_updates at our stop's GTFS stop_ids; everything else is skipped by
+ * wire type. Route and destination come from the static GTFS trip. */
+
+#define RT_MAX_CANDIDATES 64    /* soonest matching updates kept before the GTFS join */
+
+typedef struct {
+    const uint8_t *p, *end;
+    int            bad;         /* truncated or malformed input */
+} PbReader;
+
+static uint64_t pb_varint(PbReader *r) {
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (r->p >= r->end) break;
+        uint8_t b = *r->p++;
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) return v;
+    }
+    r->bad = 1;
+    return 0;
+}
 
-    const cJSON *siri = jgeto(root, "Siri");
-    const cJSON *sd = siri ? jgeto(siri, "ServiceDelivery") : NULL;
-    const cJSON *smd = sd ? jgeto(sd, "StopMonitoringDelivery") : NULL;
-    /* SIRI JSON may use one object or an array of deliveries. */
-    const cJSON *del = NULL;
-    if (smd) {
-        if (cJSON_IsArray((cJSON *)smd))
-            del = jgeti(smd, 0);
-        else if (cJSON_IsObject((cJSON *)smd))
-            del = smd;
+/* Length-delimited payload of the current field as its own reader. */
+static PbReader pb_sub(PbReader *r) {
+    uint64_t n = pb_varint(r);
+    PbReader s = { r->p, r->p, r->bad };
+    if (r->bad || n > (uint64_t)(r->end - r->p)) {
+        r->bad = s.bad = 1;
+        return s;
     }
-    /* del may be NULL when there are no deliveries; empty feed is OK (0 arrivals), not SCHEMA_FAIL. */
-    if (del && stop_name && stop_name_sz)
-        parse_stop_name(stop_name, stop_name_sz, del);
+    s.end = r->p + n;
+    r->p += n;
+    return s;
+}
 
-    const cJSON *visits = del ? jgeto(del, "MonitoredStopVisit") : NULL;
-    int n = visits && cJSON_IsArray(visits) ? cJSON_GetArraySize((cJSON *)visits) : 0;
+/* Next field key. Returns 1 with *field and *wire set, or 0 at the end (or on bad input). */
+static int pb_next(PbReader *r, uint32_t *field, int *wire) {
+    if (r->bad || r->p >= r->end) return 0;
+    uint64_t key = pb_varint(r);
+    *field = (uint32_t)(key >> 3);
+    *wire = (int)(key & 7);
+    if (*field == 0) r->bad = 1;
+    return !r->bad;
+}
 
-    time_t now = time(NULL);
+static void pb_skip(PbReader *r, int wire) {
+    switch (wire) {
+        case 0: pb_varint(r); break;
+        case 1: if (r->end - r->p < 8) r->bad = 1; else r->p += 8; break;
+        case 2: pb_sub(r); break;
+        case 5: if (r->end - r->p < 4) r->bad = 1; else r->p += 4; break;
+        default: r->bad = 1; break;     /* groups are not used by GTFS-RT */
+    }
+}
+
+static void pb_str(PbReader *r, char *out, size_t outsz) {
+    PbReader s = pb_sub(r);
+    size_t n = (size_t)(s.end - s.p);
+    if (n >= outsz) n = outsz - 1;
+    memcpy(out, s.p, n);
+    out[n] = '\0';
+}
 
-    for (int i = 0; i < n && count < max_arr; i++) {
-        const cJSON *v = jgeti(visits, i);
-        const cJSON *mvj = v ? jgeto(v, "MonitoredVehicleJourney") : NULL;
-        if (!mvj) continue;
+/* One matching stop_time_update, before the GTFS join. */
+typedef struct {
+    char   trip_id[64];
+    char   route_id[32];
+    char   vehicle[32];
+    time_t when;
+    int    stops_away;
+    int    entry;               /* STOP_ID list entry it was seen at */
+} RtCandidate;
+
+typedef struct {
+    char        (*ids)[32];     /* GTFS stop_ids of our stops */
+    int          *entries;      /* STOP_ID list entry of each id */
+    int           n_ids;
+    time_t        min_when;     /* older predictions are dropped */
+    RtCandidate   c[RT_MAX_CANDIDATES];
+    int           n;
+} RtScan;
+
+/* 1 + the list entry of stop id s, or 0 if it is not one of ours. */
+static int rt_stop_match(const RtScan *sc, const uint8_t *s, size_t n) {
+    for (int i = 0; i < sc->n_ids; i++)
+        if (strlen(sc->ids[i]) == n && memcmp(sc->ids[i], s, n) == 0) return 1 + sc->entries[i];
+    return 0;
+}
 
-        char route[32] = {0};
-        normalize_route(route, sizeof(route), jgets(jgeto(mvj, "LineRef")));
-        if (!route_allowed(route, route_filter)) continue;
+/* StopTimeEvent.time (field 2), 0 if absent, or -1 if the event is malformed. */
+static time_t rt_event_time(PbReader ev) {
+    uint32_t field;
+    int wire;
+    time_t t = 0;
+    while (pb_next(&ev, &field, &wire)) {
+        if (field == 2 && wire == 0) t = (time_t)(int64_t)pb_varint(&ev);
+        else pb_skip(&ev, wire);
+    }
+    return ev.bad ? -1 : t;
+}
+
+/* Insert c into the when-sorted candidate list, keeping the soonest RT_MAX_CANDIDATES. */
+static void rt_keep(RtScan *sc, const RtCandidate *c) {
+    if (sc->n == RT_MAX_CANDIDATES && c->when >= sc->c[sc->n - 1].when) return;
+    int j = sc->n < RT_MAX_CANDIDATES ? sc->n++ : RT_MAX_CANDIDATES - 1;
+    for (; j > 0 && sc->c[j - 1].when > c->when; j--) sc->c[j] = sc->c[j - 1];
+    sc->c[j] = *c;
+}
 
-        const char *veh = jgets(jgeto(mvj, "VehicleRef"));
-        const cJSON *mc = jgeto(mvj, "MonitoredCall");
+static void rt_trip_update(RtScan *sc, PbReader tu) {
+    /* stop_time_update (2) is serialized before vehicle (3), so matches wait for the end. */
+    struct { time_t when; int64_t seq; int index, entry; } hit[4];
+    int n_hit = 0, n_stu = 0, canceled = 0;
+    int64_t first_seq = -1;
+    RtCandidate c;
+    memset(&c, 0, sizeof(c));
+    uint32_t field;
+    int wire;
+    while (pb_next(&tu, &field, &wire)) {
+        if (field == 1 && wire == 2) {              /* TripDescriptor */
+            PbReader td = pb_sub(&tu);
+            uint32_t f2;
+            int w2;
+            while (pb_next(&td, &f2, &w2)) {
+                if (f2 == 1 && w2 == 2) pb_str(&td, c.trip_id, sizeof(c.trip_id));
+                else if (f2 == 5 && w2 == 2) pb_str(&td, c.route_id, sizeof(c.route_id));
+                else if (f2 == 4 && w2 == 0) canceled = pb_varint(&td) == 3;  /* CANCELED */
+                else pb_skip(&td, w2);
+            }
+            if (td.bad) tu.bad = 1;
+        } else if (field == 2 && wire == 2) {       /* StopTimeUpdate */
+            PbReader stu = pb_sub(&tu);
+            uint32_t f2;
+            int w2;
+            int64_t seq = -1;
+            int match = 0, skipped = 0;
+            PbReader arr = { 0 }, dep = { 0 };     /* decoded only at our stop */
+            while (pb_next(&stu, &f2, &w2)) {
+                if (f2 == 1 && w2 == 0) {
+                    seq = (int64_t)pb_varint(&stu);
+                } else if (f2 == 4 && w2 == 2) {
+                    PbReader id = pb_sub(&stu);
+                    match = rt_stop_match(sc, id.p, (size_t)(id.end - id.p));
+                } else if (f2 == 2 && w2 == 2) {
+                    arr = pb_sub(&stu);
+                } else if (f2 == 3 && w2 == 2) {
+                    dep = pb_sub(&stu);
+                } else if (f2 == 5 && w2 == 0) {
+                    skipped = pb_varint(&stu) != 0;     /* SKIPPED or NO_DATA */
+                } else {
+                    pb_skip(&stu, w2);
+                }
+            }
+            if (stu.bad) tu.bad = 1;
+            if (n_stu++ == 0) first_seq = seq;
+            if (!match || skipped) continue;
+            time_t when = arr.p ? rt_event_time(arr) : 0;
+            if (when == 0 && dep.p) when = rt_event_time(dep);
+            if (when < 0) tu.bad = 1;
+            else if (when >= sc->min_when && n_hit < (int)(sizeof(hit) / sizeof(hit[0]))) {
+                hit[n_hit].when = when;
+                hit[n_hit].seq = seq;
+                hit[n_hit].index = n_stu - 1;
+                hit[n_hit].entry = match - 1;
+                n_hit++;
+            }
+        } else if (field == 3 && wire == 2) {       /* VehicleDescriptor */
+            PbReader vd = pb_sub(&tu);
+            uint32_t f2;
+            int w2;
+            char label[32] = {0};
+            while (pb_next(&vd, &f2, &w2)) {
+                if (f2 == 1 && w2 == 2) pb_str(&vd, c.vehicle, sizeof(c.vehicle));
+                else if (f2 == 2 && w2 == 2) pb_str(&vd, label, sizeof(label));
+                else pb_skip(&vd, w2);
+            }
+            if (vd.bad) tu.bad = 1;
+            if (!c.vehicle[0]) snprintf(c.vehicle, sizeof(c.vehicle), "%s", label);
+        } else {
+            pb_skip(&tu, wire);
+        }
+    }
+    if (tu.bad || canceled) return;     /* malformed anywhere inside: drop the update */
+    for (int i = 0; i < n_hit; i++) {
+        c.when = hit[i].when;
+        c.entry = hit[i].entry;
+        /* Stops between the vehicle's next stop (the first update) and ours. */
+        c.stops_away = hit[i].seq >= 0 && first_seq >= 0 && hit[i].seq >= first_seq
+                       ? (int)(hit[i].seq - first_seq) : hit[i].index;
+        rt_keep(sc, &c);
+    }
+}
 
-        char destbuf[128] = {0};
-        const cJSON *destv = jgeto(mvj, "DestinationName");
-        const char *dstr = jgets(destv);
-        if (!dstr) {
-            const cJSON *d0 = jgeti(destv, 0);
-            dstr = jgets(d0);
+/* Walk a FeedMessage. Returns 0, or -1 if the buffer is not valid protobuf. */
+static int rt_scan_feed(RtScan *sc, const uint8_t *buf, size_t len) {
+    PbReader msg = { buf, buf + len, 0 };
+    uint32_t field;
+    int wire;
+    while (pb_next(&msg, &field, &wire)) {
+        if (field != 2 || wire != 2) {              /* header and extensions */
+            pb_skip(&msg, wire);
+            continue;
         }
-        if (dstr && *dstr)
-            snprintf(destbuf, sizeof(destbuf), "%s", dstr);
-        else
-            snprintf(destbuf, sizeof(destbuf), "--");
+        PbReader ent = pb_sub(&msg);
+        uint32_t f2;
+        int w2;
+        while (pb_next(&ent, &f2, &w2)) {
+            if (f2 == 3 && w2 == 2) rt_trip_update(sc, pb_sub(&ent));
+            else pb_skip(&ent, w2);
+        }
+        if (ent.bad) msg.bad = 1;
+    }
+    return msg.bad ? -1 : 0;
+}
+
+int fetch_mta_arrivals_rt(Arrival *arr, int max_arr,
+                          char *stop_name, size_t stop_name_sz,
+                          const char *mta_key, const char *feed_url, const char *stop_id,
+                          const char *route_filter) {
+    if (!arr || max_arr <= 0) {
+        g_mta_last_status = MTA_STATUS_BAD_INPUT;
+        return 0;
+    }
+    /* GTFS-RT has no stop names; STOP_NAME or the SIRI backend provide one. */
+    if (stop_name && stop_name_sz) stop_name[0] = '\0';
+
+    if (!feed_url || !*feed_url || !stop_id || !*stop_id) {
+        g_mta_last_status = MTA_STATUS_BAD_INPUT;
+        return 0;
+    }
+
+    char url[1024];
+    if (mta_key && *mta_key && !strstr(feed_url, "key="))
+        snprintf(url, sizeof(url), "%s%ckey=%s", feed_url, strchr(feed_url, '?') ? '&' : '?', mta_key);
+    else
+        snprintf(url, sizeof(url), "%s", feed_url);
+
+    if (http_fetch(&s_rt_body, url, HTTP_BINARY_MAX, NULL) != 0) {
+        g_mta_last_status = MTA_STATUS_HTTP_FAIL;
+        return -1;
+    }
+
+    /* The feed is rebuilt every ~30 s, so polls often get the same bytes again: reuse
+     * the last scan and GTFS join, dropping what a fresh scan would now drop. */
+    time_t now = time(NULL);
+    uint64_t key = parse_key(url, stop_id, route_filter, max_arr, &s_rt_body);
+    int hit = parse_cache_get(&s_rt_cache, key, arr, NULL, 0);
+    if (hit >= 0) {
+        int count = 0;
+        for (int i = 0; i < hit; i++)
+            if (arr[i].expected >= now - 90) arr[count++] = arr[i];
+        arrivals_retime(arr, count, now);
+        g_mta_last_status = MTA_STATUS_OK;
+        return count;
+    }
+
+    /* One feed covers every stop in the list. */
+    char stops[STOP_IDS_MAX][32];
+    int n_stops = split_stops(stop_id, stops);
+    RtScan sc;
+    char ids[32][32];
+    int entries[32];
+    memset(&sc, 0, sizeof(sc));
+    sc.ids = ids;
+    sc.entries = entries;
+    sc.n_ids = gtfs_stop_ids(stop_id, ids, entries, 32);
+    if (sc.n_ids == 0) {
+        for (int k = 0; k < n_stops; k++) {
+            snprintf(ids[k], sizeof(ids[k]), "%s", stops[k]);
+            entries[k] = k;
+        }
+        sc.n_ids = n_stops;
+    }
+    sc.min_when = now - 90;
+    int rc = rt_scan_feed(&sc, (const uint8_t *)s_rt_body.data, s_rt_body.len);
+    if (rc != 0) {
+        logf_("MTA: GTFS-RT feed is not valid protobuf (%zu bytes)", s_rt_body.len);
+        g_mta_last_status = MTA_STATUS_PB_FAIL;
+        return -1;
+    }
 
-        const char *tiso = NULL;
-        if (mc) {
-            tiso = jgets(jgeto(mc, "ExpectedArrivalTime"));
-            if (!tiso) tiso = jgets(jgeto(mc, "AimedArrivalTime"));
+    int count = 0;
+    for (int i = 0; i < sc.n && count < max_arr; i++) {
+        const RtCandidate *c = &sc.c[i];
+        char route[32] = {0}, destbuf[128] = {0};
+        if (!gtfs_trip_info(stop_id, c->trip_id, route, sizeof(route), destbuf, sizeof(destbuf))) {
+            normalize_route(route, sizeof(route), c->route_id[0] ? c->route_id : NULL);
+            snprintf(destbuf, sizeof(destbuf), "--");
         }
-        time_t exp = parse_iso8601(tiso);
-        int mins = -1;
-        if (exp > 0) {
-            double d = difftime(exp, now);
-            mins = (int)lrint(d / 60.0);
-            if (mins < 0) mins = 0;
+        if (!route_allowed(route, route_filter)) continue;
+        /* Candidates are soonest first, so a vehicle serving two of our stops keeps
+         * its nearer one. */
+        if (n_stops > 1 && c->vehicle[0]) {
+            int dup = 0;
+            for (int j = 0; j < count && !dup; j++) dup = strcmp(arr[j].bus, c->vehicle) == 0;
+            if (dup) continue;
         }
 
-        int stops = parse_stops_away(mvj);
-        double miles = parse_miles_away(mvj);
+        int mins = (int)lrint(difftime(c->when, now) / 60.0);
+        if (mins < 0) mins = 0;
 
         Arrival a;
         memset(&a, 0, sizeof(a));
         snprintf(a.route, sizeof(a.route), "%s", route);
-        snprintf(a.bus, sizeof(a.bus), "%s", veh ? veh : "--");
+        snprintf(a.bus, sizeof(a.bus), "%s", c->vehicle[0] ? c->vehicle : "--");
         snprintf(a.dest, sizeof(a.dest), "%s", destbuf);
-        a.stops_away = stops;
+        a.stops_away = c->stops_away;
         a.mins = mins;
-        a.expected = exp;
-        a.miles_away = miles;
-        a.ppl_est = estimate_people(mins, stops);
+        a.expected = c->when;
+        a.miles_away = -1.0;
+        a.ppl_est = estimate_people(mins, c->stops_away);
+        if (n_stops > 1 && c->entry >= 0 && c->entry < n_stops)
+            snprintf(a.stop, sizeof(a.stop), "%s", stops[c->entry]);
 
         arr[count++] = a;
     }
 
-    cJSON_Delete(root);
+    parse_cache_put(&s_rt_cache, key, arr, count, NULL);
     g_mta_last_status = MTA_STATUS_OK;
     return count;
 }
 
+void mta_parse_cache_stats(long *hits, long *polls) {
+    if (hits) *hits = s_cache_hits;
+    if (polls) *polls = s_cache_polls;
+}
+
 int mta_last_status(void) {
     return g_mta_last_status;
 }
@@ -331,6 +853,7 @@ const char *mta_last_status_str(void) {
         case MTA_STATUS_HTTP_FAIL: return "HTTP_FAIL";
         case MTA_STATUS_JSON_FAIL: return "JSON_FAIL";
         case MTA_STATUS_SCHEMA_FAIL: return "SCHEMA_FAIL";
+        case MTA_STATUS_PB_FAIL: return "PB_FAIL";
         default: return "UNKNOWN";
     }
 }
@@ -1,6 +1,6 @@
 /*
  * MTA Bus Time API: fetch arrivals for a stop and optional stop name.
- * Uses SIRI stop-monitoring JSON.
+ * Uses SIRI stop-monitoring JSON, or GTFS-Realtime TripUpdates (MTA_FEED=gtfsrt).
  */
 #pragma once
 
@@ -8,19 +8,38 @@
 
 /*
  * Fetch up to max_arr arrivals for the given stop.
- * Fills arr[] and returns the count (>=0). On HTTP/JSON failure returns -1
- * without changing arr[] — caller may keep showing the previous snapshot.
+ * Fills arr[] and returns the count (>=0). On HTTP/JSON failure returns -1 and arr[]
+ * may hold partial results — caller keeps showing its previous snapshot.
  * If stop_name/stop_name_sz are non-null, the stop's display name from the API is written to stop_name.
  * route_filter: comma-separated route IDs to allow, or NULL for all.
+ * stop_id may list up to STOP_IDS_MAX stops ("501627,501628"): they are requested
+ * concurrently and merged soonest first, one entry per vehicle, each tagged with its stop
+ * (Arrival.stop); stop_name comes from the first. If only some stops fail the rest are
+ * returned and the status reports the failure.
  */
 int fetch_mta_arrivals(Arrival *arr, int max_arr,
                       char *stop_name, size_t stop_name_sz,
                       const char *mta_key, const char *stop_id,
                       const char *route_filter);
 
+/*
+ * Same contract as fetch_mta_arrivals(), from the GTFS-Realtime TripUpdates protobuf at
+ * feed_url (mta_key is appended as ?key=). Keeps the stop_time_updates at stop_id's GTFS
+ * stop_ids and takes route and destination from the loaded GTFS trips. stop_name is
+ * always left empty; miles_away is unknown (<0). A stop list is served from the one feed.
+ */
+int fetch_mta_arrivals_rt(Arrival *arr, int max_arr,
+                          char *stop_name, size_t stop_name_sz,
+                          const char *mta_key, const char *feed_url, const char *stop_id,
+                          const char *route_filter);
+
 /* Build comma-separated list of routes in arr[0..n-1]. Log to stderr if any are Express (QM, BM, BxM, X). */
 void mta_log_realtime_express_routes(const Arrival *arr, int n);
 
+/* Responses whose parse was reused (request and body bytes unchanged), out of all
+ * responses parsed, since start. */
+void mta_parse_cache_stats(long *hits, long *polls);
+
 /* Last fetch status for debug instrumentation. */
 int mta_last_status(void);
 const char *mta_last_status_str(void);
@@ -0,0 +1,565 @@
+/*
+ * mta.c's response decoders on fixtures from tools/mta_fixtures.py (testdata/): the
+ * GTFS-Realtime protobuf reader (pb_varint, pb_sub, rt_trip_update, rt_scan_feed) on a
+ * TripUpdates feed and on truncated and malformed input, and siri_parse() on SIRI
+ * answers in the shapes Bus Time sends (deliveries and names as arrays or plain values,
+ * \u escapes) and on every cut of them. Both must parse a poll without allocating. Then
+ * several stops: arrivals_merge(), and a poll of up to eight against
+ * tools/http_standin.py that must take as long as one. mta.c is included so its static
+ * functions can be called directly.
+ *
+ *   mta_test                          check
+ *   mta_test -b [feed.pb siri.json stop_ids]
+ *                                     bytes and parse time of a GTFS-RT poll against a SIRI
+ *                                     poll (default: the testdata fixtures)
+ */
+#include "mta.c"
+#include "test.h"
+#include <sys/stat.h>
+
+#define RT_FIXTURE   "testdata/rt_tripupdates.pb"
+#define SIRI_FIXTURE "testdata/siri_stop.json"
+#define T0 1789000000   /* feed timestamp in tools/mta_fixtures.py */
+
+#ifdef __GLIBC__
+/* Heap calls while s_count_allocs is set; glibc's allocator does the work. */
+extern void *__libc_malloc(size_t n);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *p, size_t n);
+static volatile int s_count_allocs;   /* volatile: the compiler assumes malloc() leaves globals alone */
+static volatile long s_allocs;
+void *malloc(size_t n) { s_allocs += s_count_allocs; return __libc_malloc(n); }
+void *calloc(size_t n, size_t size) { s_allocs += s_count_allocs; return __libc_calloc(n, size); }
+void *realloc(void *p, size_t n) { s_allocs += s_count_allocs; return __libc_realloc(p, n); }
+#endif
+
+/* ---- GTFS-Realtime ------------------------------------------------------------- */
+
+static char s_ids[32][32];
+static int s_entries[32];
+
+/* An RtScan for the STOP_ID list "a,b" (each its own GTFS stop_id), keeping updates from min_when. */
+static void rt_scan_init(RtScan *sc, const char *stop_ids, time_t min_when) {
+    memset(sc, 0, sizeof(*sc));
+    sc->ids = s_ids;
+    sc->entries = s_entries;
+    sc->n_ids = split_stops(stop_ids, s_ids);
+    for (int i = 0; i < sc->n_ids; i++) s_entries[i] = i;
+    sc->min_when = min_when;
+}
+
+static PbReader reader(const void *buf, size_t len) {
+    PbReader r = { (const uint8_t *)buf, (const uint8_t *)buf + len, 0 };
+    return r;
+}
+
+static void check_varint(void) {
+    static const uint8_t v150[] = { 0x96, 0x01 };
+    PbReader r = reader(v150, sizeof(v150));
+    CHECK(pb_varint(&r) == 150 && !r.bad && r.p == r.end);
+
+    /* -30 as an int32 field: ten bytes */
+    static const uint8_t neg[] = { 0xe2, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x01 };
+    r = reader(neg, sizeof(neg));
+    CHECK((int64_t)pb_varint(&r) == -30 && !r.bad && r.p == r.end);
+
+    /* truncated: the last byte still has its continuation bit */
+    static const uint8_t cut[] = { 0x96, 0x81 };
+    r = reader(cut, sizeof(cut));
+    pb_varint(&r);
+    CHECK(r.bad);
+    r = reader(cut, 0);
+    pb_varint(&r);
+    CHECK(r.bad);
+
+    /* eleven bytes: longer than any 64-bit value */
+    static const uint8_t overlong[] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x01 };
+    r = reader(overlong, sizeof(overlong));
+    pb_varint(&r);
+    CHECK(r.bad);
+}
+
+static void check_sub(void) {
+    static const uint8_t ok[] = { 0x03, 'a', 'b', 'c', 0x7f };
+    PbReader r = reader(ok, sizeof(ok));
+    PbReader s = pb_sub(&r);
+    CHECK(!r.bad && !s.bad && s.end - s.p == 3 && memcmp(s.p, "abc", 3) == 0 && r.p == ok + 4);
+
+    static const uint8_t empty[] = { 0x00 };
+    r = reader(empty, sizeof(empty));
+    s = pb_sub(&r);
+    CHECK(!r.bad && s.p == s.end && r.p == r.end);
+
+    /* length past the end of the buffer */
+    static const uint8_t longer[] = { 0x05, 'a', 'b' };
+    r = reader(longer, sizeof(longer));
+    s = pb_sub(&r);
+    CHECK(r.bad && s.bad && s.p == s.end);
+
+    /* truncated length varint */
+    static const uint8_t cut[] = { 0x80 };
+    r = reader(cut, sizeof(cut));
+    s = pb_sub(&r);
+    CHECK(r.bad && s.bad);
+
+    /* a bad reader stays bad */
+    r = reader(ok, sizeof(ok));
+    r.bad = 1;
+    s = pb_sub(&r);
+    CHECK(s.bad);
+}
+
+static int find_trip(const RtScan *sc, const char *suffix) {
+    size_t n = strlen(suffix);
+    for (int i = 0; i < sc->n; i++) {
+        size_t m = strlen(sc->c[i].trip_id);
+        if (m >= n && strcmp(sc->c[i].trip_id + m - n, suffix) == 0) return i;
+    }
+    return -1;
+}
+
+static void check_fixture(const uint8_t *pb, size_t len) {
+    RtScan sc;
+    rt_scan_init(&sc, "501627,501628", 0);
+    CHECK(rt_scan_feed(&sc, pb, len) == 0);
+    CHECK(sc.n == 3);
+
+    /* soonest first: the label-only vehicle, the normal trip, the one that skips 501627 */
+    int label = find_trip(&sc, "_Q65_50"), match = find_trip(&sc, "_Q27_312"), skip = find_trip(&sc, "_Q17_101");
+    CHECK(label == 0 && match == 1 && skip == 2);
+    if (label == 0 && match == 1 && skip == 2) {
+        const RtCandidate *c = &sc.c[match];
+        CHECK(strcmp(c->route_id, "Q27") == 0 && strcmp(c->vehicle, "MTA NYCT_7001") == 0);
+        CHECK(c->when == T0 + 300 && c->stops_away == 2 && c->entry == 0);
+
+        c = &sc.c[label];
+        CHECK(strcmp(c->route_id, "Q65") == 0 && strcmp(c->vehicle, "7003") == 0);
+        CHECK(c->when == T0 + 120 && c->stops_away == 1 && c->entry == 0);
+
+        c = &sc.c[skip];       /* departure time only at 501628; seq 4 -> 7 */
+        CHECK(strcmp(c->route_id, "Q17") == 0 && strcmp(c->vehicle, "MTA NYCT_7002") == 0);
+        CHECK(c->when == T0 + 600 && c->stops_away == 3 && c->entry == 1);
+    }
+    CHECK(find_trip(&sc, "_Q27_313") < 0);      /* CANCELED */
+
+    /* One stop of the list; and older predictions dropped */
+    rt_scan_init(&sc, "501627", 0);
+    CHECK(rt_scan_feed(&sc, pb, len) == 0 && sc.n == 2);
+    rt_scan_init(&sc, "501627,501628", T0 + 200);
+    CHECK(rt_scan_feed(&sc, pb, len) == 0 && sc.n == 2 && find_trip(&sc, "_Q65_50") < 0);
+    rt_scan_init(&sc, "999999", 0);
+    CHECK(rt_scan_feed(&sc, pb, len) == 0 && sc.n == 0);
+
+    /* Every cut of the feed: -1 unless it falls between two top-level fields, and never
+     * a candidate the whole feed does not have. */
+    int n_bad = 0, n_ok = 0, stray = 0;
+    for (size_t cut = 0; cut < len; cut++) {
+        rt_scan_init(&sc, "501627,501628", 0);
+        int rc = rt_scan_feed(&sc, pb, cut);
+        if (rc == 0) n_ok++;
+        else n_bad++;
+        for (int i = 0; i < sc.n; i++) {
+            const RtCandidate *c = &sc.c[i];
+            stray += !(c->when == T0 + 120 || c->when == T0 + 300 || c->when == T0 + 600);
+        }
+    }
+    CHECK(stray == 0);
+    CHECK(n_ok == 1 + 1 + 28);      /* empty, after the header, after each entity but the last */
+    CHECK(n_bad == (int)len - n_ok);
+}
+
+/* Hand-built messages around one TripUpdate at 501627 (trip "G", time 1000). */
+static void check_malformed(void) {
+    /* FeedEntity { trip_update { trip { trip_id "G" } stop_time_update { arrival { time 1000 } stop_id "501627" } } } */
+    static const uint8_t good[] = {
+        0x12, 0x18,                                         /* entity, 24 bytes */
+          0x1a, 0x16,                                       /* trip_update, 22 bytes */
+            0x0a, 0x03, 0x0a, 0x01, 'G',                    /* trip { trip_id "G" } */
+            0x12, 0x0f,                                     /* stop_time_update, 15 bytes */
+              0x12, 0x03, 0x10, 0xe8, 0x07,                 /* arrival { time 1000 } */
+              0x22, 0x06, '5', '0', '1', '6', '2', '7',     /* stop_id */
+              0x28, 0x00,                                   /* schedule_relationship SCHEDULED */
+    };
+    RtScan sc;
+    rt_scan_init(&sc, "501627", 0);
+    CHECK(rt_scan_feed(&sc, good, sizeof(good)) == 0 && sc.n == 1 && sc.c[0].when == 1000 &&
+          strcmp(sc.c[0].trip_id, "G") == 0 && strcmp(sc.c[0].vehicle, "") == 0);
+
+    /* The same update SKIPPED */
+    uint8_t b[sizeof(good)];
+    memcpy(b, good, sizeof(good));
+    b[sizeof(b) - 1] = 0x01;
+    rt_scan_init(&sc, "501627", 0);
+    CHECK(rt_scan_feed(&sc, b, sizeof(b)) == 0 && sc.n == 0);
+
+    /* Straight into rt_trip_update(): the TripUpdate bytes alone */
+    rt_scan_init(&sc, "501627", 0);
+    rt_trip_update(&sc, reader(good + 4, sizeof(good) - 4));
+    CHECK(sc.n == 1 && sc.c[0].when == 1000 && sc.c[0].stops_away == 0);
+
+    /* Group wire types (3 = start, 4 = end) are rejected at every level: the feed is
+     * invalid at the top and in an entity; a trip update holding one anywhere (here in
+     * its stop_time_update) is dropped. */
+    static const uint8_t top_group[] = { 0x13, 0x14 };             /* entity as a group */
+    rt_scan_init(&sc, "501627", 0);
+    CHECK(rt_scan_feed(&sc, top_group, sizeof(top_group)) == -1);
+    static const uint8_t end_group[] = { 0x0c };                   /* a stray group end */
+    CHECK(rt_scan_feed(&sc, end_group, sizeof(end_group)) == -1);
+    static const uint8_t ent_group[] = { 0x12, 0x02, 0x2b, 0x2c };  /* entity { field 5 group } */
+    CHECK(rt_scan_feed(&sc, ent_group, sizeof(ent_group)) == -1);
+    memcpy(b, good, sizeof(good));
+    b[sizeof(b) - 2] = 0x2b;                                      /* schedule_relationship -> group */
+    b[sizeof(b) - 1] = 0x2c;
+    rt_scan_init(&sc, "501627", 0);
+    CHECK(rt_scan_feed(&sc, b, sizeof(b)) == 0 && sc.n == 0);
+
+    /* Field number 0 and a length running past its parent */
+    static const uint8_t field0[] = { 0x02, 0x00 };
+    CHECK(rt_scan_feed(&sc, field0, sizeof(field0)) == -1);
+    memcpy(b, good, sizeof(good));
+    b[1] = 0x30;                                                  /* entity longer than the feed */
+    CHECK(rt_scan_feed(&sc, b, sizeof(b)) == -1);
+    memcpy(b, good, sizeof(good));
+    b[3] = 0x17;                                                  /* trip_update longer than its entity */
+    CHECK(rt_scan_feed(&sc, b, sizeof(b)) == -1);
+    static const uint8_t cut_len[] = { 0x12, 0x80 };              /* entity length cut off */
+    CHECK(rt_scan_feed(&sc, cut_len, sizeof(cut_len)) == -1);
+
+    /* A varint cut off at the end of its event drops the update */
+    memcpy(b, good, sizeof(good));
+    b[15] = 0x87;                                                 /* time's last byte continues */
+    rt_scan_init(&sc, "501627", 0);
+    CHECK(rt_scan_feed(&sc, b, sizeof(b)) == 0 && sc.n == 0);
+    memcpy(b, good, sizeof(good));
+    b[7] = 0x02;                                                  /* trip_id runs past its trip */
+    rt_scan_init(&sc, "501627", 0);
+    CHECK(rt_scan_feed(&sc, b, sizeof(b)) == 0 && sc.n == 0);
+
+    /* Fixed-width fields are skipped by size, and must fit */
+    static const uint8_t fixed[] = { 0x0d, 1, 2, 3, 4, 0x09, 1, 2, 3, 4, 5, 6, 7, 8 };
+    CHECK(rt_scan_feed(&sc, fixed, sizeof(fixed)) == 0);
+    CHECK(rt_scan_feed(&sc, fixed, 4) == -1);
+    CHECK(rt_scan_feed(&sc, fixed, 12) == -1);
+}
+
+/* ---- SIRI ------------------------------------------------------------------------ */
+
+/* siri_parse() of data[0..len) at T0, bypassing the parse cache. */
+static int siri_run(const char *data, size_t len, int max_arr, const char *route_filter, Arrival *arr,
+                    char *name, size_t name_sz) {
+    static ParseCache cache;
+    HttpBuf body = { (char *)data, len, len };
+    cache.key = 0;
+    return siri_parse(&cache, "", &body, arr, max_arr, name, name_sz, route_filter, T0, "");
+}
+
+static void check_arrival(const Arrival *a, const char *route, const char *bus, const char *dest,
+                          time_t when, int stops, double meters) {
+    int mins = (int)lrint((double)(when - T0) / 60.0);
+    int ok = strcmp(a->route, route) == 0 && strcmp(a->bus, bus) == 0 && strcmp(a->dest, dest) == 0 &&
+             a->expected == when && a->mins == mins && a->stops_away == stops &&
+             (meters < 0 ? a->miles_away < 0 : fabs(a->miles_away - meters / 1609.344) < 1e-9);
+    if (!ok) {
+        fprintf(stderr, "arrival %s %s \"%s\" at %ld (%d min, %d stops, %.3f mi), want %s %s \"%s\" at %ld "
+                "(%d min, %d stops, %.3f mi)\n", a->route, a->bus, a->dest, (long)a->expected, a->mins,
+                a->stops_away, a->miles_away, route, bus, dest, (long)when, mins, stops,
+                meters < 0 ? -1.0 : meters / 1609.344);
+        test_failures++;
+    }
+}
+
+static void check_siri(void) {
+    Arrival arr[TILE_SLOTS_MAX];
+    char name[256];
+    size_t len = 0;
+
+    /* StopMonitoringDelivery and DestinationName as arrays */
+    char *doc = test_read_file(SIRI_FIXTURE, &len);
+    CHECK(doc != NULL);
+    if (doc) {
+        CHECK(siri_run(doc, len, TILE_SLOTS_MAX, NULL, arr, name, sizeof(name)) == 2);
+        check_arrival(&arr[0], "Q65", "MTA NYCT_7003", "COLLEGE PT 110 ST via 164 ST", T0 + 120, 1, 410.5);
+        check_arrival(&arr[1], "Q27", "MTA NYCT_7001", "CAMBRIA HTS 120 AV via SPRINGFIELD", T0 + 300, 2, 1200.5);
+        CHECK(strcmp(name, "MAIN ST/ROOSEVELT AV") == 0);
+
+        /* max_arr stops the walk after the first visit; a route filter skips one */
+        CHECK(siri_run(doc, len, 1, NULL, arr, name, sizeof(name)) == 1 && strcmp(arr[0].route, "Q65") == 0);
+        CHECK(siri_run(doc, len, TILE_SLOTS_MAX, "Q17, q27", arr, NULL, 0) == 1 && strcmp(arr[0].route, "Q27") == 0);
+
+        /* Every cut is -1 with the stop name cleared */
+        int wrong = 0;
+        for (size_t cut = 0; cut < len; cut++) {
+            strcpy(name, "stale");
+            wrong += siri_run(doc, cut, TILE_SLOTS_MAX, NULL, arr, name, sizeof(name)) != -1 || name[0] != '\0';
+        }
+        CHECK(wrong == 0);
+
+        /* The parse cache: the same bytes again are a hit, one changed byte is not */
+        ParseCache cache;
+        memset(&cache, 0, sizeof(cache));
+        HttpBuf body = { doc, len, len };
+        long hits = s_cache_hits;
+        CHECK(siri_parse(&cache, "u", &body, arr, TILE_SLOTS_MAX, name, sizeof(name), NULL, T0, "") == 2);
+        name[0] = '\0';
+        CHECK(siri_parse(&cache, "u", &body, arr, TILE_SLOTS_MAX, name, sizeof(name), NULL, T0 + 60, "") == 2);
+        CHECK(s_cache_hits == hits + 1 && arr[0].mins == 1 && strcmp(name, "MAIN ST/ROOSEVELT AV") == 0);
+        char *at = strstr(doc, "7001");
+        if (at) at[3] = '2';
+        CHECK(siri_parse(&cache, "u", &body, arr, TILE_SLOTS_MAX, name, sizeof(name), NULL, T0, "") == 2);
+        CHECK(s_cache_hits == hits + 1 && strcmp(arr[1].bus, "MTA NYCT_7002") == 0);
+    }
+    free(doc);
+
+    /* The delivery, DestinationName and StopPointName as plain values; \u escapes */
+    doc = test_read_file("testdata/siri_object.json", &len);
+    CHECK(doc != NULL);
+    if (doc) {
+        CHECK(siri_run(doc, len, TILE_SLOTS_MAX, NULL, arr, name, sizeof(name)) == 3);
+        check_arrival(&arr[0], "Q65", "MTA NYCT_7003", "JAMAICA \xe2\x80\x93 PARSONS BL", T0 + 120, 1, 410.5);
+        check_arrival(&arr[1], "Q27", "MTA NYCT_7001", "ROCKAWAY \xf0\x9f\x8c\x8a \"BEACH\"", T0 + 300, 2, 1200.5);
+        /* AimedArrivalTime only, no distances */
+        check_arrival(&arr[2], "Q17", "MTA NYCT_7002", "CAF\xc3\x89 / FLUSHING", T0 + 540, -1, -1.0);
+        CHECK(strcmp(name, "MAIN ST/ROOSEVELT AV \xe2\x80\x93 N") == 0);
+        int wrong = 0;
+        for (size_t cut = 0; cut < len; cut++)
+            wrong += siri_run(doc, cut, TILE_SLOTS_MAX, NULL, arr, name, sizeof(name)) != -1;
+        CHECK(wrong == 0);
+    }
+    free(doc);
+
+    /* Only the first of several deliveries counts */
+    doc = test_read_file("testdata/siri_multi.json", &len);
+    CHECK(doc != NULL);
+    if (doc) {
+        CHECK(siri_run(doc, len, TILE_SLOTS_MAX, NULL, arr, name, sizeof(name)) == 1);
+        check_arrival(&arr[0], "Q44", "MTA NYCT_7010", "BRONX ZOO", T0 + 400, 3, 1800.5);
+    }
+    free(doc);
+
+    /* Not SIRI, or no visits: no arrivals, not an error */
+    static const char *empty[] = {
+        "{}", "[]", "{\"Siri\":{\"ServiceDelivery\":{\"StopMonitoringDelivery\":[]}}}",
+        "{\"Siri\":{\"ServiceDelivery\":{\"StopMonitoringDelivery\":[{\"MonitoredStopVisit\":[{}]}]}}}",
+    };
+    for (size_t i = 0; i < sizeof(empty) / sizeof(empty[0]); i++)
+        CHECK(siri_run(empty[i], strlen(empty[i]), TILE_SLOTS_MAX, NULL, arr, name, sizeof(name)) == 0);
+    CHECK(siri_run("<html>", 6, TILE_SLOTS_MAX, NULL, arr, name, sizeof(name)) == -1);
+}
+
+/* ---- several stops ------------------------------------------------------------ */
+
+static void arrival(Arrival *a, const char *bus, time_t expected, const char *stop) {
+    memset(a, 0, sizeof(*a));
+    snprintf(a->bus, sizeof(a->bus), "%s", bus);
+    snprintf(a->stop, sizeof(a->stop), "%s", stop);
+    a->expected = expected;
+}
+
+/* arr[0..n) as "bus@stop ..." against want. */
+static void check_order(const Arrival *arr, int n, const char *want) {
+    char got[256] = "";
+    size_t o = 0;
+    for (int i = 0; i < n && o < sizeof(got); i++)
+        o += (size_t)snprintf(got + o, sizeof(got) - o, "%s%s@%s", i ? " " : "", arr[i].bus, arr[i].stop);
+    if (strcmp(got, want) != 0) {
+        fprintf(stderr, "merged \"%s\", want \"%s\"\n", got, want);
+        test_failures++;
+    }
+}
+
+static void check_merge(void) {
+    static const struct { const char *bus; time_t expected; const char *stop; } in[] = {
+        { "1", T0 + 500, "A" },     /* also at B sooner: dropped */
+        { "--", 0, "A" },           /* unknown vehicle and time: kept, last */
+        { "2", T0 + 300, "A" },
+        { "1", T0 + 200, "B" },
+        { "--", 0, "B" },           /* "--" is never a duplicate */
+        { "3", 0, "A" },            /* time unknown here, known at B: dropped */
+        { "4", T0 + 300, "B" },     /* ties keep their order */
+        { "3", T0 + 900, "B" },
+    };
+    const int n_in = (int)(sizeof(in) / sizeof(in[0]));
+    Arrival arr[8];
+    for (int max_arr = 8; max_arr >= 0; max_arr--) {
+        for (int i = 0; i < n_in; i++) arrival(&arr[i], in[i].bus, in[i].expected, in[i].stop);
+        int n = arrivals_merge(arr, n_in, max_arr);
+        CHECK(n == (max_arr < 6 ? max_arr : 6));
+        if (max_arr == 6) check_order(arr, n, "1@B 2@A 4@B 3@B --@A --@B");
+        if (max_arr == 3) check_order(arr, n, "1@B 2@A 4@B");
+    }
+    arrival(&arr[0], "9", T0, "A");
+    CHECK(arrivals_merge(arr, 1, 4) == 1 && arrivals_merge(arr, 0, 4) == 0);
+}
+
+/* fetch_mta_arrivals() for 1, 2, 4 and 8 stops against tools/http_standin.py answering
+ * every request LOAD_DELAY_MS late. The stops are requested at once, so a poll takes about
+ * one delay however many there are; one after another, eight would take eight. */
+#define LOAD_DELAY_MS 200
+#define LOAD_POLLS    3
+
+static void check_load(void) {
+    static const char *lists[] = {
+        "501627", "501627,501628", "501627,501628,501629,501630",
+        "501627,501628,501629,501630,501631,501632,501633,501634",
+    };
+    static const int n_stops[] = { 1, 2, 4, 8 };
+    char dir[512], root[600], path[700], url[256], mode[32], codes[2048];
+    size_t len = 0;
+    char *doc = test_read_file(SIRI_FIXTURE, &len);
+    CHECK(doc != NULL);
+    if (!doc || test_mkdtemp(dir, sizeof(dir), "mta") != 0) {
+        free(doc);
+        return;
+    }
+    snprintf(root, sizeof(root), "%s/srv", dir);
+    mkdir(root, 0755);
+    snprintf(path, sizeof(path), "%s/stop-monitoring.json", root);
+    test_write_file(path, doc, len);
+    free(doc);
+    Standin srv;
+    if (standin_start(&srv, root) != 0) {
+        test_failures++;
+        test_rmtree(dir);
+        return;
+    }
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/stop-monitoring.json", srv.port);
+    const char *saved_url = s_siri_url;
+    s_siri_url = url;
+    snprintf(mode, sizeof(mode), "delay=%d", LOAD_DELAY_MS);
+    standin_mode(&srv, mode);
+    http_init();
+
+    double worst[4];
+    for (int k = 0; k < 4; k++) {
+        worst[k] = 0;
+        for (int poll = 0; poll < LOAD_POLLS; poll++) {
+            Arrival arr[TILE_SLOTS_MAX];
+            char name[64] = "";
+            double t0 = test_now_ms();
+            int n = fetch_mta_arrivals(arr, TILE_SLOTS_MAX, name, sizeof(name), "KEY", lists[k], NULL);
+            double ms = test_now_ms() - t0;
+            if (ms > worst[k]) worst[k] = ms;
+            /* every stop answers with the same two buses: merged, they are two, at the first stop */
+            CHECK(n == 2 && mta_last_status() == MTA_STATUS_OK && strcmp(name, "MAIN ST/ROOSEVELT AV") == 0);
+            CHECK(n == 2 && strcmp(arr[0].bus, "MTA NYCT_7003") == 0 && strcmp(arr[1].bus, "MTA NYCT_7001") == 0 &&
+                  strcmp(arr[0].stop, k ? "501627" : "") == 0 && strcmp(arr[1].stop, arr[0].stop) == 0);
+        }
+        standin_codes(&srv, codes, sizeof(codes));
+        int requests = 0;
+        for (const char *p = codes; (p = strstr(p, "200 -")) != NULL; p += 5) requests++;
+        CHECK(requests == LOAD_POLLS * n_stops[k]);
+        CHECK(worst[k] >= LOAD_DELAY_MS && worst[k] < LOAD_DELAY_MS * 1.75);
+    }
+    printf("mta_test: slowest of %d polls, every answer %d ms late: 1 stop %.0f ms, 2 stops %.0f ms, "
+           "4 stops %.0f ms, 8 stops %.0f ms\n", LOAD_POLLS, LOAD_DELAY_MS, worst[0], worst[1], worst[2], worst[3]);
+
+    http_cleanup();
+    s_siri_url = saved_url;
+    standin_stop(&srv);
+    test_rmtree(dir);
+}
+
+/* ---- benchmark ------------------------------------------------------------------ */
+
+static double best_us(int reps, int (*fn)(void *), void *ctx, int *out) {
+    double best = 1e30;
+    for (int rep = 0; rep < reps; rep++) {
+        double t0 = test_now_ms();
+        *out = fn(ctx);
+        double us = (test_now_ms() - t0) * 1000.0;
+        if (us < best) best = us;
+    }
+    return best;
+}
+
+typedef struct { const char *data; size_t len; const char *stop_ids; } BenchIn;
+
+static int bench_rt(void *ctx) {
+    const BenchIn *in = (const BenchIn *)ctx;
+    RtScan sc;
+    rt_scan_init(&sc, in->stop_ids, 0);
+    return rt_scan_feed(&sc, (const uint8_t *)in->data, in->len) == 0 ? sc.n : -1;
+}
+
+static int bench_siri(void *ctx) {
+    const BenchIn *in = (const BenchIn *)ctx;
+    static ParseCache cache;
+    static Arrival arr[TILE_SLOTS_MAX];
+    char name[256];
+    HttpBuf body = { (char *)in->data, in->len, in->len };
+    cache.key = 0;                  /* parse every time */
+    return siri_parse(&cache, "", &body, arr, TILE_SLOTS_MAX, name, sizeof(name), NULL, T0, "");
+}
+
+static void bench(const char *rt_path, const char *siri_path, const char *stop_ids) {
+    BenchIn rt = { NULL, 0, stop_ids }, siri = { NULL, 0, stop_ids };
+    rt.data = test_read_file(rt_path, &rt.len);
+    siri.data = test_read_file(siri_path, &siri.len);
+    if (!rt.data || !siri.data) {
+        fprintf(stderr, "mta_test: cannot read %s or %s\n", rt_path, siri_path);
+        test_failures++;
+    } else {
+        int n_rt = 0, n_siri = 0;
+        double us_rt = best_us(200, bench_rt, &rt, &n_rt);
+        double us_siri = best_us(200, bench_siri, &siri, &n_siri);
+        printf("mta bench: one poll for stop(s) %s\n", stop_ids);
+        printf("  %-10s %9zu bytes %9.1f us  %3d arrivals  %s\n", "GTFS-RT", rt.len, us_rt, n_rt, rt_path);
+        printf("  %-10s %9zu bytes %9.1f us  %3d arrivals  %s\n", "SIRI", siri.len, us_siri, n_siri, siri_path);
+        printf("  GTFS-RT/SIRI: %.2fx bytes, %.2fx parse time (one SIRI request per stop)\n",
+               (double)rt.len / (double)siri.len, us_rt / us_siri);
+    }
+    free((char *)rt.data);
+    free((char *)siri.data);
+}
+
+/* Parse time per poll on the fixtures, and no heap use while parsing. */
+static void check_polls(void) {
+    BenchIn rt = { NULL, 0, "501627,501628" }, siri = { NULL, 0, "501627" };
+    rt.data = test_read_file(RT_FIXTURE, &rt.len);
+    siri.data = test_read_file(SIRI_FIXTURE, &siri.len);
+    if (rt.data && siri.data) {
+        int n_rt = 0, n_siri = 0;
+#ifdef __GLIBC__
+        s_allocs = 0;
+        s_count_allocs = 1;
+        void *volatile probe = malloc(16);
+        free(probe);
+        CHECK(s_allocs == 1);           /* the counter sees this binary's heap calls */
+        s_allocs = 0;
+#endif
+        double us_rt = best_us(50, bench_rt, &rt, &n_rt);
+        double us_siri = best_us(50, bench_siri, &siri, &n_siri);
+#ifdef __GLIBC__
+        s_count_allocs = 0;
+        CHECK(s_allocs == 0);
+        printf("mta_test: per poll rt_scan_feed %.1f us, siri_parse %.1f us; %ld allocations in 100 polls\n",
+               us_rt, us_siri, s_allocs);
+#else
+        printf("mta_test: per poll rt_scan_feed %.1f us, siri_parse %.1f us\n", us_rt, us_siri);
+#endif
+        CHECK(n_rt == 3 && n_siri == 2);
+    }
+    free((char *)rt.data);
+    free((char *)siri.data);
+}
+
+int main(int argc, char **argv) {
+    if (argc >= 2 && strcmp(argv[1], "-b") == 0) {
+        if (argc >= 5) bench(argv[2], argv[3], argv[4]);
+        else bench(RT_FIXTURE, SIRI_FIXTURE, "501627");
+        return test_failures ? 1 : 0;
+    }
+    check_varint();
+    check_sub();
+    size_t len = 0;
+    char *pb = test_read_file(RT_FIXTURE, &len);
+    CHECK(pb != NULL);
+    if (pb) check_fixture((const uint8_t *)pb, len);
+    free(pb);
+    check_malformed();
+    check_siri();
+    check_polls();
+    check_merge();
+    check_load();
+    return test_done("mta_test");
+}
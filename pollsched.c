@@ -0,0 +1,82 @@
+/*
+ * Adaptive poll interval. One PollSched per fetch thread; not shared.
+ */
+#include "pollsched.h"
+#include "util.h"
+#include <string.h>
+
+#define POLL_IMMINENT_MINS    2         /* a bus this close (or <= 1 stop away) polls at min */
+#define POLL_SERVICE_LEAD_S   (15 * 60) /* no departure within this: outside service hours */
+#define POLL_EMPTY_MAX_FACTOR 6         /* empty-board back-off stops at base * this */
+
+void poll_sched_init(PollSched *ps, int min_s, int base_s, int max_s) {
+    memset(ps, 0, sizeof(*ps));
+    if (min_s < 1) min_s = 1;
+    if (max_s < min_s) max_s = min_s;
+    ps->min_s = min_s;
+    ps->max_s = max_s;
+    ps->base_s = clampi(base_s, min_s, max_s);
+    ps->seconds = ps->base_s;
+    ps->reason = POLL_REASON_BASE;
+}
+
+static int any_imminent(const Arrival *arr, int n) {
+    for (int i = 0; i < n; i++) {
+        if (arr[i].mins >= 0 && arr[i].mins <= POLL_IMMINENT_MINS) return 1;
+        if (arr[i].stops_away >= 0 && arr[i].stops_away <= 1) return 1;
+    }
+    return 0;
+}
+
+int poll_sched_next(PollSched *ps, const Arrival *arr, int n,
+                    int service, time_t next_service, time_t now) {
+    long until = service == 1 ? (long)difftime(next_service, now) : -1;
+    PollReason reason;
+    int s;
+    if (n < 0) {
+        reason = POLL_REASON_FAILING;
+        s = ps->base_s;
+    } else if (n > 0) {
+        ps->empty_streak = 0;
+        reason = any_imminent(arr, n) ? POLL_REASON_IMMINENT : POLL_REASON_BASE;
+        s = reason == POLL_REASON_IMMINENT ? ps->min_s : ps->base_s;
+    } else if (service == 0 || until > POLL_SERVICE_LEAD_S) {
+        /* Nothing due for a while: sleep until shortly before the next departure. */
+        reason = POLL_REASON_NO_SERVICE;
+        s = service == 0 ? ps->max_s : clampi((int)(until - POLL_SERVICE_LEAD_S), ps->base_s, ps->max_s);
+    } else {
+        /* Empty during service: double per empty poll, but be up for the next departure. */
+        reason = POLL_REASON_EMPTY;
+        if (ps->empty_streak < 8) ps->empty_streak++;
+        long cap = (long)ps->base_s * POLL_EMPTY_MAX_FACTOR;
+        long b = (long)ps->base_s << (ps->empty_streak - 1);
+        if (b > cap) b = cap;
+        if (until >= 0 && b > until) b = until;
+        s = clampi((int)b, ps->base_s, ps->max_s);
+    }
+    if (s != ps->seconds || reason != ps->reason)
+        logf_("POLL_NEXT seconds=%d reason=%s arrivals=%d", s, poll_reason_str(reason), n);
+    ps->seconds = s;
+    ps->reason = reason;
+    ps->polls[reason]++;
+    return s;
+}
+
+const char *poll_reason_str(PollReason r) {
+    switch (r) {
+        case POLL_REASON_BASE: return "BASE";
+        case POLL_REASON_IMMINENT: return "IMMINENT";
+        case POLL_REASON_EMPTY: return "EMPTY";
+        case POLL_REASON_NO_SERVICE: return "NO_SERVICE";
+        case POLL_REASON_FAILING: return "FAILING";
+        default: return "UNKNOWN";
+    }
+}
+
+void poll_sched_log_stats(PollSched *ps) {
+    logf_("POLL_STATS seconds=%d reason=%s polls base=%ld imminent=%ld empty=%ld no_service=%ld failing=%ld",
+          ps->seconds, poll_reason_str(ps->reason), ps->polls[POLL_REASON_BASE],
+          ps->polls[POLL_REASON_IMMINENT], ps->polls[POLL_REASON_EMPTY],
+          ps->polls[POLL_REASON_NO_SERVICE], ps->polls[POLL_REASON_FAILING]);
+    memset(ps->polls, 0, sizeof(ps->polls));
+}
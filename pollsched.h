@@ -0,0 +1,38 @@
+/*
+ * Adaptive MTA poll interval: picked after each poll from what is on the board and the
+ * stop's GTFS service hours, within POLL_MIN_SECONDS .. POLL_MAX_SECONDS.
+ */
+#pragma once
+
+#include "types.h"
+
+typedef enum {
+    POLL_REASON_BASE = 0,       /* buses on the board, none close: POLL_SECONDS */
+    POLL_REASON_IMMINENT,       /* a bus is <= 2 min or <= 1 stop away: POLL_MIN_SECONDS */
+    POLL_REASON_EMPTY,          /* empty board in service hours: backing off */
+    POLL_REASON_NO_SERVICE,     /* nothing scheduled soon: wake shortly before service */
+    POLL_REASON_FAILING,        /* fetch failed: POLL_SECONDS, so recovery shows quickly */
+    POLL_REASON_COUNT
+} PollReason;
+
+typedef struct {
+    int        min_s, base_s, max_s;
+    int        empty_streak;            /* consecutive empty polls */
+    int        seconds;                 /* last interval chosen */
+    PollReason reason;
+    long       polls[POLL_REASON_COUNT];    /* since the last poll_sched_log_stats() */
+} PollSched;
+
+/* Bounds in seconds; base is clamped into [min, max]. */
+void poll_sched_init(PollSched *ps, int min_s, int base_s, int max_s);
+
+/* Seconds until the next poll after one that returned n arrivals (n < 0: fetch failed).
+ * service is gtfs_next_service()'s result for the stop and next_service its time. Logs
+ * POLL_NEXT when the interval or reason changes. */
+int poll_sched_next(PollSched *ps, const Arrival *arr, int n,
+                    int service, time_t next_service, time_t now);
+
+const char *poll_reason_str(PollReason r);
+
+/* Log the current interval and polls per reason since the last call. */
+void poll_sched_log_stats(PollSched *ps);
@@ -0,0 +1,125 @@
+/*
+ * Thread pool: one mutex, a growable FIFO of jobs, workers plus the waiting caller.
+ */
+#include "pool.h"
+#include <pthread.h>
+#include <stdlib.h>
+
+typedef struct {
+    void (*fn)(void *arg);
+    void  *arg;
+} PoolJob;
+
+struct Pool {
+    pthread_mutex_t lock;
+    pthread_cond_t  work;       /* job queued, or quit */
+    pthread_cond_t  idle;       /* queue empty and nothing running */
+    PoolJob        *q;
+    int             q_head, q_len, q_cap;
+    int             running;    /* jobs taken off the queue but not finished */
+    int             quit;
+    int             n_workers;
+    pthread_t      *workers;
+};
+
+/* Pop the oldest job; lock held, queue non-empty. */
+static PoolJob pool_take(Pool *p) {
+    PoolJob j = p->q[p->q_head];
+    p->q_head = (p->q_head + 1) % p->q_cap;
+    p->q_len--;
+    p->running++;
+    return j;
+}
+
+/* Run j with the lock dropped, then retake it and report completion. */
+static void pool_run_job(Pool *p, PoolJob j) {
+    pthread_mutex_unlock(&p->lock);
+    j.fn(j.arg);
+    pthread_mutex_lock(&p->lock);
+    p->running--;
+    if (p->q_len == 0 && p->running == 0)
+        pthread_cond_broadcast(&p->idle);
+}
+
+static void *pool_worker(void *arg) {
+    Pool *p = (Pool *)arg;
+    pthread_mutex_lock(&p->lock);
+    for (;;) {
+        while (!p->quit && p->q_len == 0)
+            pthread_cond_wait(&p->work, &p->lock);
+        if (p->q_len == 0) break;   /* quit with nothing left */
+        pool_run_job(p, pool_take(p));
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+Pool *pool_create(int n_workers) {
+    Pool *p = (Pool *)calloc(1, sizeof(Pool));
+    if (!p) return NULL;
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->work, NULL);
+    pthread_cond_init(&p->idle, NULL);
+    if (n_workers > 0) {
+        p->workers = (pthread_t *)calloc((size_t)n_workers, sizeof(pthread_t));
+        /* A worker that fails to start just leaves more for the caller in pool_wait(). */
+        for (int i = 0; p->workers && i < n_workers; i++) {
+            if (pthread_create(&p->workers[i], NULL, pool_worker, p) != 0) break;
+            p->n_workers++;
+        }
+    }
+    return p;
+}
+
+void pool_submit(Pool *p, void (*fn)(void *arg), void *arg) {
+    pthread_mutex_lock(&p->lock);
+    if (p->q_len == p->q_cap) {
+        int cap = p->q_cap ? p->q_cap * 2 : 16;
+        PoolJob *nq = (PoolJob *)malloc((size_t)cap * sizeof(PoolJob));
+        if (!nq) {
+            pthread_mutex_unlock(&p->lock);
+            fn(arg);
+            return;
+        }
+        for (int i = 0; i < p->q_len; i++)
+            nq[i] = p->q[(p->q_head + i) % p->q_cap];
+        free(p->q);
+        p->q = nq;
+        p->q_cap = cap;
+        p->q_head = 0;
+    }
+    p->q[(p->q_head + p->q_len) % p->q_cap] = (PoolJob){ fn, arg };
+    p->q_len++;
+    pthread_cond_signal(&p->work);
+    pthread_mutex_unlock(&p->lock);
+}
+
+void pool_wait(Pool *p) {
+    pthread_mutex_lock(&p->lock);
+    for (;;) {
+        if (p->q_len > 0)
+            pool_run_job(p, pool_take(p));
+        else if (p->running > 0)
+            pthread_cond_wait(&p->idle, &p->lock);
+        else
+            break;
+    }
+    pthread_mutex_unlock(&p->lock);
+}
+
+void pool_destroy(Pool *p) {
+    if (!p) return;
+    pool_wait(p);
+    pthread_mutex_lock(&p->lock);
+    p->quit = 1;
+    pthread_cond_broadcast(&p->work);
+    pthread_mutex_unlock(&p->lock);
+    for (int i = 0; i < p->n_workers; i++)
+        pthread_join(p->workers[i], NULL);
+    free(p->workers);
+    free(p->q);
+    pthread_cond_destroy(&p->work);
+    pthread_cond_destroy(&p->idle);
+    pthread_mutex_destroy(&p->lock);
+    free(p);
+}
@@ -0,0 +1,20 @@
+/*
+ * Small thread pool for load-time work (parallel GTFS member parsing).
+ * Jobs run in any order on any thread; pool_wait() is the only ordering point.
+ */
+#pragma once
+
+typedef struct Pool Pool;
+
+/* Start n_workers threads. With 0 workers (single-core boards) jobs queue up and run
+ * on the caller in pool_wait(). Returns NULL if out of memory. */
+Pool *pool_create(int n_workers);
+
+/* Queue fn(arg). If the queue cannot grow, fn runs right here. */
+void pool_submit(Pool *p, void (*fn)(void *arg), void *arg);
+
+/* Run queued jobs on the caller too, and return once every submitted job has finished. */
+void pool_wait(Pool *p);
+
+/* Finish outstanding jobs, stop the workers and free the pool. NULL is ignored. */
+void pool_destroy(Pool *p);
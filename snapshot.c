@@ -0,0 +1,225 @@
+/*
+ * Compiled GTFS snapshot: file format, atomic writer, mmap reader, string table.
+ */
+#include "snapshot.h"
+#include "util.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "GTFS snapshot columns are written in host order; little-endian hosts only"
+#endif
+
+#define SNAP_ALIGN 8
+
+static uint32_t fnv1a(const char *s) {
+    uint32_t h = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)s; *p; p++) {
+        h ^= *p;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+int snapshot_open(Snapshot *s, const char *path, uint64_t zip_hash) {
+    if (!s || !path) return -1;
+    memset(s, 0, sizeof(*s));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SnapHeader)) {
+        close(fd);
+        return -1;
+    }
+    void *m = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED) return -1;
+    s->map = (const unsigned char *)m;
+    s->size = (size_t)st.st_size;
+    s->hdr = (const SnapHeader *)m;
+
+    const SnapHeader *h = s->hdr;
+    int ok = memcmp(h->magic, SNAP_MAGIC, sizeof(h->magic)) == 0 &&
+             h->version == SNAP_VERSION &&
+             h->header_size == sizeof(SnapHeader) &&
+             h->zip_hash == zip_hash;
+    for (int i = 0; ok && i < SNAP_COL_COUNT; i++)
+        if (h->off[i] > s->size || h->size[i] > s->size - h->off[i]) ok = 0;
+    if (ok) {
+        /* Column sizes must match the counts the reader will index with. */
+        const uint64_t nr = h->n_routes, ns = h->n_stops, nt = h->n_trips;
+        const uint64_t nc = h->n_calendars, nd = h->n_cal_dates, nst = h->n_stop_times;
+        const uint64_t expect[SNAP_COL_COUNT] = {
+            [SNAP_ROUTE_ID] = nr * 4, [SNAP_ROUTE_SHORT] = nr * 4,
+            [SNAP_STOP_ID] = ns * 4, [SNAP_STOP_CODE] = ns * 4, [SNAP_STOP_ST_BEGIN] = (ns + 1) * 4,
+            [SNAP_TRIP_ID] = nt * 4, [SNAP_TRIP_ROUTE] = nt * 4,
+            [SNAP_TRIP_SERVICE] = nt * 4, [SNAP_TRIP_HEADSIGN] = nt * 4,
+            [SNAP_CAL_SERVICE] = nc * 4, [SNAP_CAL_START] = nc * 4, [SNAP_CAL_END] = nc * 4,
+            [SNAP_CAL_DOW] = nc,
+            [SNAP_CD_SERVICE] = nd * 4, [SNAP_CD_DATE] = nd * 4, [SNAP_CD_TYPE] = nd,
+            [SNAP_ST_TRIP] = nst * 4, [SNAP_ST_MINS_DELTA] = nst * 2,
+            [SNAP_STRINGS] = h->strings_size,
+        };
+        for (int i = 0; ok && i < SNAP_COL_COUNT; i++)
+            if (h->size[i] != expect[i]) ok = 0;
+        if (ok && (h->strings_size == 0 || s->map[h->off[SNAP_STRINGS] + h->strings_size - 1] != '\0'))
+            ok = 0;
+    }
+    if (!ok) {
+        snapshot_close(s);
+        return -1;
+    }
+    return 0;
+}
+
+void snapshot_close(Snapshot *s) {
+    if (!s) return;
+    if (s->map) munmap((void *)s->map, s->size);
+    memset(s, 0, sizeof(*s));
+}
+
+const void *snapshot_col(const Snapshot *s, int col) {
+    if (!s || !s->hdr || col < 0 || col >= SNAP_COL_COUNT) return NULL;
+    return s->map + s->hdr->off[col];
+}
+
+const char *snapshot_str(const Snapshot *s, uint32_t off) {
+    if (!s || !s->hdr || off >= s->hdr->strings_size) return "";
+    return (const char *)s->map + s->hdr->off[SNAP_STRINGS] + off;
+}
+
+static int write_all(FILE *f, const void *p, size_t n) {
+    return n == 0 || fwrite(p, 1, n, f) == n;
+}
+
+int snapshot_write(const char *path, const SnapHeader *hdr,
+                   const void *const cols[SNAP_COL_COUNT], const size_t sizes[SNAP_COL_COUNT]) {
+    if (!path || !hdr) return -1;
+    SnapHeader h = *hdr;
+    memcpy(h.magic, SNAP_MAGIC, sizeof(h.magic));
+    h.version = SNAP_VERSION;
+    h.header_size = sizeof(SnapHeader);
+    uint64_t pos = sizeof(SnapHeader);
+    for (int i = 0; i < SNAP_COL_COUNT; i++) {
+        pos = (pos + SNAP_ALIGN - 1) & ~(uint64_t)(SNAP_ALIGN - 1);
+        h.off[i] = pos;
+        h.size[i] = sizes[i];
+        pos += sizes[i];
+    }
+
+    char tmp[600];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "wb");
+    if (!f) {
+        logf_("GTFS: cannot write snapshot %s", tmp);
+        return -1;
+    }
+    static const unsigned char pad[SNAP_ALIGN] = { 0 };
+    int ok = write_all(f, &h, sizeof(h));
+    uint64_t at = sizeof(h);
+    for (int i = 0; ok && i < SNAP_COL_COUNT; i++) {
+        ok = write_all(f, pad, (size_t)(h.off[i] - at)) && write_all(f, cols[i], sizes[i]);
+        at = h.off[i] + sizes[i];
+    }
+    if (fflush(f) != 0 || fsync(fileno(f)) != 0) ok = 0;
+    if (fclose(f) != 0) ok = 0;
+    if (!ok || rename(tmp, path) != 0) {
+        logf_("GTFS: snapshot write failed: %s", path);
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+int strtab_init(StrTab *t) {
+    memset(t, 0, sizeof(*t));
+    t->cap = 64 * 1024;
+    t->buf = (char *)malloc(t->cap);
+    t->n_slots = 4096;
+    t->slot_off = (uint32_t *)calloc(t->n_slots, sizeof(uint32_t));
+    t->slot_id = (uint32_t *)calloc(t->n_slots, sizeof(uint32_t));
+    if (!t->buf || !t->slot_off || !t->slot_id) {
+        strtab_free(t);
+        return -1;
+    }
+    t->buf[0] = '\0';   /* offset 0 / id 0: empty string */
+    t->len = 1;
+    t->n_strings = 1;
+    return 0;
+}
+
+void strtab_free(StrTab *t) {
+    if (!t) return;
+    free(t->buf);
+    free(t->slot_off);
+    free(t->slot_id);
+    memset(t, 0, sizeof(*t));
+}
+
+static int strtab_grow_slots(StrTab *t) {
+    uint32_t n = t->n_slots * 2;
+    uint32_t *so = (uint32_t *)calloc(n, sizeof(uint32_t));
+    uint32_t *si = (uint32_t *)calloc(n, sizeof(uint32_t));
+    if (!so || !si) { free(so); free(si); return -1; }
+    for (uint32_t i = 0; i < t->n_slots; i++) {
+        if (!t->slot_off[i]) continue;
+        uint32_t j = fnv1a(t->buf + t->slot_off[i]) & (n - 1);
+        while (so[j]) j = (j + 1) & (n - 1);
+        so[j] = t->slot_off[i];
+        si[j] = t->slot_id[i];
+    }
+    free(t->slot_off);
+    free(t->slot_id);
+    t->slot_off = so;
+    t->slot_id = si;
+    t->n_slots = n;
+    return 0;
+}
+
+uint32_t strtab_find(const StrTab *t, const char *s) {
+    if (!s || !*s) return 0;
+    uint32_t j = fnv1a(s) & (t->n_slots - 1);
+    while (t->slot_off[j]) {
+        if (strcmp(t->buf + t->slot_off[j], s) == 0) return t->slot_id[j];
+        j = (j + 1) & (t->n_slots - 1);
+    }
+    return UINT32_MAX;
+}
+
+uint32_t strtab_add(StrTab *t, const char *s, uint32_t *out_id) {
+    if (out_id) *out_id = 0;
+    if (!s || !*s || t->n_strings + 1 >= t->n_slots) return 0;
+    uint32_t j = fnv1a(s) & (t->n_slots - 1);
+    while (t->slot_off[j]) {
+        if (strcmp(t->buf + t->slot_off[j], s) == 0) {
+            if (out_id) *out_id = t->slot_id[j];
+            return t->slot_off[j];
+        }
+        j = (j + 1) & (t->n_slots - 1);
+    }
+    size_t n = strlen(s) + 1;
+    if ((size_t)t->len + n > t->cap) {
+        size_t cap = t->cap;
+        while ((size_t)t->len + n > cap) cap *= 2;
+        if (cap > UINT32_MAX) return 0;
+        char *nb = (char *)realloc(t->buf, cap);
+        if (!nb) return 0;
+        t->buf = nb;
+        t->cap = (uint32_t)cap;
+    }
+    uint32_t off = t->len;
+    memcpy(t->buf + off, s, n);
+    t->len += (uint32_t)n;
+    t->slot_off[j] = off;
+    t->slot_id[j] = t->n_strings;
+    if (out_id) *out_id = t->n_strings;
+    t->n_strings++;
+    if (t->n_strings * 2 > t->n_slots)
+        strtab_grow_slots(t);   /* on failure the table just runs fuller */
+    return off;
+}
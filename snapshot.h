@@ -0,0 +1,95 @@
+/*
+ * Compiled GTFS snapshot: versioned, columnar, little-endian file written once per
+ * downloaded zip (keyed by the zip's content hash) and mmap'd at startup instead of
+ * re-parsing CSV. stop_times are stored as a per-stop inverted index with
+ * delta-encoded arrival minutes.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SNAP_MAGIC   "GTFSSNAP"
+#define SNAP_VERSION 1
+
+/* Column ids; each column is a packed little-endian array at header.off[col]. */
+enum {
+    SNAP_ROUTE_ID = 0,      /* u32 string offset, n_routes */
+    SNAP_ROUTE_SHORT,       /* u32 string offset, n_routes */
+    SNAP_STOP_ID,           /* u32 string offset, n_stops */
+    SNAP_STOP_CODE,         /* u32 string offset, n_stops */
+    SNAP_STOP_ST_BEGIN,     /* u32, n_stops + 1: stop i owns stop_times [begin[i], begin[i+1]) */
+    SNAP_TRIP_ID,           /* u32 string offset, n_trips */
+    SNAP_TRIP_ROUTE,        /* u32 route index, n_trips */
+    SNAP_TRIP_SERVICE,      /* u32 string offset, n_trips */
+    SNAP_TRIP_HEADSIGN,     /* u32 string offset, n_trips */
+    SNAP_CAL_SERVICE,       /* u32 string offset, n_calendars */
+    SNAP_CAL_START,         /* i32 YYYYMMDD, n_calendars */
+    SNAP_CAL_END,           /* i32 YYYYMMDD, n_calendars */
+    SNAP_CAL_DOW,           /* u8 bitmask, bit 0 = Sunday, n_calendars */
+    SNAP_CD_SERVICE,        /* u32 string offset, n_cal_dates */
+    SNAP_CD_DATE,           /* i32 YYYYMMDD, n_cal_dates */
+    SNAP_CD_TYPE,           /* u8 exception_type, n_cal_dates */
+    SNAP_ST_TRIP,           /* u32 trip index, n_stop_times (grouped by stop) */
+    SNAP_ST_MINS_DELTA,     /* u16 minutes after previous row of same stop (first row absolute) */
+    SNAP_STRINGS,           /* NUL-terminated strings; offset 0 is "" */
+    SNAP_COL_COUNT
+};
+
+typedef struct SnapHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t zip_hash;
+    uint32_t n_routes;
+    uint32_t n_stops;
+    uint32_t n_trips;
+    uint32_t n_calendars;
+    uint32_t n_cal_dates;
+    uint32_t n_stop_times;
+    uint32_t strings_size;
+    uint32_t reserved;
+    uint64_t off[SNAP_COL_COUNT];
+    uint64_t size[SNAP_COL_COUNT];
+} SnapHeader;
+
+/* Read-only mapping of a snapshot file. */
+typedef struct Snapshot {
+    const unsigned char *map;
+    size_t               size;
+    const SnapHeader    *hdr;
+} Snapshot;
+
+/* Map path and validate magic, version, bounds and zip_hash. Returns 0 on success, -1 if
+ * missing, stale or corrupt (caller recompiles). */
+int  snapshot_open(Snapshot *s, const char *path, uint64_t zip_hash);
+void snapshot_close(Snapshot *s);
+
+/* Column base pointer (cast to the type listed above), or NULL. */
+const void *snapshot_col(const Snapshot *s, int col);
+
+/* String at offset off in the string table ("" if out of range). */
+const char *snapshot_str(const Snapshot *s, uint32_t off);
+
+/* Write header + columns to path atomically (path.tmp then rename).
+ * hdr supplies counts and zip_hash; cols[i]/sizes[i] the packed column bytes. */
+int  snapshot_write(const char *path, const SnapHeader *hdr,
+                    const void *const cols[SNAP_COL_COUNT], const size_t sizes[SNAP_COL_COUNT]);
+
+/* Deduplicating string table used while compiling. Each distinct string gets a byte
+ * offset (stored in columns) and a dense id (0, 1, 2, ...) for side arrays. */
+typedef struct StrTab {
+    char     *buf;
+    uint32_t  len, cap;
+    uint32_t *slot_off;     /* open addressing: string offset, or 0 for empty */
+    uint32_t *slot_id;
+    uint32_t  n_slots;
+    uint32_t  n_strings;
+} StrTab;
+
+int      strtab_init(StrTab *t);
+void     strtab_free(StrTab *t);
+/* Intern s; returns its offset (0 for "" or on allocation failure). out_id may be NULL. */
+uint32_t strtab_add(StrTab *t, const char *s, uint32_t *out_id);
+/* Look up s without adding it. Returns its id, or UINT32_MAX if absent. */
+uint32_t strtab_find(const StrTab *t, const char *s);
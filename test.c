@@ -0,0 +1,123 @@
+/*
+ * make check helpers: verdicts, scratch files and the HTTP stand-in process.
+ */
+#include "test.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+int test_failures;
+
+int test_done(const char *name) {
+    if (test_failures) printf("%s: %d check(s) FAILED\n", name, test_failures);
+    else printf("%s: ok\n", name);
+    return test_failures ? 1 : 0;
+}
+
+int test_mkdtemp(char *out, size_t out_sz, const char *tag) {
+    const char *tmp = getenv("TMPDIR");
+    snprintf(out, out_sz, "%s/arrival_board_%s_XXXXXX", tmp && *tmp ? tmp : "/tmp", tag);
+    return mkdtemp(out) ? 0 : -1;
+}
+
+void test_rmtree(const char *dir) {
+    char cmd[1024];
+    if (!dir || !*dir || strchr(dir, '\'')) return;
+    snprintf(cmd, sizeof(cmd), "rm -rf '%s'", dir);
+    (void)system(cmd);
+}
+
+char *test_read_file(const char *path, size_t *len) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    size_t cap = 4096, n = 0;
+    char *buf = malloc(cap + 1);
+    size_t got;
+    while (buf && (got = fread(buf + n, 1, cap - n, f)) > 0) {
+        n += got;
+        if (n == cap) {
+            char *nb = realloc(buf, cap * 2 + 1);
+            if (!nb) { free(buf); buf = NULL; break; }
+            buf = nb;
+            cap *= 2;
+        }
+    }
+    fclose(f);
+    if (!buf) return NULL;
+    buf[n] = '\0';
+    if (len) *len = n;
+    return buf;
+}
+
+int test_write_file(const char *path, const void *data, size_t len) {
+    FILE *f = fopen(path, "wb");
+    if (!f) return -1;
+    int ok = fwrite(data, 1, len, f) == len;
+    return (fclose(f) == 0 && ok) ? 0 : -1;
+}
+
+double test_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1e6;
+}
+
+int standin_start(Standin *s, const char *root) {
+    memset(s, 0, sizeof(*s));
+    snprintf(s->root, sizeof(s->root), "%s", root);
+    snprintf(s->log, sizeof(s->log), "%s/.log", root);
+    char port_file[600];
+    snprintf(port_file, sizeof(port_file), "%s/.port", root);
+    unlink(port_file);
+    standin_mode(s, "");
+    s->pid = fork();
+    if (s->pid < 0) return -1;
+    if (s->pid == 0) {
+        execlp("python3", "python3", "tools/http_standin.py", "serve", s->root, port_file, s->log,
+               (char *)NULL);
+        _exit(127);
+    }
+    for (int i = 0; i < 500; i++) {         /* up to 5 s for the interpreter to start */
+        char *p = test_read_file(port_file, NULL);
+        if (p) {
+            s->port = atoi(p);
+            free(p);
+            return s->port > 0 ? 0 : -1;
+        }
+        if (waitpid(s->pid, NULL, WNOHANG) == s->pid) break;
+        usleep(10000);
+    }
+    fprintf(stderr, "standin: tools/http_standin.py did not start (python3 missing?)\n");
+    standin_stop(s);
+    return -1;
+}
+
+void standin_stop(Standin *s) {
+    if (s->pid > 0) {
+        kill(s->pid, SIGTERM);
+        waitpid(s->pid, NULL, 0);
+    }
+    s->pid = 0;
+}
+
+void standin_mode(const Standin *s, const char *mode) {
+    char path[600];
+    snprintf(path, sizeof(path), "%s/.mode", s->root);
+    test_write_file(path, mode, strlen(mode));
+}
+
+void standin_codes(Standin *s, char *out, size_t out_sz) {
+    size_t len = 0, o = 0;
+    char *log = test_read_file(s->log, &len);
+    out[0] = '\0';
+    if (!log) return;
+    for (size_t i = (size_t)s->log_seen; i < len && o + 1 < out_sz; i++)
+        out[o++] = log[i] == '\n' ? (i + 1 < len ? ' ' : '\0') : log[i];
+    out[o < out_sz ? o : out_sz - 1] = '\0';
+    s->log_seen = (long)len;
+    free(log);
+}
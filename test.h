@@ -0,0 +1,51 @@
+/*
+ * Helpers shared by the make check programs (*_test.c): CHECK() records a failure and
+ * carries on, test_done() prints the verdict. Tests that talk HTTP run
+ * tools/http_standin.py on a loopback port.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <sys/types.h>
+
+extern int test_failures;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            test_failures++; \
+        } \
+    } while (0)
+
+/* Print "<name>: ok" or the failure count; returns the exit status for main(). */
+int test_done(const char *name);
+
+/* Fresh scratch directory (under $TMPDIR or /tmp) into out; 0 on success. */
+int test_mkdtemp(char *out, size_t out_sz, const char *tag);
+void test_rmtree(const char *dir);
+
+/* Whole file as a malloc'd, NUL-terminated buffer (length in *len), or NULL. */
+char *test_read_file(const char *path, size_t *len);
+int test_write_file(const char *path, const void *data, size_t len);
+
+/* Milliseconds on the monotonic clock. */
+double test_now_ms(void);
+
+/* A running tools/http_standin.py serving files from root. */
+typedef struct Standin {
+    pid_t pid;
+    int   port;
+    char  root[512];
+    char  log[600];
+    long  log_seen;     /* log bytes already returned by standin_codes() */
+} Standin;
+
+/* Start the stand-in (run from the repository root); 0 once it is listening. */
+int standin_start(Standin *s, const char *root);
+void standin_stop(Standin *s);
+
+/* Fault words for the next requests ("truncate", "noetag", ...; "" for none). */
+void standin_mode(const Standin *s, const char *mode);
+
+/* Responses logged since the last call, space separated ("200 - 206 bytes=1000-"). */
+void standin_codes(Standin *s, char *out, size_t out_sz);
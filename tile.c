@@ -1,6 +1,7 @@
 #include "tile.h"
 #include "util.h"
 #include <math.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -42,6 +43,474 @@ static SDL_Texture* tex_from_text(SDL_Renderer *r, TTF_Font *font, const char *u
     return t;
 }
 
+/* ---- Text texture cache ----------------------------------------------------------
+ * Rendered strings keyed by (font, color, truncation width, UTF-8 text), kept as GPU
+ * textures with their sizes in LRU order under a byte budget (w * h * 4 per entry), so a
+ * steady board draws without rasterizing. Render thread only. */
+
+#define TEXT_CACHE_SLOTS    512
+#define TEXT_CACHE_BUCKETS  1024        /* power of two */
+#define TEXT_CACHE_MB       24          /* default budget; TEXT_CACHE_MB overrides */
+
+typedef struct {
+    uint64_t     hash;
+    TTF_Font    *font;
+    Uint32       rgba;
+    int          max_w;         /* draw_text_trunc width; 0 = not truncated */
+    char        *text;
+    SDL_Texture *tex;
+    int          w, h;
+    size_t       bytes;
+    int          chain;         /* next entry in the bucket, -1 = end */
+    int          prev, next;    /* LRU list (head = most recent), or free list via next */
+} TextEntry;
+
+static struct {
+    int           inited;
+    SDL_Renderer *r;            /* the textures belong to this renderer */
+    TextEntry     e[TEXT_CACHE_SLOTS];
+    int           bucket[TEXT_CACHE_BUCKETS];
+    int           head, tail, free_list;
+    size_t        bytes, budget;
+    long          hits, misses, evictions;
+} g_tc;
+
+static uint64_t text_key(TTF_Font *font, Uint32 rgba, int max_w, const char *utf8) {
+    uint64_t parts[3] = { (uint64_t)(uintptr_t)font, rgba, (uint64_t)(unsigned)max_w };
+    return hash_bytes(utf8, strlen(utf8), hash_bytes(parts, sizeof(parts), 0));
+}
+
+static void text_cache_reset(void) {
+    for (int i = 0; i < TEXT_CACHE_BUCKETS; i++) g_tc.bucket[i] = -1;
+    for (int i = 0; i < TEXT_CACHE_SLOTS; i++) g_tc.e[i].next = i + 1 < TEXT_CACHE_SLOTS ? i + 1 : -1;
+    g_tc.free_list = 0;
+    g_tc.head = g_tc.tail = -1;
+    g_tc.bytes = 0;
+}
+
+static void text_cache_init(void) {
+    if (g_tc.inited) return;
+    const char *mb = getenv("TEXT_CACHE_MB");
+    int v = mb && *mb ? atoi(mb) : TEXT_CACHE_MB;
+    g_tc.budget = (size_t)clampi(v, 1, 512) * 1024 * 1024;
+    text_cache_reset();
+    g_tc.inited = 1;
+}
+
+static void lru_unlink(int i) {
+    TextEntry *e = &g_tc.e[i];
+    if (e->prev >= 0) g_tc.e[e->prev].next = e->next; else g_tc.head = e->next;
+    if (e->next >= 0) g_tc.e[e->next].prev = e->prev; else g_tc.tail = e->prev;
+}
+
+static void lru_push_front(int i) {
+    TextEntry *e = &g_tc.e[i];
+    e->prev = -1;
+    e->next = g_tc.head;
+    if (g_tc.head >= 0) g_tc.e[g_tc.head].prev = i; else g_tc.tail = i;
+    g_tc.head = i;
+}
+
+/* Drop entry i: unlink it from its bucket and the LRU list, free it. */
+static void text_cache_drop(int i) {
+    TextEntry *e = &g_tc.e[i];
+    int *link = &g_tc.bucket[e->hash & (TEXT_CACHE_BUCKETS - 1)];
+    while (*link != i) link = &g_tc.e[*link].chain;
+    *link = e->chain;
+    lru_unlink(i);
+    SDL_DestroyTexture(e->tex);
+    free(e->text);
+    g_tc.bytes -= e->bytes;
+    memset(e, 0, sizeof(*e));
+    e->next = g_tc.free_list;
+    g_tc.free_list = i;
+}
+
+/* Longest prefix of utf8 (on a UTF-8 boundary) that fits max_w with "…" appended, or
+ * utf8 itself if it fits. */
+static void text_fit(TTF_Font *font, const char *utf8, int max_w, char *out, size_t outsz) {
+    snprintf(out, outsz, "%s", utf8);
+    int w = 0, h = 0;
+    if (TTF_SizeUTF8(font, out, &w, &h) == 0 && w <= max_w) return;
+    const char *ellipsis = "…";
+    char buf[512];
+    snprintf(buf, sizeof(buf), "%s", utf8);
+    size_t n = strlen(buf);
+    while (n > 0) {
+        unsigned char cut = (unsigned char)buf[--n];
+        buf[n] = '\0';
+        if ((cut & 0xC0) == 0x80) continue;     /* mid-character */
+        snprintf(out, outsz, "%s%s", buf, ellipsis);
+        if (TTF_SizeUTF8(font, out, &w, &h) == 0 && w <= max_w) return;
+    }
+    snprintf(out, outsz, "%s", ellipsis);
+}
+
+/* Texture for utf8 (fitted to max_w when > 0) from the cache, rendering it on a miss.
+ * *owned is set when the texture was too big to cache and the caller must destroy it. */
+static SDL_Texture *text_texture(SDL_Renderer *r, TTF_Font *font, const char *utf8, SDL_Color c,
+                                 int max_w, int *outw, int *outh, int *owned) {
+    if (!utf8) utf8 = "";
+    *owned = 0;
+    text_cache_init();
+    if (g_tc.r != r) {
+        text_cache_clear();
+        g_tc.r = r;
+    }
+    Uint32 rgba = (Uint32)c.r << 24 | (Uint32)c.g << 16 | (Uint32)c.b << 8 | c.a;
+    uint64_t h = text_key(font, rgba, max_w, utf8);
+    int *bucket = &g_tc.bucket[h & (TEXT_CACHE_BUCKETS - 1)];
+    for (int i = *bucket; i >= 0; i = g_tc.e[i].chain) {
+        TextEntry *e = &g_tc.e[i];
+        if (e->hash != h || e->font != font || e->rgba != rgba || e->max_w != max_w ||
+            strcmp(e->text, utf8) != 0) continue;
+        g_tc.hits++;
+        if (g_tc.head != i) {
+            lru_unlink(i);
+            lru_push_front(i);
+        }
+        *outw = e->w;
+        *outh = e->h;
+        return e->tex;
+    }
+
+    g_tc.misses++;
+    char fitted[520];
+    const char *shown = utf8;
+    if (max_w > 0) {
+        text_fit(font, utf8, max_w, fitted, sizeof(fitted));
+        shown = fitted;
+    }
+    int w = 0, th = 0;
+    SDL_Texture *t = tex_from_text(r, font, shown, c, &w, &th);
+    if (!t) return NULL;
+    size_t bytes = (size_t)w * (size_t)th * 4;
+    char *text = strdup(utf8);
+    if (!text || bytes > g_tc.budget / 4) {     /* one string may not crowd out the rest */
+        free(text);
+        *owned = 1;
+        *outw = w;
+        *outh = th;
+        return t;
+    }
+    while (g_tc.tail >= 0 && (g_tc.free_list < 0 || g_tc.bytes + bytes > g_tc.budget)) {
+        text_cache_drop(g_tc.tail);
+        g_tc.evictions++;
+    }
+    int i = g_tc.free_list;
+    TextEntry *e = &g_tc.e[i];
+    g_tc.free_list = e->next;
+    e->hash = h;
+    e->font = font;
+    e->rgba = rgba;
+    e->max_w = max_w;
+    e->text = text;
+    e->tex = t;
+    e->w = w;
+    e->h = th;
+    e->bytes = bytes;
+    e->chain = *bucket;
+    *bucket = i;
+    lru_push_front(i);
+    g_tc.bytes += bytes;
+    *outw = w;
+    *outh = th;
+    return t;
+}
+
+/* ---- Glyph atlas -----------------------------------------------------------------
+ * Per font, one texture holding printable ASCII and the few symbols the board uses,
+ * rendered white once with TTF_RenderGlyph32_Blended, plus their advances and pair
+ * kerning. Strings made only of those characters are laid out from the tables and drawn
+ * as textured quads tinted by vertex color, so ETAs, counts and times that change every
+ * poll never rasterize. Other strings (emoji, truncated lines) use the texture cache. */
+
+#define ATLAS_FONTS_MAX   12
+#define ATLAS_ASCII_FIRST 32
+#define ATLAS_ASCII_N     95            /* ' ' .. '~' */
+#define ATLAS_GLYPHS      (ATLAS_ASCII_N + 4)
+#define ATLAS_MAX_DIM     4096
+
+static const Uint32 atlas_extra[ATLAS_GLYPHS - ATLAS_ASCII_N] = {
+    0x2022, 0x00B0, 0x2026, 0x00A9      /* • ° … © */
+};
+
+typedef struct {
+    SDL_Rect src;       /* cell in the atlas; w == 0 for blank glyphs (space) */
+    int      xoff;      /* cell x relative to the pen (negative left bearing) */
+    int      advance;
+    int      ok;        /* provided by the font and fits the line box */
+} AtlasGlyph;
+
+typedef struct {
+    TTF_Font    *font;
+    SDL_Texture *tex;
+    int          failed;    /* atlas could not be built: always use the texture cache */
+    int          tex_w, tex_h, line_h;
+    AtlasGlyph   g[ATLAS_GLYPHS];
+    short        kern[ATLAS_GLYPHS][ATLAS_GLYPHS];
+    SDL_Vertex  *v;         /* quads queued since the last flush */
+    int         *idx;
+    int          nv, ni, cap_v, cap_i;
+} GlyphAtlas;
+
+static struct {
+    GlyphAtlas a[ATLAS_FONTS_MAX];
+    int        n;
+    int        batching;    /* text_batch_begin() .. text_batch_flush() */
+    long       strings, glyphs, submits;
+} g_atlas;
+
+/* Atlas slot for code point cp, or -1. */
+static int atlas_index(Uint32 cp) {
+    if (cp >= ATLAS_ASCII_FIRST && cp < ATLAS_ASCII_FIRST + ATLAS_ASCII_N)
+        return (int)(cp - ATLAS_ASCII_FIRST);
+    for (int i = 0; i < ATLAS_GLYPHS - ATLAS_ASCII_N; i++)
+        if (atlas_extra[i] == cp) return ATLAS_ASCII_N + i;
+    return -1;
+}
+
+static Uint32 atlas_codepoint(int i) {
+    return i < ATLAS_ASCII_N ? (Uint32)(ATLAS_ASCII_FIRST + i) : atlas_extra[i - ATLAS_ASCII_N];
+}
+
+/* Decode the next UTF-8 code point at *p and advance; 0xFFFD on malformed input. */
+static Uint32 utf8_next(const char **p) {
+    const unsigned char *s = (const unsigned char *)*p;
+    Uint32 cp;
+    int n;
+    if (s[0] < 0x80) { cp = s[0]; n = 1; }
+    else if ((s[0] & 0xE0) == 0xC0) { cp = s[0] & 0x1Fu; n = 2; }
+    else if ((s[0] & 0xF0) == 0xE0) { cp = s[0] & 0x0Fu; n = 3; }
+    else if ((s[0] & 0xF8) == 0xF0) { cp = s[0] & 0x07u; n = 4; }
+    else { *p += 1; return 0xFFFD; }
+    for (int i = 1; i < n; i++) {
+        if ((s[i] & 0xC0) != 0x80) { *p += i; return 0xFFFD; }
+        cp = cp << 6 | (s[i] & 0x3Fu);
+    }
+    *p += n;
+    return cp;
+}
+
+/* Render the glyph set and pack it into rows of a square power-of-two texture. */
+static void atlas_build(GlyphAtlas *a, SDL_Renderer *r) {
+    SDL_Color white = { 255, 255, 255, 255 };
+    SDL_Surface *gs[ATLAS_GLYPHS] = { 0 };
+    a->line_h = TTF_FontHeight(a->font);
+    for (int i = 0; i < ATLAS_GLYPHS; i++) {
+        Uint32 cp = atlas_codepoint(i);
+        int minx = 0, maxx = 0, miny = 0, maxy = 0, adv = 0;
+        if (!TTF_GlyphIsProvided32(a->font, cp) ||
+            TTF_GlyphMetrics32(a->font, cp, &minx, &maxx, &miny, &maxy, &adv) != 0)
+            continue;
+        a->g[i].advance = adv;
+        a->g[i].xoff = minx < 0 ? minx : 0;
+        a->g[i].ok = 1;
+        if (maxx <= minx) continue;                 /* blank: advance only */
+        gs[i] = TTF_RenderGlyph32_Blended(a->font, cp, white);
+        /* A glyph taller than the line box would shift TTF's baseline; leave it to the
+         * string path so placement matches. */
+        if (!gs[i] || gs[i]->h != a->line_h) a->g[i].ok = 0;
+    }
+
+    int dim = 256, fits = 0;
+    for (; dim <= ATLAS_MAX_DIM && !fits; dim *= 2) {
+        int x = 1, y = 1;
+        fits = 1;
+        for (int i = 0; i < ATLAS_GLYPHS && fits; i++) {
+            if (!a->g[i].ok || !gs[i]) continue;
+            if (x + gs[i]->w + 1 > dim) { x = 1; y += a->line_h + 1; }
+            if (gs[i]->w + 2 > dim || y + a->line_h + 1 > dim) fits = 0;
+            x += gs[i]->w + 1;
+        }
+        if (fits) break;
+    }
+    SDL_Surface *sheet = fits ? SDL_CreateRGBSurfaceWithFormat(0, dim, dim, 32, SDL_PIXELFORMAT_ARGB8888) : NULL;
+    if (sheet) {
+        SDL_FillRect(sheet, NULL, 0);
+        int x = 1, y = 1;
+        for (int i = 0; i < ATLAS_GLYPHS; i++) {
+            if (!a->g[i].ok || !gs[i]) continue;
+            if (x + gs[i]->w + 1 > dim) { x = 1; y += a->line_h + 1; }
+            SDL_Rect dst = { x, y, gs[i]->w, gs[i]->h };
+            SDL_SetSurfaceBlendMode(gs[i], SDL_BLENDMODE_NONE);
+            SDL_BlitSurface(gs[i], NULL, sheet, &dst);
+            a->g[i].src = dst;
+            x += gs[i]->w + 1;
+        }
+        a->tex = SDL_CreateTextureFromSurface(r, sheet);
+        SDL_FreeSurface(sheet);
+    }
+    for (int i = 0; i < ATLAS_GLYPHS; i++)
+        if (gs[i]) SDL_FreeSurface(gs[i]);
+    if (!a->tex) {
+        a->failed = 1;
+        logf_("Glyph atlas unavailable for font (%s); drawing text per string",
+              fits ? SDL_GetError() : "glyphs too large");
+        return;
+    }
+    SDL_SetTextureBlendMode(a->tex, SDL_BLENDMODE_BLEND);
+    a->tex_w = a->tex_h = dim;
+    for (int i = 0; i < ATLAS_GLYPHS; i++)
+        for (int j = 0; j < ATLAS_GLYPHS; j++)
+            a->kern[i][j] = (a->g[i].ok && a->g[j].ok)
+                ? (short)TTF_GetFontKerningSizeGlyphs32(a->font, atlas_codepoint(i), atlas_codepoint(j))
+                : 0;
+}
+
+static GlyphAtlas *atlas_for(SDL_Renderer *r, TTF_Font *font) {
+    for (int i = 0; i < g_atlas.n; i++)
+        if (g_atlas.a[i].font == font)
+            return g_atlas.a[i].failed ? NULL : &g_atlas.a[i];
+    if (g_atlas.n == ATLAS_FONTS_MAX) return NULL;
+    GlyphAtlas *a = &g_atlas.a[g_atlas.n++];
+    memset(a, 0, sizeof(*a));
+    a->font = font;
+    atlas_build(a, r);
+    return a->failed ? NULL : a;
+}
+
+static void atlas_submit(SDL_Renderer *r, GlyphAtlas *a) {
+    if (a->ni == 0) return;
+    SDL_RenderGeometry(r, a->tex, a->v, a->nv, a->idx, a->ni);
+    g_atlas.submits++;
+    a->nv = a->ni = 0;
+}
+
+static int atlas_reserve(GlyphAtlas *a, int quads) {
+    if (a->nv + 4 * quads > a->cap_v) {
+        int cap = a->cap_v ? a->cap_v : 256;
+        while (cap < a->nv + 4 * quads) cap *= 2;
+        SDL_Vertex *v = realloc(a->v, (size_t)cap * sizeof(*v));
+        if (!v) return -1;
+        a->v = v;
+        a->cap_v = cap;
+    }
+    if (a->ni + 6 * quads > a->cap_i) {
+        int cap = a->cap_i ? a->cap_i : 384;
+        while (cap < a->ni + 6 * quads) cap *= 2;
+        int *idx = realloc(a->idx, (size_t)cap * sizeof(*idx));
+        if (!idx) return -1;
+        a->idx = idx;
+        a->cap_i = cap;
+    }
+    return 0;
+}
+
+/* Draw utf8 from the atlas, queued if a batch is open. Returns -1 (nothing drawn) when
+ * the string has a character outside the atlas or no atlas is available. */
+static int atlas_draw(SDL_Renderer *r, TTF_Font *font, const char *utf8,
+                      int x, int y, SDL_Color c, int align, float scale) {
+    int slot[512];
+    int n = 0;
+    for (const char *p = utf8; *p; ) {
+        int i = atlas_index(utf8_next(&p));
+        if (i < 0 || n == (int)(sizeof(slot) / sizeof(slot[0]))) return -1;
+        slot[n++] = i;
+    }
+    if (n == 0) return 0;
+    text_cache_init();
+    if (g_tc.r != r) {
+        text_cache_clear();
+        g_tc.r = r;
+    }
+    GlyphAtlas *a = atlas_for(r, font);
+    if (!a) return -1;
+
+    /* Same box as TTF_RenderUTF8: from the leftmost ink (or pen origin) to the rightmost. */
+    int pen = 0, left = 0, right = 0, quads = 0;
+    for (int k = 0; k < n; k++) {
+        const AtlasGlyph *g = &a->g[slot[k]];
+        if (!g->ok) return -1;
+        if (k > 0) pen += a->kern[slot[k - 1]][slot[k]];
+        if (g->src.w > 0) {
+            if (pen + g->xoff < left) left = pen + g->xoff;
+            if (pen + g->xoff + g->src.w > right) right = pen + g->xoff + g->src.w;
+            quads++;
+        }
+        pen += g->advance;
+    }
+    if (pen > right) right = pen;
+    float box_w = (float)(right - left) * scale;
+    float ox = (float)x;
+    if (align == 1) ox -= (float)(int)(box_w / 2.f);
+    if (align == 2) ox -= (float)(int)box_w;
+    if (quads == 0) return 0;
+    if (atlas_reserve(a, quads) != 0) return -1;
+
+    float tw = (float)a->tex_w, th = (float)a->tex_h;
+    pen = 0;
+    for (int k = 0; k < n; k++) {
+        const AtlasGlyph *g = &a->g[slot[k]];
+        if (k > 0) pen += a->kern[slot[k - 1]][slot[k]];
+        if (g->src.w > 0) {
+            float x0 = ox + (float)(pen + g->xoff - left) * scale;
+            float y0 = (float)y;
+            float x1 = x0 + (float)g->src.w * scale;
+            float y1 = y0 + (float)g->src.h * scale;
+            float u0 = (float)g->src.x / tw, v0 = (float)g->src.y / th;
+            float u1 = (float)(g->src.x + g->src.w) / tw, v1 = (float)(g->src.y + g->src.h) / th;
+            SDL_Vertex *v = &a->v[a->nv];
+            v[0] = (SDL_Vertex){ { x0, y0 }, c, { u0, v0 } };
+            v[1] = (SDL_Vertex){ { x1, y0 }, c, { u1, v0 } };
+            v[2] = (SDL_Vertex){ { x1, y1 }, c, { u1, v1 } };
+            v[3] = (SDL_Vertex){ { x0, y1 }, c, { u0, v1 } };
+            int *ix = &a->idx[a->ni];
+            ix[0] = a->nv; ix[1] = a->nv + 1; ix[2] = a->nv + 2;
+            ix[3] = a->nv; ix[4] = a->nv + 2; ix[5] = a->nv + 3;
+            a->nv += 4;
+            a->ni += 6;
+        }
+        pen += g->advance;
+    }
+    g_atlas.strings++;
+    g_atlas.glyphs += quads;
+    if (!g_atlas.batching) atlas_submit(r, a);
+    return 0;
+}
+
+static void atlas_clear(void) {
+    for (int i = 0; i < g_atlas.n; i++) {
+        GlyphAtlas *a = &g_atlas.a[i];
+        if (a->tex) SDL_DestroyTexture(a->tex);
+        free(a->v);
+        free(a->idx);
+    }
+    g_atlas.n = 0;
+    g_atlas.batching = 0;
+}
+
+void text_batch_begin(void) {
+    g_atlas.batching = 1;
+}
+
+void text_batch_flush(SDL_Renderer *r) {
+    for (int i = 0; i < g_atlas.n; i++)
+        if (!g_atlas.a[i].failed) atlas_submit(r, &g_atlas.a[i]);
+    g_atlas.batching = 0;
+}
+
+void text_cache_clear(void) {
+    if (!g_tc.inited) return;
+    while (g_tc.head >= 0) text_cache_drop(g_tc.head);
+    text_cache_reset();
+    atlas_clear();
+    g_tc.r = NULL;
+}
+
+void text_cache_log_stats(void) {
+    int n = 0;
+    for (int i = g_tc.head; i >= 0; i = g_tc.e[i].next) n++;
+    long looks = g_tc.hits + g_tc.misses;
+    logf_("TEXT_CACHE hits=%ld misses=%ld (%.1f%% hit) evictions=%ld entries=%d bytes=%zu budget=%zu",
+          g_tc.hits, g_tc.misses, looks ? 100.0 * (double)g_tc.hits / (double)looks : 0.0,
+          g_tc.evictions, n, g_tc.bytes, g_tc.budget);
+    logf_("TEXT_ATLAS fonts=%d strings=%ld glyphs=%ld draw_calls=%ld",
+          g_atlas.n, g_atlas.strings, g_atlas.glyphs, g_atlas.submits);
+    g_tc.hits = g_tc.misses = g_tc.evictions = 0;
+    g_atlas.strings = g_atlas.glyphs = g_atlas.submits = 0;
+}
+
 int tile_load_fonts(Fonts *f, const char *font_path, const char *title_font_path, int screen_h) {
     if(!f) return -1;
     memset(f, 0, sizeof(*f));
@@ -117,6 +586,7 @@ int tile_load_fonts(Fonts *f, const char *font_path, const char *title_font_path
 
 void tile_free_fonts(Fonts *f){
     if(!f) return;
+    text_cache_clear();     /* entries are keyed by these fonts */
     if(f->h1) TTF_CloseFont(f->h1);
     if(f->h2) TTF_CloseFont(f->h2);
     if(f->title_font) TTF_CloseFont(f->title_font);
@@ -139,59 +609,37 @@ void text_size(TTF_Font *font, const char *utf8, int *out_w, int *out_h) {
 
 void draw_text(SDL_Renderer *r, TTF_Font *font, const char *utf8,
                int x, int y, SDL_Color c, int align) {
-    int tw=0, th=0;
-    SDL_Texture *t = tex_from_text(r, font, utf8, c, &tw, &th);
-    if(!t) return;
-
-    SDL_Rect dst = { x, y, tw, th };
-    if(align == 1) dst.x = x - tw/2;
-    if(align == 2) dst.x = x - tw;
-
-    SDL_RenderCopy(r, t, NULL, &dst);
-    SDL_DestroyTexture(t);
+    draw_text_scaled(r, font, utf8, x, y, c, align, 1.0f);
 }
 
 void draw_text_scaled(SDL_Renderer *r, TTF_Font *font, const char *utf8,
                       int x, int y, SDL_Color c, int align, float scale) {
-    int tw = 0, th = 0;
-    SDL_Texture *t = tex_from_text(r, font, utf8, c, &tw, &th);
-    if (!t || scale <= 0.f) return;
-    int dw = (int)(tw * scale + 0.5f);
-    int dh = (int)(th * scale + 0.5f);
+    int tw = 0, th = 0, owned = 0;
+    if (scale <= 0.f) return;
+    if (utf8 && atlas_draw(r, font, utf8, x, y, c, align, scale) == 0) return;
+    SDL_Texture *t = text_texture(r, font, utf8, c, 0, &tw, &th, &owned);
+    if (!t) return;
+    int dw = scale == 1.0f ? tw : (int)(tw * scale + 0.5f);
+    int dh = scale == 1.0f ? th : (int)(th * scale + 0.5f);
     if (dw < 1) dw = 1;
     if (dh < 1) dh = 1;
     SDL_Rect dst = { x, y, dw, dh };
     if (align == 1) dst.x = x - dw / 2;
     if (align == 2) dst.x = x - dw;
     SDL_RenderCopy(r, t, NULL, &dst);
-    SDL_DestroyTexture(t);
+    if (owned) SDL_DestroyTexture(t);
 }
 
 void draw_text_trunc(SDL_Renderer *r, TTF_Font *font, const char *utf8,
                      int x, int y, int max_w, SDL_Color c, int align) {
-    if(!utf8) utf8 = "";
-    char buf[512];
-    snprintf(buf, sizeof(buf), "%s", utf8);
-
-    int w=0, h=0;
-    if(TTF_SizeUTF8(font, buf, &w, &h) == 0 && w <= max_w) {
-        draw_text(r, font, buf, x, y, c, align);
-        return;
-    }
-
-    const char *ellipsis = "…";
-    size_t n = strlen(buf);
-    while(n > 0) {
-        buf[n-1] = '\0';
-        char tmp[520];
-        snprintf(tmp, sizeof(tmp), "%s%s", buf, ellipsis);
-        if(TTF_SizeUTF8(font, tmp, &w, &h) == 0 && w <= max_w) {
-            draw_text(r, font, tmp, x, y, c, align);
-            return;
-        }
-        n--;
-    }
-    draw_text(r, font, ellipsis, x, y, c, align);
+    int tw = 0, th = 0, owned = 0;
+    SDL_Texture *t = text_texture(r, font, utf8, c, max_w > 0 ? max_w : 1, &tw, &th, &owned);
+    if (!t) return;
+    SDL_Rect dst = { x, y, tw, th };
+    if (align == 1) dst.x = x - tw / 2;
+    if (align == 2) dst.x = x - tw;
+    SDL_RenderCopy(r, t, NULL, &dst);
+    if (owned) SDL_DestroyTexture(t);
 }
 
 /* Simple rounded-rect fill via scanlines */
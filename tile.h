@@ -28,6 +28,20 @@ void draw_text_scaled(SDL_Renderer *r, TTF_Font *font, const char *utf8,
 void draw_text_trunc(SDL_Renderer *r, TTF_Font *font, const char *utf8,
                      int x, int y, int max_w, SDL_Color c, int align);
 
+/* draw_text and draw_text_scaled draw strings of ASCII and • ° … © from a per-font glyph
+ * atlas; other strings, and draw_text_trunc, are kept as textures in an LRU cache
+ * (TEXT_CACHE_MB budget), so unchanged text is not rasterized again. Clear both before
+ * destroying the renderer or fonts they were used with (tile_free_fonts does). */
+void text_cache_clear(void);
+
+/* Log cache hits, misses, evictions and memory, and atlas use, since the last call. */
+void text_cache_log_stats(void);
+
+/* Between these, atlas text is queued and then drawn with one call per font. Only bracket
+ * text that nothing else drawn in between overlaps, and flush before switching targets. */
+void text_batch_begin(void);
+void text_batch_flush(SDL_Renderer *r);
+
 void fill_round_rect(SDL_Renderer *r, SDL_Rect rc, int radius);
 
 /* Filled circle at (cx, cy) with given radius; for overlays (e.g. robot eyes). */
@@ -113,8 +113,14 @@ def refresh_stop_options() -> int:
     except Exception:
         pass
 
-    with urlopen(url, timeout=25) as response:
-        data = response.read()
+    if url.strip().lower() == "none":
+        # GTFS_BUS_URL=none: the board only has the zip at GTFS_CACHE_PATH.
+        cache = (os.environ.get("GTFS_CACHE_PATH") or env.get("GTFS_CACHE_PATH")
+                 or str(pathlib.Path.home() / "arrival_board" / "gtfs_bus_cache.zip"))
+        data = pathlib.Path(cache).read_bytes()
+    else:
+        with urlopen(url, timeout=25) as response:
+            data = response.read()
 
     stops: list[dict[str, str]] = []
     seen: set[str] = set()
@@ -0,0 +1,184 @@
+#!/usr/bin/env python3
+"""Local HTTP stand-in for the make check programs (no network needed).
+
+  http_standin.py serve ROOT PORT_FILE LOG_FILE
+      Serve the files in ROOT on a free loopback port (written to PORT_FILE) with
+      ETag / Last-Modified, If-None-Match / If-Modified-Since (304) and
+      Range + If-Range (206, 416). /status/NNN answers with status NNN. Each response
+      appends "<code> <range>" to LOG_FILE.
+      Faults are read from ROOT/.mode before every request, one word each:
+        truncate  send the full Content-Length but only half the body, then close
+        noetag    leave out the ETag header
+        delay=MS  answer every request MS milliseconds late
+        gzip      send a full (200) body gzip-encoded when Accept-Encoding allows it
+        deflate   the same with deflate (zlib) encoding
+
+  http_standin.py gtfs-zip OUT HEADSIGN
+      Write a one-route GTFS zip (express route QM99 at stop 900001, every day, four
+      trips a day) whose trips carry HEADSIGN, padded with a stored member so a
+      transfer can be cut halfway.
+"""
+import email.utils
+import gzip
+import hashlib
+import os
+import random
+import sys
+import time
+import zipfile
+import zlib
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    # Headers and body go out in separate writes; with Nagle on, a kept-alive connection
+    # waits for the client's delayed ACK (40 ms) before the body.
+    disable_nagle_algorithm = True
+
+    def log_message(self, fmt, *args):
+        pass
+
+    def record(self, code, rng):
+        with open(self.server.log_file, "a") as f:
+            f.write("%d %s\n" % (code, rng or "-"))
+
+    def modes(self):
+        try:
+            with open(os.path.join(self.server.root, ".mode")) as f:
+                return f.read().split()
+        except OSError:
+            return []
+
+    def reply(self, code, headers, body, truncate=False):
+        self.send_response(code)
+        for k, v in headers:
+            self.send_header(k, v)
+        self.send_header("Content-Length", str(len(body)))
+        if truncate:
+            self.send_header("Connection", "close")
+        self.end_headers()
+        if self.command != "HEAD":
+            self.wfile.write(body[: len(body) // 2] if truncate else body)
+        if truncate:
+            self.wfile.flush()
+            self.close_connection = True
+
+    def do_GET(self):
+        modes = self.modes()
+        for m in modes:
+            if m.startswith("delay="):
+                time.sleep(int(m[6:]) / 1000.0)
+        name = self.path.split("?", 1)[0].lstrip("/")
+        path = os.path.join(self.server.root, name)
+        rng = self.headers.get("Range")
+        if name.startswith("status/") and name[7:].isdigit():
+            code = int(name[7:])
+            self.record(code, rng)
+            self.reply(code, [], b"status %d\n" % code)
+            return
+        if not name or name.startswith(".") or not os.path.isfile(path):
+            self.record(404, rng)
+            self.reply(404, [], b"not found\n")
+            return
+        with open(path, "rb") as f:
+            data = f.read()
+        mtime = int(os.stat(path).st_mtime)
+        etag = '"%s"' % hashlib.sha1(data).hexdigest()[:16]
+        headers = [("Last-Modified", email.utils.formatdate(mtime, usegmt=True))]
+        if "noetag" not in modes:
+            headers.append(("ETag", etag))
+
+        inm = self.headers.get("If-None-Match")
+        ims = self.headers.get("If-Modified-Since")
+        if inm is not None:
+            fresh = "noetag" not in modes and etag in [t.strip() for t in inm.split(",")]
+        elif ims:
+            since = email.utils.parsedate_to_datetime(ims).timestamp()
+            fresh = mtime <= since
+        else:
+            fresh = False
+        if fresh:
+            self.record(304, rng)
+            self.reply(304, headers, b"")
+            return
+
+        if_range = self.headers.get("If-Range")
+        if rng and rng.startswith("bytes=") and (if_range is None or if_range == etag):
+            start = int(rng[6:].split("-", 1)[0])
+            if start >= len(data):
+                self.record(416, rng)
+                self.reply(416, [("Content-Range", "bytes */%d" % len(data))], b"")
+                return
+            headers.append(("Content-Range", "bytes %d-%d/%d" % (start, len(data) - 1, len(data))))
+            self.record(206, rng)
+            self.reply(206, headers, data[start:], "truncate" in modes)
+            return
+        accept = [e.split(";", 1)[0].strip() for e in self.headers.get("Accept-Encoding", "").split(",")]
+        for enc in ("gzip", "deflate"):
+            if enc in modes and enc in accept:
+                data = gzip.compress(data, mtime=0) if enc == "gzip" else zlib.compress(data)
+                headers += [("Content-Encoding", enc), ("Vary", "Accept-Encoding")]
+                break
+        self.record(200, rng)
+        self.reply(200, headers, data, "truncate" in modes)
+
+
+def serve(root, port_file, log_file):
+    srv = ThreadingHTTPServer(("127.0.0.1", 0), Handler)
+    srv.daemon_threads = True
+    srv.root = root
+    srv.log_file = log_file
+    tmp = port_file + ".tmp"
+    with open(tmp, "w") as f:
+        f.write("%d\n" % srv.server_address[1])
+    os.rename(tmp, port_file)
+    srv.serve_forever()
+
+
+def gtfs_zip(out, headsign):
+    members = {
+        "agency.txt": "agency_id,agency_name,agency_url,agency_timezone\n"
+                      "MTABC,MTA Bus,https://new.mta.info,America/New_York\n",
+        "routes.txt": "route_id,agency_id,route_short_name,route_long_name,route_type\n"
+                      "QM99,MTABC,QM99,Test Express,3\n",
+        "stops.txt": "stop_id,stop_code,stop_name,stop_lat,stop_lon\n"
+                     "900001,900001,TEST AV/TEST ST,40.7,-73.8\n"
+                     "900002,900002,MIDTOWN,40.75,-73.98\n",
+        "calendar.txt": "service_id,monday,tuesday,wednesday,thursday,friday,saturday,sunday,"
+                        "start_date,end_date\n"
+                        "ALL,1,1,1,1,1,1,1,20200101,20991231\n",
+        "calendar_dates.txt": "service_id,date,exception_type\n",
+    }
+    trips = ["route_id,service_id,trip_id,trip_headsign"]
+    times = ["trip_id,arrival_time,departure_time,stop_id,stop_sequence"]
+    for h in (0, 6, 12, 18):
+        trip = "T%02d" % h
+        trips.append("QM99,ALL,%s,%s" % (trip, headsign))
+        times.append("%s,%02d:30:00,%02d:30:00,900001,1" % (trip, h, h))
+        times.append("%s,%02d:10:00,%02d:10:00,900002,2" % (trip, h + 1, h + 1))
+    members["trips.txt"] = "\n".join(trips) + "\n"
+    members["stop_times.txt"] = "\n".join(times) + "\n"
+    rnd = random.Random(headsign)
+    pad = "shape_id,shape_pt_lat,shape_pt_lon,shape_pt_sequence\n" + "".join(
+        "S,%.6f,%.6f,%d\n" % (rnd.uniform(40, 41), rnd.uniform(-74, -73), i) for i in range(6000))
+    tmp = out + ".tmp"
+    with zipfile.ZipFile(tmp, "w", zipfile.ZIP_DEFLATED) as z:
+        for name, text in members.items():
+            z.writestr(name, text)
+        z.writestr(zipfile.ZipInfo("shapes.txt", (2024, 1, 1, 0, 0, 0)), pad, zipfile.ZIP_STORED)
+    os.rename(tmp, out)
+
+
+def main():
+    if len(sys.argv) == 5 and sys.argv[1] == "serve":
+        serve(sys.argv[2], sys.argv[3], sys.argv[4])
+    elif len(sys.argv) == 4 and sys.argv[1] == "gtfs-zip":
+        gtfs_zip(sys.argv[2], sys.argv[3])
+    else:
+        sys.stderr.write(__doc__)
+        sys.exit(2)
+
+
+if __name__ == "__main__":
+    main()
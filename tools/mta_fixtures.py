@@ -0,0 +1,272 @@
+#!/usr/bin/env python3
+"""Write the MTA response fixtures under testdata/ that mta_test reads.
+
+  mta_fixtures.py [OUT_DIR]     (default: testdata next to this script's parent)
+
+  rt_tripupdates.pb   GTFS-Realtime FeedMessage in the layout of the MTA bus TripUpdates
+                      feed: a header, one VehiclePosition entity, filler trips at other
+                      stops, and at stops 501627 / 501628 a normal trip, a CANCELED trip,
+                      a trip whose update at 501627 is SKIPPED, and a vehicle known only
+                      by its label. Unknown fields (NYCT extension, delay, uncertainty)
+                      are left in so the reader has to skip them.
+  siri_stop.json      The SIRI stop-monitoring answer for 501627 at the same moment,
+                      with the fields Bus Time sends (StopMonitoringDelivery and
+                      DestinationName as arrays).
+  siri_object.json    The same stop with StopMonitoringDelivery, DestinationName and
+                      StopPointName as plain values, non-ASCII names as \\u escapes
+                      (one outside the BMP, so a surrogate pair) and a visit with only
+                      an AimedArrivalTime.
+  siri_multi.json     Two deliveries, of which only the first counts.
+
+The bytes are generated, not captured, so the expected values in mta_test.c can be read
+off this file. Re-run after editing and commit the output.
+"""
+import datetime
+import json
+import os
+import struct
+import sys
+
+T0 = 1789000000                     # feed timestamp (2026-09-09 20:26:40 EDT)
+EDT = datetime.timezone(datetime.timedelta(hours=-4))
+
+
+# ---- protobuf wire encoding ----------------------------------------------------------
+
+def varint(v):
+    if v < 0:
+        v += 1 << 64                # int32/int64 negatives take ten bytes
+    out = bytearray()
+    while True:
+        b = v & 0x7F
+        v >>= 7
+        if v:
+            out.append(b | 0x80)
+        else:
+            out.append(b)
+            return bytes(out)
+
+
+def key(field, wire):
+    return varint(field << 3 | wire)
+
+
+def f_varint(field, v):
+    return key(field, 0) + varint(v)
+
+
+def f_bytes(field, b):
+    if isinstance(b, str):
+        b = b.encode()
+    return key(field, 2) + varint(len(b)) + b
+
+
+def f_float(field, x):
+    return key(field, 5) + struct.pack("<f", x)
+
+
+def msg(*parts):
+    return b"".join(parts)
+
+
+# ---- GTFS-Realtime messages ------------------------------------------------------------
+
+def stop_time_event(t, delay=None, uncertainty=None):
+    parts = []
+    if delay is not None:
+        parts.append(f_varint(1, delay))
+    parts.append(f_varint(2, t))
+    if uncertainty is not None:
+        parts.append(f_varint(3, uncertainty))
+    return msg(*parts)
+
+
+def stop_time_update(stop_id, arr=None, dep=None, seq=None, skipped=False, delay=None):
+    parts = []
+    if seq is not None:
+        parts.append(f_varint(1, seq))
+    if arr is not None:
+        parts.append(f_bytes(2, stop_time_event(arr, delay, 0 if delay is not None else None)))
+    if dep is not None:
+        parts.append(f_bytes(3, stop_time_event(dep)))
+    parts.append(f_bytes(4, stop_id))
+    if skipped:
+        parts.append(f_varint(5, 1))        # SKIPPED
+    return msg(*parts)
+
+
+def trip_update(trip_id, route_id, stus, vehicle_id=None, label=None, canceled=False):
+    trip = [f_bytes(1, trip_id), f_bytes(3, "20260909"), f_bytes(5, route_id), f_varint(6, 0)]
+    if canceled:
+        trip.append(f_varint(4, 3))         # CANCELED
+    trip.append(f_bytes(1001, f_bytes(1, "QV_B6-Weekday") + f_varint(2, 1)))   # NYCT extension
+    parts = [f_bytes(1, msg(*trip))]
+    parts += [f_bytes(2, s) for s in stus]
+    if vehicle_id or label:
+        v = []
+        if vehicle_id:
+            v.append(f_bytes(1, vehicle_id))
+        if label:
+            v.append(f_bytes(2, label))
+        parts.append(f_bytes(3, msg(*v)))
+    parts.append(f_varint(4, T0 - 15))      # TripUpdate.timestamp
+    return msg(*parts)
+
+
+def entity(eid, tu=None, vp=None):
+    parts = [f_bytes(1, eid)]
+    if tu is not None:
+        parts.append(f_bytes(3, tu))
+    if vp is not None:
+        parts.append(f_bytes(4, vp))
+    return msg(*parts)
+
+
+def trip_id(route, n):
+    return "QV_B6-Weekday-SDon-%06d_%s_%d" % (57600 + n * 100, route, n)
+
+
+def rt_feed():
+    header = msg(f_bytes(1, "1.0"), f_varint(2, 0), f_varint(3, T0))
+    ents = [entity("vp_7009", vp=msg(f_bytes(1, f_bytes(1, trip_id("Q27", 9))),
+                                     f_bytes(2, f_float(1, 40.7590) + f_float(2, -73.8300)),
+                                     f_varint(5, T0 - 20)))]
+
+    # Other stops on the same routes: everything here must be skipped.
+    for n in range(24):
+        route = ("Q27", "Q17", "Q65", "Q44")[n % 4]
+        base = 503000 + n * 20
+        stus = [stop_time_update(str(base + k), arr=T0 + 60 * (n + k), dep=T0 + 60 * (n + k) + 20,
+                                 seq=k + 1, delay=-30 if k == 0 else None) for k in range(8)]
+        ents.append(entity("f%d" % n, trip_update(trip_id(route, 100 + n), route, stus,
+                                                  vehicle_id="MTA NYCT_%d" % (8000 + n))))
+
+    # Normal: two stops before ours -> stops_away 2, at T0+300.
+    ents.insert(5, entity("match", trip_update(trip_id("Q27", 312), "Q27", [
+        stop_time_update("501620", arr=T0 + 60, dep=T0 + 70, seq=10, delay=-30),
+        stop_time_update("501624", arr=T0 + 180, dep=T0 + 190, seq=11),
+        stop_time_update("501627", arr=T0 + 300, dep=T0 + 310, seq=12),
+    ], vehicle_id="MTA NYCT_7001", label="7001")))
+    # CANCELED: its update at our stop must not show.
+    ents.insert(10, entity("canceled", trip_update(trip_id("Q27", 313), "Q27", [
+        stop_time_update("501627", arr=T0 + 240, seq=12),
+    ], vehicle_id="MTA NYCT_7004", canceled=True)))
+    # SKIPPED at 501627; kept at 501628 (STOP_ID list entry 1) from its departure time.
+    ents.insert(15, entity("skipped", trip_update(trip_id("Q17", 101), "Q17", [
+        stop_time_update("501610", arr=T0 + 60, seq=4),
+        stop_time_update("501627", arr=T0 + 200, seq=5, skipped=True),
+        stop_time_update("501628", dep=T0 + 600, seq=7),
+    ], vehicle_id="MTA NYCT_7002")))
+    # Label only, no stop_sequence: stops_away is the update's index (1).
+    ents.append(entity("label", trip_update(trip_id("Q65", 50), "Q65", [
+        stop_time_update("501601", arr=T0 + 30),
+        stop_time_update("501627", arr=T0 + 120),
+    ], label="7003")))
+
+    return f_bytes(1, header) + b"".join(f_bytes(2, e) for e in ents)
+
+
+# ---- SIRI stop monitoring ------------------------------------------------------------
+
+def iso(t):
+    return datetime.datetime.fromtimestamp(t, EDT).isoformat(timespec="milliseconds")
+
+
+def siri_visit(route, trip, vehicle, dest, when, stops, meters, plain=False, aimed_only=False):
+    v = {
+        "MonitoredVehicleJourney": {
+            "LineRef": "MTA NYCT_" + route,
+            "DirectionRef": "0",
+            "FramedVehicleJourneyRef": {"DataFrameRef": "2026-09-09",
+                                        "DatedVehicleJourneyRef": "MTA NYCT_" + trip},
+            "JourneyPatternRef": "MTA_" + route + "0123",
+            "PublishedLineName": [route],
+            "OperatorRef": "MTA NYCT",
+            "OriginRef": "MTA_501600",
+            "DestinationRef": "MTA_503999",
+            "DestinationName": [dest],
+            "SituationRef": [],
+            "Monitored": True,
+            "VehicleLocation": {"Longitude": -73.8300, "Latitude": 40.7590},
+            "Bearing": 91.5,
+            "ProgressRate": "normalProgress",
+            "BlockRef": "MTA NYCT_QV_B6-Weekday_E_QV_21060_" + route + "-12",
+            "VehicleRef": "MTA NYCT_" + vehicle,
+            "MonitoredCall": {
+                "AimedArrivalTime": iso(when - 60),
+                "ExpectedArrivalTime": iso(when),
+                "ArrivalProximityText": "%d stops away" % stops,
+                "DistanceFromStop": meters,
+                "NumberOfStopsAway": stops,
+                "StopPointRef": "MTA_501627",
+                "VisitNumber": 1,
+                "StopPointName": ["MAIN ST/ROOSEVELT AV"],
+                "Extensions": {"Distances": {"PresentableDistance": "%d stops away" % stops,
+                                             "DistanceFromCall": meters + 0.5,
+                                             "StopsFromCall": stops,
+                                             "CallDistanceAlongRoute": 5123.25}},
+            },
+            "OnwardCalls": {},
+        },
+        "RecordedAtTime": iso(T0 - 20),
+    }
+    mvj = v["MonitoredVehicleJourney"]
+    if plain:
+        mvj["DestinationName"] = dest
+        mvj["MonitoredCall"]["StopPointName"] = "MAIN ST/ROOSEVELT AV \u2013 N"
+    if aimed_only:
+        del mvj["MonitoredCall"]["ExpectedArrivalTime"]
+        del mvj["MonitoredCall"]["Extensions"]
+    return v
+
+
+def siri_doc(delivery):
+    return {"Siri": {"ServiceDelivery": {
+        "ResponseTimestamp": iso(T0),
+        "StopMonitoringDelivery": delivery,
+        "SituationExchangeDelivery": [],
+    }}}
+
+
+def delivery(visits):
+    return {"MonitoredStopVisit": visits, "ResponseTimestamp": iso(T0), "ValidUntil": iso(T0 + 60)}
+
+
+def siri_stop():
+    return siri_doc([delivery([
+        siri_visit("Q65", trip_id("Q65", 50), "7003", "COLLEGE PT 110 ST via 164 ST", T0 + 120, 1, 410),
+        siri_visit("Q27", trip_id("Q27", 312), "7001", "CAMBRIA HTS 120 AV via SPRINGFIELD", T0 + 300, 2, 1200),
+    ])])
+
+
+def siri_object():
+    return siri_doc(delivery([
+        siri_visit("Q65", trip_id("Q65", 50), "7003", "JAMAICA \u2013 PARSONS BL", T0 + 120, 1, 410, plain=True),
+        siri_visit("Q27", trip_id("Q27", 312), "7001", "ROCKAWAY \U0001F30A \"BEACH\"", T0 + 300, 2, 1200,
+                   plain=True),
+        siri_visit("Q17", trip_id("Q17", 101), "7002", "CAF\u00c9 / FLUSHING", T0 + 600, 4, 2500, plain=True,
+                   aimed_only=True),
+    ]))
+
+
+def siri_multi():
+    return siri_doc([
+        delivery([siri_visit("Q44", trip_id("Q44", 7), "7010", "BRONX ZOO", T0 + 400, 3, 1800)]),
+        delivery([siri_visit("Q99", trip_id("Q99", 8), "7011", "NOT SHOWN", T0 + 60, 0, 10)]),
+    ])
+
+
+def main():
+    out = sys.argv[1] if len(sys.argv) > 1 else \
+        os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "testdata")
+    os.makedirs(out, exist_ok=True)
+    with open(os.path.join(out, "rt_tripupdates.pb"), "wb") as f:
+        f.write(rt_feed())
+    for name, doc in (("siri_stop.json", siri_stop()), ("siri_object.json", siri_object()),
+                      ("siri_multi.json", siri_multi())):
+        with open(os.path.join(out, name), "w") as f:
+            json.dump(doc, f, separators=(",", ":"))      # ASCII, non-ASCII as \u escapes
+
+
+if __name__ == "__main__":
+    main()
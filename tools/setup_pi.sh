@@ -51,8 +51,10 @@ PKGS=(
   build-essential pkg-config
   # SDL2
   libsdl2-dev libsdl2-ttf-dev libsdl2-image-dev
-  # JSON
-  libcjson-dev
+  # GTFS zip reader (inflate)
+  zlib1g-dev
+  # API polling (in-process HTTP client)
+  libcurl4-openssl-dev
   # GPIO input for setup switch
   libgpiod-dev gpiod
   # Fonts
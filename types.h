@@ -6,6 +6,9 @@
 
 #include <time.h>
 
+/* STOP_ID may list several stops (e.g. both directions at an intersection). */
+#define STOP_IDS_MAX 8
+
 /* One bus arrival from the MTA API. */
 typedef struct Arrival {
     char route[32];
@@ -16,6 +19,7 @@ typedef struct Arrival {
     time_t expected;
     double miles_away;   /* miles until stop, <0 if unknown */
     int ppl_est;         /* estimated people count */
+    char stop[32];       /* STOP_ID entry it arrives at; "" when only one stop is configured */
 } Arrival;
 
 /* Weather data from Open-Meteo (tied to stop location when possible). */
@@ -36,6 +40,7 @@ typedef struct ScheduledDeparture {
     char route[32];
     char dest[128];     /* trip_headsign */
     time_t when;        /* America/New_York */
+    char stop[32];      /* STOP_ID entry it departs from; "" when only one stop is configured */
 } ScheduledDeparture;
 
 #define SCHEDULED_MAX 12
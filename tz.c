@@ -0,0 +1,341 @@
+/*
+ * New York zone engine: TZif v2+ transitions from tzdata, extended to TZ_RULE_END_YEAR
+ * with the file's POSIX footer rule (or TZ_NY_RULE when tzdata is missing), kept in one
+ * immutable table. Each thread caches the offset interval it last hit.
+ */
+#include "tz.h"
+#include "util.h"
+#include <ctype.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef TZ_NY_PATH             /* tz_rule_test points it nowhere */
+#define TZ_NY_PATH       "/usr/share/zoneinfo/America/New_York"
+#endif
+#define TZ_NY_RULE       "EST5EDT,M3.2.0,M11.1.0"
+#define TZ_RULE_END_YEAR 2100
+#define TZ_MAX_TRANS     1024
+#define TZ_MAX_ABBR      8
+
+typedef struct {
+    int64_t at;                 /* first instant on this offset */
+    int32_t off;
+    uint8_t isdst;
+    uint8_t abbr;               /* g_abbr[] index */
+} TzTrans;
+
+/* Parsed POSIX TZ rule with Mm.w.d start/end dates. */
+typedef struct {
+    char    std_name[TZ_MAX_ABBR], dst_name[TZ_MAX_ABBR];
+    int32_t std_off, dst_off;   /* east positive */
+    int     has_dst;
+    int     mon[2], week[2], wday[2];
+    int32_t at_secs[2];         /* local time of day of the change */
+} TzRule;
+
+static TzTrans g_tr[TZ_MAX_TRANS];
+static int     g_n_tr;
+static TzTrans g_before;        /* in effect before g_tr[0] */
+static char    g_abbr[TZ_MAX_ABBR][TZ_MAX_ABBR];
+static int     g_n_abbr;
+static pthread_once_t g_once = PTHREAD_ONCE_INIT;
+
+/* Offset interval [from, until) this thread last looked up. */
+static _Thread_local struct {
+    int64_t from, until;
+    int     idx;                /* g_tr index, -1 = g_before */
+    int     valid;
+} t_cache;
+
+/* ---- Calendar math (proleptic Gregorian, days since 1970-01-01) ---- */
+
+static int64_t days_from_civil(int y, int m, int d) {
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int64_t yoe = y - era * 400;
+    int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+static void civil_from_days(int64_t z, int *y, int *m, int *d) {
+    z += 719468;
+    int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    int64_t doe = z - era * 146097;
+    int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int64_t mp = (5 * doy + 2) / 153;
+    *d = (int)(doy - (153 * mp + 2) / 5 + 1);
+    *m = (int)(mp < 10 ? mp + 3 : mp - 9);
+    *y = (int)(yoe + era * 400 + (*m <= 2));
+}
+
+static int64_t floor_div(int64_t a, int64_t b) {
+    return a / b - (a % b != 0 && (a < 0) != (b < 0));
+}
+
+long tz_ymd_to_days(int ymd) {
+    return (long)days_from_civil(ymd / 10000, (ymd / 100) % 100, ymd % 100);
+}
+
+int tz_days_to_ymd(long days) {
+    int y, m, d;
+    civil_from_days(days, &y, &m, &d);
+    return y * 10000 + m * 100 + d;
+}
+
+int tz_ymd_add(int ymd, int days) {
+    return tz_days_to_ymd(tz_ymd_to_days(ymd) + days);
+}
+
+int tz_ymd_wday(int ymd) {
+    return (int)(((tz_ymd_to_days(ymd) % 7) + 11) % 7);   /* 1970-01-01 was a Thursday */
+}
+
+/* ---- Loading ---- */
+
+static int abbr_index(const char *s) {
+    for (int i = 0; i < g_n_abbr; i++)
+        if (strcmp(g_abbr[i], s) == 0) return i;
+    if (g_n_abbr == TZ_MAX_ABBR) return 0;
+    snprintf(g_abbr[g_n_abbr], TZ_MAX_ABBR, "%s", s);
+    return g_n_abbr++;
+}
+
+static const char *rule_name(const char *p, char *out) {
+    size_t n = 0;
+    if (*p == '<') {
+        for (p++; *p && *p != '>'; p++)
+            if (n + 1 < TZ_MAX_ABBR) out[n++] = *p;
+        if (*p == '>') p++;
+    } else {
+        for (; isalpha((unsigned char)*p); p++)
+            if (n + 1 < TZ_MAX_ABBR) out[n++] = *p;
+    }
+    out[n] = '\0';
+    return n >= 3 ? p : NULL;
+}
+
+/* [+-]hh[:mm[:ss]] in seconds. */
+static const char *rule_secs(const char *p, int32_t *out) {
+    int sign = 1;
+    if (*p == '+' || *p == '-') sign = (*p++ == '-') ? -1 : 1;
+    if (!isdigit((unsigned char)*p)) return NULL;
+    int32_t v = 0;
+    for (int part = 0; part < 3; part++) {
+        int x = 0;
+        while (isdigit((unsigned char)*p)) x = x * 10 + (*p++ - '0');
+        v += x * (part == 0 ? 3600 : part == 1 ? 60 : 1);
+        if (*p != ':' || part == 2) break;
+        p++;
+    }
+    *out = sign * v;
+    return p;
+}
+
+/* ",Mm.w.d[/time]" */
+static const char *rule_date(const char *p, TzRule *r, int k) {
+    if (p[0] != ',' || p[1] != 'M') return NULL;
+    if (sscanf(p + 2, "%d.%d.%d", &r->mon[k], &r->week[k], &r->wday[k]) != 3) return NULL;
+    if (r->mon[k] < 1 || r->mon[k] > 12 || r->week[k] < 1 || r->week[k] > 5 ||
+        r->wday[k] < 0 || r->wday[k] > 6)
+        return NULL;
+    p += 2;
+    while (isdigit((unsigned char)*p) || *p == '.') p++;
+    r->at_secs[k] = 2 * 3600;
+    if (*p == '/' && !(p = rule_secs(p + 1, &r->at_secs[k]))) return NULL;
+    return p;
+}
+
+static int rule_parse(const char *s, TzRule *r) {
+    memset(r, 0, sizeof(*r));
+    int32_t v;
+    const char *p = rule_name(s, r->std_name);
+    if (!p || !(p = rule_secs(p, &v))) return -1;
+    r->std_off = -v;                        /* POSIX offsets are west positive */
+    if (!*p) return 0;
+    if (!(p = rule_name(p, r->dst_name))) return -1;
+    r->dst_off = r->std_off + 3600;
+    if (*p && *p != ',') {
+        if (!(p = rule_secs(p, &v))) return -1;
+        r->dst_off = -v;
+    }
+    if (!(p = rule_date(p, r, 0)) || !(p = rule_date(p, r, 1))) return -1;
+    r->has_dst = 1;
+    return 0;
+}
+
+/* Day of month for "week w (5 = last) weekday d of month m" in year y. */
+static int rule_mday(int y, int m, int w, int d) {
+    static const int mdays[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    int dim = mdays[m - 1] + (m == 2 && ((y % 4 == 0 && y % 100 != 0) || y % 400 == 0));
+    int first = tz_ymd_wday(y * 10000 + m * 100 + 1);
+    int mday = 1 + (d - first + 7) % 7 + (w - 1) * 7;
+    while (mday > dim) mday -= 7;
+    return mday;
+}
+
+static void push_trans(int64_t at, int32_t off, int isdst, int abbr) {
+    if (g_n_tr == TZ_MAX_TRANS) return;
+    g_tr[g_n_tr++] = (TzTrans){ at, off, (uint8_t)isdst, (uint8_t)abbr };
+}
+
+/* Append the rule's transitions after 'after' through TZ_RULE_END_YEAR. */
+static void rule_extend(const TzRule *r, int64_t after) {
+    int std_abbr = abbr_index(r->std_name), dst_abbr = abbr_index(r->dst_name);
+    if (!r->has_dst) {
+        if (g_n_tr == 0) g_before = (TzTrans){ 0, r->std_off, 0, (uint8_t)std_abbr };
+        return;
+    }
+    int y0, m0, d0;
+    civil_from_days(floor_div(after, 86400), &y0, &m0, &d0);
+    if (g_n_tr == 0) {
+        g_before = (TzTrans){ 0, r->std_off, 0, (uint8_t)std_abbr };
+        y0 = 1970;
+    }
+    for (int y = y0; y <= TZ_RULE_END_YEAR; y++) {
+        int64_t start = days_from_civil(y, r->mon[0], rule_mday(y, r->mon[0], r->week[0], r->wday[0]))
+                        * 86400 + r->at_secs[0] - r->std_off;
+        int64_t end = days_from_civil(y, r->mon[1], rule_mday(y, r->mon[1], r->week[1], r->wday[1]))
+                      * 86400 + r->at_secs[1] - r->dst_off;
+        if (start > after) push_trans(start, r->dst_off, 1, dst_abbr);
+        if (end > after) push_trans(end, r->std_off, 0, std_abbr);
+    }
+}
+
+static uint32_t be32(const unsigned char *p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static int64_t be64(const unsigned char *p) {
+    return (int64_t)((uint64_t)be32(p) << 32 | be32(p + 4));
+}
+
+/* Load the v2+ (64-bit) block of a TZif file. Fills footer with the POSIX rule, if any. */
+static int tzif_load(const char *path, char *footer, size_t footer_sz) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return -1;
+    unsigned char buf[16384];
+    size_t n = fread(buf, 1, sizeof(buf), fp);
+    fclose(fp);
+    if (n < 44 || memcmp(buf, "TZif", 4) != 0 || buf[4] < '2') return -1;
+
+    /* Skip the v1 (32-bit) block to reach the second header. */
+    const unsigned char *h = buf;
+    size_t v1 = 44 + be32(h + 32) * 5 + be32(h + 36) * 6 + be32(h + 40) + be32(h + 28) * 8 +
+                be32(h + 24) + be32(h + 20);
+    if (v1 + 44 > n) return -1;
+    h = buf + v1;
+    if (memcmp(h, "TZif", 4) != 0) return -1;
+    uint32_t isut = be32(h + 20), isstd = be32(h + 24), leap = be32(h + 28);
+    uint32_t timecnt = be32(h + 32), typecnt = be32(h + 36), charcnt = be32(h + 40);
+    const unsigned char *times = h + 44;
+    const unsigned char *idx = times + timecnt * 8;
+    const unsigned char *types = idx + timecnt;
+    const unsigned char *chars = types + typecnt * 6;
+    const unsigned char *end = chars + charcnt + leap * 12 + isstd + isut;
+    if (typecnt == 0 || end > buf + n) return -1;
+
+    char abbr[TZ_MAX_ABBR];
+    int first_std = 0;
+    for (uint32_t i = 0; i < typecnt; i++)
+        if (!types[i * 6 + 4]) { first_std = (int)i; break; }
+    for (uint32_t i = 0; i <= timecnt; i++) {
+        int ti = i == 0 ? first_std : idx[i - 1];
+        if (ti >= (int)typecnt) return -1;
+        const unsigned char *t = types + ti * 6;
+        int ci = t[5] < charcnt ? t[5] : 0;
+        snprintf(abbr, sizeof(abbr), "%.*s", (int)(charcnt - ci), (const char *)chars + ci);
+        TzTrans tr = { i == 0 ? 0 : be64(times + (i - 1) * 8), (int32_t)be32(t), t[4] ? 1 : 0,
+                       (uint8_t)abbr_index(abbr) };
+        if (i == 0) g_before = tr;
+        else if (g_n_tr < TZ_MAX_TRANS) g_tr[g_n_tr++] = tr;
+    }
+
+    footer[0] = '\0';
+    if (end < buf + n && *end == '\n') {
+        const unsigned char *nl = memchr(end + 1, '\n', (size_t)(buf + n - end - 1));
+        if (nl) snprintf(footer, footer_sz, "%.*s", (int)(nl - end - 1), (const char *)end + 1);
+    }
+    return 0;
+}
+
+static void tz_init(void) {
+    char footer[64];
+    TzRule rule;
+    int loaded = tzif_load(TZ_NY_PATH, footer, sizeof(footer)) == 0;
+    if (!loaded) {
+        g_n_tr = 0;
+        g_n_abbr = 0;
+        logf_("TZ: %s unreadable; using built-in rule %s", TZ_NY_PATH, TZ_NY_RULE);
+    }
+    if (!loaded || !footer[0] || rule_parse(footer, &rule) != 0)
+        rule_parse(TZ_NY_RULE, &rule);
+    rule_extend(&rule, g_n_tr ? g_tr[g_n_tr - 1].at : INT64_MIN);
+}
+
+/* Index of the transition in effect at t (-1 = before the first), with its interval. */
+static int tz_find(int64_t t, int64_t *from, int64_t *until) {
+    int lo = 0, hi = g_n_tr;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (g_tr[mid].at <= t) lo = mid + 1; else hi = mid;
+    }
+    int i = lo - 1;
+    *from = i >= 0 ? g_tr[i].at : INT64_MIN;
+    *until = lo < g_n_tr ? g_tr[lo].at : INT64_MAX;
+    return i;
+}
+
+static const TzTrans *tz_at(time_t t) {
+    pthread_once(&g_once, tz_init);
+    int64_t tt = (int64_t)t;
+    if (!t_cache.valid || tt < t_cache.from || tt >= t_cache.until) {
+        t_cache.idx = tz_find(tt, &t_cache.from, &t_cache.until);
+        t_cache.valid = 1;
+    }
+    return t_cache.idx >= 0 ? &g_tr[t_cache.idx] : &g_before;
+}
+
+long tz_ny_offset(time_t t) {
+    return tz_at(t)->off;
+}
+
+void tz_ny_local(time_t t, struct tm *out) {
+    const TzTrans *tr = tz_at(t);
+    int64_t local = (int64_t)t + tr->off;
+    int64_t days = floor_div(local, 86400);
+    int64_t secs = local - days * 86400;
+    int y, m, d;
+    civil_from_days(days, &y, &m, &d);
+    memset(out, 0, sizeof(*out));
+    out->tm_year = y - 1900;
+    out->tm_mon = m - 1;
+    out->tm_mday = d;
+    out->tm_hour = (int)(secs / 3600);
+    out->tm_min = (int)(secs / 60 % 60);
+    out->tm_sec = (int)(secs % 60);
+    out->tm_wday = (int)(((days % 7) + 11) % 7);
+    out->tm_yday = (int)(days - days_from_civil(y, 1, 1));
+    out->tm_isdst = tr->isdst;
+    out->tm_gmtoff = tr->off;
+    out->tm_zone = g_abbr[tr->abbr];
+}
+
+int tz_ny_ymd(time_t t) {
+    return tz_days_to_ymd((long)floor_div((int64_t)t + tz_ny_offset(t), 86400));
+}
+
+time_t tz_ny_time(int ymd, int mins) {
+    int64_t wall = (int64_t)tz_ymd_to_days(ymd) * 86400 + (int64_t)mins * 60;
+    /* The offset a day earlier is the one before any change near this wall time. */
+    long before = tz_ny_offset((time_t)(wall - 86400));
+    time_t t = (time_t)(wall - before);
+    long at = tz_ny_offset(t);
+    if (at == before) return t;             /* incl. first pass through a repeated hour */
+    time_t t2 = (time_t)(wall - at);
+    return tz_ny_offset(t2) == at ? t2 : t; /* else in the skipped hour: map forward */
+}
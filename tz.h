@@ -0,0 +1,28 @@
+/*
+ * America/New_York time conversion without TZ/tzset(): the zone's transitions are read
+ * from tzdata once (with the built-in US rule as fallback) and every lookup after that
+ * is a pure function, safe from any thread.
+ */
+#pragma once
+
+#include <time.h>
+
+/* Calendar math on YYYYMMDD dates (no zone). */
+long tz_ymd_to_days(int ymd);           /* days since 1970-01-01 */
+int  tz_days_to_ymd(long days);
+int  tz_ymd_add(int ymd, int days);
+int  tz_ymd_wday(int ymd);              /* 0 = Sunday */
+
+/* UTC offset in seconds (east positive) in New York at instant t. */
+long tz_ny_offset(time_t t);
+
+/* localtime_r() for New York. */
+void tz_ny_local(time_t t, struct tm *out);
+
+/* YYYYMMDD in New York at instant t. */
+int tz_ny_ymd(time_t t);
+
+/* Epoch of New York wall-clock time mins (may be < 0 or >= 24 h) on date ymd. Minutes in
+ * the skipped spring-forward hour map forward like mktime(); minutes in the repeated
+ * fall-back hour take the first (daylight) occurrence. */
+time_t tz_ny_time(int ymd, int mins);
@@ -0,0 +1,173 @@
+/*
+ * New York time conversion against known epochs: both 2026 DST changes, local midnight
+ * on those days, years past the tzdata transition table (POSIX footer rule), epoch ->
+ * local -> epoch round trips from several threads, and libc's localtime_r() where
+ * tzdata is installed. Built twice: tz_test reads tzdata, tz_rule_test (with
+ * TZ_TEST_BUILTIN_RULE) links a tz.c that cannot find it and runs on TZ_NY_RULE.
+ */
+#include "tz.h"
+#include "test.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define EST (-5 * 3600)
+#define EDT (-4 * 3600)
+
+static void check_local(time_t t, int ymd, int hh, int mm, int ss, int isdst) {
+    struct tm tm;
+    tz_ny_local(t, &tm);
+    int got = (tm.tm_year + 1900) * 10000 + (tm.tm_mon + 1) * 100 + tm.tm_mday;
+    if (got != ymd || tm.tm_hour != hh || tm.tm_min != mm || tm.tm_sec != ss || tm.tm_isdst != isdst ||
+        tm.tm_gmtoff != (isdst ? EDT : EST) || strcmp(tm.tm_zone, isdst ? "EDT" : "EST") != 0) {
+        fprintf(stderr, "tz_ny_local(%lld) = %d %02d:%02d:%02d dst=%d %s, want %d %02d:%02d:%02d dst=%d\n",
+                (long long)t, got, tm.tm_hour, tm.tm_min, tm.tm_sec, tm.tm_isdst, tm.tm_zone, ymd, hh, mm,
+                ss, isdst);
+        test_failures++;
+    }
+    CHECK(tz_ny_ymd(t) == ymd);
+    CHECK(tz_ny_offset(t) == (isdst ? EDT : EST));
+}
+
+static void check_time(int ymd, int mins, time_t want) {
+    time_t got = tz_ny_time(ymd, mins);
+    if (got != want) {
+        fprintf(stderr, "tz_ny_time(%d, %d) = %lld, want %lld\n", ymd, mins, (long long)got, (long long)want);
+        test_failures++;
+    }
+}
+
+static void check_known(void) {
+    /* 2026-03-08: 02:00 EST jumps to 03:00 EDT */
+    check_time(20260308, 0, 1772946000);                /* midnight, EST */
+    check_time(20260308, 119, 1772953140);              /* 01:59 EST */
+    check_time(20260308, 150, 1772955000);              /* 02:30 does not exist: 03:30 EDT */
+    check_time(20260308, 180, 1772953200);              /* 03:00 EDT */
+    check_time(20260309, 0, 1773028800);                /* next midnight, EDT */
+    check_local(1772953199, 20260308, 1, 59, 59, 0);
+    check_local(1772953200, 20260308, 3, 0, 0, 1);
+
+    /* 2026-11-01: 02:00 EDT falls back to 01:00 EST */
+    check_time(20261101, 0, 1793505600);                /* midnight, EDT */
+    check_time(20261101, 90, 1793511000);               /* 01:30 twice: the first (EDT) */
+    check_time(20261101, 120, 1793516400);              /* 02:00 EST */
+    check_time(20261102, 0, 1793595600);                /* next midnight, EST */
+    check_time(20261101, 24 * 60, 1793595600);          /* minutes past the day's end */
+    check_time(20261102, -60, 1793592000);              /* and before its start */
+    check_local(1793511000, 20261101, 1, 30, 0, 1);
+    check_local(1793514600, 20261101, 1, 30, 0, 0);     /* the repeated 01:30 */
+    check_local(1793516399, 20261101, 1, 59, 59, 0);
+    check_local(1793505599, 20261031, 23, 59, 59, 1);
+
+    /* Past tzdata's table (2037): M3.2.0 / M11.1.0 from the footer rule */
+    check_time(20400311, 180, 2215062000);
+    check_time(20400311, 0, 2215054800);
+    check_time(20401104, 0, 2235614400);
+    check_time(20401104, 90, 2235619800);
+    check_local(2215062000 - 1, 20400311, 1, 59, 59, 0);
+    check_local(2235621600, 20401104, 1, 0, 0, 0);
+    check_time(20990308, 180, 4076636400);
+    check_time(20990308, 0, 4076629200);
+    check_time(20991101, 0, 4097188800);
+    check_time(20991101, 90, 4097194200);
+    check_local(4097196000 - 1, 20991101, 1, 59, 59, 1);
+    check_local(4097196000, 20991101, 1, 0, 0, 0);
+
+    /* Calendar helpers */
+    CHECK(tz_ymd_to_days(19700101) == 0);
+    CHECK(tz_days_to_ymd(tz_ymd_to_days(20240229)) == 20240229);
+    CHECK(tz_ymd_add(20261231, 1) == 20270101);
+    CHECK(tz_ymd_add(20240301, -1) == 20240229);
+    CHECK(tz_ymd_wday(20260308) == 0 && tz_ymd_wday(20261101) == 0);
+}
+
+/* epoch -> local -> epoch over [from, to): every instant comes back, except the
+ * second pass through a repeated hour, which tz_ny_time() maps to the first. */
+typedef struct { time_t from, to, step; int bad; } RoundTrip;
+
+static void *round_trip(void *arg) {
+    RoundTrip *rt = (RoundTrip *)arg;
+    for (time_t t = rt->from; t < rt->to; t += rt->step) {
+        struct tm tm;
+        tz_ny_local(t, &tm);
+        int ymd = (tm.tm_year + 1900) * 10000 + (tm.tm_mon + 1) * 100 + tm.tm_mday;
+        time_t back = tz_ny_time(ymd, tm.tm_hour * 60 + tm.tm_min) + tm.tm_sec;
+        if (back == t) continue;
+        if (back == t - 3600 && !tm.tm_isdst && tz_ny_offset(t - 3600) == EDT) continue;
+        if (rt->bad++ < 3)
+            fprintf(stderr, "round trip %lld -> %d %02d:%02d:%02d -> %lld\n", (long long)t, ymd,
+                    tm.tm_hour, tm.tm_min, tm.tm_sec, (long long)back);
+    }
+    return NULL;
+}
+
+static void check_round_trips(void) {
+    /* Four threads at once (each keeps its own interval cache), 2000..2100. */
+    RoundTrip rt[4];
+    pthread_t th[4];
+    const time_t from = 946684800, span = (4102444800 - 946684800) / 4;
+    for (int i = 0; i < 4; i++) {
+        rt[i] = (RoundTrip){ from + i * span, from + (i + 1) * span, 1799 + 2 * i, 0 };
+        pthread_create(&th[i], NULL, round_trip, &rt[i]);
+    }
+    for (int i = 0; i < 4; i++) {
+        pthread_join(th[i], NULL);
+        CHECK(rt[i].bad == 0);
+    }
+    /* Second by second across both 2026 changes */
+    RoundTrip edge[2] = { { 1772953200 - 7200, 1772953200 + 7200, 1, 0 },
+                          { 1793512800 - 7200, 1793512800 + 7200, 1, 0 } };
+    for (int i = 0; i < 2; i++) {
+        round_trip(&edge[i]);
+        CHECK(edge[i].bad == 0);
+    }
+}
+
+/* Same answers as libc with TZ=America/New_York (from 2007 for the built-in rule,
+ * which only knows the current US dates). */
+static void check_libc(void) {
+    if (access("/usr/share/zoneinfo/America/New_York", R_OK) != 0) {
+        printf("tz_test: no tzdata, skipping the localtime_r() comparison\n");
+        return;
+    }
+    setenv("TZ", "America/New_York", 1);
+    tzset();
+#ifdef TZ_TEST_BUILTIN_RULE
+    const time_t from = 1167609600;                     /* 2007-01-01 */
+#else
+    const time_t from = 0;
+#endif
+    int bad = 0;
+    for (time_t t = from; t < 4102444800; t += 997) {
+        struct tm a, b;
+        tz_ny_local(t, &a);
+        localtime_r(&t, &b);
+        if (a.tm_year != b.tm_year || a.tm_yday != b.tm_yday || a.tm_mon != b.tm_mon ||
+            a.tm_mday != b.tm_mday || a.tm_hour != b.tm_hour || a.tm_min != b.tm_min ||
+            a.tm_sec != b.tm_sec || a.tm_wday != b.tm_wday || a.tm_isdst != b.tm_isdst ||
+            a.tm_gmtoff != b.tm_gmtoff || strcmp(a.tm_zone, b.tm_zone) != 0) {
+            if (bad++ < 3)
+                fprintf(stderr, "t=%lld: tz %02d:%02d %s, libc %02d:%02d %s\n", (long long)t, a.tm_hour,
+                        a.tm_min, a.tm_zone, b.tm_hour, b.tm_min, b.tm_zone);
+        }
+    }
+    CHECK(bad == 0);
+}
+
+int main(void) {
+#ifdef TZ_TEST_BUILTIN_RULE
+    const char *name = "tz_rule_test";
+    /* The rule alone gets 2000 wrong (DST then began in April), tzdata does not. */
+    CHECK(tz_ny_offset(953553600) == EDT);              /* 2000-03-20 12:00 UTC */
+#else
+    const char *name = "tz_test";
+    if (access("/usr/share/zoneinfo/America/New_York", R_OK) == 0)
+        CHECK(tz_ny_offset(953553600) == EST);
+#endif
+    check_known();
+    check_round_trips();
+    check_libc();
+    return test_done(name);
+}
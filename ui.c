@@ -4,8 +4,11 @@
 #include "ui.h"
 #include "texture.h"
 #include "types.h"
+#include "tz.h"
 #include "util.h"
 #include <math.h>
+#include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -57,6 +60,8 @@ static void tile_draw_fallback_panel(SDL_Renderer *r, SDL_Rect rect, int radius)
 #define REF_TEXT_UP_HEADER 22
 #define REF_TEXT_UP_TILE   26
 
+static int s_animation;     /* UI_ANIM_* seen by the last ui_render() */
+
 #define STEAM_PUFFS  2
 #define STEAM_SPHERE_OFFSET 60 /* ref px at 2160p height */
 #define EYE_RADIUS_SCALE  18
@@ -150,6 +155,7 @@ static void draw_tile_left_content(SDL_Renderer *r, Fonts *f, const Arrival *a,
     } else {
         tile_draw_fallback_panel(r, left_rect, radius);
     }
+    text_batch_begin();
     int inner = clampi((int)(32 * scale), 12, 60);
     int tile_up = px_scaled(scale, REF_TEXT_UP_TILE);
     int y = left_rect.y + clampi((int)(20 * scale), 8, 40) + px_scaled(scale, 23) - tile_up;
@@ -195,9 +201,12 @@ static void draw_tile_left_content(SDL_Renderer *r, Fonts *f, const Arrival *a,
     if (a->miles_away >= 0.0) snprintf(milesbuf, sizeof(milesbuf), "%.1f", (double)a->miles_away);
     else snprintf(milesbuf, sizeof(milesbuf), "--");
     char meta[256];
-    snprintf(meta, sizeof(meta), "%s stops  •  %d ppl  •  BUS %s  •  %s mi",
-             stopsbuf, a->ppl_est, busnum, milesbuf);
+    int m = snprintf(meta, sizeof(meta), "%s stops  •  %d ppl  •  BUS %s  •  %s mi",
+                     stopsbuf, a->ppl_est, busnum, milesbuf);
+    if (a->stop[0] && m > 0 && (size_t)m < sizeof(meta))
+        snprintf(meta + m, sizeof(meta) - (size_t)m, "  •  STOP %s", a->stop);
     draw_text(r, f->tile_small, meta, left_x, y2, dim, 0);
+    text_batch_flush(r);
 }
 
 static void draw_tile_right_content(SDL_Renderer *r, Fonts *f, const Arrival *a,
@@ -207,6 +216,7 @@ static void draw_tile_right_content(SDL_Renderer *r, Fonts *f, const Arrival *a,
 
     if (!narrow_tile_tex)
         tile_draw_fallback_panel(r, right_rect, radius);
+    text_batch_begin();
 
     char minsbuf[16];
     if (a->mins == 0) snprintf(minsbuf, sizeof(minsbuf), "NOW");
@@ -244,12 +254,14 @@ static void draw_tile_right_content(SDL_Renderer *r, Fonts *f, const Arrival *a,
         draw_text(r, mins_font, minsbuf, center_x, top_y, eta_color, 1);
         draw_text(r, f->tile_small, "min", center_x, top_y + h1 + line_gap - px_scaled(scale, 20), dim, 1);
     }
+    text_batch_flush(r);
 }
 
-/* True if left-part fields changed (route, dest, bus, stops, ppl, miles). */
+/* True if left-part fields changed (route, dest, bus, stop, stops, ppl, miles). */
 static int arrival_left_changed(const Arrival *a, const Arrival *b) {
     return strcmp(a->route, b->route) != 0 || strcmp(a->dest, b->dest) != 0 ||
-           strcmp(a->bus, b->bus) != 0 || a->stops_away != b->stops_away ||
+           strcmp(a->bus, b->bus) != 0 || strcmp(a->stop, b->stop) != 0 ||
+           a->stops_away != b->stops_away ||
            a->ppl_est != b->ppl_est || (a->miles_away != b->miles_away);
 }
 
@@ -281,18 +293,21 @@ static void render_right_to_texture(SDL_Renderer *r, Fonts *f, SDL_Texture *tex,
     render_target_end(r);
 }
 
-static void draw_background_and_steam(SDL_Renderer *r, int W, int H,
-                                      int body_y, float scale,
-                                      SDL_Texture *bg_tex, SDL_Texture *steam_tex) {
-    const int bg_h = H - body_y; /* same vertical span as background RenderCopy dst */
+static void draw_background(SDL_Renderer *r, int W, int H, int body_y, SDL_Texture *bg_tex) {
+    SDL_SetRenderDrawColor(r, 10, 12, 16, 255);
+    SDL_RenderClear(r);
     if (bg_tex) {
-        SDL_Rect dst = { 0, body_y, W, bg_h };
+        SDL_Rect dst = { 0, body_y, W, H - body_y };
         /* ~48%: low enough for UI contrast, high enough to read on dark clear (10,12,16). */
         SDL_SetTextureAlphaMod(bg_tex, 122);
         SDL_RenderCopy(r, bg_tex, NULL, &dst);
         SDL_SetTextureAlphaMod(bg_tex, 255);
     }
+}
 
+static void draw_steam(SDL_Renderer *r, int W, int H, int body_y, float scale,
+                       SDL_Texture *steam_tex) {
+    const int bg_h = H - body_y; /* same vertical span as the background */
     if (!steam_tex) return;
 
     static SteamPuff puffs[STEAM_PUFFS];
@@ -341,7 +356,7 @@ static void draw_background_and_steam(SDL_Renderer *r, int W, int H,
     float frame = 1.0f / 60.0f;
     float dt_norm = dt > 0.f ? dt / frame : 1.f;
     if (dt_norm < 0.25f) dt_norm = 0.25f;
-    if (dt_norm > 4.0f) dt_norm = 4.0f;
+    if (dt_norm > 8.0f) dt_norm = 8.0f;     /* keeps pace down to AMBIENT_FPS=8 */
 
     SDL_SetTextureBlendMode(steam_tex, SDL_BLENDMODE_BLEND);
     const float speed_scale = (1.0f / 25.0f) * 1.3f;
@@ -414,6 +429,13 @@ static void draw_eyes(SDL_Renderer *r, int W, int H, int body_y, float scale) {
     }
 }
 
+/* Header date/time; changes once a minute. */
+static void header_clock(char *ts, size_t tssz) {
+    struct tm lt;
+    tz_ny_local(time(NULL), &lt);
+    strftime(ts, tssz, "%a %b %-d  %-I:%M %p", &lt);
+}
+
 static void draw_header(SDL_Renderer *r, Fonts *f, int W, int pad, int header_h,
                         const char *stop_id, const char *stop_name, Weather *wx,
                         TTF_Font *symbol_font, TTF_Font *emoji_font, float scale) {
@@ -424,6 +446,7 @@ static void draw_header(SDL_Renderer *r, Fonts *f, int W, int pad, int header_h,
     SDL_Rect hdr = { pad, pad, W - 2 * pad, header_h };
     SDL_SetRenderDrawColor(r, 22, 26, 34, 255);
     fill_round_rect(r, hdr, clampi((int)(24 * scale), 10, 40));
+    text_batch_begin();
 
     int hdr_up = px_scaled(scale, REF_TEXT_UP_HEADER);
     int title_y = hdr.y + clampi((int)(22 * scale), 10, 36) - hdr_up;
@@ -443,11 +466,8 @@ static void draw_header(SDL_Renderer *r, Fonts *f, int W, int pad, int header_h,
     draw_text(r, f->h2, left2, left_x, top_y + clampi((int)(78 * scale), 44, 120), dim, 0);
 
     int right_x = hdr.x + hdr.w - pad;
-    time_t now = time(NULL);
-    struct tm lt;
-    localtime_r(&now, &lt);
     char ts[64];
-    strftime(ts, sizeof(ts), "%a %b %-d  %-I:%M %p", &lt);
+    header_clock(ts, sizeof(ts));
     int ts_w = 0, ts_h = 0;
     text_size(f->h2, ts, &ts_w, &ts_h);
     int time_moon_gap = clampi((int)(10 * scale), 6, 20);
@@ -511,26 +531,28 @@ static void draw_header(SDL_Renderer *r, Fonts *f, int W, int pad, int header_h,
         draw_text(r, f->h2, "Weather --", weather_right_x,
                   hdr.y + pad + ts_h + right_line_gap + weather_line_offset - hdr_up, dim, 2);
     }
+    text_batch_flush(r);
 }
 
-static void draw_footer(SDL_Renderer *r, Fonts *f, int W, int H,
-                        int pad, SDL_Texture *logo_tex, float scale,
-                        int body_y, int body_h) {
-    (void)H;
-    SDL_Color dim = { 210, 210, 210, 255 };
-
+/* The footer's grid cell: the empty bottom-right one (col 1, row 5) - slot 11. */
+static SDL_Rect footer_cell(int W, int pad, float scale, int body_y, int body_h) {
     const int cols = TILE_COLS_FIXED;
     const int rows = TILE_ROWS_FIXED;
     int gap = clampi((int)(20 * scale), 2, 48);
     int tile_w = (W - 2 * pad - gap * (cols - 1)) / cols;
     int tile_h = (body_h - gap * (rows - 1)) / rows;
-    /* Empty cell is bottom-right (col 1, row 5) - slot 11. */
     SDL_Rect cell = {
         pad + 1 * (tile_w + gap),
         body_y + 5 * (tile_h + gap),
         tile_w,
         tile_h
     };
+    return cell;
+}
+
+static void draw_footer(SDL_Renderer *r, Fonts *f, SDL_Rect cell,
+                        SDL_Texture *logo_tex, float scale) {
+    SDL_Color dim = { 210, 210, 210, 255 };
 
     /* Copyright text: "(C) 2026 " in small font; name in small Smythe (title_small) at larger size. */
     static const char copy_left[] = "\xC2\xA9 2026 ";
@@ -585,6 +607,7 @@ static void draw_footer(SDL_Renderer *r, Fonts *f, int W, int H,
     int copy_y = cell.y + (cell.h - copy_h) / 2;
     /* Left part: © and year in small font, vertically centered within combined block. */
     int left_y = copy_y + (copy_h - left_h) / 2;
+    text_batch_begin();
     draw_text(r, f->tile_small, copy_left,
               copy_x,
               left_y,
@@ -595,21 +618,16 @@ static void draw_footer(SDL_Renderer *r, Fonts *f, int W, int H,
               copy_x + left_w,
               name_y,
               dim, 0);
+    text_batch_flush(r);
 }
 
 /* Format scheduled when (America/New_York): today = "2:30 PM", tomorrow = "tomorrow 2:30 PM", else "Wed 2:30 PM". */
 static void format_scheduled_time(time_t when, char *buf, size_t bufsz) {
-    tz_set_ny();
-    time_t now = time(NULL);
-    struct tm tm_when, tm_now;
-    localtime_r(&when, &tm_when);
-    localtime_r(&now, &tm_now);
+    struct tm tm_when;
+    tz_ny_local(when, &tm_when);
     int when_ymd = (tm_when.tm_year + 1900) * 10000 + (tm_when.tm_mon + 1) * 100 + tm_when.tm_mday;
-    int now_ymd = (tm_now.tm_year + 1900) * 10000 + (tm_now.tm_mon + 1) * 100 + tm_now.tm_mday;
-    time_t tomorrow_sec = now + 24 * 3600;
-    struct tm tm_tomorrow;
-    localtime_r(&tomorrow_sec, &tm_tomorrow);
-    int tomorrow_ymd = (tm_tomorrow.tm_year + 1900) * 10000 + (tm_tomorrow.tm_mon + 1) * 100 + tm_tomorrow.tm_mday;
+    int now_ymd = tz_ny_ymd(time(NULL));
+    int tomorrow_ymd = tz_ymd_add(now_ymd, 1);
 
     char time_part[32];
     strftime(time_part, sizeof(time_part), "%I:%M %p", &tm_when);
@@ -637,6 +655,7 @@ static void draw_scheduled_tile_content(SDL_Renderer *r, Fonts *f, const Schedul
 
     if (!wide_tile_tex)
         tile_draw_fallback_panel(r, rect, radius);
+    text_batch_begin();
 
     const char *route = s->route[0] ? s->route : "--";
     const char *dest  = s->dest[0]  ? s->dest  : "--";
@@ -654,8 +673,13 @@ static void draw_scheduled_tile_content(SDL_Renderer *r, Fonts *f, const Schedul
 
     char line2[128];
     format_scheduled_time(s->when, line2, sizeof(line2));
+    if (s->stop[0]) {
+        size_t n = strlen(line2);
+        snprintf(line2 + n, sizeof(line2) - n, "  •  STOP %s", s->stop);
+    }
     int y2 = y + clampi((int)(120 * scale), 70, 190);
     draw_text(r, f->tile_small, line2, x, y2, dim, 0);
+    text_batch_flush(r);
 }
 
 static void flip_part_advance(FlipPart *fp, float dt_ms, int *ended) {
@@ -944,6 +968,9 @@ static void draw_tile_grid(SDL_Renderer *r, Fonts *f, int W, int body_y, int bod
         draw_center_divider(r, trc, tile_h, scale);
     }
 
+    for (int i = 0; i < realtime_count; i++)
+        if (slots[i].left.animating || slots[i].right.animating) s_animation |= UI_ANIM_FLIP;
+
     if (flip_ended_this_frame && on_flip_ended)
         on_flip_ended(flip_userdata);
 }
@@ -988,6 +1015,85 @@ static void draw_health_overlay(SDL_Renderer *r, Fonts *f, int W, int H, const c
     draw_text(r, f->h2, "Press the configure button on the Raspberry Pi Zero to run setup.", x, y, accent, 0);
 }
 
+/* ---- Static layers -----------------------------------------------------------------
+ * The background, the header (panel, title, stop, clock, weather) and the footer cell
+ * only change with their inputs, so each is drawn into a render target when its key
+ * changes and composited with one copy per frame. Steam, eyes and tiles stay per frame. */
+
+typedef enum { LAYER_BACKGROUND, LAYER_HEADER, LAYER_FOOTER, LAYER_COUNT } LayerId;
+
+typedef struct {
+    SDL_Texture *tex;
+    int          w, h;
+    int          valid;
+    uint64_t     key;       /* hash of the inputs the content was drawn from */
+    int          broken;    /* no target or blend support: draw to the screen instead */
+    long         redraws;
+} UiLayer;
+
+static UiLayer s_layers[LAYER_COUNT];
+static long s_frames;
+
+static uint64_t layer_key(const char *fmt, ...) {
+    char buf[1024];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (n < 0) n = 0;
+    if ((size_t)n >= sizeof(buf)) n = (int)sizeof(buf) - 1;
+    return hash_bytes(buf, (size_t)n, 0);
+}
+
+/* Returns 1 with l's target set and cleared when its content must be redrawn, 0 when
+ * it is current, -1 when layers are unavailable (draw to the screen directly). */
+static int layer_begin(SDL_Renderer *r, UiLayer *l, int w, int h, uint64_t key, int opaque) {
+    if (l->broken) return -1;
+    if (!l->tex || l->w != w || l->h != h) {
+        if (l->tex) SDL_DestroyTexture(l->tex);
+        l->tex = SDL_CreateTexture(r, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, w, h);
+        /* Blending onto a transparent target leaves premultiplied color, so composite
+         * with ONE / ONE_MINUS_SRC_ALPHA rather than darken edges a second time. */
+        SDL_BlendMode mode = opaque ? SDL_BLENDMODE_NONE :
+            SDL_ComposeCustomBlendMode(SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA,
+                                       SDL_BLENDOPERATION_ADD,
+                                       SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA,
+                                       SDL_BLENDOPERATION_ADD);
+        if (!l->tex || SDL_SetTextureBlendMode(l->tex, mode) != 0) {
+            logf_("UI layer %dx%d unavailable (%s); drawing it every frame", w, h, SDL_GetError());
+            if (l->tex) SDL_DestroyTexture(l->tex);
+            l->tex = NULL;
+            l->broken = 1;
+            return -1;
+        }
+        l->w = w;
+        l->h = h;
+        l->valid = 0;
+    }
+    if (l->valid && l->key == key) return 0;
+    render_target_begin_clear_transparent(r, l->tex);
+    l->key = key;
+    l->valid = 1;
+    l->redraws++;
+    return 1;
+}
+
+/* Finish layer_begin()'s redraw, if any, and composite the layer at (x, y). */
+static void layer_finish(SDL_Renderer *r, UiLayer *l, int st, int x, int y) {
+    if (st == 1) render_target_end(r);
+    if (st < 0) return;
+    SDL_Rect dst = { x, y, l->w, l->h };
+    SDL_RenderCopy(r, l->tex, NULL, &dst);
+}
+
+void ui_log_stats(void) {
+    logf_("UI_LAYERS frames=%ld redraws background=%ld header=%ld footer=%ld",
+          s_frames, s_layers[LAYER_BACKGROUND].redraws, s_layers[LAYER_HEADER].redraws,
+          s_layers[LAYER_FOOTER].redraws);
+    s_frames = 0;
+    for (int i = 0; i < LAYER_COUNT; i++) s_layers[i].redraws = 0;
+}
+
 void ui_render(SDL_Renderer *r, Fonts *f, int W, int H,
                const char *stop_id, const char *stop_name,
                Weather *wx, Arrival *arr, int n,
@@ -999,25 +1105,45 @@ void ui_render(SDL_Renderer *r, Fonts *f, int W, int H,
                const char *health_message) {
     SDL_Color white = { 255, 255, 255, 255 };
 
-    SDL_SetRenderDrawColor(r, 10, 12, 16, 255);
-    SDL_RenderClear(r);
-
     float scale = layout_scale(H);
     int pad = clampi((int)(46 * scale), 18, 90);
     int header_h = clampi((int)(220 * scale), 120, 380);
     int body_y = pad + header_h + pad;
     int body_h = H - body_y - pad;
     if (body_h < 100) body_h = 100;
+    s_frames++;
+    s_animation = UI_ANIM_AMBIENT;     /* eye pulse (and steam) always move */
 
-    draw_background_and_steam(r, W, H, body_y, scale, bg_tex, steam_tex);
-    draw_eyes(r, W, H, body_y, scale);
-    draw_header(r, f, W, pad, header_h, stop_id, stop_name, wx, symbol_font, emoji_font, scale);
+    UiLayer *layer = &s_layers[LAYER_BACKGROUND];
+    int st = layer_begin(r, layer, W, H, layer_key("%d %d %d %p", W, H, body_y, (void *)bg_tex), 1);
+    if (st != 0) draw_background(r, W, H, body_y, bg_tex);
+    layer_finish(r, layer, st, 0, 0);
 
-    body_y = pad + header_h + pad;
-    body_h = H - body_y - pad;
-    if (body_h < 100) body_h = 100;
+    draw_steam(r, W, H, body_y, scale, steam_tex);
+    draw_eyes(r, W, H, body_y, scale);
 
-    draw_footer(r, f, W, H, pad, logo_tex, scale, body_y, body_h);
+    /* Header inputs: the layer is redrawn when the clock minute, stop or weather changes. */
+    char ts[64];
+    header_clock(ts, sizeof(ts));
+    int moon_idx = (wx && wx->have && wx->moon_phase >= 0.f && emoji_font)
+                 ? (int)(wx->moon_phase * 8) % 8 : -1;
+    layer = &s_layers[LAYER_HEADER];
+    st = layer_begin(r, layer, W, body_y,
+                     layer_key("%d %d %p %p %s|%s|%s|%d %d %d %.2f %s %d", W, H, (void *)f,
+                               (void *)emoji_font, stop_id ? stop_id : "", stop_name ? stop_name : "",
+                               ts, wx ? wx->have : 0, wx ? wx->temp_f : 0,
+                               wx ? wx->precip_prob : 0, wx ? wx->precip_in : 0.0,
+                               wx ? wx->icon : "", moon_idx), 0);
+    if (st != 0) draw_header(r, f, W, pad, header_h, stop_id, stop_name, wx, symbol_font, emoji_font, scale);
+    layer_finish(r, layer, st, 0, 0);
+
+    SDL_Rect cell = footer_cell(W, pad, scale, body_y, body_h);
+    layer = &s_layers[LAYER_FOOTER];
+    st = layer_begin(r, layer, cell.w, cell.h,
+                     layer_key("%d %d %p %p", W, H, (void *)f, (void *)logo_tex), 0);
+    if (st == 1) draw_footer(r, f, (SDL_Rect){ 0, 0, cell.w, cell.h }, logo_tex, scale);
+    else if (st < 0) draw_footer(r, f, cell, logo_tex, scale);
+    layer_finish(r, layer, st, cell.x, cell.y);
 
     if (n <= 0 && ( !scheduled || ns <= 0)) {
         draw_text(r, f->h1, "No upcoming buses", W / 2, body_y + body_h / 2, white, 1);
@@ -1031,6 +1157,10 @@ void ui_render(SDL_Renderer *r, Fonts *f, int W, int H,
     SDL_RenderPresent(r);
 }
 
+int ui_animation(void) {
+    return s_animation;
+}
+
 void ui_render_config(SDL_Renderer *r, Fonts *f, int W, int H, const char *status) {
     SDL_Color white  = { 255, 255, 255, 255 };
     SDL_Color accent = { 100, 220, 255, 255 };
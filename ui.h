@@ -20,5 +20,15 @@ void ui_render(SDL_Renderer *r, Fonts *f, int W, int H,
                void (*on_flip_ended)(void*), void *flip_userdata,
                const char *health_message);
 
+#define UI_ANIM_FLIP    1     /* split-flap flips running or about to start */
+#define UI_ANIM_AMBIENT 2     /* steam puffs and the eye pulse */
+
+/* UI_ANIM_* flags for what moved in the last ui_render(), for frame pacing. */
+int ui_animation(void);
+
+/* Log frames rendered and static layer redraws (background, header, footer) since the
+ * last call. */
+void ui_log_stats(void);
+
 /* Render the phone setup instructions while Arrival Board is suspended. */
 void ui_render_config(SDL_Renderer *r, Fonts *f, int W, int H, const char *status);
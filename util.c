@@ -1,26 +1,20 @@
 /*
- * Utility implementation: logging, HTTP, JSON accessors.
+ * Utility implementation: logging, streaming JSON.
  */
 #include "util.h"
 #include "types.h"
+#include <limits.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <time.h>
-#include <unistd.h>
-#include <sys/wait.h>
 
 int clampi(int v, int lo, int hi) {
     return (v < lo) ? lo : (v > hi) ? hi : v;
 }
 
-void tz_set_ny(void) {
-    setenv("TZ", "America/New_York", 1);
-    tzset();
-}
-
 int arrivals_refresh_eta(Arrival *arr, int n, time_t now) {
     if (!arr || n <= 0) return 0;
     int out = 0;
@@ -38,6 +32,49 @@ int arrivals_refresh_eta(Arrival *arr, int n, time_t now) {
     return out;
 }
 
+int arrival_same(const Arrival *a, const Arrival *b) {
+    if (a->expected != b->expected) return 0;
+    if (a->expected <= 0 && a->mins != b->mins) return 0;
+    return strcmp(a->route, b->route) == 0 && strcmp(a->bus, b->bus) == 0 &&
+           strcmp(a->dest, b->dest) == 0 && strcmp(a->stop, b->stop) == 0 &&
+           a->stops_away == b->stops_away && a->ppl_est == b->ppl_est &&
+           a->miles_away == b->miles_away;
+}
+
+/* Four independent multiply-xorshift lanes over 32-byte blocks, so the multiplies
+ * overlap instead of forming one long dependency chain. */
+static uint64_t hash_mix(uint64_t h) {
+    h ^= h >> 31;
+    h *= 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 29;
+    return h;
+}
+
+uint64_t hash_bytes(const void *data, size_t len, uint64_t seed) {
+    const unsigned char *p = (const unsigned char *)data;
+    uint64_t h[4] = { seed ^ 0x9E3779B97F4A7C15ull, seed + 0x94D049BB133111EBull,
+                      ~seed, seed * 0xD6E8FEB86659FD93ull };
+    const uint64_t k = 0xFF51AFD7ED558CCDull;
+    size_t n = len;
+    for (; n >= 32; n -= 32, p += 32) {
+        for (int i = 0; i < 4; i++) {
+            uint64_t w;
+            memcpy(&w, p + 8 * i, 8);
+            h[i] = (h[i] ^ w) * k;
+            h[i] ^= h[i] >> 32;
+        }
+    }
+    unsigned char tail[32] = { 0 };
+    memcpy(tail, p, n);
+    uint64_t r = (uint64_t)len * k;
+    for (int i = 0; i < 4; i++) {
+        uint64_t w;
+        memcpy(&w, tail + 8 * i, 8);
+        r = hash_mix(r ^ hash_mix(h[i] ^ w));
+    }
+    return r;
+}
+
 float layout_scale(int screen_height) {
     return (screen_height > 0) ? ((float)screen_height / (float)LAYOUT_REF_HEIGHT) : 1.0f;
 }
@@ -45,8 +82,10 @@ float layout_scale(int screen_height) {
 void logf_(const char *fmt, ...) {
     va_list ap;
     va_start(ap, fmt);
+    flockfile(stderr);      /* one line at a time when feeds load concurrently */
     vfprintf(stderr, fmt, ap);
     fputc('\n', stderr);
+    funlockfile(stderr);
     va_end(ap);
 }
 
@@ -90,94 +129,244 @@ void urlencode(char *out, size_t outsz, const char *in) {
     out[o] = '\0';
 }
 
-/* Single attempt: run curl (new process = fresh connection). Returns malloc'd string or NULL. */
-static char *http_get_one(const char *url) {
-    if (!url) return NULL;
-    char cmd[2048];
-    snprintf(cmd, sizeof(cmd),
-             "curl -fsSL --connect-timeout 10 --max-time 20 --retry 1 --retry-delay 1 --retry-connrefused '%s'",
-             url);
-    FILE *fp = popen(cmd, "r");
-    if (!fp) return NULL;
-
-    size_t cap = 64 * 1024;
-    const size_t max_cap = 4 * 1024 * 1024;
-    size_t len = 0;
-    char *buf = (char *)malloc(cap);
-    if (!buf) { pclose(fp); return NULL; }
-
-    int ch;
-    while ((ch = fgetc(fp)) != EOF) {
-        if (len + 2 > cap) {
-            if (cap >= max_cap) {
-                logf_("HTTP_GET_FAIL response exceeds %zu bytes, aborting", max_cap);
-                free(buf); pclose(fp); return NULL;
+int is_express_route(const char *route) {
+    if (!route || !route[0]) return 0;
+    return (strncmp(route, "QM", 2) == 0 || strncmp(route, "BM", 2) == 0 ||
+            strncmp(route, "BxM", 3) == 0 || route[0] == 'X');
+}
+
+/* ---- Streaming JSON ---------------------------------------------------------- */
+
+typedef struct {
+    const char *p, *end;
+    JsonSeg     path[JSON_MAX_DEPTH];
+    int         depth;
+    JsonFn      fn;
+    void       *ctx;
+    int         stop;       /* nonzero value returned by fn */
+} JsonWalker;
+
+static void jw_ws(JsonWalker *w) {
+    while (w->p < w->end && (*w->p == ' ' || *w->p == '\n' || *w->p == '\r' || *w->p == '\t')) w->p++;
+}
+
+/* String at w->p (opening quote); body returned raw, escapes intact. */
+static int jw_string(JsonWalker *w, const char **s, size_t *len) {
+    const char *q = w->p + 1;
+    *s = q;
+    while (q < w->end && *q != '"') {
+        if ((unsigned char)*q < 0x20) return -1;
+        if (*q == '\\' && ++q >= w->end) return -1;
+        q++;
+    }
+    if (q >= w->end) return -1;
+    *len = (size_t)(q - *s);
+    w->p = q + 1;
+    return 0;
+}
+
+static void jw_emit(JsonWalker *w, JsonType type, const char *s, size_t len) {
+    JsonTok t = { type, s, len, w->depth, w->path };
+    w->stop = w->fn(&t, w->ctx);
+}
+
+static int jw_value(JsonWalker *w) {
+    jw_ws(w);
+    if (w->p >= w->end) return -1;
+    const char c = *w->p;
+    if (c == '{' || c == '[') {
+        const int obj = c == '{';
+        const char close = obj ? '}' : ']';
+        if (w->depth >= JSON_MAX_DEPTH) return -1;
+        jw_emit(w, obj ? JSON_OBJECT : JSON_ARRAY, w->p, 1);
+        if (w->stop) return 0;
+        w->p++;
+        jw_ws(w);
+        if (w->p < w->end && *w->p == close) {
+            w->p++;
+        } else {
+            for (int i = 0;; i++) {
+                JsonSeg *seg = &w->path[w->depth];
+                seg->key = NULL;
+                seg->key_len = 0;
+                seg->index = obj ? -1 : i;
+                if (obj) {
+                    jw_ws(w);
+                    if (w->p >= w->end || *w->p != '"' || jw_string(w, &seg->key, &seg->key_len) != 0)
+                        return -1;
+                    jw_ws(w);
+                    if (w->p >= w->end || *w->p++ != ':') return -1;
+                }
+                w->depth++;
+                int rc = jw_value(w);
+                w->depth--;
+                if (rc != 0 || w->stop) return rc;
+                jw_ws(w);
+                if (w->p >= w->end) return -1;
+                if (*w->p == ',') { w->p++; continue; }
+                if (*w->p++ == close) break;
+                return -1;
             }
-            cap *= 2;
-            if (cap > max_cap) cap = max_cap;
-            char *nb = (char *)realloc(buf, cap);
-            if (!nb) { free(buf); pclose(fp); return NULL; }
-            buf = nb;
         }
-        buf[len++] = (char)ch;
+        jw_emit(w, JSON_END, NULL, 0);
+        return 0;
     }
-    buf[len] = '\0';
-    int rc = pclose(fp);
-    if (rc != 0) {
-        if (WIFEXITED(rc))
-            logf_("HTTP_GET_FAIL url=%s exit=%d", url, WEXITSTATUS(rc));
-        else if (WIFSIGNALED(rc))
-            logf_("HTTP_GET_FAIL url=%s signal=%d", url, WTERMSIG(rc));
-        else
-            logf_("HTTP_GET_FAIL url=%s rc=%d", url, rc);
-        free(buf);
-        return NULL;
+    if (c == '"') {
+        const char *s;
+        size_t n;
+        if (jw_string(w, &s, &n) != 0) return -1;
+        jw_emit(w, JSON_STRING, s, n);
+        return 0;
     }
-    return buf;
+    static const struct { const char *word; JsonType type; } lit[] = {
+        { "true", JSON_TRUE }, { "false", JSON_FALSE }, { "null", JSON_NULL },
+    };
+    for (size_t i = 0; i < sizeof(lit) / sizeof(lit[0]); i++) {
+        size_t n = strlen(lit[i].word);
+        if ((size_t)(w->end - w->p) >= n && memcmp(w->p, lit[i].word, n) == 0) {
+            jw_emit(w, lit[i].type, w->p, n);
+            w->p += n;
+            return 0;
+        }
+    }
+    if (c != '-' && (c < '0' || c > '9')) return -1;
+    const char *s = w->p;
+    while (w->p < w->end && (strchr("+-.eE", *w->p) || (*w->p >= '0' && *w->p <= '9'))) w->p++;
+    jw_emit(w, JSON_NUMBER, s, (size_t)(w->p - s));
+    return 0;
 }
 
-char *http_get(const char *url) {
-    if (!url) return NULL;
-    char *buf = http_get_one(url);
-    if (!buf) {
-        sleep(2);
-        buf = http_get_one(url);
+int json_walk(const char *buf, size_t len, JsonFn fn, void *ctx) {
+    if (!buf || !fn) return -1;
+    JsonWalker w;
+    w.p = buf;
+    w.end = buf + len;
+    w.depth = 0;
+    w.fn = fn;
+    w.ctx = ctx;
+    w.stop = 0;
+    if (jw_value(&w) != 0) return -1;
+    return w.stop;
+}
+
+int json_match(const JsonTok *t, int from, const char *pattern) {
+    int d = from;
+    for (const char *p = pattern; *p;) {
+        const char *dot = strchr(p, '.');
+        size_t n = dot ? (size_t)(dot - p) : strlen(p);
+        if (d >= t->depth) return -1;
+        const JsonSeg *s = &t->path[d++];
+        if (n == 1 && *p == '*') {
+            /* any member or element */
+        } else if (n == 1 && *p == '#') {
+            if (s->index < 0) return -1;
+        } else if (s->index >= 0 || s->key_len != n || memcmp(s->key, p, n) != 0) {
+            return -1;
+        }
+        p += n;
+        if (*p == '.') p++;
     }
-    return buf;
+    return d;
 }
 
-int is_express_route(const char *route) {
-    if (!route || !route[0]) return 0;
-    return (strncmp(route, "QM", 2) == 0 || strncmp(route, "BM", 2) == 0 ||
-            strncmp(route, "BxM", 3) == 0 || route[0] == 'X');
+static void put_utf8(char *out, size_t outsz, size_t *o, unsigned cp) {
+    char b[4];
+    size_t n;
+    if (cp < 0x80) { b[0] = (char)cp; n = 1; }
+    else if (cp < 0x800) { b[0] = (char)(0xC0 | cp >> 6); b[1] = (char)(0x80 | (cp & 0x3F)); n = 2; }
+    else if (cp < 0x10000) {
+        b[0] = (char)(0xE0 | cp >> 12); b[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        b[2] = (char)(0x80 | (cp & 0x3F)); n = 3;
+    } else {
+        b[0] = (char)(0xF0 | cp >> 18); b[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+        b[2] = (char)(0x80 | ((cp >> 6) & 0x3F)); b[3] = (char)(0x80 | (cp & 0x3F)); n = 4;
+    }
+    for (size_t i = 0; i < n && *o + 1 < outsz; i++) out[(*o)++] = b[i];
 }
 
-const cJSON *jgeto(const cJSON *o, const char *k) {
-    if (!o || !cJSON_IsObject(o)) return NULL;
-    return cJSON_GetObjectItemCaseSensitive((cJSON *)o, k);
+/* Length of out[0..o) without a UTF-8 sequence cut off at its end. */
+static size_t utf8_trim(const char *out, size_t o) {
+    size_t i = o, cont = 0;
+    while (i > 0 && cont < 3 && ((unsigned char)out[i - 1] & 0xC0) == 0x80) i--, cont++;
+    if (i == 0) return o;
+    unsigned char lead = (unsigned char)out[i - 1];
+    size_t need = lead >= 0xF0 ? 3 : lead >= 0xE0 ? 2 : lead >= 0xC0 ? 1 : 0;
+    return need > cont ? i - 1 : o;
+}
+
+static int hex4(const char *s, const char *end, unsigned *v) {
+    if (end - s < 4) return -1;
+    *v = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = s[i];
+        int d = (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10
+              : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+        if (d < 0) return -1;
+        *v = *v << 4 | (unsigned)d;
+    }
+    return 0;
 }
 
-const cJSON *jgeti(const cJSON *a, int idx) {
-    if (!a || !cJSON_IsArray(a)) return NULL;
-    return cJSON_GetArrayItem((cJSON *)a, idx);
+const char *json_str(const JsonTok *t, char *out, size_t outsz) {
+    if (!t || t->type != JSON_STRING || !out || outsz == 0) return NULL;
+    const char *s = t->s, *end = t->s + t->len;
+    size_t o = 0;
+    while (s < end && o + 1 < outsz) {
+        if (*s != '\\') { out[o++] = *s++; continue; }
+        if (++s >= end) break;
+        char c = *s++;
+        unsigned cp;
+        switch (c) {
+            case 'b': out[o++] = '\b'; break;
+            case 'f': out[o++] = '\f'; break;
+            case 'n': out[o++] = '\n'; break;
+            case 'r': out[o++] = '\r'; break;
+            case 't': out[o++] = '\t'; break;
+            case 'u':
+                if (hex4(s, end, &cp) != 0) { out[o] = '\0'; return out; }
+                s += 4;
+                if (cp >= 0xD800 && cp < 0xDC00) {
+                    unsigned lo;
+                    if (end - s >= 6 && s[0] == '\\' && s[1] == 'u' && hex4(s + 2, end, &lo) == 0 &&
+                        lo >= 0xDC00 && lo < 0xE000) {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                        s += 6;
+                    }
+                }
+                if (cp >= 0xD800 && cp < 0xE000) cp = 0xFFFD;     /* unpaired surrogate */
+                put_utf8(out, outsz, &o, cp);
+                break;
+            default: out[o++] = c; break;     /* \" \\ \/ */
+        }
+    }
+    if (o + 1 >= outsz) o = utf8_trim(out, o);
+    out[o] = '\0';
+    return out;
 }
 
-const char *jgets(const cJSON *v) {
-    if (!v) return NULL;
-    if (cJSON_IsString(v) && v->valuestring) return v->valuestring;
-    return NULL;
+/* Number or string token as a C string for strtod/atoi; "" for anything else. */
+static const char *json_scalar_text(const JsonTok *t, char *buf, size_t bufsz) {
+    if (t->type == JSON_STRING) return json_str(t, buf, bufsz);
+    if (t->type != JSON_NUMBER) return NULL;
+    size_t n = t->len < bufsz - 1 ? t->len : bufsz - 1;
+    memcpy(buf, t->s, n);
+    buf[n] = '\0';
+    return buf;
 }
 
-int jint(const cJSON *v, int defv) {
-    if (!v) return defv;
-    if (cJSON_IsNumber(v)) return v->valueint;
-    if (cJSON_IsString(v) && v->valuestring) return atoi(v->valuestring);
-    return defv;
+int json_int(const JsonTok *t, int defv) {
+    char buf[64];
+    const char *s = t ? json_scalar_text(t, buf, sizeof(buf)) : NULL;
+    if (!s) return defv;
+    if (t->type == JSON_STRING) return atoi(s);
+    double d = strtod(s, NULL);
+    if (d >= (double)INT_MAX) return INT_MAX;
+    if (d <= (double)INT_MIN) return INT_MIN;
+    return (int)d;
 }
 
-double jdouble(const cJSON *v, double defv) {
-    if (!v) return defv;
-    if (cJSON_IsNumber(v)) return v->valuedouble;
-    if (cJSON_IsString(v) && v->valuestring) return atof(v->valuestring);
-    return defv;
+double json_double(const JsonTok *t, double defv) {
+    char buf[64];
+    const char *s = t ? json_scalar_text(t, buf, sizeof(buf)) : NULL;
+    return s ? strtod(s, NULL) : defv;
 }
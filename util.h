@@ -1,12 +1,12 @@
 /*
- * Utility helpers: logging, HTTP, JSON accessors.
+ * Utility helpers: logging, streaming JSON.
  * Used by main.c, mta.c, weather.c, ui.c.
  */
 #pragma once
 
 #include "types.h"
-#include <cjson/cJSON.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <time.h>
 
 /* Clamp integer v to [lo, hi]. */
@@ -24,9 +24,6 @@ void log_to_boot_log(const char *fmt, ...);
 /* URL-encode string 'in' into 'out', at most outsz bytes. Stops at first NUL. */
 void urlencode(char *out, size_t outsz, const char *in);
 
-/* Fetch URL via curl; returns malloc'd string or NULL. Caller must free. */
-char *http_get(const char *url);
-
 /* Return 1 if route is an Express route (QM*, BM*, BxM*, X*). */
 int is_express_route(const char *route);
 
@@ -35,12 +32,55 @@ int is_express_route(const char *route);
  * Drops arrivals whose expected time is more than 90s in the past; returns new count. */
 int arrivals_refresh_eta(Arrival *arr, int n, time_t now);
 
-/* Set process TZ to America/New_York and call tzset(). Idempotent. */
-void tz_set_ny(void);
+/* 1 if a and b would draw the same tile: every shown field, with the countdown compared
+ * through expected when known (the render loop derives mins from it). */
+int arrival_same(const Arrival *a, const Arrival *b);
+
+/* Fast 64-bit hash of data[0..len) (not cryptographic), chained through seed. Used to
+ * spot byte-identical API responses. */
+uint64_t hash_bytes(const void *data, size_t len, uint64_t seed);
+
+/* --- Streaming JSON: one pass over the body, no allocation ---------------------------
+ * json_walk() calls fn for every value in document order with the path that leads to it;
+ * callers pick the paths they need with json_match() and copy values out with json_str /
+ * json_int / json_double. */
+
+#define JSON_MAX_DEPTH 32
+
+typedef enum {
+    JSON_NULL, JSON_FALSE, JSON_TRUE, JSON_NUMBER, JSON_STRING,
+    JSON_OBJECT, JSON_ARRAY,    /* container opens; its members follow */
+    JSON_END,                   /* container at path[0..depth) closes */
+} JsonType;
+
+typedef struct JsonSeg {
+    const char *key;            /* member name, escapes intact (NULL for array elements) */
+    size_t      key_len;
+    int         index;          /* element index, or -1 for object members */
+} JsonSeg;
+
+typedef struct JsonTok {
+    JsonType       type;
+    const char    *s;           /* string body (escapes intact) or number text */
+    size_t         len;
+    int            depth;       /* path[0..depth) names this value; 0 = document root */
+    const JsonSeg *path;
+} JsonTok;
+
+/* Return 0 to continue, nonzero to stop the walk (json_walk returns it). */
+typedef int (*JsonFn)(const JsonTok *t, void *ctx);
+
+/* Walk buf[0..len). Returns 0 when the document ends, fn's nonzero value if it stopped
+ * early, or -1 on malformed JSON or nesting deeper than JSON_MAX_DEPTH. */
+int json_walk(const char *buf, size_t len, JsonFn fn, void *ctx);
+
+/* Match t->path from depth `from` against a dotted pattern ("MonitoredCall.StopPointName";
+ * "#" = any array index, "*" = any segment). Returns the depth after the pattern, or -1.
+ * The pattern names t itself when the result equals t->depth. */
+int json_match(const JsonTok *t, int from, const char *pattern);
 
-/* --- JSON helpers (return NULL or default; do not free the returned pointers) --- */
-const cJSON *jgeto(const cJSON *o, const char *k);   /* get object member */
-const cJSON *jgeti(const cJSON *a, int idx);         /* get array element */
-const char *jgets(const cJSON *v);                   /* get string value */
-int jint(const cJSON *v, int defv);                  /* get int with default */
-double jdouble(const cJSON *v, double defv);         /* get double with default */
+/* String value unescaped into out as UTF-8, truncated to outsz without cutting a character
+ * (an unpaired \u surrogate becomes U+FFFD); NULL if t is not a string. */
+const char *json_str(const JsonTok *t, char *out, size_t outsz);
+int    json_int(const JsonTok *t, int defv);        /* number, or atoi() of a string */
+double json_double(const JsonTok *t, double defv);  /* number, or atof() of a string */
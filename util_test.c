@@ -0,0 +1,266 @@
+/*
+ * util.c's streaming JSON: json_walk() token order and paths, every cut of a document
+ * and other malformed input (-1), the depth limit and early stops; json_match() patterns;
+ * json_str() escapes, surrogate pairs and truncation; json_int() / json_double().
+ */
+#include "util.h"
+#include "test.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ---- json_walk ------------------------------------------------------------------ */
+
+typedef struct {
+    char out[1024];
+    size_t n;
+    int calls, stop_at, stop_rc;
+} Trace;
+
+/* One letter per token type, then its path ("a.0.b"): "O: A:a N:a.0 ..." */
+static int trace_fn(const JsonTok *t, void *ctx) {
+    Trace *tr = (Trace *)ctx;
+    static const char type[] = "0FTNSOAE";
+    char seg[128] = "";
+    size_t o = 0;
+    for (int d = 0; d < t->depth && o + 40 < sizeof(seg); d++) {
+        if (t->path[d].index >= 0) o += (size_t)snprintf(seg + o, sizeof(seg) - o, "%s%d", d ? "." : "", t->path[d].index);
+        else o += (size_t)snprintf(seg + o, sizeof(seg) - o, "%s%.*s", d ? "." : "", (int)t->path[d].key_len, t->path[d].key);
+    }
+    if (tr->n + strlen(seg) + 4 < sizeof(tr->out))
+        tr->n += (size_t)snprintf(tr->out + tr->n, sizeof(tr->out) - tr->n, "%s%c:%s", tr->n ? " " : "",
+                                  type[t->type], seg);
+    return ++tr->calls == tr->stop_at ? tr->stop_rc : 0;
+}
+
+static int walk(const char *doc, Trace *tr) {
+    memset(tr, 0, sizeof(*tr));
+    return json_walk(doc, strlen(doc), trace_fn, tr);
+}
+
+static void check_walk(void) {
+    Trace tr;
+    CHECK(walk(" {\"a\" : [1, \"x\", {\"b\":null}], \"c\":true, \"d\":{}, \"e\":[], \"f\":-2.5e3}\n", &tr) == 0);
+    CHECK(strcmp(tr.out, "O: A:a N:a.0 S:a.1 O:a.2 0:a.2.b E:a.2 E:a T:c O:d E:d A:e E:e N:f E:") == 0);
+    CHECK(walk("\"top\"", &tr) == 0 && strcmp(tr.out, "S:") == 0);
+    CHECK(walk("false", &tr) == 0 && strcmp(tr.out, "F:") == 0);
+    /* keys keep their escapes */
+    CHECK(walk("{\"a\\\"b\":1}", &tr) == 0 && strcmp(tr.out, "O: N:a\\\"b E:") == 0);
+
+    /* fn's nonzero value stops the walk and is returned */
+    memset(&tr, 0, sizeof(tr));
+    tr.stop_at = 3;
+    tr.stop_rc = 7;
+    const char *doc = "[1,2,3,4]";
+    CHECK(json_walk(doc, strlen(doc), trace_fn, &tr) == 7 && tr.calls == 3);
+    memset(&tr, 0, sizeof(tr));
+    tr.stop_at = 1;
+    tr.stop_rc = 1;
+    CHECK(json_walk(doc, strlen(doc), trace_fn, &tr) == 1 && tr.calls == 1);   /* at the opening */
+
+    /* depth: JSON_MAX_DEPTH containers nest, one more does not */
+    char deep[2 * JSON_MAX_DEPTH + 8];
+    size_t o = 0;
+    for (int i = 0; i < JSON_MAX_DEPTH; i++) deep[o++] = '[';
+    deep[o++] = '1';
+    for (int i = 0; i < JSON_MAX_DEPTH; i++) deep[o++] = ']';
+    deep[o] = '\0';
+    CHECK(walk(deep, &tr) == 0);
+    memmove(deep + 1, deep, o + 1);
+    deep[0] = '[';
+    deep[o + 1] = ']';
+    deep[o + 2] = '\0';
+    CHECK(walk(deep, &tr) == -1);
+
+    /* malformed */
+    static const char *bad[] = {
+        "", " ", "[1,]", "[,1]", "{\"a\" 1}", "{\"a\":}", "{a:1}", "{\"a\":1,}", "[1 2]", "\"abc",
+        "\"a\tb\"", "\"a\\", "tru", "nul", "+1", "[1}", "{\"a\":1]", "{\"a\"", "[\"x\\\"]",
+    };
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        if (walk(bad[i], &tr) != -1) {
+            fprintf(stderr, "json_walk(%s) did not fail\n", bad[i]);
+            test_failures++;
+        }
+    }
+    CHECK(json_walk(NULL, 0, trace_fn, &tr) == -1);
+    CHECK(json_walk("1", 1, NULL, NULL) == -1);
+}
+
+/* Every proper prefix of a document is malformed, and nothing past the cut is read. */
+static void check_cuts(const char *path) {
+    size_t len = 0;
+    char *doc = test_read_file(path, &len);
+    CHECK(doc != NULL);
+    if (!doc) return;
+    Trace tr;
+    memset(&tr, 0, sizeof(tr));
+    CHECK(json_walk(doc, len, trace_fn, &tr) == 0);
+    int wrong = 0;
+    for (size_t cut = 0; cut < len; cut++) {
+        char *part = malloc(cut ? cut : 1);       /* exact size, so a read past it is caught by ASan */
+        memcpy(part, doc, cut);
+        memset(&tr, 0, sizeof(tr));
+        wrong += json_walk(part, cut, trace_fn, &tr) != -1;
+        free(part);
+    }
+    if (wrong) fprintf(stderr, "%s: %d cut(s) walked without error\n", path, wrong);
+    CHECK(wrong == 0);
+    free(doc);
+}
+
+/* ---- json_match ----------------------------------------------------------------- */
+
+typedef struct { int seen, bad; } MatchCtx;
+
+static int match_fn(const JsonTok *t, void *ctx) {
+    MatchCtx *m = (MatchCtx *)ctx;
+    if (t->type != JSON_STRING) return 0;
+    m->seen = 1;
+    /* Siri.ServiceDelivery.StopMonitoringDelivery.0.MonitoredStopVisit.1.MonitoredVehicleJourney.LineRef */
+    static const struct { int from; const char *pattern; int want; } cases[] = {
+        { 0, "Siri", 1 },
+        { 0, "Siri.ServiceDelivery", 2 },
+        { 0, "Siri.ServiceDelivery.StopMonitoringDelivery.#", 4 },
+        { 0, "Siri.*.StopMonitoringDelivery.*.MonitoredStopVisit", 5 },
+        { 0, "*.*.*.*.*.*.*.*", 8 },
+        { 0, "*.*.*.*.*.*.*.*.*", -1 },               /* longer than the path */
+        { 0, "Siri.ServiceDelivery.StopMonitoringDelivery.MonitoredStopVisit", -1 },   /* index, not key */
+        { 0, "Siri.#", -1 },                          /* key, not index */
+        { 0, "Siri.Service", -1 },
+        { 0, "Siri.ServiceDeliveryX", -1 },
+        { 0, "siri", -1 },
+        { 4, "MonitoredStopVisit.#.MonitoredVehicleJourney.LineRef", 8 },
+        { 6, "MonitoredVehicleJourney", 7 },
+        { 3, "MonitoredStopVisit", -1 },
+        { 8, "", 8 },
+        { 8, "LineRef", -1 },
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        int got = json_match(t, cases[i].from, cases[i].pattern);
+        if (got != cases[i].want) {
+            fprintf(stderr, "json_match(from %d, \"%s\") = %d, want %d\n", cases[i].from, cases[i].pattern,
+                    got, cases[i].want);
+            m->bad++;
+        }
+    }
+    return 0;
+}
+
+static void check_match(void) {
+    const char *doc = "{\"Siri\":{\"ServiceDelivery\":{\"StopMonitoringDelivery\":[{\"MonitoredStopVisit\":"
+                      "[{}, {\"MonitoredVehicleJourney\":{\"LineRef\":\"MTA NYCT_Q27\"}}]}]}}}";
+    MatchCtx m = { 0, 0 };
+    CHECK(json_walk(doc, strlen(doc), match_fn, &m) == 0);
+    CHECK(m.seen && m.bad == 0);
+}
+
+/* ---- json_str / json_int / json_double --------------------------------------------- */
+
+/* A STRING token over the raw body s (escapes intact), as json_walk hands it over. */
+static JsonTok str_tok(const char *s) {
+    JsonTok t = { JSON_STRING, s, strlen(s), 0, NULL };
+    return t;
+}
+
+/* 1 if s is well-formed UTF-8 (no cut or overlong sequence, no surrogate). */
+static int utf8_valid(const char *s) {
+    const unsigned char *p = (const unsigned char *)s;
+    while (*p) {
+        unsigned c = *p, n = c < 0x80 ? 0 : (c & 0xE0) == 0xC0 ? 1 : (c & 0xF0) == 0xE0 ? 2 : (c & 0xF8) == 0xF0 ? 3 : 9;
+        if (n == 9 || (n == 1 && c < 0xC2)) return 0;
+        unsigned cp = n ? c & (0x3F >> n) : c;
+        for (unsigned i = 1; i <= n; i++) {
+            if ((p[i] & 0xC0) != 0x80) return 0;
+            cp = cp << 6 | (p[i] & 0x3F);
+        }
+        if ((n == 2 && (cp < 0x800 || (cp >= 0xD800 && cp < 0xE000))) || (n == 3 && (cp < 0x10000 || cp > 0x10FFFF)))
+            return 0;
+        p += n + 1;
+    }
+    return 1;
+}
+
+static void check_str(void) {
+    static const struct { const char *raw, *want; } cases[] = {
+        { "plain", "plain" },
+        { "", "" },
+        { "a\\\"b\\\\c\\/d", "a\"b\\c/d" },
+        { "\\b\\f\\n\\r\\t", "\b\f\n\r\t" },
+        { "\\u0041\\u00e9\\u2013\\uFFFD", "A\xc3\xa9\xe2\x80\x93\xef\xbf\xbd" },
+        { "\\u0000x", "" },                                    /* NUL ends the C string */
+        { "BUS \\ud83d\\ude8c!", "BUS \xf0\x9f\x9a\x8c!" },    /* surrogate pair */
+        { "\\uD83C\\uDF0A", "\xf0\x9f\x8c\x8a" },
+        { "\\udbff\\udfff", "\xf4\x8f\xbf\xbf" },              /* U+10FFFF */
+        { "caf\xc3\xa9", "caf\xc3\xa9" },                      /* raw UTF-8 passes through */
+        /* lone surrogates become U+FFFD */
+        { "a\\ud83dz", "a\xef\xbf\xbdz" },
+        { "a\\ud83d", "a\xef\xbf\xbd" },
+        { "a\\ude8cz", "a\xef\xbf\xbdz" },
+        { "\\ud83d\\u0041", "\xef\xbf\xbd" "A" },
+        { "\\ud83d\\ud83d\\ude8c", "\xef\xbf\xbd\xf0\x9f\x9a\x8c" },
+        /* a bad \u escape ends the value there */
+        { "ab\\u00zz", "ab" },
+        { "ab\\u00", "ab" },
+        { "ab\\", "ab" },
+        { "a\\qb", "aqb" },
+    };
+    char out[64];
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        JsonTok t = str_tok(cases[i].raw);
+        const char *got = json_str(&t, out, sizeof(out));
+        if (!got || strcmp(got, cases[i].want) != 0) {
+            fprintf(stderr, "json_str(\"%s\") = \"%s\", want \"%s\"\n", cases[i].raw, got ? got : "(null)",
+                    cases[i].want);
+            test_failures++;
+        }
+    }
+
+    /* Truncated to every size: a prefix of the whole value, never a cut character */
+    static const char *raws[] = {
+        "ROCKAWAY \\ud83c\\udf0a \\\"BEACH\\\"", "CAF\\u00c9 \xe2\x80\x93 X", "\xf0\x9f\x9a\x8c\xc3\xa9\\u2013",
+    };
+    for (size_t r = 0; r < sizeof(raws) / sizeof(raws[0]); r++) {
+        char full[64];
+        JsonTok t = str_tok(raws[r]);
+        json_str(&t, full, sizeof(full));
+        size_t prev = 0;
+        for (size_t sz = 1; sz <= strlen(full) + 1; sz++) {
+            char part[64];
+            memset(part, 0x55, sizeof(part));
+            json_str(&t, part, sz);
+            size_t n = strlen(part);
+            if (n >= sz || strncmp(part, full, n) != 0 || !utf8_valid(part) || n < prev || part[sz] != 0x55 ||
+                (sz == strlen(full) + 1 && n != sz - 1)) {
+                fprintf(stderr, "json_str(\"%s\", %zu bytes) = \"%s\"\n", raws[r], sz, part);
+                test_failures++;
+            }
+            prev = n;
+        }
+    }
+
+    JsonTok num = { JSON_NUMBER, "12", 2, 0, NULL };
+    CHECK(json_str(&num, out, sizeof(out)) == NULL);
+    JsonTok s = str_tok("x");
+    CHECK(json_str(&s, out, 0) == NULL && json_str(NULL, out, sizeof(out)) == NULL);
+    CHECK(json_str(&s, out, 1) == out && out[0] == '\0');
+
+    /* numbers, and numbers sent as strings */
+    JsonTok n1 = { JSON_NUMBER, "42", 2, 0, NULL }, n2 = { JSON_NUMBER, "-2.5e3", 6, 0, NULL };
+    JsonTok n3 = { JSON_NUMBER, "1e20", 4, 0, NULL }, n4 = { JSON_NUMBER, "-1e20", 5, 0, NULL };
+    JsonTok s1 = str_tok("17 stops"), s2 = str_tok("1200.5"), nul = { JSON_NULL, "null", 4, 0, NULL };
+    CHECK(json_int(&n1, -1) == 42 && json_int(&n2, -1) == -2500);
+    CHECK(json_int(&n3, -1) == INT_MAX && json_int(&n4, -1) == INT_MIN);
+    CHECK(json_int(&s1, -1) == 17 && json_int(&nul, -1) == -1 && json_int(NULL, -3) == -3);
+    CHECK(json_double(&n2, 0) == -2500.0 && json_double(&s2, 0) == 1200.5 && json_double(&nul, -1.0) == -1.0);
+}
+
+int main(void) {
+    check_walk();
+    check_cuts("testdata/siri_stop.json");
+    check_cuts("testdata/siri_object.json");
+    check_match();
+    check_str();
+    return test_done("util_test");
+}
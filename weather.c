@@ -1,9 +1,9 @@
 /*
  * Weather: Open-Meteo forecast API and moon phase.
  */
+#include "http.h"
 #include "util.h"
 #include "weather.h"
-#include <cjson/cJSON.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -20,6 +20,14 @@ enum {
 
 static int g_weather_last_status = WEATHER_STATUS_OK;
 
+/* Response body, reused fetch to fetch (fetch thread only). */
+static HttpBuf s_body;
+
+/* Hash of the request and body last parsed into a Weather; an identical response is
+ * not parsed again. */
+static uint64_t s_body_key;
+static long s_cache_hits, s_cache_polls;
+
 /* Map Open-Meteo weather code to a single Unicode symbol (UTF-8).
  * `is_day`: 1=day, 0=night, -1 unknown. */
 static void icon_for_code(int code, int is_day, char *out, size_t outsz) {
@@ -70,6 +78,37 @@ static float moon_phase_from_date(void) {
     return (float)(lunation < 0 ? lunation + 1.0 : lunation);
 }
 
+/* Values picked out of the forecast as it streams past. */
+typedef struct {
+    int    have_current;
+    int    temp;
+    double precip;
+    int    code, is_day;
+    int    prob;    /* max precipitation_probability over the next 6 hours */
+} WeatherScan;
+
+static int weather_fn(const JsonTok *t, void *ctx) {
+    WeatherScan *sc = (WeatherScan *)ctx;
+    if (t->type == JSON_END) return 0;
+    if (json_match(t, 0, "current") == t->depth) {
+        sc->have_current = 1;
+    } else if (json_match(t, 0, "current.temperature_2m") == t->depth) {
+        sc->temp = json_int(t, -999);
+    } else if (json_match(t, 0, "current.precipitation") == t->depth) {
+        sc->precip = json_double(t, -1.0);
+    } else if (json_match(t, 0, "current.weather_code") == t->depth) {
+        sc->code = json_int(t, -1);
+    } else if (json_match(t, 0, "current.is_day") == t->depth) {
+        sc->is_day = json_int(t, -1);
+    } else if (json_match(t, 0, "hourly.precipitation_probability.#") == t->depth &&
+               t->path[t->depth - 1].index < 6) {
+        /* The maximum over the next several hours instead of only [0]. */
+        int v = json_int(t, -1);
+        if (v > sc->prob) sc->prob = v;
+    }
+    return 0;
+}
+
 void fetch_weather(Weather *w, const char *stop_name) {
     (void)stop_name;
     if (!w) return;
@@ -99,54 +138,43 @@ void fetch_weather(Weather *w, const char *stop_name) {
              "https://api.open-meteo.com/v1/forecast?latitude=%.5f&longitude=%.5f&timezone=America%%2FNew_York&temperature_unit=fahrenheit&precipitation_unit=inch&current=temperature_2m,precipitation,weather_code,is_day&hourly=precipitation_probability",
              w->lat, w->lon);
 
-    char *json = http_get(url);
-    if (!json) {
+    if (http_fetch(&s_body, url, HTTP_TEXT_MAX, NULL) != 0) {
         logf_("Weather: fetch failed (no response from API)");
         g_weather_last_status = WEATHER_STATUS_HTTP_FAIL;
         return;
     }
 
-    cJSON *root = cJSON_Parse(json);
-    free(json);
-    if (!root) {
+    uint64_t key = hash_bytes(s_body.data, s_body.len, hash_bytes(url, strlen(url), 0));
+    s_cache_polls++;
+    if (w->have && key == s_body_key) {
+        s_cache_hits++;
+        w->moon_phase = moon_phase_from_date();
+        w->last_fetch = now;
+        g_weather_last_status = WEATHER_STATUS_OK;
+        return;
+    }
+    s_body_key = 0;
+
+    WeatherScan sc = { 0, -999, -1.0, -1, -1, -1 };
+    int rc = json_walk(s_body.data, s_body.len, weather_fn, &sc);
+    if (rc < 0) {
         logf_("Weather: invalid JSON from API");
         g_weather_last_status = WEATHER_STATUS_JSON_FAIL;
         return;
     }
-
-    const cJSON *cur = jgeto(root, "current");
-    if (!cur) {
+    if (!sc.have_current) {
         logf_("Weather: API response missing 'current'");
-        cJSON_Delete(root);
         g_weather_last_status = WEATHER_STATUS_SCHEMA_FAIL;
         return;
     }
-    int temp = jint(jgeto(cur, "temperature_2m"), -999);
-    double precip = jdouble(jgeto(cur, "precipitation"), -1.0);
-    int code = jint(jgeto(cur, "weather_code"), -1);
-    int is_day = jint(jgeto(cur, "is_day"), -1);
+    int temp = sc.temp, code = sc.code, is_day = sc.is_day, prob = sc.prob;
+    double precip = sc.precip;
 
     char icon[8];
     icon_for_code(code, is_day, icon, sizeof(icon));
 
-    int prob = -1;
-    const cJSON *hourly = jgeto(root, "hourly");
-    const cJSON *pp = hourly ? jgeto(hourly, "precipitation_probability") : NULL;
-    /* Use the maximum precip probability over the next several hours instead of only [0]. */
-    if (pp && cJSON_IsArray((cJSON *)pp)) {
-        int count = cJSON_GetArraySize((cJSON *)pp);
-        int horizon = count < 6 ? count : 6;
-        for (int i = 0; i < horizon; i++) {
-            const cJSON *ppi = jgeti(pp, i);
-            int v = jint(ppi, -1);
-            if (v > prob) prob = v;
-        }
-    }
-
     w->moon_phase = moon_phase_from_date();
 
-    cJSON_Delete(root);
-
     w->have = 1;
     snprintf(w->icon, sizeof(w->icon), "%s", icon);
     w->is_day = is_day;
@@ -159,9 +187,15 @@ void fetch_weather(Weather *w, const char *stop_name) {
      * are updated and what values Open-Meteo returned. */
     logf_("Weather: fetched code=%d icon='%s' temp=%dF precip_prob=%d precip_in=%.2f moon_phase=%.2f",
           code, w->icon, w->temp_f, w->precip_prob, w->precip_in, w->moon_phase);
+    s_body_key = key;
     g_weather_last_status = WEATHER_STATUS_OK;
 }
 
+void weather_parse_cache_stats(long *hits, long *polls) {
+    if (hits) *hits = s_cache_hits;
+    if (polls) *polls = s_cache_polls;
+}
+
 int weather_last_status(void) {
     return g_weather_last_status;
 }
@@ -8,6 +8,10 @@
 
 void fetch_weather(Weather *w, const char *stop_name);
 
+/* Responses identical to the last one parsed (so not parsed again), out of all
+ * responses received, since start. */
+void weather_parse_cache_stats(long *hits, long *polls);
+
 /* Last weather fetch status for debug instrumentation. */
 int weather_last_status(void);
 const char *weather_last_status_str(void);
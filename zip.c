@@ -0,0 +1,497 @@
+/*
+ * In-process ZIP reader: replaces one `unzip -p` process per GTFS member.
+ * Only what GTFS zips need: stored (0) and deflate (8) members, no ZIP64, no encryption.
+ * The writer at the end produces the same subset.
+ */
+#include "zip.h"
+#include "util.h"
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#define ZIP_SIG_LOCAL   0x04034b50u
+#define ZIP_SIG_CENTRAL 0x02014b50u
+#define ZIP_SIG_EOCD    0x06054b50u
+#define ZIP_EOCD_SIZE   22
+#define ZIP_CENTRAL_SIZE 46
+#define ZIP_LOCAL_SIZE  30
+
+/* Line window; a line longer than this is split like the old fgets path. */
+#define ZIP_WINDOW_SIZE (256 * 1024)
+
+/* Archive pages a member has been read past are dropped from RSS this often. */
+#define ZIP_DROP_CHUNK  (1024 * 1024)
+
+static uint16_t rd16(const unsigned char *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t rd32(const unsigned char *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void wr16(unsigned char *p, uint16_t v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+}
+
+static void wr32(unsigned char *p, uint32_t v) {
+    wr16(p, (uint16_t)v);
+    wr16(p + 2, (uint16_t)(v >> 16));
+}
+
+int zip_open(ZipArchive *za, const char *zip_path) {
+    if (!za || !zip_path) return -1;
+    memset(za, 0, sizeof(*za));
+
+    int fd = open(zip_path, O_RDONLY);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < ZIP_EOCD_SIZE) {
+        close(fd);
+        return -1;
+    }
+    void *m = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED) return -1;
+    za->map = (const unsigned char *)m;
+    za->size = (size_t)st.st_size;
+
+    /* End of central directory: last 22 bytes plus an optional comment of up to 64 KB. */
+    const unsigned char *eocd = NULL;
+    size_t min_pos = za->size > ZIP_EOCD_SIZE + 65535 ? za->size - ZIP_EOCD_SIZE - 65535 : 0;
+    for (size_t pos = za->size - ZIP_EOCD_SIZE; ; pos--) {
+        if (rd32(za->map + pos) == ZIP_SIG_EOCD) { eocd = za->map + pos; break; }
+        if (pos == min_pos) break;
+    }
+    if (!eocd) {
+        logf_("ZIP: %s: end of central directory not found", zip_path);
+        zip_close(za);
+        return -1;
+    }
+    uint16_t entries = rd16(eocd + 10);
+    uint32_t cd_size = rd32(eocd + 12);
+    uint32_t cd_off  = rd32(eocd + 16);
+    if (entries == 0xFFFF || cd_off == 0xFFFFFFFFu) {
+        logf_("ZIP: %s: ZIP64 archives are not supported", zip_path);
+        zip_close(za);
+        return -1;
+    }
+    if ((size_t)cd_off + cd_size > za->size) {
+        logf_("ZIP: %s: central directory out of range (truncated download?)", zip_path);
+        zip_close(za);
+        return -1;
+    }
+    za->cdir = za->map + cd_off;
+    za->cdir_size = cd_size;
+    za->n_entries = entries;
+    return 0;
+}
+
+void zip_close(ZipArchive *za) {
+    if (!za) return;
+    if (za->map) munmap((void *)za->map, za->size);
+    free(za->window);
+    memset(za, 0, sizeof(*za));
+}
+
+/* Find member in the central directory; on success set method, compressed and
+ * uncompressed size, data pointer and (if crc is non-NULL) CRC-32. */
+static int zip_find(const ZipArchive *za, const char *name, int *method,
+                    const unsigned char **data, size_t *comp_size, size_t *raw_size, uint32_t *crc) {
+    if (!za || !za->map || !name) return -1;
+    size_t name_len = strlen(name);
+    const unsigned char *p = za->cdir;
+    const unsigned char *end = za->cdir + za->cdir_size;
+    for (int i = 0; i < za->n_entries; i++) {
+        if (p + ZIP_CENTRAL_SIZE > end || rd32(p) != ZIP_SIG_CENTRAL) return -1;
+        uint16_t n_len = rd16(p + 28);
+        uint16_t x_len = rd16(p + 30);
+        uint16_t c_len = rd16(p + 32);
+        if (p + ZIP_CENTRAL_SIZE + n_len > end) return -1;
+        if (n_len == name_len && memcmp(p + ZIP_CENTRAL_SIZE, name, name_len) == 0) {
+            uint32_t local_off = rd32(p + 42);
+            if ((size_t)local_off + ZIP_LOCAL_SIZE > za->size) return -1;
+            const unsigned char *lh = za->map + local_off;
+            if (rd32(lh) != ZIP_SIG_LOCAL) return -1;
+            size_t data_off = (size_t)local_off + ZIP_LOCAL_SIZE + rd16(lh + 26) + rd16(lh + 28);
+            /* Sizes come from the central entry: local ones are zero when a data descriptor is used. */
+            *method = rd16(p + 10);
+            *comp_size = rd32(p + 20);
+            *raw_size = rd32(p + 24);
+            if (crc) *crc = rd32(p + 16);
+            if (data_off + *comp_size > za->size) return -1;
+            *data = za->map + data_off;
+            return 0;
+        }
+        p += ZIP_CENTRAL_SIZE + n_len + x_len + c_len;
+    }
+    return -1;
+}
+
+uint64_t zip_content_hash(const ZipArchive *za) {
+    uint64_t h = 14695981039346656037ull;
+    if (!za || !za->cdir) return h;
+    for (size_t i = 0; i < za->cdir_size; i++) {
+        h ^= za->cdir[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+int zip_has_member(const ZipArchive *za, const char *name) {
+    int method;
+    const unsigned char *data;
+    size_t csz, rsz;
+    return zip_find(za, name, &method, &data, &csz, &rsz, NULL) == 0;
+}
+
+size_t zip_member_size(const ZipArchive *za, const char *name) {
+    int method;
+    const unsigned char *data;
+    size_t csz, rsz;
+    return zip_find(za, name, &method, &data, &csz, &rsz, NULL) == 0 ? rsz : 0;
+}
+
+/* Line sink: complete lines of window[0..*len) go to fn; the partial tail moves to the front. */
+typedef struct {
+    int   skip_header;
+    int   count;
+    int (*fn)(char *line, void *ctx);
+    void *ctx;
+} ZipLineSink;
+
+/* Block sink: all complete lines of the window go to fn in one call. */
+typedef struct {
+    int   skip_header;
+    int   count;
+    int (*fn)(char *buf, size_t len, void *ctx);
+    void *ctx;
+} ZipBlockSink;
+
+/* Emit complete lines from window[0..*len); keep the partial tail at the front.
+ * Returns 1 if fn asked to stop. */
+static int zip_emit_lines(char *win, size_t *len, int final, void *sink) {
+    ZipLineSink *ls = (ZipLineSink *)sink;
+    size_t start = 0;
+    for (;;) {
+        char *nl = memchr(win + start, '\n', *len - start);
+        size_t line_end;
+        if (nl) {
+            line_end = (size_t)(nl - win);
+        } else if (final && start < *len) {
+            line_end = *len;
+        } else {
+            break;
+        }
+        size_t e = line_end;
+        if (e > start && win[e - 1] == '\r') e--;
+        win[e] = '\0';
+        char *line = win + start;
+        start = line_end + 1;
+        if (ls->skip_header) { ls->skip_header = 0; continue; }
+        if (ls->fn(line, ls->ctx) != 0) return 1;
+        ls->count++;
+        if (start > *len) { start = *len; break; }
+    }
+    if (start > 0) {
+        memmove(win, win + start, *len - start);
+        *len -= start;
+    }
+    return 0;
+}
+
+/* Emit window[0..*len) up to and including its last '\n' as one block. */
+static int zip_emit_block(char *win, size_t *len, int final, void *sink) {
+    ZipBlockSink *bs = (ZipBlockSink *)sink;
+    size_t start = 0, end = *len;
+    if (bs->skip_header) {
+        char *nl = memchr(win, '\n', *len);
+        if (!nl && !final) return 0;
+        start = nl ? (size_t)(nl - win) + 1 : *len;
+        bs->skip_header = 0;
+    }
+    if (!final) {
+        char *nl = memrchr(win + start, '\n', *len - start);
+        end = nl ? (size_t)(nl - win) + 1 : start;
+    }
+    int stopped = 0;
+    if (end > start) {
+        char keep = win[end];   /* first byte of the tail; the window has one spare past cap */
+        win[end] = '\0';
+        stopped = bs->fn(win + start, end - start, bs->ctx) != 0;
+        win[end] = keep;
+        bs->count++;
+    }
+    memmove(win, win + end, *len - end);
+    *len -= end;
+    return stopped;
+}
+
+/* Drop the mapped archive pages wholly before p from our RSS (from *done on). */
+static void zip_drop_before(const unsigned char **done, const unsigned char *p, uintptr_t page_mask) {
+    const unsigned char *end = (const unsigned char *)((uintptr_t)p & ~page_mask);
+    if (end <= *done) return;
+    madvise((void *)*done, (size_t)(end - *done), MADV_DONTNEED);
+    *done = end;
+}
+
+/* A member streamed to its end is whole only if it gave raw_size bytes whose CRC-32 is
+ * the central directory's. */
+static int zip_check(const char *name, size_t got, size_t raw_size, uLong crc, uint32_t want) {
+    if (got == raw_size && crc == want) return 0;
+    logf_("ZIP: %s: corrupt member (%zu of %zu bytes, CRC-32 %08lx, expected %08x)", name, got, raw_size,
+          (unsigned long)crc, (unsigned)want);
+    return -1;
+}
+
+/* Stream member 'name' through the window into emit. Returns 0 when done (or stopped),
+ * or -1 if the member is missing, unreadable or corrupt: inflate failed, or the size or
+ * CRC-32 is wrong. emit may have seen part of a corrupt member by then. */
+static int zip_stream(ZipArchive *za, const char *name,
+                      int (*emit)(char *win, size_t *len, int final, void *sink), void *sink) {
+    int method;
+    const unsigned char *data;
+    size_t comp_size, raw_size;
+    uint32_t want_crc;
+    if (zip_find(za, name, &method, &data, &comp_size, &raw_size, &want_crc) != 0) return -1;
+    if (method != 0 && method != 8) {
+        logf_("ZIP: %s: unsupported compression method %d", name, method);
+        return -1;
+    }
+    if (!za->window) {
+        za->window = (char *)malloc(ZIP_WINDOW_SIZE + 1);
+        if (!za->window) return -1;
+        za->window_cap = ZIP_WINDOW_SIZE;
+    }
+    /* Members are read front to back once: read ahead, and drop the pages from our RSS
+     * as the reader moves past them. */
+    uintptr_t page_mask = (uintptr_t)sysconf(_SC_PAGESIZE) - 1;
+    uintptr_t page_off = (uintptr_t)data & page_mask;
+    void *adv_base = (void *)((uintptr_t)data - page_off);
+    size_t adv_len = comp_size + page_off;
+    madvise(adv_base, adv_len, MADV_SEQUENTIAL);
+    const unsigned char *dropped = (const unsigned char *)adv_base;
+
+    char *win = za->window;
+    size_t len = 0, got = 0;
+    uLong crc = crc32(0L, Z_NULL, 0);
+    int stopped = 0;
+
+    if (method == 0) {
+        size_t pos = 0;
+        while (!stopped && pos < comp_size) {
+            size_t n = za->window_cap - len;
+            if (n > comp_size - pos) n = comp_size - pos;
+            memcpy(win + len, data + pos, n);
+            crc = crc32(crc, (const Bytef *)win + len, (uInt)n);
+            len += n;
+            pos += n;
+            got += n;
+            if (data + pos - dropped >= ZIP_DROP_CHUNK) zip_drop_before(&dropped, data + pos, page_mask);
+            stopped = emit(win, &len, 0, sink);
+            if (!stopped && len == za->window_cap) {
+                /* No newline in a full window: hand it over as one line. */
+                stopped = emit(win, &len, 1, sink);
+            }
+        }
+        if (!stopped)
+            emit(win, &len, 1, sink);
+        madvise(adv_base, adv_len, MADV_DONTNEED);
+        return stopped ? 0 : zip_check(name, got, raw_size, crc, want_crc);
+    }
+
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (inflateInit2(&zs, -MAX_WBITS) != Z_OK) return -1;
+    zs.next_in = (Bytef *)data;
+    int zrc = Z_OK;
+    size_t in_left = comp_size;
+    while (!stopped && zrc != Z_STREAM_END) {
+        if (zs.avail_in == 0) {
+            uInt chunk = in_left > ZIP_DROP_CHUNK ? ZIP_DROP_CHUNK : (uInt)in_left;
+            zip_drop_before(&dropped, zs.next_in, page_mask);
+            zs.avail_in = chunk;
+            in_left -= chunk;
+        }
+        zs.next_out = (Bytef *)(win + len);
+        zs.avail_out = (uInt)(za->window_cap - len);
+        zrc = inflate(&zs, Z_NO_FLUSH);
+        if (zrc != Z_OK && zrc != Z_STREAM_END) {
+            logf_("ZIP: %s: inflate failed (%d) after %zu of %zu bytes", name, zrc, got, raw_size);
+            inflateEnd(&zs);
+            madvise(adv_base, adv_len, MADV_DONTNEED);
+            return -1;
+        }
+        size_t n = za->window_cap - zs.avail_out - len;
+        crc = crc32(crc, (const Bytef *)win + len, (uInt)n);
+        got += n;
+        len += n;
+        stopped = emit(win, &len, 0, sink);
+        if (!stopped && len == za->window_cap)
+            stopped = emit(win, &len, 1, sink);
+    }
+    if (!stopped)
+        emit(win, &len, 1, sink);
+    inflateEnd(&zs);
+    madvise(adv_base, adv_len, MADV_DONTNEED);
+    return stopped ? 0 : zip_check(name, got, raw_size, crc, want_crc);
+}
+
+int zip_for_each_line(ZipArchive *za, const char *name,
+                      int (*fn)(char *line, void *ctx), void *ctx) {
+    if (!fn) return -1;
+    ZipLineSink ls = { 1, 0, fn, ctx };
+    return zip_stream(za, name, zip_emit_lines, &ls) < 0 ? -1 : ls.count;
+}
+
+int zip_for_each_block(ZipArchive *za, const char *name,
+                       int (*fn)(char *buf, size_t len, void *ctx), void *ctx) {
+    if (!fn) return -1;
+    ZipBlockSink bs = { 1, 0, fn, ctx };
+    return zip_stream(za, name, zip_emit_block, &bs) < 0 ? -1 : bs.count;
+}
+
+typedef struct {
+    char  *out;
+    size_t out_sz;
+    int    found;
+} ZipHeaderCopy;
+
+static int zip_header_fn(char *line, void *ctx) {
+    ZipHeaderCopy *hc = (ZipHeaderCopy *)ctx;
+    snprintf(hc->out, hc->out_sz, "%s", line);
+    hc->found = 1;
+    return 1;
+}
+
+int zip_member_header(ZipArchive *za, const char *name, char *out, size_t out_sz) {
+    if (!out || out_sz == 0) return -1;
+    ZipHeaderCopy hc = { out, out_sz, 0 };
+    ZipLineSink ls = { 0, 0, zip_header_fn, &hc };
+    if (zip_stream(za, name, zip_emit_lines, &ls) < 0 || !hc.found) return -1;
+    return 0;
+}
+
+void zip_view(ZipArchive *view, const ZipArchive *za) {
+    *view = *za;
+    view->window = NULL;
+    view->window_cap = 0;
+}
+
+void zip_view_close(ZipArchive *view) {
+    if (!view) return;
+    free(view->window);
+    memset(view, 0, sizeof(*view));
+}
+
+int zip_writer_open(ZipWriter *zw, const char *path) {
+    memset(zw, 0, sizeof(*zw));
+    snprintf(zw->path, sizeof(zw->path), "%s", path);
+    char tmp[600];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    zw->fp = fopen(tmp, "wb");
+    return zw->fp ? 0 : -1;
+}
+
+int zip_writer_add(ZipWriter *zw, const char *name, const void *data, size_t len) {
+    if (!zw->fp || zw->failed) return -1;
+    size_t name_len = strlen(name);
+    uLong bound = compressBound((uLong)len);
+    unsigned char *comp = malloc(bound ? bound : 1);
+    long off = ftell(zw->fp);
+    if (!comp || off < 0 || len > 0xFFFFFFFFu || name_len > 0xFFFF) {
+        free(comp);
+        zw->failed = 1;
+        return -1;
+    }
+    /* Raw deflate, as zip members carry no zlib header. */
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    int zrc = deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+    if (zrc == Z_OK) {
+        zs.next_in = (Bytef *)data;
+        zs.avail_in = (uInt)len;
+        zs.next_out = comp;
+        zs.avail_out = (uInt)bound;
+        zrc = deflate(&zs, Z_FINISH);
+        deflateEnd(&zs);
+    }
+    if (zrc != Z_STREAM_END) {
+        free(comp);
+        zw->failed = 1;
+        return -1;
+    }
+    uint32_t csize = (uint32_t)zs.total_out;
+    uint32_t crc = (uint32_t)crc32(crc32(0L, Z_NULL, 0), (const Bytef *)data, (uInt)len);
+
+    unsigned char lh[ZIP_LOCAL_SIZE] = { 0 };
+    wr32(lh, ZIP_SIG_LOCAL);
+    wr16(lh + 4, 20);                   /* version needed */
+    wr16(lh + 8, 8);                    /* deflate */
+    wr16(lh + 12, 0x21);                /* 1980-01-01: the content hash, not mtime, tracks changes */
+    wr32(lh + 14, crc);
+    wr32(lh + 18, csize);
+    wr32(lh + 22, (uint32_t)len);
+    wr16(lh + 26, (uint16_t)name_len);
+    int ok = fwrite(lh, 1, sizeof(lh), zw->fp) == sizeof(lh) &&
+             fwrite(name, 1, name_len, zw->fp) == name_len &&
+             fwrite(comp, 1, csize, zw->fp) == csize;
+    free(comp);
+
+    size_t need = zw->cdir_len + ZIP_CENTRAL_SIZE + name_len;
+    if (ok && need > zw->cdir_cap) {
+        size_t cap = zw->cdir_cap ? zw->cdir_cap * 2 : 1024;
+        while (cap < need) cap *= 2;
+        unsigned char *nc = realloc(zw->cdir, cap);
+        if (nc) {
+            zw->cdir = nc;
+            zw->cdir_cap = cap;
+        } else {
+            ok = 0;
+        }
+    }
+    if (!ok) {
+        zw->failed = 1;
+        return -1;
+    }
+    unsigned char *ce = zw->cdir + zw->cdir_len;
+    memset(ce, 0, ZIP_CENTRAL_SIZE);
+    wr32(ce, ZIP_SIG_CENTRAL);
+    wr16(ce + 4, 20);                   /* version made by */
+    memcpy(ce + 6, lh + 4, 26);         /* version needed .. name length, as in the local header */
+    wr32(ce + 42, (uint32_t)off);
+    memcpy(ce + ZIP_CENTRAL_SIZE, name, name_len);
+    zw->cdir_len = need;
+    zw->n_entries++;
+    return 0;
+}
+
+int zip_writer_close(ZipWriter *zw) {
+    if (!zw->fp) return -1;
+    char tmp[600];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", zw->path);
+    long cd_off = ftell(zw->fp);
+    unsigned char eocd[ZIP_EOCD_SIZE] = { 0 };
+    wr32(eocd, ZIP_SIG_EOCD);
+    wr16(eocd + 8, (uint16_t)zw->n_entries);
+    wr16(eocd + 10, (uint16_t)zw->n_entries);
+    wr32(eocd + 12, (uint32_t)zw->cdir_len);
+    wr32(eocd + 16, (uint32_t)cd_off);
+    int ok = !zw->failed && cd_off >= 0 && zw->n_entries < 0xFFFF &&
+             fwrite(zw->cdir, 1, zw->cdir_len, zw->fp) == zw->cdir_len &&
+             fwrite(eocd, 1, sizeof(eocd), zw->fp) == sizeof(eocd);
+    ok = (fclose(zw->fp) == 0) && ok;
+    free(zw->cdir);
+    zw->fp = NULL;
+    zw->cdir = NULL;
+    if (ok && rename(tmp, zw->path) != 0) ok = 0;
+    if (!ok) unlink(tmp);
+    return ok ? 0 : -1;
+}
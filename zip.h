@@ -0,0 +1,82 @@
+/*
+ * In-process ZIP reader for the GTFS cache: mmap the archive, walk the central
+ * directory, and stream one member's lines (stored or deflate) through a reusable buffer.
+ * Plus a small writer for the per-stop feeds cut by gtfs_slice.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef struct ZipArchive {
+    const unsigned char *map;       /* whole archive, read-only mapping */
+    size_t               size;
+    const unsigned char *cdir;      /* first central directory entry */
+    size_t               cdir_size;
+    int                  n_entries;
+    char                *window;    /* line buffer reused across members */
+    size_t               window_cap;
+} ZipArchive;
+
+/* Map zip_path and locate its central directory. Returns 0 on success, -1 on error. */
+int  zip_open(ZipArchive *za, const char *zip_path);
+void zip_close(ZipArchive *za);
+
+/* 64-bit FNV-1a of the central directory (names, sizes, CRC-32s): changes whenever any
+ * member's content does, without reading member data. */
+uint64_t zip_content_hash(const ZipArchive *za);
+
+/* Return 1 if the archive contains member 'name', else 0. */
+int  zip_has_member(const ZipArchive *za, const char *name);
+
+/* Uncompressed size of member 'name', or 0 if missing. */
+size_t zip_member_size(const ZipArchive *za, const char *name);
+
+/* Copy the first (CSV header) line of member 'name' into out, CR/LF stripped.
+ * Returns 0, or -1 if the member is missing, unreadable or empty. */
+int  zip_member_header(ZipArchive *za, const char *name, char *out, size_t out_sz);
+
+/*
+ * Call fn once per line of member 'name', skipping the first (CSV header) line.
+ * Lines point into the archive's window (no copy), NUL-terminated with CR/LF stripped;
+ * fn may modify the line in place but must not keep the pointer. A nonzero return
+ * from fn stops the walk. Returns lines passed to fn, or -1 if missing/corrupt: inflate
+ * did not reach the end of the stream, or the size or CRC-32 differs from the central
+ * directory. That is only known at the end, so fn may have seen lines of a corrupt member
+ * and the caller must drop what it built from them. (A walk fn stopped is not checked.)
+ */
+int  zip_for_each_line(ZipArchive *za, const char *name,
+                       int (*fn)(char *line, void *ctx), void *ctx);
+
+/*
+ * Like zip_for_each_line, but fn gets each window's run of whole lines at once:
+ * buf[0..len) ends just after a '\n' (or at the member end) and is NUL-terminated at
+ * len; lines inside keep their "\r\n"/"\n". fn may modify buf but not keep it.
+ * Returns blocks passed to fn, or -1 if missing/corrupt (as above).
+ */
+int  zip_for_each_block(ZipArchive *za, const char *name,
+                        int (*fn)(char *buf, size_t len, void *ctx), void *ctx);
+
+/* A second reader over za's mapping with its own window, so another thread can stream
+ * a different member. Close with zip_view_close() before zip_close(za). */
+void zip_view(ZipArchive *view, const ZipArchive *za);
+void zip_view_close(ZipArchive *view);
+
+/* Writer for small archives: deflated members, no ZIP64. The archive goes to
+ * <path>.tmp and is renamed over path by zip_writer_close(), so readers never see
+ * a partial file. */
+typedef struct ZipWriter {
+    FILE          *fp;
+    char           path[512];
+    unsigned char *cdir;            /* central directory, built as members are added */
+    size_t         cdir_len, cdir_cap;
+    int            n_entries;
+    int            failed;
+} ZipWriter;
+
+int  zip_writer_open(ZipWriter *zw, const char *path);
+/* Add member name with data[0..len). Returns 0, or -1 (the archive is then discarded on close). */
+int  zip_writer_add(ZipWriter *zw, const char *name, const void *data, size_t len);
+/* Finish and publish the archive. Returns 0 if every member was written, else -1. */
+int  zip_writer_close(ZipWriter *zw);
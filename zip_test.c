@@ -0,0 +1,366 @@
+/*
+ * zip.c's reader on archives from its own writer (deflate) and from Python's zipfile via
+ * tools/http_standin.py gtfs-zip (a stored member): a whole member streams every line and
+ * byte once, and one that is cut short, has a flipped byte, or whose central directory
+ * size or CRC-32 disagrees with its data is -1, not a short count.
+ *
+ *   zip_test                        check
+ *   zip_test -b [feed.zip [member]] wall time and peak RSS of zip_for_each_line() against
+ *                                   the popen("unzip -p") + fgets() path it replaced
+ *                                   (default: a synthetic stop_times.txt; member defaults
+ *                                   to stop_times.txt)
+ */
+#include "test.h"
+#include "zip.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define ROWS 40000      /* ~1.5 MB: several reader windows */
+#define BENCH_ROWS 1000000
+#define BENCH_REPS 3
+
+static char s_dir[512];
+
+typedef struct {
+    int      lines;
+    size_t   bytes;
+    uint64_t hash;
+    int      stop_after;        /* nonzero: stop the walk after this many lines */
+} Walk;
+
+static uint64_t fnv(uint64_t h, const char *s, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+static int walk_line(char *line, void *ctx) {
+    Walk *w = (Walk *)ctx;
+    if (w->stop_after && w->lines == w->stop_after) return 1;
+    w->lines++;
+    w->hash = fnv(w->hash, line, strlen(line) + 1);
+    return 0;
+}
+
+static int walk_block(char *buf, size_t len, void *ctx) {
+    Walk *w = (Walk *)ctx;
+    (void)buf;
+    w->bytes += len;
+    return 0;
+}
+
+/* Lines of member in the archive bytes z[0..n), as zip_for_each_line() reports them:
+ * the count, or -1 (-2 if the archive does not open). *w gets what the walk saw. */
+static int lines_of(const char *z, size_t n, const char *member, Walk *w, int stop_after) {
+    char path[600];
+    snprintf(path, sizeof(path), "%s/t.zip", s_dir);
+    test_write_file(path, z, n);
+    ZipArchive za;
+    memset(w, 0, sizeof(*w));
+    w->hash = 14695981039346656037ull;
+    w->stop_after = stop_after;
+    if (zip_open(&za, path) != 0) return -2;
+    int rc = zip_for_each_line(&za, member, walk_line, w);
+    zip_close(&za);
+    return rc;
+}
+
+static int blocks_of(const char *z, size_t n, const char *member, size_t *bytes) {
+    char path[600];
+    snprintf(path, sizeof(path), "%s/t.zip", s_dir);
+    test_write_file(path, z, n);
+    ZipArchive za;
+    Walk w;
+    memset(&w, 0, sizeof(w));
+    if (zip_open(&za, path) != 0) return -2;
+    int rc = zip_for_each_block(&za, member, walk_block, &w);
+    zip_close(&za);
+    *bytes = w.bytes;
+    return rc;
+}
+
+static uint32_t rd32(const unsigned char *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void wr32(unsigned char *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+/* Header of member in z[0..n): the central directory entry (sig "PK\1\2", name at 46) or
+ * the local one ("PK\3\4", name at 30). */
+static unsigned char *entry(char *z, size_t n, const char *member, int central) {
+    size_t name_len = strlen(member), at = central ? 46 : 30;
+    const char *sig = central ? "PK\1\2" : "PK\3\4";
+    for (size_t i = 0; i + at + name_len <= n; i++) {
+        unsigned char *e = (unsigned char *)z + i;
+        size_t len_at = central ? 28 : 26;
+        if (memcmp(e, sig, 4) == 0 && (size_t)(e[len_at] | e[len_at + 1] << 8) == name_len &&
+            memcmp(e + at, member, name_len) == 0)
+            return e;
+    }
+    return NULL;
+}
+
+/* Start of member's data in z. */
+static unsigned char *member_data(char *z, size_t n, const char *member) {
+    unsigned char *lh = entry(z, n, member, 0);
+    if (!lh) return NULL;
+    return lh + 30 + (lh[26] | lh[27] << 8) + (lh[28] | lh[29] << 8);
+}
+
+/* Every corruption of member in zip (deflated or stored) is -1 from both walks. */
+static void check_corrupt(const char *zip, size_t n, const char *member, int rows) {
+    char *z = malloc(n);
+    Walk w;
+    size_t bytes;
+    if (!z) return;
+
+    /* CRC-32 off by one bit: the data streams fine but is not what was stored */
+    memcpy(z, zip, n);
+    unsigned char *ce = entry(z, n, member, 1);
+    CHECK(ce != NULL);
+    if (!ce) { free(z); return; }
+    uint32_t comp = rd32(ce + 20), raw = rd32(ce + 24);
+    wr32(ce + 16, rd32(ce + 16) ^ 1);
+    CHECK(lines_of(z, n, member, &w, 0) == -1 && w.lines == rows);
+    CHECK(blocks_of(z, n, member, &bytes) == -1);
+    /* A walk the callback stops is not checked: it never reached the end */
+    CHECK(lines_of(z, n, member, &w, 10) == 10);
+
+    /* Central size one byte more or less than the data */
+    memcpy(z, zip, n);
+    wr32(ce + 24, raw + 1);
+    CHECK(lines_of(z, n, member, &w, 0) == -1);
+    wr32(ce + 24, raw - 1);
+    CHECK(lines_of(z, n, member, &w, 0) == -1);
+
+    /* Compressed data cut to half (a truncated download the directory does not know about) */
+    memcpy(z, zip, n);
+    wr32(ce + 20, comp / 2);
+    CHECK(lines_of(z, n, member, &w, 0) == -1 && w.lines < rows);
+    CHECK(blocks_of(z, n, member, &bytes) == -1);
+
+    /* One byte of the data flipped, at a few places */
+    for (int k = 1; k <= 3; k++) {
+        memcpy(z, zip, n);
+        unsigned char *d = member_data(z, n, member);
+        CHECK(d != NULL);
+        if (!d) break;
+        d[(size_t)comp * k / 4] ^= 0x20;
+        CHECK(lines_of(z, n, member, &w, 0) == -1);
+        CHECK(blocks_of(z, n, member, &bytes) == -1);
+    }
+    free(z);
+}
+
+/* A stop_times.txt of rows lines (header excluded) in a malloc'd buffer; every third
+ * line ends in "\r\n" when crlf is set. *header_len and *hash (of the lines as
+ * zip_for_each_line() hands them over) are set. */
+static char *stop_times(int rows, int crlf, size_t *len, size_t *header_len, uint64_t *hash) {
+    size_t cap = (size_t)rows * 64 + 64, n = 0;
+    char *body = malloc(cap);
+    if (!body) return NULL;
+    n += (size_t)snprintf(body + n, cap - n, "trip_id,arrival_time,departure_time,stop_id,stop_sequence%s",
+                          crlf ? "\r\n" : "\n");
+    *header_len = n;
+    *hash = 14695981039346656037ull;
+    for (int i = 0; i < rows; i++) {
+        char *line = body + n;
+        int m = snprintf(line, cap - n, "T%07d,%02d:%02d:00,%02d:%02d:30,%06d,%d", i, i / 60 % 30, i % 60,
+                         i / 60 % 30, i % 60, 500000 + i % 977, i % 40 + 1);
+        *hash = fnv(*hash, line, (size_t)m + 1);
+        n += (size_t)m;
+        n += (size_t)snprintf(body + n, cap - n, crlf && i % 3 == 0 ? "\r\n" : "\n");
+    }
+    *len = n;
+    return body;
+}
+
+/* A deflated member from zip_writer_add(). */
+static void check_deflated(void) {
+    char path[600];
+    size_t len = 0, header_len = 0, n = 0;
+    uint64_t hash = 0;
+    char *body = stop_times(ROWS, 1, &len, &header_len, &hash);
+    CHECK(body != NULL);
+    if (!body) return;
+    snprintf(path, sizeof(path), "%s/w.zip", s_dir);
+    ZipWriter zw;
+    CHECK(zip_writer_open(&zw, path) == 0 && zip_writer_add(&zw, "stop_times.txt", body, len) == 0 &&
+          zip_writer_add(&zw, "empty.txt", "", 0) == 0 && zip_writer_close(&zw) == 0);
+    char *zip = test_read_file(path, &n);
+    CHECK(zip != NULL);
+    if (zip) {
+        Walk w;
+        size_t bytes = 0;
+        CHECK(lines_of(zip, n, "stop_times.txt", &w, 0) == ROWS && w.lines == ROWS && w.hash == hash);
+        CHECK(blocks_of(zip, n, "stop_times.txt", &bytes) > 1 && bytes == len - header_len);
+        CHECK(lines_of(zip, n, "empty.txt", &w, 0) == 0);
+        CHECK(lines_of(zip, n, "missing.txt", &w, 0) == -1);
+        check_corrupt(zip, n, "stop_times.txt", ROWS);
+    }
+    free(zip);
+    free(body);
+}
+
+/* A stored member (shapes.txt) in a zip from Python's zipfile. */
+static void check_stored(void) {
+    char path[600], cmd[1400];
+    size_t n = 0;
+    snprintf(path, sizeof(path), "%s/py.zip", s_dir);
+    snprintf(cmd, sizeof(cmd), "python3 tools/http_standin.py gtfs-zip '%s' STORED", path);
+    CHECK(system(cmd) == 0);
+    char *zip = test_read_file(path, &n);
+    CHECK(zip != NULL);
+    if (zip) {
+        Walk w;
+        CHECK(lines_of(zip, n, "shapes.txt", &w, 0) == 6000);
+        CHECK(lines_of(zip, n, "trips.txt", &w, 0) == 4);
+        check_corrupt(zip, n, "shapes.txt", 6000);
+    }
+    free(zip);
+}
+
+/* ---- benchmark ------------------------------------------------------------------ */
+
+static int count_line(char *line, void *ctx) {
+    (void)line;
+    (*(int *)ctx)++;
+    return 0;
+}
+
+/* The path zip.c replaced: one `unzip -p` process per member, read a line at a time. */
+static int popen_lines(const char *zip, const char *member, int (*fn)(char *line, void *ctx), void *ctx) {
+    char cmd[1400], buf[2048];
+    snprintf(cmd, sizeof(cmd), "unzip -p '%s' '%s' 2>/dev/null", zip, member);
+    FILE *fp = popen(cmd, "r");
+    if (!fp) return -1;
+    if (!fgets(buf, sizeof(buf), fp)) { pclose(fp); return 0; }
+    int count = 0;
+    while (fgets(buf, sizeof(buf), fp)) {
+        size_t len = strlen(buf);
+        if (len > 0 && buf[len - 1] == '\n') buf[--len] = '\0';
+        if (fn(buf, ctx) != 0) break;
+        count++;
+    }
+    pclose(fp);
+    return count;
+}
+
+typedef struct {
+    int    lines;
+    double ms;
+    long   maxrss_kb;               /* the reading process */
+    long   child_maxrss_kb;         /* its largest child (unzip), 0 in-process */
+} BenchRun;
+
+enum { BENCH_ZIP, BENCH_UNZIP, BENCH_IDLE };
+
+/* One pass over member in a fresh child process, so each path's peak RSS is its own
+ * (BENCH_IDLE reads nothing: the process's own baseline). */
+static BenchRun bench_run(int how, const char *zip, const char *member) {
+    BenchRun r = { -1, 0, 0, 0 };
+    int fds[2];
+    if (pipe(fds) != 0) return r;
+    fflush(NULL);
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        int seen = 0;
+        double t0 = test_now_ms();
+        if (how == BENCH_UNZIP) {
+            r.lines = popen_lines(zip, member, count_line, &seen);
+        } else if (how == BENCH_ZIP) {
+            ZipArchive za;
+            if (zip_open(&za, zip) == 0) {
+                r.lines = zip_for_each_line(&za, member, count_line, &seen);
+                zip_close(&za);
+            }
+        }
+        r.ms = test_now_ms() - t0;
+        struct rusage ru;
+        getrusage(RUSAGE_SELF, &ru);
+        r.maxrss_kb = ru.ru_maxrss;
+        getrusage(RUSAGE_CHILDREN, &ru);
+        r.child_maxrss_kb = ru.ru_maxrss;
+        ssize_t wr = write(fds[1], &r, sizeof(r));
+        _exit(wr == (ssize_t)sizeof(r) ? 0 : 1);
+    }
+    close(fds[1]);
+    if (pid < 0 || read(fds[0], &r, sizeof(r)) != (ssize_t)sizeof(r)) r.lines = -1;
+    close(fds[0]);
+    if (pid > 0) waitpid(pid, NULL, 0);
+    return r;
+}
+
+static void bench(const char *zip_arg, const char *member) {
+    char zip[600];
+    if (zip_arg) {
+        snprintf(zip, sizeof(zip), "%s", zip_arg);
+    } else {
+        size_t len = 0, header_len = 0;
+        uint64_t hash = 0;
+        char *body = stop_times(BENCH_ROWS, 0, &len, &header_len, &hash);
+        ZipWriter zw;
+        snprintf(zip, sizeof(zip), "%s/bench.zip", s_dir);
+        int ok = body && zip_writer_open(&zw, zip) == 0 && zip_writer_add(&zw, member, body, len) == 0;
+        if (body && zip_writer_close(&zw) != 0) ok = 0;
+        free(body);
+        CHECK(ok);
+        if (!ok) return;
+    }
+    ZipArchive za;
+    size_t raw = 0, zip_size = 0;
+    if (zip_open(&za, zip) == 0) {
+        raw = zip_member_size(&za, member);
+        zip_size = za.size;
+        zip_close(&za);
+    }
+    if (raw == 0) {
+        fprintf(stderr, "zip_test: no member %s in %s\n", member, zip);
+        test_failures++;
+        return;
+    }
+    int have_unzip = system("unzip -v >/dev/null 2>&1") == 0;
+    BenchRun best[2] = { { -1, 1e30, 0, 0 }, { -1, 1e30, 0, 0 } };
+    for (int rep = 0; rep < BENCH_REPS; rep++) {
+        for (int k = 0; k < 1 + have_unzip; k++) {
+            BenchRun r = bench_run(k ? BENCH_UNZIP : BENCH_ZIP, zip, member);
+            if (r.ms < best[k].ms) best[k] = r;
+        }
+    }
+    BenchRun idle = bench_run(BENCH_IDLE, zip, member);
+    printf("zip bench: %s, %.1f MB, in %s of %.1f MB (best of %d)\n", member, raw / 1e6,
+           zip_arg ? zip_arg : "a synthetic zip", zip_size / 1e6, BENCH_REPS);
+    static const char *names[2] = { "zip_for_each_line", "popen(unzip -p)" };
+    for (int k = 0; k < 1 + have_unzip; k++) {
+        printf("  %-18s %9d lines %8.1f ms %7.1f MB/s  peak RSS %6.1f MB", names[k], best[k].lines, best[k].ms,
+               raw / 1e3 / best[k].ms, best[k].maxrss_kb / 1024.0);
+        if (k) printf(" + unzip %.1f MB", best[k].child_maxrss_kb / 1024.0);
+        printf("\n");
+    }
+    printf("  (a child process that reads nothing peaks at %.1f MB)\n", idle.maxrss_kb / 1024.0);
+    CHECK(best[0].lines > 0);
+    if (have_unzip) CHECK(best[1].lines == best[0].lines);
+}
+
+int main(int argc, char **argv) {
+    if (test_mkdtemp(s_dir, sizeof(s_dir), "zip") != 0) return 1;
+    if (argc >= 2 && strcmp(argv[1], "-b") == 0) {
+        bench(argc >= 3 ? argv[2] : NULL, argc >= 4 ? argv[3] : "stop_times.txt");
+        test_rmtree(s_dir);
+        return test_failures ? 1 : 0;
+    }
+    check_deflated();
+    check_stored();
+    test_rmtree(s_dir);
+    return test_done("zip_test");
+}